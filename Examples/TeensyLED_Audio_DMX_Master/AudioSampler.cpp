@@ -0,0 +1,174 @@
+// ----------------------------------------------------------------------
+//
+// TeensyLED Audio DMX Master
+// Version 0.9
+// Copyright Brian Neltner 2016
+//
+// License:
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------
+
+#include "AudioSampler.h"
+#include <string.h>
+
+AudioSampler *AudioSampler::_active = 0;
+
+AudioSampler::AudioSampler(uint8_t pin, uint32_t rate, uint8_t bits) :
+  _pin(pin),
+  _rate(rate),
+  _bits(bits),
+  _wraps(0),
+  _read(0),
+  _dropped(0) {
+  memset(_ring, 0, sizeof(_ring));
+}
+
+#if defined(__MK20DX128__) || defined(__MK20DX256__)
+
+#include <DMAChannel.h>
+
+static DMAChannel dma;
+
+// ADC0 channels of A0 to A9, as in the Teensy core.
+static const uint8_t adc0channel[] = {5, 14, 8, 9, 13, 12, 6, 7, 15, 4};
+
+// The only interrupt, once per trip round the ring.
+void AudioSampler::ringISR(void) {
+  dma.clearInterrupt();
+  _active->_wraps++;
+}
+
+void AudioSampler::begin(void) {
+  _active = this;
+  _wraps = _read = _dropped = 0;
+  
+  // Let the core set up and calibrate the ADC at 16 bits, then have the
+  // PDB start each conversion and DMA pick up each result.
+  analogReadResolution(16);
+  analogRead(_pin);
+  ADC0_SC2 |= ADC_SC2_ADTRG | ADC_SC2_DMAEN;
+  ADC0_SC3 = 0;
+  
+  dma.source(*(volatile const uint16_t *)&ADC0_RA);
+  dma.destinationBuffer(_ring, sizeof(_ring));
+  dma.triggerAtHardwareEvent(DMAMUX_SOURCE_ADC0);
+  dma.interruptAtCompletion();
+  dma.attachInterrupt(ringISR);
+  dma.enable();
+  
+  ADC0_SC1A = adc0channel[_pin < sizeof(adc0channel) ? _pin : 0];
+  
+  SIM_SCGC6 |= SIM_SCGC6_PDB;
+  PDB0_MOD = (F_BUS + _rate/2)/_rate - 1;
+  PDB0_IDLY = 1;
+  PDB0_SC = PDB_SC_TRGSEL(15) | PDB_SC_PDBEN | PDB_SC_CONT | PDB_SC_LDOK;
+  PDB0_SC = PDB_SC_TRGSEL(15) | PDB_SC_PDBEN | PDB_SC_CONT | PDB_SC_SWTRIG;
+  PDB0_CH0C1 = PDB_CH0C1_TOS(1) | PDB_CH0C1_EN(1);
+}
+
+void AudioSampler::end(void) {
+  PDB0_SC = 0;
+  dma.disable();
+  ADC0_SC2 &= ~(ADC_SC2_ADTRG | ADC_SC2_DMAEN);
+}
+
+// Samples written so far, from the trips round the ring and where in it
+// the DMA is now. The wrap count is read either side of the address in
+// case ringISR() runs in between. From the DMA wrapping until ringISR()
+// counts it, its interrupt is pending, and the address is on the next
+// trip unless it was read just before the wrap, near the end of the ring.
+// DONE is no help, as the next transfer clears it.
+uint32_t AudioSampler::written(void) {
+  uint32_t wraps, position;
+  boolean pending;
+  do {
+    wraps = _wraps;
+    position = ((uint16_t *)dma.destinationAddress() - _ring);
+    pending = (DMA_INT & (1 << dma.channel)) != 0;
+  } while (wraps != _wraps);
+  if (pending && (position < audioRingSamples/2)) wraps++;
+  return wraps*audioRingSamples + position;
+}
+
+#else
+
+// Host build. An IntervalTimer at the sample rate stands in for the PDB,
+// and each tick does what the DMA would.
+
+void AudioSampler::sampleISR(void) {
+  AudioSampler *sampler = _active;
+  sampler->_ring[sampler->_position] = analogRead(sampler->_pin);
+  if (++sampler->_position == audioRingSamples) {
+    sampler->_position = 0;
+    sampler->_wraps++;
+  }
+}
+
+void AudioSampler::begin(void) {
+  _active = this;
+  _wraps = _read = _dropped = _position = 0;
+  analogReadResolution(_bits);
+  _timer.begin(sampleISR, 1e6/_rate);
+}
+
+void AudioSampler::end(void) {
+  _timer.end();
+}
+
+uint32_t AudioSampler::written(void) {
+  return _wraps*audioRingSamples + _position;
+}
+
+#endif
+
+int AudioSampler::available(void) {
+  uint32_t unread = written() - _read;
+  if (unread > audioRingSamples - audioBlockSamples) {
+    // The DMA has caught up with the oldest block, or is about to, so
+    // move past everything that may since have been overwritten.
+    uint32_t skip = unread - (audioRingSamples - 2*audioBlockSamples);
+    skip = (skip + audioBlockSamples - 1)/audioBlockSamples*audioBlockSamples;
+    _read += skip;
+    _dropped += skip;
+    unread -= skip;
+  }
+  return unread/audioBlockSamples;
+}
+
+boolean AudioSampler::readBlock(uint16_t *block) {
+  if (available() == 0) return false;
+  const uint16_t *samples = &_ring[_read % audioRingSamples];
+#if defined(__MK20DX128__) || defined(__MK20DX256__)
+  // Conversions are 16 bits, brought down to the resolution asked for.
+  for (int i=0; i<audioBlockSamples; i++) block[i] = samples[i] >> (16 - _bits);
+#else
+  memcpy(block, samples, sizeof(uint16_t)*audioBlockSamples);
+#endif
+  _read += audioBlockSamples;
+  return true;
+}
+
+uint32_t AudioSampler::getSampleCount(void) {
+  return written();
+}
+
+uint32_t AudioSampler::getDropped(void) {
+  return _dropped;
+}
+
+uint32_t AudioSampler::getRate(void) {
+  return _rate;
+}
@@ -0,0 +1,77 @@
+// ----------------------------------------------------------------------
+//
+// TeensyLED Audio DMX Master
+// Version 0.9
+// Copyright Brian Neltner 2016
+//
+// Samples an analog input at a fixed rate in the background and hands
+// the samples to the sketch in blocks.
+//
+// On the Teensy 3.1 the PDB triggers ADC0 at the sample rate and DMA
+// copies every result into a ring buffer, so no sample depends on
+// loop() getting round in time. The sketch reads whole blocks out of
+// the ring whenever it likes; as long as it keeps up on average, a
+// stall of up to the length of the ring loses nothing. If it does fall
+// behind by more than that, the oldest samples are skipped and counted.
+//
+// License:
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <Arduino.h>
+
+// Samples per block, and blocks in the ring. 8 blocks of 128 is about
+// 23ms of audio at 44.1kHz.
+#define audioBlockSamples 128
+#define audioRingBlocks 8
+#define audioRingSamples (audioBlockSamples*audioRingBlocks)
+
+class AudioSampler {
+  private:
+    uint16_t _ring[audioRingSamples];
+    uint8_t _pin;
+    uint32_t _rate;
+    uint8_t _bits;
+    volatile uint32_t _wraps;
+    uint32_t _read;
+    uint32_t _dropped;
+    static AudioSampler *_active;
+    uint32_t written(void);
+#if !(defined(__MK20DX128__) || defined(__MK20DX256__))
+    IntervalTimer _timer;
+    uint32_t _position;
+    static void sampleISR(void);
+#else
+    static void ringISR(void);
+#endif
+  public:
+    // Analog pin as for analogRead(), samples per second, and the
+    // resolution in bits of the samples handed out.
+    AudioSampler(uint8_t pin, uint32_t rate, uint8_t bits);
+    void begin(void);
+    void end(void);
+    // Complete blocks waiting to be read.
+    int available(void);
+    // Copies out the oldest unread block. False if there is none.
+    boolean readBlock(uint16_t *block);
+    // Samples taken since begin(), and those skipped because the ring
+    // overflowed before they were read.
+    uint32_t getSampleCount(void);
+    uint32_t getDropped(void);
+    uint32_t getRate(void);
+};
@@ -0,0 +1,234 @@
+// ----------------------------------------------------------------------
+//
+// TeensyLED Audio DMX Master
+// Version 0.9
+// Copyright Brian Neltner 2016
+//
+// License:
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------
+
+#include "BeatDetector.h"
+
+BeatDetector::BeatDetector(uint32_t rate, float target, uint16_t stepMillis) :
+  _rate(rate),
+  _stepSamples((rate*stepMillis + 500)/1000),
+  _target(target) {
+  if (_stepSamples == 0) _stepSamples = 1;
+  reset();
+}
+
+void BeatDetector::reset(void) {
+  // The audio zero starts at roughly mid-scale. Once you get some info on
+  // what your board signal levels look like the starting values can be
+  // shifted to get to where the board is working well sooner.
+  
+  _audioZero = (int64_t)audioZeroStart << 32;
+  _audioRMSMax = audioRMSMaxStart;
+  _dThreshold = dThresholdStart;
+  _lightDecayPeriod = lightDecayPeriodStart;
+  _audioRMSFiltered = 0;
+  _daudioRMSFiltered = 0;
+  _beatCountsFiltered = 0;
+  _beatCounts = 0;
+  
+  _samples = 0;
+  _stepPosition = 0;
+  _tunePosition = 0;
+  _stepBeat = false;
+  _stepBeatSample = 0;
+  _peakBeatVolume = 0;
+  _beat = false;
+  _beatSample = 0;
+  _beatVolume = 0;
+  _tuned = false;
+}
+
+void BeatDetector::process(const uint16_t *samples, int count) {
+  while (count > 0) {
+    // Run up to the end of the current step at most, so that the
+    // bookkeeping is once a step rather than once a sample.
+    
+    uint32_t n = _stepSamples - _stepPosition;
+    if (n > (uint32_t)count) n = count;
+    
+    for (uint32_t i=0; i<n; i++) {
+      float audioSignal = samples[i];
+      
+      // Use exponential smoothing to capture the DC offset. This is using
+      // the pure audio signal which should always have a stable DC offset
+      // due to being capacitively coupled to the analog input.
+      
+      // The Cortex-M4 only has a single precision FPU, and double
+      // constants would have every sample go through software floating
+      // point. A float zero stalls, though, as a millionth of the
+      // difference is under half a float step at 4096 until the zero is
+      // hundreds off. So this one filter is fixed point, with 0.000001
+      // as 281474977/2^48, and gives what the doubles did:
+      //
+      //   audioZero = 0.999999*audioZero + 0.000001*audioSignal;
+      
+      int64_t delta = ((int64_t)samples[i] << 32) - _audioZero;
+      _audioZero += ((delta >> 16)*281474977) >> 32;
+      float audioZero = (uint32_t)(_audioZero >> 16)*(1.0f/65536);
+      
+      // Use the audioZero to calculate the RMS audio signal. This gives
+      // the volume of the audio rather than an AC signal that is hard
+      // to interpret. The RMS of a single sample is just its magnitude,
+      // so this is fabs() rather than sqrt(pow()).
+      
+      float audioRMS = fabsf(audioSignal - audioZero);
+      float oldaudioRMSFiltered = _audioRMSFiltered;
+      _audioRMSFiltered = 0.99f*_audioRMSFiltered + 0.01f*audioRMS;
+      
+      // If the audioRMSFiltered value exceeds the previously seen maximum,
+      // set the audioRMSMax to the new value.
+      
+      if (_audioRMSFiltered > _audioRMSMax) _audioRMSMax = _audioRMSFiltered;
+      
+      // but every sample, drag the audioRMSMax back towards zero so
+      // that it doesn't only ever grow larger when it sees a volume increase.
+      
+      _audioRMSMax = 0.99999f*_audioRMSMax + 0.00001f*audioRMSMaxStart;
+      
+      // Next we need the rough derivitive of the piece, so we take the
+      // current audioRMSFiltered value and subtract the immediately prior
+      // sample. Very light exponential smoothing to avoid false pops.
+      
+      _daudioRMSFiltered = 0.99f*_daudioRMSFiltered + 0.01f*(_audioRMSFiltered - oldaudioRMSFiltered);
+      
+      // and if the daudioRMSFiltered is higher than the threshold, there
+      // is a beat in this step.
+      
+      if (_daudioRMSFiltered > _dThreshold) {
+        if (!_stepBeat) {
+          _stepBeat = true;
+          _stepBeatSample = _samples + i;
+        }
+        
+        // The derivitive might exceed the threshold for several samples, so only
+        // save the peak volume over the beat to set the light brightness peak during
+        // that flash.
+        
+        float volume = _audioRMSFiltered/_audioRMSMax;
+        if (volume > _peakBeatVolume) _peakBeatVolume = (volume < 1) ? volume : 1;
+      }
+    }
+    
+    samples += n;
+    count -= n;
+    _samples += n;
+    _stepPosition += n;
+    _tunePosition += n;
+    if (_stepPosition == _stepSamples) endStep();
+    if (_tunePosition >= _rate) tune();
+  }
+}
+
+// Counts a beat at most once a step, which also debounces beats too close
+// together to be told apart by eye.
+void BeatDetector::endStep(void) {
+  _stepPosition = 0;
+  if (!_stepBeat) return;
+  _stepBeat = false;
+  _beatCounts++;
+  if (!_beat) {
+    _beat = true;
+    _beatSample = _stepBeatSample;
+    _beatVolume = _peakBeatVolume;
+  }
+  else if (_peakBeatVolume > _beatVolume) _beatVolume = _peakBeatVolume;
+  _peakBeatVolume = 0;
+}
+
+// Once a second of audio, some automatic fudging of the beat detection threshold
+// and the time decay constant for the light to return to normal after a beat
+// to help compensate for quiet/classical/ambient music versus electronica.
+// The general idea is that if the threshold is pushed high because the song
+// has lots of light beats that would be too confusing to see if they were
+// all detected, the length of time of a light pulse up and back down is shorter
+// since the song overall sounds much more rhythmic and drummy.
+void BeatDetector::tune(void) {
+  _tunePosition -= _rate;
+  
+  _beatCountsFiltered = 0.7*_beatCountsFiltered + 0.3*(float)_beatCounts;
+  if (_beatCountsFiltered < 0.1) _beatCountsFiltered = 0.1;
+  
+  _dThreshold = _dThreshold + 0.05*(_beatCountsFiltered - _target);
+  if (_dThreshold < dThresholdMin) _dThreshold = dThresholdMin;
+  
+  _lightDecayPeriod = (dThresholdMin/_dThreshold)*300;
+  if (_lightDecayPeriod < 30) _lightDecayPeriod = 30;
+  
+  _beatCounts = 0;
+  _tuned = true;
+}
+
+boolean BeatDetector::beatDetected(void) {
+  boolean beat = _beat;
+  _beat = false;
+  return beat;
+}
+
+float BeatDetector::getBeatVolume(void) {
+  return _beatVolume;
+}
+
+uint32_t BeatDetector::getBeatSample(void) {
+  return _beatSample;
+}
+
+boolean BeatDetector::tuned(void) {
+  boolean tuned = _tuned;
+  _tuned = false;
+  return tuned;
+}
+
+float BeatDetector::getThreshold(void) {
+  return _dThreshold;
+}
+
+float BeatDetector::getDecayPeriod(void) {
+  return _lightDecayPeriod;
+}
+
+float BeatDetector::getBeatsPerSecond(void) {
+  return _beatCountsFiltered;
+}
+
+void BeatDetector::setTarget(float target) {
+  _target = target;
+}
+
+float BeatDetector::getTarget(void) {
+  return _target;
+}
+
+float BeatDetector::getZero(void) {
+  return (uint32_t)(_audioZero >> 16)*(1.0f/65536);
+}
+
+float BeatDetector::getRMS(void) {
+  return _audioRMSFiltered;
+}
+
+float BeatDetector::getRMSMax(void) {
+  return _audioRMSMax;
+}
+
+uint32_t BeatDetector::getSampleCount(void) {
+  return _samples;
+}
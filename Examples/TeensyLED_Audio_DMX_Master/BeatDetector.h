@@ -0,0 +1,115 @@
+// ----------------------------------------------------------------------
+//
+// TeensyLED Audio DMX Master
+// Version 0.9
+// Copyright Brian Neltner 2016
+//
+// The beat detector from the audio analysis effect: DC offset and RMS
+// tracking, volume normalization, the thresholded derivative of the
+// RMS signal, and the once a second tuning of the threshold towards a
+// target number of beats per second.
+//
+// Everything is timed by counting samples rather than by the clock,
+// so the detector gives the same answer for the same audio whether it
+// runs live from the sampler or from a recording on a desktop, and
+// however late loop() gets round to it. Beats are gathered into steps,
+// 10ms by default, so that beats closer together than that count once.
+//
+// License:
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <Arduino.h>
+
+// Starting points for the audio DC offset, the lowest allowable RMS
+// maximum, the starting and minimum threshold for a change in RMS to
+// be considered a beat, and the starting light decay period in ms.
+
+#define audioZeroStart 4096
+#define audioRMSMaxStart 100
+#define dThresholdStart 10
+#define dThresholdMin 1
+#define lightDecayPeriodStart 100
+
+class BeatDetector {
+  private:
+    uint32_t _rate;
+    uint32_t _stepSamples;
+    float _target;
+    
+    // Filtered signals. The zero is in Q32 fixed point, as a float can
+    // not hold it to a millionth of a step.
+    int64_t _audioZero;
+    float _audioRMSFiltered;
+    float _audioRMSMax;
+    float _daudioRMSFiltered;
+    
+    // Tuning, updated once a second.
+    float _dThreshold;
+    float _lightDecayPeriod;
+    float _beatCountsFiltered;
+    unsigned int _beatCounts;
+    
+    // Samples seen, and how far into the current step and second.
+    uint32_t _samples;
+    uint32_t _stepPosition;
+    uint32_t _tunePosition;
+    
+    // The beat in the current step, if any.
+    boolean _stepBeat;
+    uint32_t _stepBeatSample;
+    float _peakBeatVolume;
+    
+    // Beats and tuning not yet picked up by the sketch.
+    boolean _beat;
+    uint32_t _beatSample;
+    float _beatVolume;
+    boolean _tuned;
+    
+    void endStep(void);
+    void tune(void);
+  public:
+    // Samples per second of the audio, the target number of beats per
+    // second, and the length of a step in ms.
+    BeatDetector(uint32_t rate, float target = 6, uint16_t stepMillis = 10);
+    void reset(void);
+    
+    // Runs the analysis over count samples, mid-scale centered as they
+    // come from the ADC.
+    void process(const uint16_t *samples, int count);
+    
+    // True once for each beat since the last call, with the volume of
+    // the loudest beat normalized to 0 to 1, and the sample at which
+    // the first of them started.
+    boolean beatDetected(void);
+    float getBeatVolume(void);
+    uint32_t getBeatSample(void);
+    
+    // True once after each time the threshold is tuned.
+    boolean tuned(void);
+    float getThreshold(void);
+    float getDecayPeriod(void);
+    float getBeatsPerSecond(void);
+    void setTarget(float target);
+    float getTarget(void);
+    
+    float getZero(void);
+    float getRMS(void);
+    float getRMSMax(void);
+    uint32_t getSampleCount(void);
+};
@@ -0,0 +1,238 @@
+// ----------------------------------------------------------------------
+//
+// TeensyLED Audio DMX Master
+// Version 0.9
+// Copyright Brian Neltner 2016
+//
+// License:
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------
+
+#include "DmxTransmitter.h"
+#include <string.h>
+
+// The line itself. lineBreak() and lineMark() hold the TX pin low or
+// high, lineSend() hands a frame to the UART and calls done once the
+// last byte has been queued, and lineIdle() says when it is fully out.
+
+#if defined(__MK20DX128__) || defined(__MK20DX256__)
+
+#include <DMAChannel.h>
+
+static DMAChannel dma;
+static void (*dmadone)(void);
+
+static void dmaISR(void) {
+  dma.clearInterrupt();
+  UART0_C2 &= ~UART_C2_TIE;
+  dmadone();
+}
+
+static void lineBegin(void) {
+  // Serial1 sets the baud rate and format, then the UART's transmit
+  // requests go to DMA instead of its interrupt.
+  Serial1.begin(250000, SERIAL_8N2);
+  UART0_C5 |= UART_C5_TDMAS;
+  dma.destination(UART0_D);
+  dma.triggerAtHardwareEvent(DMAMUX_SOURCE_UART0_TX);
+  dma.interruptAtCompletion();
+  dma.disableOnCompletion();
+  dma.attachInterrupt(dmaISR);
+  pinMode(1, OUTPUT);
+}
+
+static void lineEnd(void) {
+  dma.disable();
+  UART0_C2 &= ~UART_C2_TIE;
+  UART0_C5 &= ~UART_C5_TDMAS;
+  Serial1.end();
+}
+
+// The break and mark are made with the pin as GPIO, which leaves the
+// UART's baud rate alone.
+static void lineBreak(void) {
+  CORE_PIN1_CONFIG = PORT_PCR_DSE | PORT_PCR_SRE | PORT_PCR_MUX(1);
+  digitalWriteFast(1, LOW);
+}
+
+static void lineMark(void) {
+  digitalWriteFast(1, HIGH);
+}
+
+static void lineSend(const uint8_t *data, int length, void (*done)(void)) {
+  dmadone = done;
+  CORE_PIN1_CONFIG = PORT_PCR_DSE | PORT_PCR_SRE | PORT_PCR_MUX(3);
+  dma.sourceBuffer(data, length);
+  dma.enable();
+  UART0_C2 |= UART_C2_TIE;
+}
+
+static boolean lineIdle(void) {
+  return UART0_S1 & UART_S1_TC;
+}
+
+#else
+
+// Host build. The line is recorded with TeensyHost::lineEvent() and the
+// DMA transfer is timed with an IntervalTimer of its own.
+
+#include "TeensyHost.h"
+
+static TeensyHost::LineState linestate;
+static uint64_t linesince, lastbyteend;
+static IntervalTimer dmatimer;
+static void (*dmadone)(void);
+
+static void lineTo(TeensyHost::LineState state) {
+  uint64_t now = TeensyHost::nanos();
+  if (now > linesince) {
+    TeensyHost::LineEvent event = {linesince, now, linestate, 0};
+    TeensyHost::lineEvent(event);
+  }
+  linestate = state;
+  linesince = now;
+}
+
+static void dmaISR(void) {
+  dmatimer.end();
+  dmadone();
+}
+
+static void lineBegin(void) {
+  linestate = TeensyHost::LineMark;
+  linesince = lastbyteend = TeensyHost::nanos();
+}
+
+static void lineEnd(void) {
+  dmatimer.end();
+}
+
+static void lineBreak(void) {
+  lineTo(TeensyHost::LineBreak);
+}
+
+static void lineMark(void) {
+  lineTo(TeensyHost::LineMark);
+}
+
+// The bytes are all recorded up front, since their timing is fixed
+// once the DMA starts. It runs dry as the last one starts to go out.
+static void lineSend(const uint8_t *data, int length, void (*done)(void)) {
+  lineTo(TeensyHost::LineMark);
+  uint64_t t = TeensyHost::nanos();
+  for (int i=0; i<length; i++) {
+    TeensyHost::LineEvent event = {t, t + DMXSlotMicros*1000, TeensyHost::LineByte, data[i]};
+    TeensyHost::lineEvent(event);
+    t += DMXSlotMicros*1000;
+  }
+  linesince = lastbyteend = t;
+  dmadone = done;
+  dmatimer.begin(dmaISR, (length-1)*DMXSlotMicros);
+}
+
+static boolean lineIdle(void) {
+  return TeensyHost::nanos() >= lastbyteend;
+}
+
+#endif
+
+DmxTransmitter *DmxTransmitter::_active = 0;
+
+DmxTransmitter::DmxTransmitter(int channels) :
+  _front(0),
+  _swappending(false),
+  _frames(0) {
+  _channels = channels<DMXMinChannels?DMXMinChannels:(channels>DMXMaxChannels?DMXMaxChannels:channels);
+  memset(_buffers, 0, sizeof(_buffers));
+}
+
+void DmxTransmitter::begin(void) {
+  _active = this;
+  lineBegin();
+  startFrame();
+}
+
+void DmxTransmitter::end(void) {
+  _timer.end();
+  lineEnd();
+  _active = 0;
+}
+
+uint8_t *DmxTransmitter::getBuffer(void) {
+  // Slot 0 is the start code.
+  return &_buffers[_front ^ 1][1];
+}
+
+void DmxTransmitter::write(int channel, uint8_t value) {
+  if ((channel < 1) || (channel > _channels)) return;
+  _buffers[_front ^ 1][channel] = value;
+}
+
+void DmxTransmitter::swap(void) {
+  _swappending = true;
+}
+
+boolean DmxTransmitter::isSwapPending(void) {
+  return _swappending;
+}
+
+unsigned long DmxTransmitter::getFrameCount(void) {
+  return _frames;
+}
+
+int DmxTransmitter::getChannels(void) {
+  return _channels;
+}
+
+// Each step of the frame starts the next from its interrupt: break,
+// mark after break, the DMA transfer, then waiting out the last bytes
+// still in the UART before the next break.
+
+void DmxTransmitter::startFrame(void) {
+  lineBreak();
+  _timer.begin(breakDone, DMXBreakMicros);
+}
+
+void DmxTransmitter::breakDone(void) {
+  lineMark();
+  _active->_timer.end();
+  _active->_timer.begin(markDone, DMXMarkMicros);
+}
+
+void DmxTransmitter::markDone(void) {
+  DmxTransmitter *dmx = _active;
+  dmx->_timer.end();
+  lineSend(dmx->_buffers[dmx->_front], dmx->_channels + 1, dataDone);
+}
+
+void DmxTransmitter::dataDone(void) {
+  _active->_timer.begin(drainCheck, DMXSlotMicros);
+}
+
+void DmxTransmitter::drainCheck(void) {
+  DmxTransmitter *dmx = _active;
+  if (!lineIdle()) return;
+  dmx->_timer.end();
+  dmx->_frames++;
+  if (dmx->_swappending) {
+    // The new front goes out from the next break, and the back buffer
+    // starts from it so that single channel writes carry on from there.
+    dmx->_front ^= 1;
+    memcpy(dmx->_buffers[dmx->_front ^ 1], dmx->_buffers[dmx->_front], dmx->_channels + 1);
+    dmx->_swappending = false;
+  }
+  dmx->startFrame();
+}
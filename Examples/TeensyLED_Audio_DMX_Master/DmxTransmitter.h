@@ -0,0 +1,75 @@
+// ----------------------------------------------------------------------
+//
+// TeensyLED Audio DMX Master
+// Version 0.9
+// Copyright Brian Neltner 2016
+//
+// A DMX-512 transmitter for the Teensy 3.1 that sends frames from
+// Serial1 (TX on pin 1) with DMA, so the CPU only sees a handful of
+// short interrupts per frame instead of bit-banging every slot.
+//
+// Frames are sent continuously from a front buffer while the sketch
+// fills the back buffer. swap() asks for the back buffer to go out,
+// and the exchange happens at the end of the frame on the wire, so a
+// frame is never sent half old and half new.
+//
+// Each frame is a 180us break, a 20us mark after break, the start
+// code and then the channels at 250 kbaud with two stop bits.
+//
+// License:
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <Arduino.h>
+
+#define DMXBreakMicros 180
+#define DMXMarkMicros 20
+#define DMXSlotMicros 44
+
+// DMX-512 needs at least 1204us from break to break, which 24 channels
+// already take, so shorter frames are padded out to that.
+#define DMXMinChannels 24
+#define DMXMaxChannels 512
+
+class DmxTransmitter {
+  private:
+    uint8_t _buffers[2][DMXMaxChannels+1];
+    volatile uint8_t _front;
+    volatile boolean _swappending;
+    volatile unsigned long _frames;
+    int _channels;
+    IntervalTimer _timer;
+    static DmxTransmitter *_active;
+    void startFrame(void);
+    static void breakDone(void);
+    static void markDone(void);
+    static void dataDone(void);
+    static void drainCheck(void);
+  public:
+    DmxTransmitter(int channels);
+    void begin(void);
+    void end(void);
+    // The back buffer, channel 1 first. Only write it while no swap is
+    // pending.
+    uint8_t *getBuffer(void);
+    void write(int channel, uint8_t value);
+    void swap(void);
+    boolean isSwapPending(void);
+    unsigned long getFrameCount(void);
+    int getChannels(void);
+};
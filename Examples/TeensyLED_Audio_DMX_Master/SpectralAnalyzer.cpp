@@ -0,0 +1,179 @@
+// ----------------------------------------------------------------------
+//
+// TeensyLED Audio DMX Master
+// Version 0.9
+// Copyright Brian Neltner 2016
+//
+// License:
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------
+
+#include "SpectralAnalyzer.h"
+#include "AudioSampler.h"
+#include <math.h>
+
+// Q15 multiply. The Cortex-M4 does the 64-bit product in one cycle.
+static inline int32_t mulQ15(int32_t a, int32_t b) {
+  return (int32_t)(((int64_t)a*b) >> 15);
+}
+
+SpectralAnalyzer::SpectralAnalyzer(uint32_t rate) :
+  _rate(rate) {
+  // Chamberlin state variable filters, with f = 2sin(pi*fc/fs) and the
+  // damping for a Butterworth response, 1/Q = sqrt(2).
+  _bassF = lrintf(2*sinf(M_PI*bassCrossover/rate)*32768);
+  _highF = lrintf(2*sinf(M_PI*highCrossover/rate)*32768);
+  _damping = lrintf(sqrtf(2)*32768);
+  
+  float blockMillis = 1000.0f*audioBlockSamples/rate;
+  _averageCoefficient = blockMillis/bandAverageMillis;
+  _maxCoefficient = 1 - blockMillis/bandMaxMillis;
+  _holdSamples = (uint32_t)rate*onsetHoldMillis/1000;
+  reset();
+}
+
+void SpectralAnalyzer::reset(void) {
+  // The DC offset starts at mid-scale, as for BeatDetector.
+  _zero = 4096 << 16;
+  _bassLow = _bassBand = _highLow = _highBand = _midLow = _midBand = 0;
+  _blockPosition = 0;
+  _samples = 0;
+  for (int b=0; b<audioBands; b++) {
+    _sums[b] = 0;
+    _level[b] = 0;
+    _average[b] = 0;
+    _max[b] = bandMaxStart;
+    _lastOnset[b] = 0;
+    _onset[b] = false;
+    _onsetVolume[b] = 0;
+    _onsetSample[b] = 0;
+  }
+}
+
+void SpectralAnalyzer::process(const uint16_t *samples, int count) {
+  while (count > 0) {
+    uint32_t n = audioBlockSamples - _blockPosition;
+    if (n > (uint32_t)count) n = count;
+    
+    // Locals, so that the state stays in registers across the block.
+    int32_t zero = _zero;
+    int32_t bassLow = _bassLow, bassBand = _bassBand;
+    int32_t highLow = _highLow, highBand = _highBand;
+    int32_t midLow = _midLow, midBand = _midBand;
+    uint32_t bassSum = _sums[BassBand], midSum = _sums[MidBand], highSum = _sums[HighBand];
+    
+    for (uint32_t i=0; i<n; i++) {
+      // Remove the DC offset with a one pole high pass of about 3Hz,
+      // leaving Q8 ADC counts.
+      int32_t sample = (int32_t)samples[i] << 16;
+      zero += (sample - zero) >> 14;
+      int32_t x = (sample - zero) >> 8;
+      
+      // Bass is the low pass output at the bass crossover.
+      bassLow += mulQ15(_bassF, bassBand);
+      int32_t bassHigh = x - bassLow - mulQ15(_damping, bassBand);
+      bassBand += mulQ15(_bassF, bassHigh);
+      
+      // High is the high pass output at the high crossover.
+      highLow += mulQ15(_highF, highBand);
+      int32_t high = x - highLow - mulQ15(_damping, highBand);
+      highBand += mulQ15(_highF, high);
+      
+      // And mid is the low pass output of that, high passed at the bass
+      // crossover, so that it falls off as steeply either side.
+      midLow += mulQ15(_bassF, midBand);
+      int32_t mid = highLow - midLow - mulQ15(_damping, midBand);
+      midBand += mulQ15(_bassF, mid);
+      
+      bassSum += abs(bassLow);
+      midSum += abs(mid);
+      highSum += abs(high);
+    }
+    
+    _zero = zero;
+    _bassLow = bassLow;
+    _bassBand = bassBand;
+    _highLow = highLow;
+    _highBand = highBand;
+    _midLow = midLow;
+    _midBand = midBand;
+    _sums[BassBand] = bassSum;
+    _sums[MidBand] = midSum;
+    _sums[HighBand] = highSum;
+    
+    samples += n;
+    count -= n;
+    _samples += n;
+    _blockPosition += n;
+    if (_blockPosition == audioBlockSamples) endBlock();
+  }
+}
+
+void SpectralAnalyzer::endBlock(void) {
+  _blockPosition = 0;
+  for (int b=0; b<audioBands; b++) {
+    float level = _sums[b]*(1.0f/(256*audioBlockSamples));
+    _sums[b] = 0;
+    _level[b] = level;
+    
+    // The loudest level lately, immediately following increases and
+    // decaying back down over a few seconds.
+    _max[b] = _max[b]*_maxCoefficient;
+    if (_max[b] < bandMaxStart) _max[b] = bandMaxStart;
+    if (level > _max[b]) _max[b] = level;
+    
+    if ((level > onsetRatio*_average[b]) && (level > onsetFloor*_max[b]) &&
+        (_samples - _lastOnset[b] >= _holdSamples)) {
+      _lastOnset[b] = _samples;
+      float volume = level/_max[b];
+      if (!_onset[b]) {
+        _onset[b] = true;
+        _onsetSample[b] = _samples;
+        _onsetVolume[b] = volume;
+      }
+      else if (volume > _onsetVolume[b]) _onsetVolume[b] = volume;
+    }
+    
+    _average[b] += _averageCoefficient*(level - _average[b]);
+  }
+}
+
+float SpectralAnalyzer::getLevel(AudioBand band) {
+  float level = _level[band]/_max[band];
+  return (level < 1) ? level : 1;
+}
+
+float SpectralAnalyzer::getEnergy(AudioBand band) {
+  return _level[band];
+}
+
+boolean SpectralAnalyzer::onsetDetected(AudioBand band) {
+  boolean onset = _onset[band];
+  _onset[band] = false;
+  return onset;
+}
+
+float SpectralAnalyzer::getOnsetVolume(AudioBand band) {
+  return _onsetVolume[band];
+}
+
+uint32_t SpectralAnalyzer::getOnsetSample(AudioBand band) {
+  return _onsetSample[band];
+}
+
+uint32_t SpectralAnalyzer::getSampleCount(void) {
+  return _samples;
+}
@@ -0,0 +1,118 @@
+// ----------------------------------------------------------------------
+//
+// TeensyLED Audio DMX Master
+// Version 0.9
+// Copyright Brian Neltner 2016
+//
+// Splits the audio into bass, mid and high bands and detects onsets in
+// each separately, so that different lights can follow the kick drum,
+// the vocals and the hi-hats.
+//
+// The split is three state variable filters in fixed point: a low pass
+// at the bass crossover, a high pass at the high crossover, and the
+// low pass output of that high passed at the bass crossover for the
+// mid band, each 12dB an octave. That is a few integer multiplies a
+// sample, against the several thousand an FFT of each block would
+// take, and gives the energy in each band directly. Everything after
+// that runs once a block.
+//
+// Like BeatDetector, it is timed by counting samples.
+//
+// License:
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <Arduino.h>
+
+enum AudioBand {BassBand = 0, MidBand = 1, HighBand = 2};
+#define audioBands 3
+
+// Crossover frequencies in Hz.
+#define bassCrossover 200
+#define highCrossover 2000
+
+// An onset is a band's level jumping to onsetRatio times its recent
+// average, when that is also at least onsetFloor of the loudest it has
+// been lately. Onsets closer together than onsetHoldMillis count once.
+#define onsetRatio 1.8
+#define onsetFloor 0.2
+#define onsetHoldMillis 60
+
+// Time constants of the recent average and of the loudest level's
+// decay, in ms.
+#define bandAverageMillis 150
+#define bandMaxMillis 5000
+
+// Lowest loudest level, in ADC counts, so that silence is not stretched
+// up to full scale.
+#define bandMaxStart 20
+
+class SpectralAnalyzer {
+  private:
+    uint32_t _rate;
+    
+    // Filter coefficients in Q15, and state. Samples are handled as Q8
+    // ADC counts with the DC offset removed.
+    int32_t _bassF, _highF, _damping;
+    int32_t _zero;
+    int32_t _bassLow, _bassBand;
+    int32_t _highLow, _highBand;
+    int32_t _midLow, _midBand;
+    
+    // Magnitude summed over the block so far, per band.
+    uint32_t _sums[audioBands];
+    uint32_t _blockPosition;
+    uint32_t _samples;
+    
+    // Per band levels, once a block.
+    float _averageCoefficient, _maxCoefficient;
+    uint32_t _holdSamples;
+    float _level[audioBands];
+    float _average[audioBands];
+    float _max[audioBands];
+    uint32_t _lastOnset[audioBands];
+    
+    // Onsets not yet picked up by the sketch.
+    boolean _onset[audioBands];
+    float _onsetVolume[audioBands];
+    uint32_t _onsetSample[audioBands];
+    
+    void endBlock(void);
+  public:
+    // Samples per second of the audio.
+    SpectralAnalyzer(uint32_t rate);
+    void reset(void);
+    
+    // Runs the filters over count samples, mid-scale centered as they
+    // come from the ADC. Band levels update every audioBlockSamples.
+    void process(const uint16_t *samples, int count);
+    
+    // A band's level over the last block, 0 to 1 of the loudest it has
+    // been lately.
+    float getLevel(AudioBand band);
+    // Its level in ADC counts, the mean magnitude over the block.
+    float getEnergy(AudioBand band);
+    
+    // True once for each onset in a band since the last call, with the
+    // loudest onset's level and the sample ending the block it was in.
+    boolean onsetDetected(AudioBand band);
+    float getOnsetVolume(AudioBand band);
+    uint32_t getOnsetSample(AudioBand band);
+    
+    uint32_t getSampleCount(void);
+};
@@ -81,15 +81,22 @@
 // arranged in a color wheel so that the entire array rotates around while
 // pulsing synchronously.
 //
+// With SPECTRAL defined, SpectralAnalyzer splits the audio into bass, mid
+// and high bands instead, with crossovers at 200Hz and 2kHz, and each
+// light follows one band: it flashes on onsets in that band and its hue
+// runs ahead while that band is loud, so the kick drum, vocals and
+// hi-hats show up on different lights.
+//
 // This rough algorithm was first demonstrated in 2013:
 // http://blog.saikoled.com/post/44823088119/myki-prototype-with-direct-audio-analysis
 // and the improved algorithm below was first demonstrated in 2016 at the
 // Firefly Arts Festival.
 //
-// This software requires the DmxSimple library which uses bit-banging of
-// DMX outputs and does not support RDM or other advanced DMX features.
-// However, the ADM2582E and Teensy 3.1 should be perfectly capable of using
-// these features if a better library becomes available.
+// DMX is sent by DmxTransmitter, included with this example, which drives
+// the hardware UART on pin 1 with DMA so that sending frames takes almost
+// no CPU time away from audio sampling. It does not support RDM or other
+// advanced DMX features, though the ADM2582E and Teensy 3.1 should be
+// perfectly capable of them.
 //
 // Filtering is used throughout this code, using explonential smoothing as a
 // very fast and simple way to accomplish a low-pass filter.
@@ -109,8 +116,9 @@
 // I am not good at C flags, but there are commented out serial communication
 // lines that can be uncommented for debug information (for instance, printing
 // the audio RMS values and beat detection values for tuning and debugging
-// audio signal issues). Some of this should probably be better encapsulated
-// in a C++ style class to reduce the unabstracted complexity of the effects.
+// audio signal issues). The beat detection itself is in BeatDetector, which
+// counts samples rather than time so that it can be tuned against recordings
+// on a desktop with the teensyled_wav host tool.
 //
 // License:
 //
@@ -129,69 +137,81 @@
 //
 // ----------------------------------------------------------------------
 
-#include <DmxSimple.h>
+#include "AudioSampler.h"
+#include "BeatDetector.h"
+#include "DmxTransmitter.h"
+#include "SpectralAnalyzer.h"
+#include "hsi2rgb.h"
+
+// Uncomment to have each light follow one band of the audio, bass, mid
+// or high, rather than all of them pulsing on the broadband beat. Each
+// light then flashes on onsets in its band and its hue runs ahead while
+// its band is loud.
 
-// Starting points for the audio DC offset, the lowest allowable audioRMSMax value,
-// the starting threshold for a delta audio to be considered a beat, the minimum
-// LED intensity, the target number of beats per second, the timestep between
-// light setpoint updates, and the amount of hue change per second in degrees.
+//#define SPECTRAL
+
+// The minimum LED intensity, the target number of beats per second, the
+// timestep between light setpoint updates, and the amount of hue change
+// per second in degrees. The starting points for the beat detector's own
+// filters are in BeatDetector.h.
 
-#define audioZeroStart 4096
-#define audioRMSMaxStart 100
-#define dThresholdStart 10
-#define dThresholdMin 1
 #define intensityMin 0.05
-#define lightDecayPeriodStart 100
 #define bpsTarget 6
 #define timestep 10
 #define hueStepPerSecond 60
 
+// The number of RGB lights on the DMX universe, at three channels each.
+// A full universe of 512 channels holds 170.
+
+#define numLights 8
+
 // The initial hues of each light. In this example there are eight
 // RGB lights in the DMX universe numbered in the typical fashion
-// with the first light using DMX Channel 0 for red, Channel 1 for
-// green, Channel 2 for blue, and then the second light doing the
-// same starting with DMX Channel 3 for red. I used here fully
-// saturated colors, so did not need to keep track of the saturation.
+// with the first light using DMX Channel 1 for red, Channel 2 for
+// green, Channel 3 for blue, and then the second light doing the
+// same starting with DMX Channel 4 for red. I used here fully
+// saturated colors, so the saturations are all left at 1.
 
-float huearray[8] = {0, 45, 90, 135, 180, 225, 270, 315};
-float intensityarray[8] = {intensityMin, intensityMin, intensityMin, intensityMin, intensityMin, intensityMin, intensityMin, intensityMin};
+float huearray[numLights] = {0, 45, 90, 135, 180, 225, 270, 315};
+float saturationarray[numLights] = {1, 1, 1, 1, 1, 1, 1, 1};
+float intensityarray[numLights] = {intensityMin, intensityMin, intensityMin, intensityMin, intensityMin, intensityMin, intensityMin, intensityMin};
 
-// Flag to indicate that a beat has been detected. Beats are only
-// recognized every DMX update (10ms default) which incidentally also
-// manages debouncing to avoid confusing visual effects.
+#ifdef SPECTRAL
+// The band each light follows, and the extra hue change per second in
+// degrees while that band is at full level.
 
-boolean beatdetected;
+AudioBand bandarray[numLights] = {BassBand, MidBand, HighBand, BassBand, MidBand, HighBand, BassBand, MidBand};
+#define spectralHueStepPerSecond 120
+#endif
 
-// Global variables to store filtered versions of signals and beat counts for
-// auto-tuning. Also has decay periods for LED turn-off and the beat detection
-// threshold which are varied slightly to adjust for different music genres.
+// Set up audio sampling on A0 at 44.1kHz with 13 bits, the noise floor
+// of the Teensy 3.1 ADC. In all honesty, this high of a speed is
+// unnecessary to get excellent results, but your filter time constants
+// will need changing to match different sampling rates. Samples are
+// taken in the background and come back in blocks, so nothing else in
+// loop() can make them late or drop them.
 
-float daudioRMSFiltered;
-float dThreshold;
-unsigned int beatCounts;
-float beatCountsFiltered;
-float lightDecayPeriod;
-float audioRMSFiltered;
-float audioRMSMax;
-float audioZero;
-float peakBeatVolume;
+#define audioSampleRate 44100
 
-// Set up a timer for audio sampling rate. 44.1kHz is roughly 22us.
-// In all honesty, this high of a speed is unnecessary to get excellent
-// results, but your filter time constants will need changing to
-// match different sampling rates.
+AudioSampler sampler(0, audioSampleRate, 13);
 
-elapsedMicros audioSamplingTimer;
+// The beat detector, which gathers beats into steps of the same length
+// as the light updates and tunes its threshold towards bpsTarget.
 
-// Set up a timer to periodically see how we're doing on getting a
-// pleasant number of light flashes per beat analysis period.
+BeatDetector detector(audioSampleRate, bpsTarget, timestep);
 
-elapsedMillis beatTimer;
+#ifdef SPECTRAL
+SpectralAnalyzer analyzer(audioSampleRate);
+#endif
 
 // Set up a timer for actually sending updates to LED lights.
 
 elapsedMillis sendtimer;
 
+// The DMX output, on Serial1 whose TX is pin 1.
+
+DmxTransmitter dmx(3*numLights);
+
 void setup() {
   // I like to delay for a second so that serial is up and running before
   // the code starts in earnest.
@@ -199,23 +219,14 @@ void setup() {
   delay(1000);
   Serial.println("TeensyLED Audio Analysis System Operational.");
   
-  // Setup for the DMX Simple Library. Pin 1 is the TX pin on the Teensy.
-  // A better DMX library would allow me to send packets using the hardware
-  // UART on that pin, but it works fine as is.
+  // Start sending DMX frames. From here on they go out continuously in
+  // the background, and writecolors() only has to update the buffer.
   
-  pinMode(1, OUTPUT);
-  DmxSimple.usePin(1);
-
-  // This sets the number of DMX channels to 3*number of lights. It might
-  // actually need to be +1, my seventh light's blue channel wasn't active.
-  // I was using very old used lights though, and didn't test whether
-  // making this 25 instead of 24 would cause that channel to work.
-  
-  DmxSimple.maxChannel(24);
+  dmx.begin();
 
   // Configure the ADM2582E to transmit only (no DMX receive in this code).
   // These correspond to the Receive and Transmit enable lines on the specific
-  // chip and so are not included in the DmxSimple library tutorial. They
+  // chip and so are not part of the DMX transmitter itself. They
   // are not necessary if you are using another way to send DMX signals.
   
   pinMode(18, OUTPUT);
@@ -223,100 +234,23 @@ void setup() {
   pinMode(19, OUTPUT);
   digitalWrite(19, HIGH);
 
-  // Configure input ADC for 13-bit mode, listed as the noise floor for the
-  // Teensy 3.1 ADC. It would be fine to use 16 bits but I didn't see much
-  // point between the noise in the ADC and the noise intrinsic in the audio
-  // signal.
-  
-  analogReadResolution(13);
-
-  // Set the audio zero level to ~4096 to start since it should be roughly
-  // mid-scale, and sets start values for the threshold, max volume seen,
-  // and light decay period. Once you get some info on what your board signal
-  // levels look like this can be shifted to achieve a faster time to
-  // when the board is working well.
-  
-  audioZero = audioZeroStart;
-  audioRMSMax = audioRMSMaxStart;
-  dThreshold = dThresholdStart;
-  lightDecayPeriod = lightDecayPeriodStart;
-
-  // Set the beat detected flag to false to start.
-  
-  beatdetected = false;
-
-  // Starting parameters for filtered signals.
-  
-  daudioRMSFiltered = 0;
-  beatCountsFiltered = 0;
-  audioRMSFiltered = 0;
 
-  // Initialize the peak beat volume storage.
+  // And start sampling audio.
   
-  peakBeatVolume = 0;
+  sampler.begin();
 }
 
 void loop() {
 
-  // This portion handles audio sampling and analysis.
+  // This portion handles audio analysis, a block of samples at a time as
+  // the sampler fills them.
   
-  if (audioSamplingTimer > 22) { // No, really, 22us is roughly 44.1kHz! Coincidence?
-    audioSamplingTimer = audioSamplingTimer - 22;
-    
-    // Input capacitively coupled, mid-scale centered audio signal.
-    
-    float audioSignal = analogRead(0);
-  
-    // Use exponential smoothing to capture the DC offset. This is using
-    // the pure audio signal which should always have a stable DC offset
-    // due to being capacitively coupled to the analog input.
-    
-    audioZero = 0.999999*audioZero + 0.000001*audioSignal;
-  
-    // Use the audioZero to calculate the RMS audio signal. This gives
-    // the volume of the audio rather than an AC signal that is hard
-    // to interpret. In past versions, abs() was used instead of RMS with
-    // little loss of performance and faster calculation for use on
-    // lower end hardware.
-    
-    float audioRMS = sqrt(pow(audioSignal - audioZero, 2));
-    float oldaudioRMSFiltered = audioRMSFiltered;
-    audioRMSFiltered = 0.99*audioRMSFiltered + 0.01*audioRMS;
-  
-    // If the audioRMSFiltered value exceeds the previously seen maximum,
-    // set the audioRMSMax to the new value.
-    
-    if (audioRMSFiltered > audioRMSMax) audioRMSMax = audioRMSFiltered;
-  
-    // but every loop through, drag the audioRMSMax back towards zero so
-    // that it doesn't only ever grow larger when it sees a volume increase.
-    
-    audioRMSMax = 0.99999*audioRMSMax + 0.00001*audioRMSMaxStart;
-
-    // Next we need the rough derivitive of the piece, so we take the
-    // current audioRMSFiltered value and subtract the immediately prior
-    // sample. Very light exponential smoothing to avoid false pops.
-
-    daudioRMSFiltered = 0.99*daudioRMSFiltered + 0.01*(audioRMSFiltered - oldaudioRMSFiltered);
-
-    // and if the daudioRMSFIltered is higher than a threshold, indicate
-    // beat detection.
-
-    if (daudioRMSFiltered > dThreshold) {
-      beatdetected = true;
-
-      // The derivitive might exceed the threshold for several samples, so only
-      // save the peak volume over the beat to set the light brightness peak during
-      // that flash.
-      
-      peakBeatVolume = min(max(audioRMSFiltered/audioRMSMax, peakBeatVolume), 1);
-
-      // Uncomment this to get debug values for tuning the audio signal chain.
-      // However, it executes every audio sample, so disable during normal operation
-      // to avoid taxing the processor too much.
-      
-      // Serial.println("Beat Detected with dAudio: " + String(daudioRMSFiltered) + " and amplitude " + String(peakBeatVolume));
-    }
+  uint16_t block[audioBlockSamples];
+  while (sampler.readBlock(block)) {
+    detector.process(block, audioBlockSamples);
+#ifdef SPECTRAL
+    analyzer.process(block, audioBlockSamples);
+#endif
   }
 
   // This portion handles the actual DMX light updates.
@@ -324,112 +258,83 @@ void loop() {
   if (sendtimer >= timestep) {
     sendtimer = sendtimer - timestep;
 
-    for (unsigned int i=0; i<8; i++) {
+    for (unsigned int i=0; i<numLights; i++) {
       // Rotate hue of all lights based on parameters at the start of the program.
-      huearray[i] = fmod(huearray[i] + ((float)timestep/1000)*hueStepPerSecond, 360);
+      float hueStep = hueStepPerSecond;
+#ifdef SPECTRAL
+      hueStep += spectralHueStepPerSecond*analyzer.getLevel(bandarray[i]);
+#endif
+      huearray[i] = fmod(huearray[i] + ((float)timestep/1000)*hueStep, 360);
     }
 
     // Uncomment the below to get a stream of the detected audio DC offset level
     // useful for debugging, as well as the realtime audio RMS signal and recorded
     // maximum RMS value it is normalizing against.
     
-    // Serial.println("Audio Zero: " + String(audioZero) + " Audio RMS: " + String(audioRMSFiltered) + " Normalized to Max of: " + String(audioRMSMax));
+    // Serial.println("Audio Zero: " + String(detector.getZero()) + " Audio RMS: " + String(detector.getRMS()) + " Normalized to Max of: " + String(detector.getRMSMax()));
 
-    // This section handles the case where a beat was detected.
+    // This section handles the case where a beat was detected. The detector
+    // only counts one beat per timestep of audio, which de-bounces beats
+    // (i.e. doesn't count beats detected closer than 10ms apart as distinct).
     
-    if (beatdetected) {
-      beatdetected = false;
-      
-      // Increment the beatCounts by one, but only do this every DMX timestep to do
-      // de-bouncing (i.e. don't count beats detected closer than 10ms apart as distinct).
-      
-      beatCounts++;
-
+#ifdef SPECTRAL
+    // Or with SPECTRAL, an onset in a band sets the brightness of just the
+    // lights following it.
+    
+    boolean onsets[audioBands];
+    float volumes[audioBands];
+    for (unsigned int b=0; b<audioBands; b++) {
+      onsets[b] = analyzer.onsetDetected((AudioBand)b);
+      volumes[b] = analyzer.getOnsetVolume((AudioBand)b);
+    }
+    for (unsigned int i=0; i<numLights; i++) {
+      if (onsets[bandarray[i]]) intensityarray[i] = max(volumes[bandarray[i]], intensityarray[i]);
+    }
+    
+    // The broadband beats still tune the decay period, so are dropped here.
+    
+    detector.beatDetected();
+#else
+    if (detector.beatDetected()) {
       // Set the light brightnesses to the normalized volume immediately.
       
-      for (unsigned int i=0; i<8; i++) {
-        intensityarray[i] = max(peakBeatVolume, intensityarray[i]);
+      for (unsigned int i=0; i<numLights; i++) {
+        intensityarray[i] = max(detector.getBeatVolume(), intensityarray[i]);
       }
-
-      // And reset the peak beat volume for the next beat detection event.
-      peakBeatVolume = 0;
     }
+#endif
 
     // But regardless, always be letting the light intensity drop down to the min level.
     // The decay speed varies based on song genre and the constants above.
     
-    float timeConstant = min(timestep/lightDecayPeriod, 0.5);
-    for (unsigned int i=0; i<8; i++) {
+    float timeConstant = min(timestep/detector.getDecayPeriod(), 0.5);
+    for (unsigned int i=0; i<numLights; i++) {
       intensityarray[i] = (1-timeConstant)*intensityarray[i] + timeConstant*intensityMin;
     }
 
-    // And writecolors actually uses the DmxSimple library and HSI2RGB function
+    // And writecolors actually uses the HSI2RGB function and DMX transmitter
     // to send updated values out to the lights.
     
     writecolors();
   }
 
-  // Finally, this does some automatic fudging of the beat detection threshold
-  // and the time decay constant for the light to return to normal after a beat
-  // to help compensate for quiet/classical/ambient music versus electronica.
-  // The general idea is that if the threshold is pushed high because the song
-  // has lots of light beats that would be too confusing to see if they were
-  // all detected, the length of time of a light pulse up and back down is shorter
-  // since the song overall sounds much more rhythmic and drummy.
-
-  if (beatTimer > 1000) {
-    beatTimer = beatTimer - 1000;
-    beatCountsFiltered = max(0.1, 0.7*beatCountsFiltered + 0.3*(float)beatCounts);
-    
-    dThreshold = dThreshold + 0.05*(beatCountsFiltered - bpsTarget);
-    dThreshold = max(dThreshold, dThresholdMin);
-    
-    lightDecayPeriod = max((dThresholdMin/dThreshold)*300, 30);
+  // Finally, the detector retunes its beat detection threshold and the light
+  // decay period once a second of audio to help compensate for quiet/classical/
+  // ambient music versus electronica. Debug information about the tuning is
+  // infrequent enough that I left it uncommented here.
 
-    // Debug information about the beat detection tuning, which is infrequent enough
-    // that I left it uncommented here.
-    
-    Serial.println("Detected " + String(beatCountsFiltered) + " BPS, target is " + String(bpsTarget) + ". New threshold is " + String(dThreshold) + ". Pulse decay TC is " + String(lightDecayPeriod));
-    beatCounts = 0;
+  if (detector.tuned()) {
+    Serial.println("Detected " + String(detector.getBeatsPerSecond()) + " BPS, target is " + String(bpsTarget) + ". New threshold is " + String(detector.getThreshold()) + ". Pulse decay TC is " + String(detector.getDecayPeriod()));
   }
 }
 
 void writecolors() {
-  for (unsigned int i=0; i<8; i++) {    
-    // Convert hue to RGB value assuming fully saturated and full brightness.
-    int rgb[3];
-    hsi2rgb(huearray[i], 1, intensityarray[i], rgb);
-
-    // Write them out to the DMX port.
-    DmxSimple.write(i*3, rgb[0]);
-    DmxSimple.write(i*3+1, rgb[1]);
-    DmxSimple.write(i*3+2, rgb[2]);
-  }
+  // A frame takes about 1.3ms on the wire, so the last update has almost
+  // always gone out by now. If not, this one waits for the next timestep.
+  if (dmx.isSwapPending()) return;
+  
+  // Convert every light to RGB in one go, straight into the DMX back
+  // buffer in channel order, and have it sent from the next frame on.
+  hsi2rgb(huearray, saturationarray, intensityarray, dmx.getBuffer(), numLights);
+  dmx.swap();
 }
-
-void hsi2rgb(float H, float S, float I, int* rgb) {
-  int r, g, b;
-  H = fmod(H,360); // cycle H around to 0-360 degrees
-  H = 3.14159*H/(float)180; // Convert to radians.
-  S = S>0?(S<1?S:1):0; // clamp S and I to interval [0,1]
-  I = I>0?(I<1?I:1):0;
-    
-  if(H < 2.09439) {
-    r = 255*I/3*(1+S*cos(H)/cos(1.047196667-H));
-    g = 255*I/3*(1+S*(1-cos(H)/cos(1.047196667-H)));
-    b = 255*I/3*(1-S);
-  } else if(H < 4.188787) {
-    H = H - 2.09439;
-    g = 255*I/3*(1+S*cos(H)/cos(1.047196667-H));
-    b = 255*I/3*(1+S*(1-cos(H)/cos(1.047196667-H)));
-    r = 255*I/3*(1-S);
-  } else {
-    H = H - 4.188787;
-    b = 255*I/3*(1+S*cos(H)/cos(1.047196667-H));
-    r = 255*I/3*(1+S*(1-cos(H)/cos(1.047196667-H)));
-    g = 255*I/3*(1-S);
-  }
-  rgb[0]=r;
-  rgb[1]=g;
-  rgb[2]=b;
-}
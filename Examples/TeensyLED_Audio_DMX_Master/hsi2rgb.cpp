@@ -0,0 +1,118 @@
+// ----------------------------------------------------------------------
+//
+// TeensyLED Audio DMX Master
+// Version 0.9
+// Copyright Brian Neltner 2016
+//
+// The SaikoLED HSI to RGB conversion used to drive the DMX lights,
+// kept separate from the sketch so it can also be built and
+// benchmarked on a desktop.
+//
+// License:
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------
+
+#include "hsi2rgb.h"
+
+void hsi2rgb(float H, float S, float I, int* rgb) {
+  int r, g, b;
+  H = fmod(H,360); // cycle H around to 0-360 degrees
+  H = 3.14159*H/(float)180; // Convert to radians.
+  S = S>0?(S<1?S:1):0; // clamp S and I to interval [0,1]
+  I = I>0?(I<1?I:1):0;
+    
+  if(H < 2.09439) {
+    r = 255*I/3*(1+S*cos(H)/cos(1.047196667-H));
+    g = 255*I/3*(1+S*(1-cos(H)/cos(1.047196667-H)));
+    b = 255*I/3*(1-S);
+  } else if(H < 4.188787) {
+    H = H - 2.09439;
+    g = 255*I/3*(1+S*cos(H)/cos(1.047196667-H));
+    b = 255*I/3*(1+S*(1-cos(H)/cos(1.047196667-H)));
+    r = 255*I/3*(1-S);
+  } else {
+    H = H - 4.188787;
+    b = 255*I/3*(1+S*cos(H)/cos(1.047196667-H));
+    r = 255*I/3*(1+S*(1-cos(H)/cos(1.047196667-H)));
+    g = 255*I/3*(1-S);
+  }
+  rgb[0]=r;
+  rgb[1]=g;
+  rgb[2]=b;
+}
+
+// The batch conversion works on blocks of lights in passes of plain
+// arithmetic with no branches or calls, so the compiler can vectorize
+// each pass. cos() is replaced by a polynomial good to 4e-7 over the
+// +/-2.1 radians it is used on, and the sector is chosen by multiplying
+// with 0 or 1 rather than by writing to a different channel.
+
+#define hsi2rgbBlock 32
+
+static inline float cosine(float x) {
+  float x2 = x*x;
+  return 1 + x2*(-1/2.0f + x2*(1/24.0f + x2*(-1/720.0f + x2*(1/40320.0f +
+    x2*(-1/3628800.0f + x2*(1/479001600.0f))))));
+}
+
+// Both comparisons are made every time so that neither is conditional,
+// which would stop the compiler turning them into selects.
+static inline float clamp(float x, float max) {
+  x = x>0?x:0;
+  return x<max?x:max;
+}
+
+void hsi2rgb(const float* H, const float* S, const float* I, uint8_t* rgb, int count) {
+  float sat[hsi2rgbBlock], scale[hsi2rgbBlock];
+  float r[hsi2rgbBlock], g[hsi2rgbBlock], b[hsi2rgbBlock];
+  for (int start=0; start<count; start+=hsi2rgbBlock) {
+    int n = count - start < hsi2rgbBlock ? count - start : hsi2rgbBlock;
+    const float *h = H + start, *s = S + start, *in = I + start;
+    
+    // Clamp S and I to [0,1] in a pass of their own, or the compiler
+    // specializes the next pass for the clamped ends and cannot vectorize it.
+    for (int i=0; i<n; i++) {
+      sat[i] = clamp(s[i], 1);
+      scale[i] = clamp(in[i]*(255/3.0f), 255/3.0f);
+    }
+    
+    for (int i=0; i<n; i++) {
+      float hue = h[i] - 360*(int)(h[i]/360); // fmod(H,360)
+      hue = 3.14159f*hue/180;
+      
+      // Which third of the circle the hue is in, as 0 or 1 for each, and
+      // the angle within it.
+      float past1 = hue >= 2.09439f, past2 = hue >= 4.188787f;
+      float in0 = 1 - past1, in1 = past1 - past2, in2 = past2;
+      hue -= in1*2.09439f + in2*4.188787f;
+      
+      float ratio = cosine(hue)/cosine(1.047196667f-hue);
+      float first = scale[i]*(1+sat[i]*ratio);
+      float second = scale[i]*(1+sat[i]*(1-ratio));
+      float third = scale[i]*(1-sat[i]);
+      r[i] = clamp(in0*first + in1*third + in2*second, 255);
+      g[i] = clamp(in0*second + in1*first + in2*third, 255);
+      b[i] = clamp(in0*third + in1*second + in2*first, 255);
+    }
+    
+    uint8_t *out = rgb + 3*start;
+    for (int i=0; i<n; i++) {
+      out[3*i] = (int)r[i];
+      out[3*i+1] = (int)g[i];
+      out[3*i+2] = (int)b[i];
+    }
+  }
+}
@@ -0,0 +1,38 @@
+// ----------------------------------------------------------------------
+//
+// TeensyLED Audio DMX Master
+// Version 0.9
+// Copyright Brian Neltner 2016
+//
+// The SaikoLED HSI to RGB conversion used to drive the DMX lights,
+// kept separate from the sketch so it can also be built and
+// benchmarked on a desktop.
+//
+// License:
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------
+
+#pragma once
+
+#include <Arduino.h>
+
+// Converts a hue in degrees, saturation and intensity to 8-bit RGB.
+void hsi2rgb(float H, float S, float I, int* rgb);
+
+// Converts count lights at once from separate hue, saturation and
+// intensity arrays into packed R, G, B bytes, three per light, in the
+// order they go out on the DMX universe.
+void hsi2rgb(const float* H, const float* S, const float* I, uint8_t* rgb, int count);
@@ -160,6 +160,15 @@ boolean HSIColor::isupdated(void) {
   return _updated;
 }  
 
+uint64_t LampClock::_micros = 0;
+
+// The low 32 bits of the count are micros() when it was last read, so the
+// time since is what micros() has moved on by, wrapped or not.
+uint64_t LampClock::now(void) {
+  _micros += (uint32_t)(micros() - (uint32_t)_micros);
+  return _micros;
+}
+
 HSIFader::HSIFader(HSIColor color1, HSIColor color2, float time, byte direction) {
   setFader(color1, color2, time, direction);
 }
@@ -168,38 +177,39 @@ void HSIFader::setFader(HSIColor color1, HSIColor color2, float time, byte direc
   _colors[0] = color1;
   _colors[1] = color2;
   _delaymicros = time*1000;
-  _startmicros = micros();
+  _startmicros = LampClock::now();
   _direction = direction;
   // If the hues match, set to constant hue.
   if (_colors[0].getHue() == _colors[1].getHue()) _direction = 2;
 }
 
 HSIColor HSIFader::getHSIColor() {
-  long time = micros() - _startmicros;
+  // How far through the fade, as a float so that no term divides integers.
+  float time = _delaymicros ? (float)(LampClock::now() - _startmicros)/_delaymicros : 1;
   float hue;
   // If direction is 1, rotate positive.
-  if (_direction == 1) hue = (_colors[0].getHue() * (1-time/_delaymicros) + _colors[1].getHue()*time/_delaymicros);
+  if (_direction == 1) hue = (_colors[0].getHue() * (1-time) + _colors[1].getHue()*time);
   // If direction is 0, rotate negative.
-  else if (_direction == 0) hue = (_colors[0].getHue() * (1-time/_delaymicros) + (_colors[1].getHue()-360)*time/_delaymicros);
+  else if (_direction == 0) hue = (_colors[0].getHue() * (1-time) + (_colors[1].getHue()-360)*time);
   // If direction is -1, constant hue.
   else if (_direction == 2) hue = _colors[0].getHue();
   // Otherwise, somethign weird happened. Just set to red.
   else hue = 0;
   
-  float saturation = (_colors[0].getSaturation() * (1-time/_delaymicros) + _colors[1].getSaturation()*time/_delaymicros);
-  float intensity = (_colors[0].getIntensity() * (1-time/_delaymicros) + _colors[1].getIntensity()*time/_delaymicros);
+  float saturation = (_colors[0].getSaturation() * (1-time) + _colors[1].getSaturation()*time);
+  float intensity = (_colors[0].getIntensity() * (1-time) + _colors[1].getIntensity()*time);
   return HSIColor(hue, saturation, intensity);
 }
 
 boolean HSIFader::isRunning(void) {
-  long time = micros() - _startmicros;
+  uint64_t time = LampClock::now() - _startmicros;
   if (time <= _delaymicros) return true;
   else return false;
 }
 
 HSIStrober::HSIStrober(HSIColor color1, HSIColor color2, float time) {
   setStrober(color1, color2, time);
-  _startmicros = micros();
+  _startmicros = LampClock::now();
   _periodmicros = _periodmicrosDB;
 }
 
@@ -218,22 +228,18 @@ void HSIStrober::setColor(byte num, HSIColor color) {
 }
 
 HSIColor HSIStrober::getHSIColor(void) {
-  long time = micros() - _startmicros;
-  // For first half, show color1.
-  if (time < _periodmicros/2) {
-    return _colors[0];
-  }
-  if (time > _periodmicros/2) {
-    if (time > _periodmicros) {
-      // Load the double buffered period.
-      _periodmicros = _periodmicrosDB;
-      _startmicros = micros();
-      return _colors[0];
-    }
-    else return _colors[1];
+  uint64_t now = LampClock::now();
+  if (now - _startmicros >= _periodmicros) {
+    // The next period starts where this one ended, so the strobe keeps
+    // time, unless it was not drawn for longer than a period.
+    _startmicros += _periodmicros;
+    // Load the double buffered period.
+    _periodmicros = _periodmicrosDB;
+    if (now - _startmicros >= _periodmicros) _startmicros = now;
   }
-  // Shouldn't get here.
-  return _colors[0];
+  // For first half, show color1.
+  if (now - _startmicros < _periodmicros/2) return _colors[0];
+  else return _colors[1];
 }
 
 CIELED::CIELED(float u, float v, float maxvalue, byte pin) :
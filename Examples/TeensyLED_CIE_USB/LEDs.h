@@ -68,11 +68,22 @@ class HSIColor {
     boolean isupdated();
 };
 
+// Microseconds since power up in 64 bits, which the fader and strober
+// time themselves by so that neither sees micros() wrap every 71 minutes.
+// Each read extends the count from micros(), so it must be read at least
+// once a wrap, as loop() does every pass.
+class LampClock {
+  private:
+    static uint64_t _micros;
+  public:
+    static uint64_t now(void);
+};
+
 class HSIFader {
   private:
     HSIColor _colors[2];
-    unsigned long _startmicros;
-    unsigned long _delaymicros;
+    uint64_t _startmicros;
+    uint64_t _delaymicros;
     byte _direction;
   public:
     HSIFader(HSIColor color1, HSIColor color2, float time, byte direction);
@@ -84,7 +95,7 @@ class HSIFader {
 class HSIStrober {
   private:
     HSIColor _colors[2];
-    unsigned long _startmicros;
+    uint64_t _startmicros;
     unsigned long _periodmicros;
     unsigned long _periodmicrosDB;
   public:
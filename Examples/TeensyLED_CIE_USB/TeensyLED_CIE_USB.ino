@@ -122,6 +122,8 @@ enum strobestate {on = 1, off = 0} strobestate = on;
 float savedintensity;
 
 void loop() {
+  // Keeps the fader and strober clock counting in every mode.
+  LampClock::now();
   if (Serial.available()) evaluateCommand(Serial.readStringUntil(0x0D));
   
   switch (mode) {
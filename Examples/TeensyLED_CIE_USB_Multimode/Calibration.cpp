@@ -0,0 +1,164 @@
+//*********************************************************
+//
+// TeensyLED Controller Library
+// Copyright Brian Neltner 2015
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Calibration.h"
+#include "LampProtocol.h"
+#include <EEPROM.h>
+
+static const uint8_t calibrationMagic[2] = {'L', 'C'};
+#define calibrationVersion 1
+
+Calibration::Calibration(void) :
+  _count(0) {
+}
+
+void Calibration::clear(void) {
+  _count = 0;
+}
+
+boolean Calibration::addLED(const CIELED &LED, uint8_t role, float chance) {
+  if ((_count == maxChannels) || (role > CalibrationEffect)) return false;
+  _LEDs[_count].LED = LED;
+  _LEDs[_count].role = role;
+  _LEDs[_count].chance = chance>0?(chance<1?chance:1):0;
+  _count++;
+  return true;
+}
+
+int Calibration::getCount(void) {
+  return _count;
+}
+
+const CalibratedLED &Calibration::getLED(int LED) {
+  return _LEDs[LED];
+}
+
+boolean Calibration::isValid(void) {
+  int whites = 0, colors = 0;
+  for (int i=0; i<_count; i++) {
+    if (_LEDs[i].role == CalibrationWhite) whites++;
+    if (_LEDs[i].role == CalibrationColor) colors++;
+  }
+  return (whites == 1) && (colors >= 3);
+}
+
+std::shared_ptr<Colorspace> Calibration::colorspace(void) {
+  CIELED white;
+  for (int i=0; i<_count; i++) {
+    if (_LEDs[i].role == CalibrationWhite) white = _LEDs[i].LED;
+  }
+  std::shared_ptr<Colorspace> colorspace (new Colorspace(white));
+  for (int i=0; i<_count; i++) {
+    if (_LEDs[i].role != CalibrationColor) continue;
+    CIELED LED = _LEDs[i].LED;
+    colorspace->addLED(LED);
+  }
+  return colorspace;
+}
+
+void Calibration::addTo(RandomFader &randomfader) {
+  for (int i=0; i<_count; i++) {
+    if (_LEDs[i].role == CalibrationColor) randomfader.addLED(_LEDs[i].LED);
+  }
+  for (int i=0; i<_count; i++) {
+    if (_LEDs[i].role == CalibrationEffect) randomfader.addEffectLED(_LEDs[i].LED, _LEDs[i].chance);
+  }
+}
+
+static uint16_t toFraction(float value, float scale) {
+  value *= scale;
+  return value>0?(value<65535?value + 0.5f:65535):0;
+}
+
+void Calibration::encodeLED(const CalibratedLED &LED, uint8_t *bytes) {
+  CIELED led = LED.LED;
+  uint16_t values[5] = {toFraction(led.getU(), 65535), toFraction(led.getV(), 65535), toFraction(led.getMax(), 65535),
+                        toFraction(led.getPower(), 4096), toFraction(LED.chance, 65535)};
+  bytes[0] = LED.role;
+  bytes[1] = led.getPin();
+  for (int i=0; i<5; i++) {
+    bytes[2 + 2*i] = values[i];
+    bytes[3 + 2*i] = values[i] >> 8;
+  }
+}
+
+CalibratedLED Calibration::decodeLED(const uint8_t *bytes) {
+  float values[5];
+  for (int i=0; i<5; i++) values[i] = bytes[2 + 2*i] | (bytes[3 + 2*i] << 8);
+  CalibratedLED LED;
+  LED.LED = CIELED(values[0]/65535, values[1]/65535, values[2]/65535, bytes[1], values[3]/4096);
+  LED.role = bytes[0];
+  LED.chance = values[4]/65535;
+  return LED;
+}
+
+int Calibration::getSize(void) {
+  return 8 + calibrationLEDBytes*_count;
+}
+
+int Calibration::encode(uint8_t *blob) {
+  uint16_t crc = 0xFFFF;
+  for (int i=0; i<_count; i++) {
+    encodeLED(_LEDs[i], blob + 8 + calibrationLEDBytes*i);
+    crc = LampProtocol::crc16(blob + 8 + calibrationLEDBytes*i, calibrationLEDBytes, crc);
+  }
+  const uint8_t header[8] = {calibrationMagic[0], calibrationMagic[1], calibrationVersion, (uint8_t)_count, 0, 0,
+                             (uint8_t)crc, (uint8_t)(crc >> 8)};
+  for (int j=0; j<8; j++) blob[j] = header[j];
+  return getSize();
+}
+
+boolean Calibration::decode(const uint8_t *blob, int length) {
+  if (length < 8) return false;
+  int count = blob[3];
+  if ((blob[0] != calibrationMagic[0]) || (blob[1] != calibrationMagic[1]) || (blob[2] != calibrationVersion) ||
+      (count > maxChannels) || (length < 8 + calibrationLEDBytes*count)) return false;
+  if ((blob[6] | (blob[7] << 8)) != LampProtocol::crc16(blob + 8, calibrationLEDBytes*count)) return false;
+  Calibration decoded;
+  for (int i=0; i<count; i++) {
+    CalibratedLED LED = decodeLED(blob + 8 + calibrationLEDBytes*i);
+    if (!decoded.addLED(LED.LED, LED.role, LED.chance)) return false;
+  }
+  if (!decoded.isValid()) return false;
+  *this = decoded;
+  return true;
+}
+
+boolean Calibration::save(int address) {
+  if ((address < 0) || (address + getSize() > E2END + 1)) return false;
+  uint8_t blob[calibrationEEPROMSize];
+  int size = encode(blob);
+  // The header goes last, so a save cut short leaves nothing that loads.
+  for (int j=8; j<size; j++) EEPROM.update(address + j, blob[j]);
+  for (int j=0; j<8; j++) EEPROM.update(address + j, blob[j]);
+  return true;
+}
+
+boolean Calibration::load(int address) {
+  if ((address < 0) || (address + 8 > E2END + 1)) return false;
+  uint8_t blob[calibrationEEPROMSize];
+  for (int j=0; j<8; j++) blob[j] = EEPROM.read(address + j);
+  int count = blob[3];
+  if ((count > maxChannels) || (address + 8 + calibrationLEDBytes*count > E2END + 1)) return false;
+  for (int j=8; j<8 + calibrationLEDBytes*count; j++) blob[j] = EEPROM.read(address + j);
+  return decode(blob, 8 + calibrationLEDBytes*count);
+}
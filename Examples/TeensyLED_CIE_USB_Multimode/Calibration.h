@@ -0,0 +1,88 @@
+//*********************************************************
+//
+// TeensyLED Controller Library
+// Copyright Brian Neltner 2015
+//
+// The lamp's LEDs as measured: each one's u', v', maximum value, power
+// and pin, and what it is for, the white point, a color of the
+// colorspace, or one of RandomFader's effect LEDs. A fixture keeps its
+// own in EEPROM, loaded at power up, so a new bin of LEDs needs new
+// numbers and not a new build.
+//
+// Stored as a header of "LC", a version, the count, two spare bytes and
+// the CRC of the LEDs, then 12 bytes for each LED: its role, its pin,
+// and u', v', maximum value, power and effect chance as uint16, little
+// endian. u', v', maximum value and chance are fractions of 65535 and
+// power is in 4096ths. The same bytes are the blob teensyled_calgen
+// writes, and each LED is the payload of a LampCalLED frame.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include "LEDs.h"
+#include "CueSequencer.h"
+
+#define calibrationLEDBytes 12
+#define calibrationEEPROMAddress (cueEEPROMAddress + cueEEPROMSize)
+#define calibrationEEPROMSize (8 + calibrationLEDBytes*maxChannels)
+
+// What an LED is for. There is one CalibrationWhite, and the colorspace
+// needs at least three CalibrationColor LEDs around it.
+enum CalibrationRole {CalibrationWhite = 0, CalibrationColor = 1, CalibrationEffect = 2};
+
+struct CalibratedLED {
+  CIELED LED;
+  uint8_t role;
+  // For CalibrationEffect, how often RandomFader turns it on.
+  float chance;
+};
+
+class Calibration {
+  private:
+    std::array<CalibratedLED, maxChannels> _LEDs;
+    int _count;
+  public:
+    Calibration(void);
+    void clear(void);
+    // False if the calibration is full or the role is not one of the above.
+    boolean addLED(const CIELED &LED, uint8_t role, float chance = 0);
+    int getCount(void);
+    const CalibratedLED &getLED(int LED);
+    // One white and at least three colors.
+    boolean isValid(void);
+
+    // A colorspace of the white and the colors, to be finalized, and the
+    // colors and effect LEDs for a RandomFader.
+    std::shared_ptr<Colorspace> colorspace(void);
+    void addTo(RandomFader &randomfader);
+
+    // The stored form, which takes getSize() bytes. decode() is false and
+    // leaves the calibration as it was if the blob is not a whole, valid
+    // calibration.
+    int getSize(void);
+    int encode(uint8_t *blob);
+    boolean decode(const uint8_t *blob, int length);
+    static void encodeLED(const CalibratedLED &LED, uint8_t *bytes);
+    static CalibratedLED decodeLED(const uint8_t *bytes);
+
+    // False if the calibration does not fit before the end of EEPROM, or
+    // there is no valid calibration stored there.
+    boolean save(int address = calibrationEEPROMAddress);
+    boolean load(int address = calibrationEEPROMAddress);
+};
@@ -0,0 +1,200 @@
+//*********************************************************
+//
+// TeensyLED Controller Library
+//
+// A Colorspace worked out by the compiler, for a lamp whose LEDs are
+// known when it is built. Declared constexpr, the LEDs are put in order
+// of angle, the slopes of the gamut edges found and the hue tables of
+// Colorspace::finalize() built at compile time, and the whole table goes
+// into flash. A Colorspace made from it points at the table, so there is
+// no float work or heap use for it at boot, and none of its RAM:
+//
+//   static constexpr CIELED white(0.2025, 0.4699, 1, 9);
+//   static constexpr ColorspaceTable<3, 360> table(white, red, green, blue);
+//   std::shared_ptr<Colorspace> colorspace(new Colorspace(table));
+//
+// It is the colorspace the same LEDs make at runtime, with the angles and
+// the tangents in the table worked out in double precision rather than
+// float. Mixing other than MixPair is still solved at runtime, and adding
+// an LED or finalizing at another resolution copies the colorspace into
+// RAM first.
+//
+// Working it out needs loops in constant expressions, which came with
+// C++14. Built as C++11 this header declares nothing, and a sketch has
+// to build its colorspace with addLED() and finalize() instead.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include "LEDs.h"
+
+#if __cplusplus >= 201402L
+
+// The trigonometry of Colorspace as constant expressions, which the
+// library's math functions are not. Series in double, accurate to the
+// last bit of a float.
+
+// atan for |z| <= 1, turned by pi/6 to within tan(pi/12) of 0, where its
+// series converges fast.
+constexpr double colorspaceAtan(double z) {
+  double offset = 0;
+  if (z > 0.2679491924311227) {
+    offset = M_PI/6;
+    z = (z - 0.5773502691896258)/(1 + 0.5773502691896258*z);
+  }
+  else if (z < -0.2679491924311227) {
+    offset = -M_PI/6;
+    z = (z + 0.5773502691896258)/(1 - 0.5773502691896258*z);
+  }
+  double sum = 0, term = z;
+  for (int n=1; n<40; n+=2) {
+    sum += term/n;
+    term *= -z*z;
+  }
+  return offset + sum;
+}
+
+constexpr double colorspaceAtan2(double y, double x) {
+  double ay = y<0?-y:y, ax = x<0?-x:x;
+  if ((ax == 0) && (ay == 0)) return 0;
+  double angle = ay <= ax ? colorspaceAtan(ay/ax) : M_PI/2 - colorspaceAtan(ax/ay);
+  if (x < 0) angle = M_PI - angle;
+  return y < 0 ? -angle : angle;
+}
+
+// tan for x >= 0, from sin and cos within pi/2 of 0.
+constexpr double colorspaceTan(double x) {
+  x -= M_PI*(long)(x/M_PI + 0.5);
+  double sine = 0, cosine = 0, term = 1;
+  for (int n=0; n<30; n++) {
+    if (n & 1) sine += term;
+    else cosine += term;
+    term *= x/(n + 1);
+    if (n & 1) term = -term;
+  }
+  return sine/cosine;
+}
+
+template <int colors, int resolution> class ColorspaceTable {
+  static_assert(colors >= 2, "A colorspace needs two colored LEDs to have a table");
+  static_assert(colors < maxChannels, "A colorspace has at most maxChannels channels, white included");
+  static_assert(resolution > 0, "The table needs at least one entry");
+  friend class Colorspace;
+  private:
+    CIELED _white;
+    CIELED _LEDs[colors];
+    float _angle[colors], _slope[colors];
+    HueSegment _table[resolution + 1];
+    HueSegmentQ16 _tableQ16[resolution + 1];
+    uint32_t _angleQ16[colors];
+
+    // Colorspace::hueWeights(), as the table is built.
+    constexpr void hueWeights(float H, int &LED1, int &LED2, float &weight1, float &weight2) const {
+      float tanH = colorspaceTan(M_PI*H/180);
+      if ((H < _angle[0]) || (H >= _angle[colors-1])) {
+        LED1 = colors - 1;
+        LED2 = 0;
+      }
+      else {
+        int i = 1;
+        while ((H > _angle[i]) && (i < colors-1)) i++;
+        LED1 = i - 1;
+        LED2 = i;
+      }
+      float LED1_ustar = _LEDs[LED1].getU() - _white.getU();
+      float LED2_ustar = _LEDs[LED2].getU() - _white.getU();
+      float LED2_vstar = _LEDs[LED2].getV() - _white.getV();
+      float slope = _slope[LED1];
+      float ustar = (LED2_vstar - slope*LED2_ustar)/(tanH - slope);
+      float span = LED2_ustar - LED1_ustar;
+      span = span<0?-span:span;
+      weight1 = (ustar - LED2_ustar)/span;
+      weight2 = (ustar - LED1_ustar)/span;
+      weight1 = weight1<0?-weight1:weight1;
+      weight2 = weight2<0?-weight2:weight2;
+    }
+  public:
+    // The white LED, then the colored ones in any order.
+    template <class... LEDs> constexpr ColorspaceTable(const CIELED &white, const LEDs &... LED) :
+      _white(white), _LEDs(), _angle(), _slope(), _table(), _tableQ16(), _angleQ16() {
+      static_assert(sizeof...(LED) == colors, "The table takes as many colored LEDs as its colors");
+      const CIELED added[] = {LED...};
+      // Inserted by angle as Colorspace::addLED() does, ahead of any at the
+      // same angle.
+      for (int n=0; n<colors; n++) {
+        float du = added[n].getU() - white.getU();
+        float dv = added[n].getV() - white.getV();
+        double degrees = (180/M_PI)*colorspaceAtan2(dv, du) + 360;
+        float angle = degrees >= 360 ? degrees - 360 : degrees;
+        int at = 0;
+        while ((at < n) && (_angle[at] < angle)) at++;
+        for (int i=n; i>at; i--) {
+          _LEDs[i] = _LEDs[i-1];
+          _angle[i] = _angle[i-1];
+        }
+        _LEDs[at] = added[n];
+        _angle[at] = angle;
+      }
+      for (int i=0; i<colors; i++) {
+        const CIELED &next = _LEDs[(i + 1) % colors];
+        _slope[i] = (next.getV() - _LEDs[i].getV()) / (next.getU() - _LEDs[i].getU());
+      }
+
+      for (int i=0; i<resolution; i++) {
+        int LED1 = 0, LED2 = 0;
+        float weight1 = 0, weight2 = 0;
+        hueWeights((float)i*360/resolution, LED1, LED2, weight1, weight2);
+        _table[i].LED1 = LED1;
+        _table[i].LED2 = LED2;
+        _table[i].weight1 = weight1;
+        _table[i].weight2 = weight2;
+      }
+      _table[resolution] = _table[0];
+
+      float tablescale = (float)resolution/360;
+      for (int i=0; i<=resolution; i++) {
+        _tableQ16[i].LED1 = _table[i].LED1;
+        _tableQ16[i].LED2 = _table[i].LED2;
+        _tableQ16[i].weight1 = _table[i].weight1 * 0x10000 + 0.5f;
+        _tableQ16[i].weight2 = _table[i].weight2 * 0x10000 + 0.5f;
+      }
+      for (int i=0; i<colors; i++) {
+        _angleQ16[i] = _angle[i] * tablescale * 0x10000 + 0.5f;
+      }
+    }
+};
+
+template <int colors, int resolution> Colorspace::Colorspace(const ColorspaceTable<colors, resolution> &table) :
+  _LEDs(table._LEDs),
+  _angle(table._angle),
+  _slope(table._slope),
+  _table(table._table),
+  _tableQ16(table._tableQ16),
+  _angleQ16(table._angleQ16),
+  _count(colors),
+  _fixed(true),
+  _white(table._white),
+  _tablescale((float)resolution/360),
+  _resolution(resolution),
+  _interpolate(true),
+  _mixmode(MixPair) {
+  _mixcells.fill(0);
+}
+
+#endif
@@ -0,0 +1,164 @@
+//*********************************************************
+//
+// TeensyLED Controller Library
+// Copyright Brian Neltner 2015
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or 
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Compositor.h"
+
+Compositor::Compositor(RGBWLamp &lamp) :
+  _lamp(lamp),
+  _count(0),
+  _master(1),
+  _drivenCount(0) {
+  resetStats();
+}
+
+int Compositor::addLayer(Effect &effect, BlendMode blend, float opacity) {
+  if (_count == maxLayers) return -1;
+  _layers[_count].effect = &effect;
+  _count++;
+  if (!setLayer(_count - 1, blend, opacity)) {
+    _count--;
+    return -1;
+  }
+  return _count - 1;
+}
+
+boolean Compositor::setLayer(int layer, BlendMode blend, float opacity) {
+  if ((layer < 0) || (layer >= _count) || (blend > BlendCrossfade)) return false;
+  _layers[layer].blend = blend;
+  _layers[layer].opacity = opacity>0?(opacity<1?opacity:1):0;
+  return true;
+}
+
+int Compositor::getLayers(void) {
+  return _count;
+}
+
+BlendMode Compositor::getBlend(int layer) {
+  return _layers[layer].blend;
+}
+
+float Compositor::getOpacity(int layer) {
+  return _layers[layer].opacity;
+}
+
+void Compositor::setMaster(float master) {
+  _master = master>0?(master<1?master:1):0;
+}
+
+float Compositor::getMaster(void) {
+  return _master;
+}
+
+// The frame channel that drives a pin, added after the others if it is
+// not there yet. -1 if the frame is full.
+int Compositor::channel(LampFrame &frame, int pin) {
+  for (int i=0; i<frame.channels; i++) {
+    if (frame.pins[i] == pin) return i;
+  }
+  if (frame.channels == maxChannels) return -1;
+  frame.pins[frame.channels] = pin;
+  frame.levels[frame.channels] = 0;
+  return frame.channels++;
+}
+
+void Compositor::render(LampFrame &frame) {
+  // The lamp's own channels come first, in its order, so that the frame
+  // lines up from one render to the next.
+  frame.direct = true;
+  frame.channels = _lamp.getChannels();
+  for (int i=0; i<frame.channels; i++) {
+    frame.pins[i] = _lamp.getPin(i);
+    frame.levels[i] = 0;
+  }
+  // Then the pins direct layers have driven before, off unless a layer
+  // drives them again.
+  for (int i=0; i<_drivenCount; i++) channel(frame, _driven[i]);
+  
+  for (int l=0; l<_count; l++) {
+    Layer &layer = _layers[l];
+    if (layer.opacity == 0) continue;
+    uint32_t start = ARM_DWT_CYCCNT;
+    
+    layer.effect->render(_layerFrame);
+    _levels.fill(0);
+    if (_layerFrame.direct) {
+      for (int i=0; i<_layerFrame.channels; i++) {
+        int c = channel(frame, _layerFrame.pins[i]);
+        if (c >= 0) _levels[c] = _layerFrame.levels[i];
+      }
+    }
+    else _lamp.getLevels(_layerFrame.color, _levels.data());
+    
+    float opacity = layer.opacity;
+    switch (layer.blend) {
+      case BlendAdd:
+        for (int i=0; i<frame.channels; i++) frame.levels[i] += opacity*_levels[i];
+        break;
+      case BlendMax:
+        for (int i=0; i<frame.channels; i++) {
+          float level = opacity*_levels[i];
+          if (level > frame.levels[i]) frame.levels[i] = level;
+        }
+        break;
+      case BlendMultiply:
+        for (int i=0; i<frame.channels; i++) frame.levels[i] *= 1 - opacity + opacity*_levels[i];
+        break;
+      case BlendCrossfade:
+        for (int i=0; i<frame.channels; i++) frame.levels[i] += opacity*(_levels[i] - frame.levels[i]);
+        break;
+    }
+    
+    uint32_t cycles = ARM_DWT_CYCCNT - start;
+    layer.frames++;
+    layer.totalCycles += cycles;
+    if (cycles > layer.maxCycles) layer.maxCycles = cycles;
+  }
+  
+  for (int i=_lamp.getChannels(); i<frame.channels; i++) {
+    int known = 0;
+    while ((known < _drivenCount) && (_driven[known] != frame.pins[i])) known++;
+    if (known == _drivenCount) _driven[_drivenCount++] = frame.pins[i];
+  }
+  
+  for (int i=0; i<frame.channels; i++) {
+    float level = _master*frame.levels[i];
+    frame.levels[i] = level>0?(level<1?level:1):0;
+  }
+}
+
+float Compositor::getLayerAvgMicros(int layer) {
+  if ((layer < 0) || (layer >= _count) || (_layers[layer].frames == 0)) return 0;
+  return (float)_layers[layer].totalCycles/_layers[layer].frames*(1e6f/F_CPU);
+}
+
+float Compositor::getLayerMaxMicros(int layer) {
+  if ((layer < 0) || (layer >= _count)) return 0;
+  return _layers[layer].maxCycles*(1e6f/F_CPU);
+}
+
+void Compositor::resetStats(void) {
+  for (int l=0; l<maxLayers; l++) {
+    _layers[l].frames = 0;
+    _layers[l].maxCycles = 0;
+    _layers[l].totalCycles = 0;
+  }
+}
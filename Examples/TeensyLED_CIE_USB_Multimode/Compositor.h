@@ -0,0 +1,95 @@
+//*********************************************************
+//
+// TeensyLED Controller Library
+// Copyright Brian Neltner 2015
+//
+// Runs several effects at once as layers, such as a cycler underneath
+// a strobe, and blends them into one frame.
+//
+// Each layer is rendered in turn, converted to a level for every lamp
+// channel plus any pins a direct effect like RandomFader drives, and
+// blended onto the layers below it. Levels are output levels, which are
+// linear in light, so blending them mixes light the way it mixes in
+// the room:
+//
+//   BlendAdd        below + opacity*layer
+//   BlendMax        the larger of below and opacity*layer
+//   BlendMultiply   below scaled by layer, by opacity of the way
+//   BlendCrossfade  opacity of the way from below to layer
+//
+// The sum is clipped and scaled by the master level once at the end.
+// Every pin a direct layer has driven stays in the frame, at 0 when no
+// layer drives it, so that a layer skipped or swapped out goes dark
+// rather than leaving its pins at their last level.
+// A Compositor is itself an Effect, so it can be put in an
+// EffectRegistry and drawn like any other.
+//
+// Each layer's render, conversion and blend is timed with the cycle
+// counter, which RenderScheduler::begin() turns on, to budget layers
+// against the frame period.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or 
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include "LEDs.h"
+
+const int maxLayers = 4;
+
+enum BlendMode {BlendAdd = 0, BlendMax = 1, BlendMultiply = 2, BlendCrossfade = 3};
+
+class Compositor : public Effect {
+  private:
+    struct Layer {
+      Effect *effect;
+      BlendMode blend;
+      float opacity;
+      uint32_t frames;
+      uint32_t maxCycles;
+      uint64_t totalCycles;
+    };
+    RGBWLamp &_lamp;
+    std::array<Layer, maxLayers> _layers;
+    int _count;
+    float _master;
+    LampFrame _layerFrame;
+    std::array<float, maxChannels> _levels;
+    // Pins off the lamp that direct layers have driven.
+    std::array<int, maxChannels> _driven;
+    int _drivenCount;
+    int channel(LampFrame &frame, int pin);
+  public:
+    Compositor(RGBWLamp &lamp);
+    // Adds a layer on top of the others. Returns its number, or -1 if
+    // there are already maxLayers.
+    int addLayer(Effect &effect, BlendMode blend, float opacity = 1);
+    // A layer with opacity 0 is skipped altogether, and pins only it
+    // drives are turned off.
+    boolean setLayer(int layer, BlendMode blend, float opacity);
+    int getLayers(void);
+    BlendMode getBlend(int layer);
+    float getOpacity(int layer);
+    void setMaster(float master);
+    float getMaster(void);
+    void render(LampFrame &frame);
+    
+    // Time taken by each layer's frames, in microseconds.
+    float getLayerAvgMicros(int layer);
+    float getLayerMaxMicros(int layer);
+    void resetStats(void);
+};
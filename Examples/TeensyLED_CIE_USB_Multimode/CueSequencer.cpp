@@ -0,0 +1,242 @@
+//*********************************************************
+//
+// TeensyLED Controller Library
+// Copyright Brian Neltner 2015
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or 
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "CueSequencer.h"
+#include "LampProtocol.h"
+#include <EEPROM.h>
+
+static const uint8_t cueMagic[2] = {'C', 'L'};
+#define cueVersion 1
+
+CueSequencer::CueSequencer(void) :
+  _count(0),
+  _loop(true),
+  _length(0),
+  _position(0),
+  _startmicros(0),
+  _current(0),
+  _playing(false) {
+}
+
+void CueSequencer::clear(boolean loop) {
+  _count = 0;
+  _loop = loop;
+  _playing = false;
+  compile();
+}
+
+boolean CueSequencer::addCue(const Cue &cue) {
+  if ((_count == maxCues) || (cue.easing > EaseStep) || (cue.direction > 2)) return false;
+  _cues[_count++] = cue;
+  compile();
+  return true;
+}
+
+int CueSequencer::getCount(void) {
+  return _count;
+}
+
+const Cue &CueSequencer::getCue(int cue) {
+  return _cues[cue];
+}
+
+boolean CueSequencer::getLoop(void) {
+  return _loop;
+}
+
+uint32_t CueSequencer::getLength(void) {
+  return _length;
+}
+
+// Works out each cue's start time and the color it fades from, which is
+// where the cue before it ended.
+void CueSequencer::compile(void) {
+  _length = 0;
+  _current = 0;
+  if (_count == 0) return;
+  HSIColor from = _cues[_count - 1].color;
+  for (int i=0; i<_count; i++) {
+    Cue &cue = _cues[i];
+    Segment &segment = _segments[i];
+    segment.start = _length;
+    segment.fade = cue.fade;
+    segment.end = _length + cue.fade + cue.hold;
+    segment.easing = cue.easing;
+    segment.rate = cue.fade ? 1.0f/(cue.fade*1000.0f) : 0;
+    
+    float hue = fmod(from.getHue(), 360);
+    if (hue < 0) hue += 360;
+    float target = fmod(cue.color.getHue(), 360);
+    if (target < 0) target += 360;
+    float step = target - hue;
+    if ((cue.direction == 1) && (step < 0)) step += 360;
+    if ((cue.direction == 0) && (step > 0)) step -= 360;
+    if (cue.direction == 2) step = 0;
+    segment.hue = hue;
+    segment.huestep = step;
+    segment.saturation = from.getSaturation();
+    segment.saturationstep = cue.color.getSaturation() - from.getSaturation();
+    segment.intensity = from.getIntensity();
+    segment.intensitystep = cue.color.getIntensity() - from.getIntensity();
+    segment.target = HSIColor(hue + step, cue.color.getSaturation(), cue.color.getIntensity());
+    
+    from = segment.target;
+    _length = segment.end;
+  }
+}
+
+void CueSequencer::start(void) {
+  _position = 0;
+  _current = 0;
+  _startmicros = LampClock::now();
+  _playing = true;
+}
+
+boolean CueSequencer::isPlaying(void) {
+  return _playing;
+}
+
+uint64_t CueSequencer::getPosition(void) {
+  return _position;
+}
+
+int CueSequencer::getCurrent(void) {
+  return _current;
+}
+
+void CueSequencer::render(LampFrame &frame) {
+  frame.direct = false;
+  if (_playing) _position = LampClock::now() - _startmicros;
+  if (_count == 0) {
+    frame.color = HSIColor();
+    return;
+  }
+  
+  uint64_t length = (uint64_t)_length*1000;
+  if (_position >= length) {
+    if (_loop && (length > 0)) {
+      // Usually a single step, unless frames stopped for a whole loop.
+      while (_position >= length) {
+        _position -= length;
+        _startmicros += length;
+      }
+      _current = 0;
+    }
+    else {
+      _playing = false;
+      _position = length;
+      _current = _count - 1;
+      frame.color = _segments[_current].target;
+      return;
+    }
+  }
+  while (_position >= (uint64_t)_segments[_current].end*1000) _current++;
+  
+  Segment &segment = _segments[_current];
+  uint64_t elapsed = _position - (uint64_t)segment.start*1000;
+  if (elapsed >= (uint64_t)segment.fade*1000) {
+    frame.color = segment.target;
+    return;
+  }
+  float t = elapsed*segment.rate;
+  switch (segment.easing) {
+    case EaseIn: t = t*t; break;
+    case EaseOut: t = t*(2 - t); break;
+    case EaseInOut: t = t*t*(3 - 2*t); break;
+    case EaseStep: t = 0; break;
+  }
+  frame.color.setHSI(segment.hue + t*segment.huestep, segment.saturation + t*segment.saturationstep,
+                     segment.intensity + t*segment.intensitystep);
+}
+
+// Stored as a header of "CL", a version, the count, the loop flag, a
+// spare byte and the CRC of the cues, then each cue as its color in the
+// same 16 bit form as a LampProtocol frame, fade and hold as uint32 and
+// the easing and direction bytes, all little endian.
+static void writeCue(uint8_t *p, const Cue &cue) {
+  HSIColor color = cue.color;
+  float hue = fmod(color.getHue(), 360);
+  if (hue < 0) hue += 360;
+  uint16_t values[3] = {(uint16_t)((uint32_t)(hue*(65536/360.0f) + 0.5f) & 0xFFFF),
+                        (uint16_t)(color.getSaturation()*65535 + 0.5f), (uint16_t)(color.getIntensity()*65535 + 0.5f)};
+  for (int i=0; i<3; i++) {
+    p[2*i] = values[i];
+    p[2*i + 1] = values[i] >> 8;
+  }
+  for (int i=0; i<4; i++) {
+    p[6 + i] = cue.fade >> (8*i);
+    p[10 + i] = cue.hold >> (8*i);
+  }
+  p[14] = cue.easing;
+  p[15] = cue.direction;
+}
+
+static Cue readCue(const uint8_t *p) {
+  Cue cue;
+  cue.color.setHSI((p[0] | (p[1] << 8))*(360.0f/65536), (p[2] | (p[3] << 8))*(1.0f/65535), (p[4] | (p[5] << 8))*(1.0f/65535));
+  cue.fade = 0;
+  cue.hold = 0;
+  for (int i=0; i<4; i++) {
+    cue.fade |= (uint32_t)p[6 + i] << (8*i);
+    cue.hold |= (uint32_t)p[10 + i] << (8*i);
+  }
+  cue.easing = p[14];
+  cue.direction = p[15];
+  return cue;
+}
+
+boolean CueSequencer::save(int address) {
+  if ((address < 0) || (address + 8 + 16*_count > E2END + 1)) return false;
+  uint8_t bytes[16];
+  uint16_t crc = 0xFFFF;
+  for (int i=0; i<_count; i++) {
+    writeCue(bytes, _cues[i]);
+    crc = LampProtocol::crc16(bytes, 16, crc);
+    for (int j=0; j<16; j++) EEPROM.update(address + 8 + 16*i + j, bytes[j]);
+  }
+  const uint8_t header[8] = {cueMagic[0], cueMagic[1], cueVersion, (uint8_t)_count, _loop, 0, (uint8_t)crc, (uint8_t)(crc >> 8)};
+  for (int j=0; j<8; j++) EEPROM.update(address + j, header[j]);
+  return true;
+}
+
+boolean CueSequencer::load(int address) {
+  if ((address < 0) || (address + 8 > E2END + 1)) return false;
+  uint8_t header[8];
+  for (int j=0; j<8; j++) header[j] = EEPROM.read(address + j);
+  int count = header[3];
+  if ((header[0] != cueMagic[0]) || (header[1] != cueMagic[1]) || (header[2] != cueVersion) ||
+      (count > maxCues) || (address + 8 + 16*count > E2END + 1)) return false;
+  uint8_t bytes[16];
+  uint16_t crc = 0xFFFF;
+  for (int i=0; i<count; i++) {
+    for (int j=0; j<16; j++) bytes[j] = EEPROM.read(address + 8 + 16*i + j);
+    crc = LampProtocol::crc16(bytes, 16, crc);
+  }
+  if ((header[6] | (header[7] << 8)) != crc) return false;
+  
+  clear(header[4]);
+  for (int i=0; i<count; i++) {
+    for (int j=0; j<16; j++) bytes[j] = EEPROM.read(address + 8 + 16*i + j);
+    if (!addCue(readCue(bytes))) return false;
+  }
+  return true;
+}
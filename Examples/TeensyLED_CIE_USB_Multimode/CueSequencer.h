@@ -0,0 +1,106 @@
+//*********************************************************
+//
+// TeensyLED Controller Library
+// Copyright Brian Neltner 2015
+//
+// Plays a list of cues, each a color to fade to and then hold, for
+// running a show without a computer attached.
+//
+// A cue fades from the color before it to its own over fade ms along
+// an easing curve, then holds for hold ms. The hue turns the way
+// HSIFader's direction says: 1 up, 0 down, and 2 not at all, keeping
+// the hue it started from. The first cue fades from the last, so a
+// looping list runs seamlessly.
+//
+// The list is compiled into one segment per cue, with its start time
+// and its color change worked out in advance, so a frame only needs
+// the segment it is in. The playback position is taken from LampClock,
+// so it never wraps, and with time only moving forward finding the
+// segment is a check of the current one, or a step to the next.
+//
+// A list can be saved to EEPROM and loaded again at power up. It
+// takes 8 bytes plus 16 for each cue from the address given.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or 
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include "LEDs.h"
+
+#define maxCues 64
+#define cueEEPROMAddress 0
+#define cueEEPROMSize (8 + 16*maxCues)
+
+// How a fade moves from one color to the next. EaseStep holds the old
+// color for the whole fade and then jumps.
+enum CueEasing {EaseLinear = 0, EaseIn = 1, EaseOut = 2, EaseInOut = 3, EaseStep = 4};
+
+struct Cue {
+  HSIColor color;
+  uint32_t fade, hold;
+  uint8_t easing;
+  uint8_t direction;
+};
+
+class CueSequencer : public Effect {
+  private:
+    struct Segment {
+      uint32_t start, fade, end;
+      uint8_t easing;
+      float hue, saturation, intensity;
+      float huestep, saturationstep, intensitystep;
+      float rate;
+      HSIColor target;
+    };
+    std::array<Cue, maxCues> _cues;
+    std::array<Segment, maxCues> _segments;
+    int _count;
+    boolean _loop;
+    uint32_t _length;
+    uint64_t _position;
+    uint64_t _startmicros;
+    int _current;
+    boolean _playing;
+    void compile(void);
+  public:
+    CueSequencer(void);
+    // Empties the list, and sets whether it starts over at the end or
+    // holds the last cue.
+    void clear(boolean loop);
+    // False if the list is full or the cue's easing or direction is not
+    // one of the above.
+    boolean addCue(const Cue &cue);
+    int getCount(void);
+    const Cue &getCue(int cue);
+    boolean getLoop(void);
+    // Length of the list in ms.
+    uint32_t getLength(void);
+    
+    // Plays from the start.
+    void start(void);
+    boolean isPlaying(void);
+    // Microseconds since start(), and the cue playing.
+    uint64_t getPosition(void);
+    int getCurrent(void);
+    void render(LampFrame &frame);
+    
+    // False if the list does not fit before the end of EEPROM, or there
+    // is no list stored there that loads cleanly.
+    boolean save(int address = cueEEPROMAddress);
+    boolean load(int address = cueEEPROMAddress);
+};
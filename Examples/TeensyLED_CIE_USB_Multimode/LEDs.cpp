@@ -1,8 +1,60 @@
 #include "LEDs.h"
 
+// Q16 multiply, rounded. The M4 does the 32x32->64 bit product in one
+// instruction.
+static inline uint32_t mulQ16(uint32_t a, uint32_t b) {
+  return ((uint64_t)a * b + 0x8000) >> 16;
+}
+
+// IS, intensity times saturation in Q32, times the Q16 weights blended t
+// of the way from weight1 to weight2, rounded once to Q16. Rounding each
+// product on the way puts the level out by up to two LSBs.
+static inline uint32_t blendQ16(uint64_t IS, uint32_t t, uint32_t weight1, uint32_t weight2) {
+  uint64_t weight = (uint64_t)(0x10000 - t) * weight1 + (uint64_t)t * weight2;
+  return ((weight >> 8) * (IS >> 8) + 0x80000000) >> 32;
+}
+
+OutputTransfer::OutputTransfer(TransferCurve curve, float gamma) {
+  setCurve(curve, gamma);
+}
+
+void OutputTransfer::setCurve(TransferCurve curve, float gamma) {
+  for (int i=0; i<=transferPoints; i++) {
+    float level = (float)i/transferPoints;
+    float light = level;
+    if (curve == TransferGamma) light = powf(level, gamma);
+    // CIE L*, with the level as L*/100.
+    else if (curve == TransferLstar) light = level > 0.08f ? powf((100*level + 16)/116, 3) : 100*level/903.3f;
+    light = light>0?(light<1?light:1):0;
+    _table[i] = light*0xFFFF00 + 0.5f;
+  }
+}
+
+uint32_t OutputTransfer::getDuty(float level) const {
+  float point = (level>0?(level<1?level:1):0)*transferPoints;
+  int i = point;
+  if (i == transferPoints) return _table[i];
+  return _table[i] + (uint32_t)((_table[i+1] - _table[i])*(point - i));
+}
+
 RGBWLamp::RGBWLamp(int resolution, float PWMfrequency) :
   _resolution(resolution),
-  _PWMfrequency(PWMfrequency) {
+  _PWMfrequency(PWMfrequency),
+  _issued(0),
+  _skipped(0),
+  _ditherBits(0),
+  _supply(0),
+  _budget(0),
+  _channelbudget(0),
+  _powerscale(1),
+  _modelled(false) {
+  _transfers.fill(0);
+  _codes.fill(0);
+  _amps.fill(0);
+  _forwardvolts.fill(0);
+  _fullwatts.fill(0);
+  _watts.fill(0);
+  invalidate();
 }
 
 void RGBWLamp::begin(void) {
@@ -10,30 +62,291 @@ void RGBWLamp::begin(void) {
     pinMode(*i, OUTPUT);
     analogWrite(*i, 0);
     analogWriteFrequency(*i, _PWMfrequency);
+    if ((*i >= 0) && (*i < lampPins)) _duties[*i] = 0;
   }
   analogWriteResolution(_resolution);
 }
 
+// Writes a duty to a pin unless it already has it. Pins out of range are
+// always written.
+void RGBWLamp::writeDuty(int pin, int duty) {
+  if ((pin >= 0) && (pin < lampPins)) {
+    if (_duties[pin] == duty) {
+      _skipped++;
+      return;
+    }
+    _duties[pin] = duty;
+  }
+  analogWrite(pin, duty);
+  _issued++;
+}
+
+unsigned long RGBWLamp::getWritesIssued(void) {
+  return _issued;
+}
+
+unsigned long RGBWLamp::getWritesSkipped(void) {
+  return _skipped;
+}
+
+void RGBWLamp::invalidate(void) {
+  _duties.fill(-1);
+  _fractions.fill(0);
+  _residues.fill(0);
+}
+
+// Writes a level through the pin's transfer and the dither. With neither,
+// this is the lamp's linear map, truncated to a code.
+void RGBWLamp::writeLevel(int pin, float level) {
+  boolean tracked = (pin >= 0) && (pin < lampPins);
+  if (!(tracked && _transfers[pin]) && (!_ditherBits || !tracked)) {
+    writeDuty(pin, 0xFFFF * level);
+    return;
+  }
+  writeFineDuty(pin, levelDuty(pin, level));
+}
+
+// A level's duty through the pin's transfer, in 1/256ths of a code.
+uint32_t RGBWLamp::levelDuty(int pin, float level) {
+  const OutputTransfer *transfer = (pin >= 0) && (pin < lampPins) ? _transfers[pin] : 0;
+  return transfer ? transfer->getDuty(level) : (uint32_t)((level>0?(level<1?level:1):0)*0xFFFF00);
+}
+
+void RGBWLamp::writeFineDuty(int pin, uint32_t duty) {
+  if ((pin < 0) || (pin >= lampPins)) {
+    writeDuty(pin, duty >> 8);
+    return;
+  }
+  _codes[pin] = duty >> 8;
+  _fractions[pin] = duty & 0xFF;
+  writeDuty(pin, ditherStep(pin));
+}
+
+// Works out the frame's dissipation, pins it leaves out staying at what
+// they last had, and scales its duties to keep within the budgets. The
+// light of each channel follows its duty whatever the transfer, so scaling
+// every duty alike keeps the color and only dims it.
+void RGBWLamp::limitDuties(uint32_t *duties, const int *pins, int channels) {
+  float frame = 0, others = 0, scale = 1;
+  for (int i=0; i<channels; i++) {
+    int pin = pins[i];
+    if ((pin < 0) || (pin >= lampPins)) continue;
+    _watts[pin] = duties[i]*(_fullwatts[pin]/0xFFFF00);
+    frame += _watts[pin];
+    if ((_channelbudget > 0) && (_watts[pin]*scale > _channelbudget)) scale = _channelbudget/_watts[pin];
+  }
+  for (int pin=0; pin<lampPins; pin++) others += _watts[pin];
+  others -= frame;
+  if ((_budget > 0) && (others + frame*scale > _budget)) {
+    scale = others < _budget ? (_budget - others)/frame : 0;
+  }
+  _powerscale = scale;
+  if (scale >= 1) return;
+  for (int i=0; i<channels; i++) {
+    int pin = pins[i];
+    duties[i] *= scale;
+    if ((pin >= 0) && (pin < lampPins)) _watts[pin] *= scale;
+  }
+}
+
+// The code for this frame: the fraction is added up frame by frame, and
+// each time it comes to a whole code the next code up is shown instead.
+int RGBWLamp::ditherStep(int pin) {
+  if (!_ditherBits) return _codes[pin];
+  _residues[pin] += _fractions[pin] >> (8 - _ditherBits);
+  if (_residues[pin] >= (1 << _ditherBits)) {
+    _residues[pin] -= 1 << _ditherBits;
+    return _codes[pin] + 1;
+  }
+  return _codes[pin];
+}
+
+void RGBWLamp::setTransfer(int channel, const OutputTransfer *transfer) {
+  if ((channel < 0) || (channel >= (int)_pins.size())) return;
+  int pin = _pins[channel];
+  if ((pin >= 0) && (pin < lampPins)) _transfers[pin] = transfer;
+}
+
+void RGBWLamp::setTransfer(const OutputTransfer *transfer) {
+  for (unsigned int i=0; i<_pins.size(); i++) setTransfer(i, transfer);
+}
+
+void RGBWLamp::setDither(int bits) {
+  _ditherBits = bits>0?(bits<maxDitherBits?bits:maxDitherBits):0;
+  _residues.fill(0);
+}
+
+int RGBWLamp::getDither(void) {
+  return _ditherBits;
+}
+
+void RGBWLamp::dither(void) {
+  if (!_ditherBits) return;
+  for (int pin=0; pin<lampPins; pin++) {
+    if ((_fractions[pin] >> (8 - _ditherBits)) && (_duties[pin] >= 0)) writeDuty(pin, ditherStep(pin));
+  }
+}
+
+void RGBWLamp::setSupply(float volts) {
+  _supply = volts;
+  updatePower();
+}
+
+void RGBWLamp::setDrive(int channel, float amps, float forwardVolts) {
+  if ((channel < 0) || (channel >= (int)_pins.size())) return;
+  setPinDrive(_pins[channel], amps, forwardVolts);
+}
+
+void RGBWLamp::setDrive(float amps, float forwardVolts) {
+  for (unsigned int i=0; i<_pins.size(); i++) setDrive(i, amps, forwardVolts);
+}
+
+void RGBWLamp::setPinDrive(int pin, float amps, float forwardVolts) {
+  if ((pin < 0) || (pin >= lampPins)) return;
+  _amps[pin] = amps;
+  _forwardvolts[pin] = forwardVolts;
+  updatePower();
+}
+
+void RGBWLamp::setPowerBudget(float watts, float channelWatts) {
+  _budget = watts>0?watts:0;
+  _channelbudget = channelWatts>0?channelWatts:0;
+}
+
+// A sink whose LED drops more than the supply has nothing left to dissipate.
+void RGBWLamp::updatePower(void) {
+  _modelled = _supply > 0;
+  for (int pin=0; pin<lampPins; pin++) {
+    float drop = _supply - _forwardvolts[pin];
+    _fullwatts[pin] = _amps[pin]*(drop>0?drop:0);
+  }
+  _watts.fill(0);
+  _powerscale = 1;
+  // Rewrite every pin on the next frame so the estimate starts from it.
+  invalidate();
+}
+
+float RGBWLamp::getPower(void) {
+  float total = 0;
+  for (int pin=0; pin<lampPins; pin++) total += _watts[pin];
+  return total;
+}
+
+float RGBWLamp::getPower(int channel) {
+  if ((channel < 0) || (channel >= (int)_pins.size())) return 0;
+  int pin = _pins[channel];
+  return (pin >= 0) && (pin < lampPins) ? _watts[pin] : 0;
+}
+
+float RGBWLamp::getPowerScale(void) {
+  return _powerscale;
+}
+
 void RGBWLamp::setColor(HSIColor &color) {
-  std::vector<float> LEDs = _colorspace->Hue2LEDs(color);
-  for (int i=0; i<LEDs.size(); i++) {
-    LEDs[i] = _maxvalues[i] * LEDs[i];
+#ifdef FIXEDPOINT
+  HSIColorQ16 fixedcolor(color);
+  setColor(fixedcolor);
+#else
+  // Converts into the lamp's own buffer so that rendering a frame does
+  // not touch the heap.
+  int channels = getLevels(color, _LEDOutputs.data());
+  setLEDs(_LEDOutputs.data(), _pins.data(), channels);
+#endif
+}
+
+int RGBWLamp::getLevels(HSIColor &color, float *levels) {
+  int channels = _colorspace->Hue2LEDs(color, levels, maxChannels);
+  for (int i=0; i<channels; i++) {
+    levels[i] = _maxvalues[i] * levels[i];
+  }
+  return channels;
+}
+
+void RGBWLamp::setColor(HSIColorQ16 &color) {
+  int channels = _colorspace->Hue2LEDs(color, _LEDOutputsQ16);
+  for (int i=0; i<channels; i++) {
+    _LEDOutputsQ16[i] = mulQ16(_maxvaluesQ16[i], _LEDOutputsQ16[i]);
   }
-  setLEDs(LEDs, _pins);
+  setLEDs(_LEDOutputsQ16.data(), _pins.data(), channels);
 }
 
 void RGBWLamp::setLEDs(std::vector<float> &LEDs, std::vector<int> &pins) {
-  for (int i=0; i<LEDs.size(); i++) {
-    analogWrite(pins[i], 0xFFFF * LEDs[i]);
+  setLEDs(LEDs.data(), pins.data(), LEDs.size());
+}
+
+void RGBWLamp::setLEDs(const float *LEDs, const int *pins, int channels) {
+  if (_modelled) {
+    uint32_t duties[maxChannels];
+    if (channels > maxChannels) channels = maxChannels;
+    for (int i=0; i<channels; i++) duties[i] = levelDuty(pins[i], LEDs[i]);
+    limitDuties(duties, pins, channels);
+    for (int i=0; i<channels; i++) writeFineDuty(pins[i], duties[i]);
+    return;
+  }
+  for (int i=0; i<channels; i++) {
+    writeLevel(pins[i], LEDs[i]);
 //    Serial.print(LEDs[i]);
 //    Serial.print(" ");
   }
 //  Serial.println("");
 }
 
+// Q16 levels, so 0x10000 is fully on.
+void RGBWLamp::setLEDs(const uint32_t *LEDs, const int *pins, int channels) {
+  if (_modelled) {
+    uint32_t duties[maxChannels];
+    if (channels > maxChannels) channels = maxChannels;
+    for (int i=0; i<channels; i++) {
+      int pin = pins[i];
+      uint32_t level = LEDs[i]<0x10000?LEDs[i]:0x10000;
+      if ((pin >= 0) && (pin < lampPins) && _transfers[pin]) duties[i] = _transfers[pin]->getDuty(level*(1.0f/0x10000));
+      else duties[i] = ((uint64_t)0xFFFF00 * level) >> 16;
+    }
+    limitDuties(duties, pins, channels);
+    for (int i=0; i<channels; i++) writeFineDuty(pins[i], duties[i]);
+    return;
+  }
+  for (int i=0; i<channels; i++) {
+    int pin = pins[i];
+    if (_ditherBits || ((pin >= 0) && (pin < lampPins) && _transfers[pin])) writeLevel(pin, LEDs[i]*(1.0f/0x10000));
+    else writeDuty(pin, ((uint64_t)0xFFFF * LEDs[i]) >> 16);
+  }
+}
+
+// Levels for each colorspace channel, scaled by each LED's maximum.
+void RGBWLamp::setLevels(const float *levels, int channels) {
+  if (channels > (int)_pins.size()) channels = _pins.size();
+  for (int i=0; i<channels; i++) {
+    _LEDOutputs[i] = _maxvalues[i] * levels[i];
+  }
+  setLEDs(_LEDOutputs.data(), _pins.data(), channels);
+}
+
+void RGBWLamp::setFrame(const LampFrame &frame) {
+  if (frame.direct) {
+    setLEDs(frame.levels.data(), frame.pins.data(), frame.channels);
+  }
+  else {
+    HSIColor color = frame.color;
+    setColor(color);
+  }
+}
+
+int RGBWLamp::getChannels(void) {
+  return _pins.size();
+}
+
+int RGBWLamp::getPin(int channel) {
+  return _pins[channel];
+}
+
 void RGBWLamp::addColorspace(std::shared_ptr<Colorspace> colorspace) {  
   _pins = colorspace->getPins();
   _maxvalues = colorspace->getMaxValues();
+  _maxvaluesQ16.clear();
+  for (unsigned int i=0; i<_maxvalues.size(); i++) {
+    _maxvaluesQ16.push_back(_maxvalues[i] * 0x10000 + 0.5f);
+  }
   _colorspace = colorspace;
 }
 
@@ -86,6 +399,122 @@ void HSIColor::getHSI(float *HSI) {
   HSI[2] = getIntensity();
 }
 
+boolean HSIColor::operator==(const HSIColor &color) const {
+  return (_hue == color._hue) && (_saturation == color._saturation) && (_intensity == color._intensity);
+}
+
+boolean HSIColor::operator!=(const HSIColor &color) const {
+  return !(*this == color);
+}
+
+HSIColorQ16::HSIColorQ16(uint16_t hue, uint32_t saturation, uint32_t intensity) {
+  setHSI(hue, saturation, intensity);
+}
+
+HSIColorQ16::HSIColorQ16(HSIColor &color) {
+  // HSIColor keeps the hue within (-360, 360).
+  float hue = color.getHue();
+  if (hue < 0) hue += 360;
+  setHSI((uint32_t)(hue * (float)0x10000/360), color.getSaturation() * 0x10000 + 0.5f, color.getIntensity() * 0x10000 + 0.5f);
+}
+
+// Default constructor.
+HSIColorQ16::HSIColorQ16(void) {
+  setHSI(0, 0, 0);
+}
+
+void HSIColorQ16::setHSI(uint16_t hue, uint32_t saturation, uint32_t intensity) {
+  _hue = hue;
+  _saturation = saturation<0x10000?saturation:0x10000;
+  _intensity = intensity<0x10000?intensity:0x10000;
+}
+
+uint64_t LampClock::_micros = 0;
+
+// The low 32 bits of the count are micros() when it was last read, so the
+// time since is what micros() has moved on by, wrapped or not.
+uint64_t LampClock::now(void) {
+  _micros += (uint32_t)(micros() - (uint32_t)_micros);
+  return _micros;
+}
+
+LampFrame::LampFrame(void) :
+  direct(false),
+  channels(0) {
+}
+
+boolean LampFrame::operator==(const LampFrame &frame) const {
+  if (direct != frame.direct) return false;
+  if (!direct) return color == frame.color;
+  if (channels != frame.channels) return false;
+  for (int i=0; i<channels; i++) {
+    if ((levels[i] != frame.levels[i]) || (pins[i] != frame.pins[i])) return false;
+  }
+  return true;
+}
+
+EffectRegistry::EffectRegistry(void) :
+  _count(0),
+  _active(noEffect),
+  _redraw(true) {
+}
+
+int EffectRegistry::add(Effect &effect) {
+  if (_count == maxEffects) return noEffect;
+  _effects[_count] = &effect;
+  return _count++;
+}
+
+boolean EffectRegistry::select(int number) {
+  if ((number < noEffect) || (number >= _count)) return false;
+  _active = number;
+  _redraw = true;
+  return true;
+}
+
+int EffectRegistry::getActive(void) {
+  return _active;
+}
+
+int EffectRegistry::getCount(void) {
+  return _count;
+}
+
+boolean EffectRegistry::render(void) {
+  int active = _active;
+  if (active == noEffect) return false;
+  _effects[active]->render(_frame);
+  if (!_redraw && (_frame == _drawn)) return false;
+  _drawn = _frame;
+  _redraw = false;
+  return true;
+}
+
+const LampFrame &EffectRegistry::getFrame(void) {
+  return _frame;
+}
+
+void EffectRegistry::redraw(void) {
+  _redraw = true;
+}
+
+HSISteady::HSISteady(HSIColor color) :
+  _color(color) {
+}
+
+void HSISteady::setColor(HSIColor color) {
+  _color = color;
+}
+
+HSIColor HSISteady::getHSIColor(void) {
+  return _color;
+}
+
+void HSISteady::render(LampFrame &frame) {
+  frame.direct = false;
+  frame.color = _color;
+}
+
 HSIFader::HSIFader(HSIColor color1, HSIColor color2, float time, int direction) {
   setFader(color1, color2, time, direction);
 }
@@ -94,35 +523,41 @@ void HSIFader::setFader(HSIColor color1, HSIColor color2, float time, int direct
   _colors[0] = color1;
   _colors[1] = color2;
   _delaymicros = time*1000;
-  _startmicros = micros();
+  _startmicros = LampClock::now();
   _direction = direction;
   // If the hues match, set to constant hue.
   if (_colors[0].getHue() == _colors[1].getHue()) _direction = 2;
 }
 
 HSIColor HSIFader::getHSIColor() {
-  long time = micros() - _startmicros;
+  // How far through the fade, as a float so that no term divides integers.
+  float time = _delaymicros ? (float)(LampClock::now() - _startmicros)/_delaymicros : 1;
   float hue;
   // If direction is 1, rotate positive.
-  if (_direction == 1) hue = (_colors[0].getHue() * (1-time/_delaymicros) + _colors[1].getHue()*time/_delaymicros);
+  if (_direction == 1) hue = (_colors[0].getHue() * (1-time) + _colors[1].getHue()*time);
   // If direction is 0, rotate negative.
-  else if (_direction == 0) hue = (_colors[0].getHue() * (1-time/_delaymicros) + (_colors[1].getHue()-360)*time/_delaymicros);
+  else if (_direction == 0) hue = (_colors[0].getHue() * (1-time) + (_colors[1].getHue()-360)*time);
   // If direction is 2, constant hue.
   else if (_direction == 2) hue = _colors[0].getHue();
   // Otherwise, somethign weird happened. Just set to red.
   else hue = 0;
   
-  float saturation = (_colors[0].getSaturation() * (1-(float)time/_delaymicros) + _colors[1].getSaturation()*(float)time/_delaymicros);
-  float intensity = (_colors[0].getIntensity() * (1-(float)time/_delaymicros) + _colors[1].getIntensity()*(float)time/_delaymicros);
+  float saturation = (_colors[0].getSaturation() * (1-time) + _colors[1].getSaturation()*time);
+  float intensity = (_colors[0].getIntensity() * (1-time) + _colors[1].getIntensity()*time);
   return HSIColor(hue, saturation, intensity);
 }
 
 boolean HSIFader::isRunning(void) {
-  long time = micros() - _startmicros;
+  uint64_t time = LampClock::now() - _startmicros;
   if (time <= _delaymicros) return true;
   else return false;
 }
 
+void HSIFader::render(LampFrame &frame) {
+  frame.direct = false;
+  frame.color = isRunning() ? getHSIColor() : _colors[1];
+}
+
 RandomFader::RandomFader(float period) {
   _periodmicros = period*1000;
 }
@@ -132,19 +567,30 @@ void RandomFader::startRandom(float period) {
   _LED1 = random(_LEDs.size());
   _LED2 = random(_LEDs.size());
   while(_LED1 == _LED2) _LED2 = random(_LEDs.size());
-  _startmicros = micros();
+  _startmicros = LampClock::now();
+}
+
+void RandomFader::clear(void) {
+  _LEDs.clear();
+  _effectLEDs.clear();
+  _effectprob.clear();
+  _effect.clear();
 }
 
+// Only as many LEDs as fit in a frame are kept.
 void RandomFader::addLED(CIELED LED) {
+  if (_LEDs.size() + _effectLEDs.size() >= (unsigned int)maxChannels) return;
   _LEDs.push_back(LED);
 }
 
-std::vector<float> RandomFader::getLEDs(void) {
-  std::vector<float> LEDOutputs;
-  for (int i=0; i<(_LEDs.size()+_effectLEDs.size()); i++) {
-    LEDOutputs.push_back(0);
+void RandomFader::render(LampFrame &frame) {
+  frame.direct = true;
+  frame.channels = _LEDs.size() + _effectLEDs.size();
+  for (int i=0; i<frame.channels; i++) {
+    frame.levels[i] = 0;
   }
-  long time = micros() - _startmicros;
+  uint64_t now = LampClock::now();
+  uint64_t time = now - _startmicros;
   if (time > _periodmicros) {
     _LED1 = _LED2;
     _LED2 = random(_LEDs.size());
@@ -175,38 +621,46 @@ std::vector<float> RandomFader::getLEDs(void) {
       }
     }
             
+    // The next fade starts where this one ended, unless frames stopped
+    // for longer than a fade, and is drawn from its own start.
     _startmicros += _periodmicros;
+    if (now - _startmicros > _periodmicros) _startmicros = now;
+    time = now - _startmicros;
   }
-  LEDOutputs[_LED1] = _LEDs[_LED1].getMax()*(1-((float)time/_periodmicros));
-  LEDOutputs[_LED2] = _LEDs[_LED2].getMax()*((float)time/_periodmicros);
+  frame.levels[_LED1] = _LEDs[_LED1].getMax()*(1-((float)time/_periodmicros));
+  frame.levels[_LED2] = _LEDs[_LED2].getMax()*((float)time/_periodmicros);
   
   if (_effectLEDs.size() != 0) {
     for (unsigned int i=0; i<_effectLEDs.size(); i++) {
       switch (_effect[i]) {
         case 0: // Case where it is off.
-          LEDOutputs[i+_LEDs.size()] = 0;
+          frame.levels[i+_LEDs.size()] = 0;
           break;
         case 1: // Case where it is on.
-          LEDOutputs[i+_LEDs.size()] = 1;
+          frame.levels[i+_LEDs.size()] = 1;
           break;
         case 2: // Case where it is turning on.
-          LEDOutputs[i+_LEDs.size()] = (float)time/_periodmicros;
+          frame.levels[i+_LEDs.size()] = (float)time/_periodmicros;
           break;
         case 3: // Case where it is turning off.
-          LEDOutputs[i+_LEDs.size()] = 1-(float)time/_periodmicros;
+          frame.levels[i+_LEDs.size()] = 1-(float)time/_periodmicros;
           break;
       }
     }
   }
   
-  // For debugging, print the actual output values.
-//  Serial.println("Output Values. LED1 is " + String(_LED1) + " LED2 is " + String(_LED2));
-//  for (std::vector<float>::iterator i=LEDOutputs.begin(); i != LEDOutputs.end(); ++i) {
-//    Serial.print(*i, 2);
-//    Serial.print(" ");
-//  }
-//  Serial.println("");
-  return LEDOutputs;
+  for (unsigned int i=0; i<_LEDs.size(); i++) {
+    frame.pins[i] = _LEDs[i].getPin();
+  }
+  for (unsigned int i=0; i<_effectLEDs.size(); i++) {
+    frame.pins[i+_LEDs.size()] = _effectLEDs[i].getPin();
+  }
+}
+
+std::vector<float> RandomFader::getLEDs(void) {
+  LampFrame frame;
+  render(frame);
+  return std::vector<float>(frame.levels.begin(), frame.levels.begin() + frame.channels);
 }
 
 std::vector<int> RandomFader::getPins(void) {
@@ -223,35 +677,54 @@ std::vector<int> RandomFader::getPins(void) {
 }
 
 void RandomFader::addEffectLED(CIELED LED, float effectprob) {
+  if (_LEDs.size() + _effectLEDs.size() >= (unsigned int)maxChannels) return;
   _effectLEDs.push_back(LED);
   _effectprob.push_back(effectprob);
   _effect.push_back(0);
 }
 
 HSICycler::HSICycler(HSIColor color, float time, int dir) :
-  _color(color) {
-  if (dir == 1) _huestep = 0.36/(float)time;
-  if (dir == 0) _huestep = -0.36/(float)time;
-  _lastmicros = micros();
+  _color(color),
+  _startmicros(LampClock::now()),
+  _periodmicros(0),
+  _starthue(color.getHue()),
+  _huestep(0) {
+  setCycler(color, time, dir);
 }
 
+// A turn needs a time above 0 and a direction of 0 or 1. Anything else
+// would step the hue by infinity or leave the step as it was, so it is
+// ignored, and a cycler that has never had one holds its color.
 void HSICycler::setCycler(HSIColor color, float time, int dir) {
+  if (!(time > 0) || ((dir != 0) && (dir != 1))) return;
   _color = color;
+  _starthue = color.getHue();
   if (dir == 1) _huestep = 0.36/time;
   if (dir == 0) _huestep = -0.36/time;
-  _lastmicros = micros();
+  _periodmicros = time*1000;
+  _startmicros = LampClock::now();
 }
 
+// The hue is worked out from the start of the turn it is in rather than
+// added up frame by frame, so it does not drift over a long show.
 HSIColor HSICycler::getHSIColor(void) {
-  long time = micros() - _lastmicros;
-  _color.setHue(_color.getHue() + (time * _huestep));
-  _lastmicros = micros();
+  uint64_t now = LampClock::now();
+  if (now - _startmicros >= _periodmicros) {
+    _startmicros += _periodmicros;
+    if (now - _startmicros >= _periodmicros) _startmicros = now - (now - _startmicros) % (_periodmicros ? _periodmicros : 1);
+  }
+  _color.setHue(_starthue + (now - _startmicros) * _huestep);
   return _color;
 }
 
+void HSICycler::render(LampFrame &frame) {
+  frame.direct = false;
+  frame.color = getHSIColor();
+}
+
 HSIStrober::HSIStrober(HSIColor color1, HSIColor color2, float time) {
   setStrober(color1, color2, time);
-  _startmicros = micros();
+  _startmicros = LampClock::now();
   _periodmicros = _periodmicrosDB;
 }
 
@@ -270,58 +743,170 @@ void HSIStrober::setColor(int num, HSIColor color) {
 }
 
 HSIColor HSIStrober::getHSIColor(void) {
-  long time = micros() - _startmicros;
-  // For first half, show color1.
-  if (time < _periodmicros/2) {
-    return _colors[0];
-  }
-  if (time > _periodmicros/2) {
-    if (time > _periodmicros) {
-      // Load the double buffered period.
-      _periodmicros = _periodmicrosDB;
-      _startmicros = micros();
-      return _colors[0];
-    }
-    else return _colors[1];
+  uint64_t now = LampClock::now();
+  if (now - _startmicros >= _periodmicros) {
+    // The next period starts where this one ended, so the strobe keeps
+    // time, unless frames stopped for longer than a period.
+    _startmicros += _periodmicros;
+    // Load the double buffered period.
+    _periodmicros = _periodmicrosDB;
+    if (now - _startmicros >= _periodmicros) _startmicros = now;
   }
-  // Shouldn't get here.
-  return _colors[0];
+  // For first half, show color1.
+  if (now - _startmicros < _periodmicros/2) return _colors[0];
+  else return _colors[1];
 }
 
-CIELED::CIELED(float u, float v, float maxvalue, int pin) :
-  _u(u),
-  _v(v),
-  _maxvalue(maxvalue),
-  _pin(pin) {
+void HSIStrober::render(LampFrame &frame) {
+  frame.direct = false;
+  frame.color = getHSIColor();
 }
 
-CIELED::CIELED(void) {
+// An address whose footprint does not fit the universe leaves the
+// fixture at address 1.
+DMXFixture::DMXFixture(RGBWLamp &lamp, int address, DMXPersonality personality) :
+  _lamp(lamp),
+  _address(1),
+  _personality(personality) {
+  setFixture(address, personality);
 }
-  
-float CIELED::getU(void) {
-  return _u;
+
+// Changes the start address and personality, as long as the whole
+// footprint fits in the 512 channel universe.
+boolean DMXFixture::setFixture(int address, DMXPersonality personality) {
+  DMXPersonality oldpersonality = _personality;
+  _personality = personality;
+  if ((address < 1) || (address + getFootprint() - 1 > 512)) {
+    _personality = oldpersonality;
+    return false;
+  }
+  _address = address;
+  return true;
 }
 
-float CIELED::getV(void) {
-  return _v;
+int DMXFixture::getAddress(void) {
+  return _address;
 }
 
-float CIELED::getMax(void) {
-  return _maxvalue;
+int DMXFixture::getFootprint(void) {
+  switch (_personality) {
+    case DMXHSI8:
+      return 3;
+    case DMXHSI16:
+      return 6;
+    default:
+      return _lamp.getChannels() < maxChannels ? _lamp.getChannels() : maxChannels;
+  }
 }
 
-int CIELED::getPin(void) {
-  return _pin;
+void DMXFixture::apply(const uint8_t *slots) {
+  switch (_personality) {
+    case DMXHSI8: {
+      // Hue goes all the way round, so 256 would be back at 0.
+      HSIColor color((float)slots[0]*360/256, (float)slots[1]/255, (float)slots[2]/255);
+      _lamp.setColor(color);
+      break;
+    }
+    case DMXHSI16: {
+      unsigned int hue = (slots[0] << 8) | slots[1];
+      unsigned int saturation = (slots[2] << 8) | slots[3];
+      unsigned int intensity = (slots[4] << 8) | slots[5];
+      HSIColor color((float)hue*360/65536, (float)saturation/65535, (float)intensity/65535);
+      _lamp.setColor(color);
+      break;
+    }
+    default: {
+      int channels = getFootprint();
+      for (int i=0; i<channels; i++) {
+        _levels[i] = (float)slots[i]/255;
+      }
+      _lamp.setLevels(_levels.data(), channels);
+      break;
+    }
+  }
 }
 
 Colorspace::Colorspace(CIELED &white) :
-  _white(white) {
+  _white(white),
+  _tablescale(0),
+  _resolution(0),
+  _interpolate(true),
+  _mixmode(MixPair) {
+  _mixcells.fill(0);
+  point();
 }
 
-Colorspace::Colorspace(void) {
+Colorspace::Colorspace(void) :
+  _tablescale(0),
+  _resolution(0),
+  _interpolate(true),
+  _mixmode(MixPair) {
+  _mixcells.fill(0);
+  point();
+}
+
+Colorspace::Colorspace(const Colorspace &colorspace) {
+  *this = colorspace;
+}
+
+// A copy of a colorspace in RAM points at its own copies of the vectors.
+Colorspace &Colorspace::operator=(const Colorspace &colorspace) {
+  _LEDs = colorspace._LEDs;
+  _angle = colorspace._angle;
+  _slope = colorspace._slope;
+  _table = colorspace._table;
+  _tableQ16 = colorspace._tableQ16;
+  _angleQ16 = colorspace._angleQ16;
+  _count = colorspace._count;
+  _fixed = colorspace._fixed;
+  _ownLEDs = colorspace._ownLEDs;
+  _ownangle = colorspace._ownangle;
+  _ownslope = colorspace._ownslope;
+  _owntable = colorspace._owntable;
+  _owntableQ16 = colorspace._owntableQ16;
+  _ownangleQ16 = colorspace._ownangleQ16;
+  _white = colorspace._white;
+  _tablescale = colorspace._tablescale;
+  _resolution = colorspace._resolution;
+  _interpolate = colorspace._interpolate;
+  _mixmode = colorspace._mixmode;
+  _mix = colorspace._mix;
+  _mixinverse = colorspace._mixinverse;
+  _mixhues = colorspace._mixhues;
+  _mixedges = colorspace._mixedges;
+  _mixcells = colorspace._mixcells;
+  if (!_fixed) point();
+  return *this;
+}
+
+// Points the colorspace at its own LEDs and tables, after they change.
+void Colorspace::point(void) {
+  _fixed = false;
+  _count = _ownLEDs.size();
+  _LEDs = _ownLEDs.data();
+  _angle = _ownangle.data();
+  _slope = _ownslope.data();
+  _table = _owntable.empty() ? 0 : _owntable.data();
+  _tableQ16 = _owntableQ16.empty() ? 0 : _owntableQ16.data();
+  _angleQ16 = _ownangleQ16.empty() ? 0 : _ownangleQ16.data();
+}
+
+// Copies a fixed colorspace's LEDs into RAM, to change them or build new
+// tables from them.
+void Colorspace::own(void) {
+  if (!_fixed) return;
+  _ownLEDs.assign(_LEDs, _LEDs + _count);
+  _ownangle.assign(_angle, _angle + _count);
+  _ownslope.assign(_slope, _slope + _count);
+  _owntable.clear();
+  _owntableQ16.clear();
+  _ownangleQ16.clear();
+  point();
 }
 
 void Colorspace::addLED(CIELED &LED) {
+  own();
+  
   // To figure out where to put it in the colorspace, calculate the angle from the white point.
   float uLED = LED.getU();
   float vLED = LED.getV();
@@ -331,29 +916,33 @@ void Colorspace::addLED(CIELED &LED) {
   float angle = fmod((180/M_PI) * atan2((vLED - vWHITE),(uLED - uWHITE)) + 360, 360);
   
   // If it is the first LED, simply place it in the array.
-  if (_LEDs.empty()) {
-    _LEDs.push_back(LED);
-    _angle.push_back(angle);
+  if (_ownLEDs.empty()) {
+    _ownLEDs.push_back(LED);
+    _ownangle.push_back(angle);
     // With only one LED, slope is undefined.
-    _slope.push_back(0);
+    _ownslope.push_back(0);
   }
   // Otherwise, place the LED at the appropriate point in the array, and also recalculate slopes.
   else {
     int insertlocation;
     // Iterate through until finding the first location where the angle fits.
-    for (insertlocation = 0; (_angle[insertlocation] < angle) && (insertlocation < _angle.size()); insertlocation++);
-    _LEDs.insert(_LEDs.begin() + insertlocation, LED);
-    _angle.insert(_angle.begin() + insertlocation, angle);
+    for (insertlocation = 0; (_ownangle[insertlocation] < angle) && (insertlocation < _ownangle.size()); insertlocation++);
+    _ownLEDs.insert(_ownLEDs.begin() + insertlocation, LED);
+    _ownangle.insert(_ownangle.begin() + insertlocation, angle);
     
     // Add an empty slope since we need to recalculate them all once they're ordered.
-    _slope.push_back(0);
+    _ownslope.push_back(0);
     
     // And then recalculate all slopes. Last slope is a special case.
-    for (int i=0; i<(_LEDs.size()-1); i++) {
-      _slope[i] = (_LEDs[i+1].getV() - _LEDs[i].getV()) / (_LEDs[i+1].getU() - _LEDs[i].getU());
+    for (int i=0; i<(_ownLEDs.size()-1); i++) {
+      _ownslope[i] = (_ownLEDs[i+1].getV() - _ownLEDs[i].getV()) / (_ownLEDs[i+1].getU() - _ownLEDs[i].getU());
     }
-    _slope[_LEDs.size()-1] = (_LEDs[0].getV() - _LEDs[_LEDs.size()-1].getV()) / (_LEDs[0].getU() - _LEDs[_LEDs.size()-1].getU());
+    _ownslope[_ownLEDs.size()-1] = (_ownLEDs[0].getV() - _ownLEDs[_ownLEDs.size()-1].getV()) / (_ownLEDs[0].getU() - _ownLEDs[_ownLEDs.size()-1].getU());
   } 
+  point();
+  
+  // Keep an existing lookup table in step with the new LED set.
+  if (_resolution > 0) finalize(_resolution, _interpolate);
   
 //  // For debugging, print the current array of angles.
 //  Serial.println("Current LED Angles");
@@ -374,9 +963,13 @@ float Colorspace::getAngle(int num) {
   return _angle[num];
 }
 
+float Colorspace::getSlope(int num) {
+  return _slope[num];
+}
+
 std::vector<int> Colorspace::getPins(void) {
   std::vector<int> pins;
-  for (int i=0; i<_LEDs.size(); i++) {
+  for (int i=0; i<_count; i++) {
     pins.push_back(_LEDs[i].getPin());
   }
   pins.push_back(_white.getPin());
@@ -385,55 +978,337 @@ std::vector<int> Colorspace::getPins(void) {
 
 std::vector<float> Colorspace::getMaxValues(void) {
   std::vector<float> maxvals;
-  for (int i=0; i<_LEDs.size(); i++) {
+  for (int i=0; i<_count; i++) {
     maxvals.push_back(_LEDs[i].getMax());
   }
   maxvals.push_back(_white.getMax());
   return maxvals;
 }
 
-// And this is the meat. Converts the abstract color into RGBW (scaled 0-1).
+int Colorspace::getChannels(void) {
+  return _count + 1;
+}
+
 std::vector<float> Colorspace::Hue2LEDs(HSIColor &HSI) {
-  float H = fmod(HSI.getHue()+360,360);
+  // Has all LED output values followed by white.
+  std::vector<float> LEDOutputs(getChannels());
+  Hue2LEDs(HSI, LEDOutputs.data(), LEDOutputs.size());
+  return LEDOutputs;
+}
+
+// And this is the meat. Converts the abstract color into RGBW (scaled 0-1).
+// Writes the LED output values followed by white into the caller's buffer
+// and returns how many channels were written, getChannels(), or 0 if the
+// buffer is too small to hold them.
+int Colorspace::Hue2LEDs(HSIColor &HSI, float *LEDOutputs, int channels) {
+  if (channels < getChannels()) return 0;
+  channels = getChannels();
+  
   float S = HSI.getSaturation();
   float I = HSI.getIntensity();
   
-  float tanH = tan(M_PI*fmod(H,360)/(float)180); // Get the tangent since we will use it often.
+  if (!_mix.empty()) {
+    // Find the rows either side of the hue, starting from the first row
+    // of its step, which is at most a few LED angles away.
+    float H = HSI.getHue();
+    if (H < 0) H += 360;
+    int step = H * (mixHues/360.0f);
+    if (step >= mixHues) step = H = 0;
+    int row = _mixcells[step];
+    while (_mixhues[row+1] <= H) row++;
+    // Both rows' targets lie on one edge of the gamut, which the hue does
+    // not turn along evenly, so blend them as far as the hue's ray meets
+    // that edge.
+    float radians = H * (float)(M_PI/180);
+    float du = cosf(radians), dv = sinf(radians);
+    const float *edge = &_mixedges[2*row];
+    float along = du*(edge[3] - edge[1]) - dv*(edge[2] - edge[0]);
+    float th = (H - _mixhues[row]) / (_mixhues[row+1] - _mixhues[row]);
+    if (along != 0) th = (edge[0]*dv - edge[1]*du) / along;
+    th = th>0?(th<1?th:1):0;
+    float s = S * mixSaturations;
+    int saturation = s;
+    if (saturation >= mixSaturations) saturation = mixSaturations - 1;
+    float ts = s - saturation;
+    // The four mixes of the cell are blended by weight over light, as if
+    // each made the same light, so the chromaticity follows the targets
+    // and no channel goes past full.
+    int corner = row*(mixSaturations + 1) + saturation;
+    int corners[4] = {corner, corner + 1, corner + mixSaturations + 1, corner + mixSaturations + 2};
+    float weights[4] = {(1-th)*(1-ts), (1-th)*ts, th*(1-ts), th*ts};
+    float total = 0;
+    for (int k=0; k<4; k++) {
+      weights[k] *= _mixinverse[corners[k]];
+      total += weights[k];
+    }
+    for (int i=0; i<channels; i++) {
+      LEDOutputs[i] = 0;
+    }
+    for (int k=0; k<4; k++) {
+      const uint16_t *mix = &_mix[corners[k]*channels];
+      float weight = weights[k] * I / (total * 0xFFFF);
+      for (int i=0; i<channels; i++) {
+        LEDOutputs[i] += weight * mix[i];
+      }
+    }
+    return channels;
+  }
   
-  // Has all LED output values followed by white.
-  std::vector<float> LEDOutputs;
+  for (int i=0; i<channels; i++) {
+    LEDOutputs[i] = 0;
+  }
+  
+  if (_table) {
+    // Once finalized, the LED pair and weights come from the table.
+    // HSIColor keeps the hue within (-360, 360).
+    float H = HSI.getHue();
+    if (H < 0) H += 360;
+    float position = H * _tablescale;
+    float IS = I * S;
+    if (_interpolate) {
+      int index = position;
+      if (index >= _resolution) index = position = 0;
+      float t = position - index;
+      const HueSegment &a = _table[index];
+      const HueSegment &b = _table[index+1];
+      
+      if ((a.LED1 == b.LED1) && (a.LED2 == b.LED2)) {
+        // Both ends mix the same two LEDs, so blend their weights.
+        LEDOutputs[a.LED1] = IS * ((1-t) * a.weight1 + t * b.weight1);
+        LEDOutputs[a.LED2] = IS * ((1-t) * a.weight2 + t * b.weight2);
+      }
+      else if (a.LED2 == b.LED1) {
+        // The cell holds the angle of the LED shared by both pairs, where
+        // it is the only one lit. Blend towards that point from whichever
+        // side the hue is on so the kink there is kept.
+        float split = _angle[a.LED2] * _tablescale - index;
+        if (t < split) {
+          float u = t / split;
+          LEDOutputs[a.LED1] = IS * (1-u) * a.weight1;
+          LEDOutputs[a.LED2] = IS * ((1-u) * a.weight2 + u);
+        }
+        else {
+          float u = (t - split) / (1 - split);
+          LEDOutputs[b.LED1] = IS * ((1-u) + u * b.weight1);
+          LEDOutputs[b.LED2] = IS * u * b.weight2;
+        }
+      }
+      else {
+        // More than one LED angle in the cell, only with very coarse tables.
+        int LED1, LED2;
+        float weight1, weight2;
+        hueWeights(H, LED1, LED2, weight1, weight2);
+        LEDOutputs[LED1] = IS * weight1;
+        LEDOutputs[LED2] = IS * weight2;
+      }
+    }
+    else {
+      const HueSegment &a = _table[(int)(position + 0.5f)];
+      LEDOutputs[a.LED1] = IS * a.weight1;
+      LEDOutputs[a.LED2] = IS * a.weight2;
+    }
+  }
+  else {
+    float H = fmod(HSI.getHue()+360,360);
+    int LED1, LED2;
+    float weight1, weight2;
+    hueWeights(H, LED1, LED2, weight1, weight2);
+    
+    // Set the two selected colors.
+    LEDOutputs[LED1] = I * S * weight1;
+    LEDOutputs[LED2] = I * S * weight2;
+  }
+  
+  // And set white.
+  LEDOutputs[_count] = I * (1 - S);
+  
+//  // For debugging, print the actual output values.
+//  Serial.println("Target Hue of " + String(HSI.getHue()));
+//  Serial.println("Output Values");
+//  for (int i=0; i<channels; i++) {
+//    Serial.print(LEDOutputs[i], 2);
+//    Serial.print(" ");
+//  }
+//  Serial.println("");
+  
+  return channels;
+}
+
+// The batch conversion goes through a block of colors in passes. The
+// first and last only do arithmetic on contiguous arrays so that they
+// vectorize, leaving the table reads on their own in the middle.
+#define Hue2LEDsBlock 32
+
+int Colorspace::Hue2LEDs(const float *hue, const float *saturation, const float *intensity, int count, float *LEDOutputs, int channels) {
+  int used = getChannels();
+  if (channels < used) return 0;
+  
+  for (int i=0; i<count*channels; i++) {
+    LEDOutputs[i] = 0;
+  }
+  
+  if (!_table || !_interpolate || !_mix.empty()) {
+    for (int i=0; i<count; i++) {
+      HSIColor color(hue[i], saturation[i], intensity[i]);
+      Hue2LEDs(color, LEDOutputs + i*channels, channels);
+    }
+    return used;
+  }
+  
+  int index[Hue2LEDsBlock];
+  float t[Hue2LEDsBlock], sat[Hue2LEDsBlock], in[Hue2LEDsBlock];
+  float IS[Hue2LEDsBlock], white[Hue2LEDsBlock];
+  for (int start=0; start<count; start+=Hue2LEDsBlock) {
+    int n = count - start < Hue2LEDsBlock ? count - start : Hue2LEDsBlock;
+    const float *H = hue + start, *S = saturation + start, *I = intensity + start;
+    float *rows = LEDOutputs + start*channels;
+    
+    // Clamp S and I as HSIColor does, in a pass of their own. Clamping
+    // and using them in one loop lets the compiler split it into cases
+    // for the clamped ends, which stops it vectorizing.
+    for (int i=0; i<n; i++) {
+      float s = S[i]>0?S[i]:0;
+      sat[i] = s<1?s:1;
+      float v = I[i]>0?I[i]:0;
+      in[i] = v<1?v:1;
+    }
+    
+    // Table cells and how far along them each hue is. Wrapping is done
+    // by multiplying with 0 or 1 for the same reason.
+    for (int i=0; i<n; i++) {
+      float h = H[i] - 360*(int)(H[i]/360);
+      h += (h < 0)*360.0f;
+      float position = h * _tablescale;
+      int cell = position;
+      int wrap = cell >= _resolution;
+      index[i] = cell*(1-wrap);
+      t[i] = (position - cell)*(1-wrap);
+      IS[i] = in[i] * sat[i];
+      white[i] = in[i] * (1 - sat[i]);
+    }
+    
+    // Blend the weights of each cell. Cells that hold an LED angle take
+    // the single color path, which keeps the kink there.
+    for (int i=0; i<n; i++) {
+      const HueSegment &a = _table[index[i]];
+      const HueSegment &b = _table[index[i]+1];
+      float *row = rows + i*channels;
+      if ((a.LED1 == b.LED1) && (a.LED2 == b.LED2)) {
+        row[a.LED1] = IS[i] * ((1-t[i]) * a.weight1 + t[i] * b.weight1);
+        row[a.LED2] = IS[i] * ((1-t[i]) * a.weight2 + t[i] * b.weight2);
+      }
+      else {
+        HSIColor color(H[i], S[i], I[i]);
+        Hue2LEDs(color, row, channels);
+      }
+    }
+    
+    // And white, in the last used channel of each row.
+    for (int i=0; i<n; i++) {
+      rows[i*channels + used - 1] = white[i];
+    }
+  }
+  
+  return used;
+}
+
+// The same conversion in Q16 fixed point, into levels where 0x10000 is
+// fully on. Needs the table from finalize(), and falls back to the float
+// path without one.
+int Colorspace::Hue2LEDs(HSIColorQ16 &HSI, uint32_t *LEDOutputs, int channels) {
+  if (channels < getChannels()) return 0;
+  channels = getChannels();
+  
+  uint32_t S = HSI.getSaturation();
+  uint32_t I = HSI.getIntensity();
   
-  for (int i=0; i<(_LEDs.size()+1); i++) {
-    LEDOutputs.push_back(0);
+  if (!_tableQ16 || !_mix.empty()) {
+    HSIColor color((float)HSI.getHue()*360/0x10000, (float)S/0x10000, (float)I/0x10000);
+    float levels[maxChannels];
+    channels = Hue2LEDs(color, levels, maxChannels);
+    for (int i=0; i<channels; i++) {
+      LEDOutputs[i] = levels[i] * 0x10000 + 0.5f;
+    }
+    return channels;
+  }
+  
+  for (int i=0; i<channels; i++) {
+    LEDOutputs[i] = 0;
   }
   
-  int LED1, LED2;
+  // Position in the table with a 16 bit fraction.
+  uint32_t position = (uint32_t)HSI.getHue() * _resolution;
+  uint64_t IS = (uint64_t)I * S;
+  
+  if (_interpolate) {
+    int index = position >> 16;
+    uint32_t t = position & 0xFFFF;
+    const HueSegmentQ16 &a = _tableQ16[index];
+    const HueSegmentQ16 &b = _tableQ16[index+1];
+    
+    if ((a.LED1 == b.LED1) && (a.LED2 == b.LED2)) {
+      LEDOutputs[a.LED1] = blendQ16(IS, t, a.weight1, b.weight1);
+      LEDOutputs[a.LED2] = blendQ16(IS, t, a.weight2, b.weight2);
+    }
+    else if (a.LED2 == b.LED1) {
+      // As in the float path, blend towards the shared LED's angle.
+      int32_t split = (int32_t)(_angleQ16[a.LED2] - ((uint32_t)index << 16));
+      split = split>0?(split<0xFFFF?split:0xFFFF):0;
+      if ((int32_t)t < split) {
+        uint32_t u = (t << 16) / split;
+        LEDOutputs[a.LED1] = blendQ16(IS, u, a.weight1, 0);
+        LEDOutputs[a.LED2] = blendQ16(IS, u, a.weight2, 0x10000);
+      }
+      else {
+        uint32_t u = ((t - split) << 16) / (0x10000 - split);
+        LEDOutputs[b.LED1] = blendQ16(IS, u, 0x10000, b.weight1);
+        LEDOutputs[b.LED2] = blendQ16(IS, u, 0, b.weight2);
+      }
+    }
+    else {
+      int LED1, LED2;
+      float weight1, weight2;
+      hueWeights((float)HSI.getHue()*360/0x10000, LED1, LED2, weight1, weight2);
+      LEDOutputs[LED1] = blendQ16(IS, 0, weight1 * 0x10000 + 0.5f, 0);
+      LEDOutputs[LED2] = blendQ16(IS, 0, weight2 * 0x10000 + 0.5f, 0);
+    }
+  }
+  else {
+    const HueSegmentQ16 &a = _tableQ16[(position + 0x8000) >> 16];
+    LEDOutputs[a.LED1] = blendQ16(IS, 0, a.weight1, 0);
+    LEDOutputs[a.LED2] = blendQ16(IS, 0, a.weight2, 0);
+  }
+  
+  // And set white.
+  LEDOutputs[_count] = mulQ16(I, 0x10000 - S);
+  
+  return channels;
+}
+
+// Finds the two LEDs either side of hue H (in [0, 360)) and how much of
+// each makes up that hue at full saturation and intensity.
+void Colorspace::hueWeights(float H, int &LED1, int &LED2, float &weight1, float &weight2) {
+  float tanH = tan(M_PI*fmod(H,360)/(float)180); // Get the tangent since we will use it often.
  
   // Check the range to determine which intersection to do.
   // For angle less than the smallest CIE hue or larger than the largest, special case.
   
-  if ((H < _angle[0]) || (H >= _angle[_LEDs.size()-1])) {
+  if ((H < _angle[0]) || (H >= _angle[_count-1])) {
     // Then we're mixing the lowest angle LED with the highest angle LED.
-    LED1 = _LEDs.size() - 1;
+    LED1 = _count - 1;
     LED2 = 0;
   }
   
   else {
     // Iterate through the angles until we find an LED with hue smaller than the angle.
     int i;
-    for (i=1; (H > _angle[i]) && (i<(_LEDs.size()-1)); i++) {
-      if (H > _angle[i]) {
-        LED1 = i-1;
-        LED2 = i;
-      }
-    }
+    for (i=1; (H > _angle[i]) && (i<(_count-1)); i++);
     LED1 = i-1;
     LED2 = i;
   }
   
   // Get the ustar and vstar values for the target LEDs.
   float LED1_ustar = _LEDs[LED1].getU() - _white.getU();
-  float LED1_vstar = _LEDs[LED1].getV() - _white.getV();
   float LED2_ustar = _LEDs[LED2].getU() - _white.getU();
   float LED2_vstar = _LEDs[LED2].getV() - _white.getV();
   
@@ -441,25 +1316,249 @@ std::vector<float> Colorspace::Hue2LEDs(HSIColor &HSI) {
   float slope = _slope[LED1];
   
   float ustar = (LED2_vstar - slope*LED2_ustar)/(tanH - slope);
-  float vstar = tanH/(slope - tanH) * (slope * LED2_ustar - LED2_vstar);
-  
-  // Set the two selected colors.
-  LEDOutputs[LED1] = I * S * abs(ustar-LED2_ustar)/abs(LED2_ustar - LED1_ustar);
-  LEDOutputs[LED2] = I * S * abs(ustar-LED1_ustar)/abs(LED2_ustar - LED1_ustar);
   
-  // And set white.
-  LEDOutputs[_LEDs.size()] = I * (1 - S);
+  weight1 = abs(ustar-LED2_ustar)/abs(LED2_ustar - LED1_ustar);
+  weight2 = abs(ustar-LED1_ustar)/abs(LED2_ustar - LED1_ustar);
+}
+
+// Builds the hue lookup table once the LED set is complete. The table has
+// resolution entries around the hue circle plus a copy of the first at
+// the end, each holding the LED pair and weights at that hue. With
+// interpolation the weights of neighbouring entries are blended,
+// otherwise the nearest entry is used as is. Adding an LED afterwards
+// rebuilds the table. A fixed colorspace already has the table for its
+// own resolution.
+void Colorspace::finalize(int resolution, boolean interpolate) {
+  _mix.clear();
+  _mixinverse.clear();
+  _mixedges.clear();
+  if (!_fixed || (resolution != _resolution)) {
+    own();
+    _owntable.clear();
+    _owntableQ16.clear();
+    _ownangleQ16.clear();
+    point();
+  }
+  _resolution = resolution;
+  _interpolate = interpolate;
+  if ((resolution <= 0) || (_count < 2)) return;
   
-//  // For debugging, print the actual output values.
-//  Serial.println("Target Hue of " + String(H) + " between LEDs " + String(LED1) + " and " + String(LED2));
-//  Serial.println("Output Values");
-//  for (std::vector<float>::iterator i=LEDOutputs.begin(); i != LEDOutputs.end(); ++i) {
-//    Serial.print(*i, 2);
-//    Serial.print(" ");
-//  }
-//  Serial.println("");
+  if (!_fixed) {
+    _owntable.resize(resolution + 1);
+    _tablescale = (float)resolution/360;
+    for (int i=0; i<resolution; i++) {
+      int LED1, LED2;
+      float weight1, weight2;
+      hueWeights((float)i*360/resolution, LED1, LED2, weight1, weight2);
+      _owntable[i].LED1 = LED1;
+      _owntable[i].LED2 = LED2;
+      _owntable[i].weight1 = weight1;
+      _owntable[i].weight2 = weight2;
+    }
+    _owntable[resolution] = _owntable[0];
+    
+    // And the Q16 copy, with LED angles as table positions.
+    _owntableQ16.resize(resolution + 1);
+    for (int i=0; i<=resolution; i++) {
+      _owntableQ16[i].LED1 = _owntable[i].LED1;
+      _owntableQ16[i].LED2 = _owntable[i].LED2;
+      _owntableQ16[i].weight1 = _owntable[i].weight1 * 0x10000 + 0.5f;
+      _owntableQ16[i].weight2 = _owntable[i].weight2 * 0x10000 + 0.5f;
+    }
+    for (int i=0; i<_count; i++) {
+      _ownangleQ16.push_back(_angle[i] * _tablescale * 0x10000 + 0.5f);
+    }
+    point();
+  }
   
-  return LEDOutputs;
+  if (_mixmode != MixPair) buildMix();
+}
+
+void Colorspace::setMix(MixMode mode) {
+  _mixmode = mode;
+  if (_resolution > 0) finalize(_resolution, _interpolate);
+}
+
+MixMode Colorspace::getMix(void) {
+  return _mixmode;
+}
+
+// A small simplex for the mixing table: maximizes objective.x over
+// 0 <= x <= 1 with rows.x = rhs, for n LEDs and m rows. The upper bounds
+// are rows of their own with a slack each, and a first phase with an
+// artificial variable per row finds a starting mix. Bland's rule keeps it
+// from cycling. Returns false if no mix makes the target.
+#define mixRows 3
+#define mixTableauRows (mixRows + maxChannels)
+#define mixTableauColumns (2*maxChannels + mixRows + 1)
+#define mixEpsilon 1e-6f
+
+static void mixPivot(float (*T)[mixTableauColumns], int rows, int columns, int *basis, int row, int column) {
+  float pivot = T[row][column];
+  for (int j=0; j<=columns; j++) T[row][j] /= pivot;
+  for (int r=0; r<rows; r++) {
+    if ((r == row) || (T[r][column] == 0)) continue;
+    float factor = T[r][column];
+    for (int j=0; j<=columns; j++) T[r][j] -= factor*T[row][j];
+  }
+  basis[row] = column;
 }
 
+// Runs the simplex to the optimum of cost over the columns below allowed.
+static void mixOptimize(float (*T)[mixTableauColumns], int rows, int columns, int *basis, const float *cost, int allowed) {
+  for (int pass=0; pass<1000; pass++) {
+    int entering = -1;
+    for (int j=0; (j<allowed) && (entering < 0); j++) {
+      float reduced = cost[j];
+      for (int r=0; r<rows; r++) reduced -= cost[basis[r]]*T[r][j];
+      if (reduced > mixEpsilon) entering = j;
+    }
+    if (entering < 0) return;
+    int leaving = -1;
+    float best = 0;
+    for (int r=0; r<rows; r++) {
+      if (T[r][entering] <= mixEpsilon) continue;
+      float ratio = T[r][columns]/T[r][entering];
+      if ((leaving < 0) || (ratio < best - mixEpsilon) || ((ratio < best + mixEpsilon) && (basis[r] < basis[leaving]))) {
+        leaving = r;
+        best = ratio;
+      }
+    }
+    if (leaving < 0) return;
+    mixPivot(T, rows, columns, basis, leaving, entering);
+  }
+}
+
+static boolean solveMix(int n, int m, const float (*A)[maxChannels], const float *rhs, const float *objective, float *x) {
+  float T[mixTableauRows][mixTableauColumns];
+  int basis[mixTableauRows];
+  int rows = m + n, columns = 2*n + m;
+  for (int r=0; r<rows; r++) {
+    for (int j=0; j<=columns; j++) T[r][j] = 0;
+  }
+  for (int r=0; r<m; r++) {
+    float sign = rhs[r] < 0 ? -1 : 1;
+    for (int j=0; j<n; j++) T[r][j] = sign*A[r][j];
+    T[r][2*n + r] = 1;
+    T[r][columns] = sign*rhs[r];
+    basis[r] = 2*n + r;
+  }
+  for (int i=0; i<n; i++) {
+    T[m + i][i] = 1;
+    T[m + i][n + i] = 1;
+    T[m + i][columns] = 1;
+    basis[m + i] = n + i;
+  }
+  
+  float cost[mixTableauColumns];
+  for (int j=0; j<columns; j++) cost[j] = j >= 2*n ? -1 : 0;
+  mixOptimize(T, rows, columns, basis, cost, columns);
+  float artificial = 0;
+  for (int r=0; r<rows; r++) {
+    if (basis[r] >= 2*n) artificial += T[r][columns];
+  }
+  if (artificial > 1e-5f) return false;
+  // Drive out artificials left in the basis at zero where a row allows.
+  for (int r=0; r<rows; r++) {
+    if (basis[r] < 2*n) continue;
+    for (int j=0; j<2*n; j++) {
+      if (fabsf(T[r][j]) > mixEpsilon) {
+        mixPivot(T, rows, columns, basis, r, j);
+        break;
+      }
+    }
+  }
+  
+  for (int j=0; j<columns; j++) cost[j] = j < n ? objective[j] : 0;
+  mixOptimize(T, rows, columns, basis, cost, 2*n);
+  for (int i=0; i<n; i++) x[i] = 0;
+  for (int r=0; r<rows; r++) {
+    if (basis[r] < n) x[basis[r]] = T[r][columns]>0?(T[r][columns]<1?T[r][columns]:1):0;
+  }
+  return true;
+}
 
+// Solves the mix at each hue and saturation of the table. The target is
+// the chromaticity MixPair makes, the white point moved towards the two
+// LED mix at the hue by the saturation.
+void Colorspace::buildMix(void) {
+  int channels = getChannels();
+  int LEDs = _count;
+  _mixhues.clear();
+  for (int step=0; step<mixHues; step++) {
+    _mixcells[step] = _mixhues.size();
+    float hue = (float)step*360/mixHues;
+    float next = (float)(step + 1)*360/mixHues;
+    _mixhues.push_back(hue);
+    for (int i=0; i<LEDs; i++) {
+      if ((_angle[i] > hue) && (_angle[i] < next)) _mixhues.push_back(_angle[i]);
+    }
+  }
+  _mixhues.push_back(360);
+  int rows = _mixhues.size();
+  _mix.resize(rows*(mixSaturations + 1)*channels);
+  _mixinverse.resize(rows*(mixSaturations + 1));
+  _mixedges.resize(2*rows);
+  
+  float A[mixRows][maxChannels], rhs[mixRows], objective[maxChannels], x[maxChannels];
+  for (int row=0; row<rows-1; row++) {
+    int LED1, LED2;
+    float weight1, weight2;
+    hueWeights(_mixhues[row], LED1, LED2, weight1, weight2);
+    float uEdge = weight1*_LEDs[LED1].getU() + weight2*_LEDs[LED2].getU();
+    float vEdge = weight1*_LEDs[LED1].getV() + weight2*_LEDs[LED2].getV();
+    _mixedges[2*row] = uEdge - _white.getU();
+    _mixedges[2*row + 1] = vEdge - _white.getV();
+    for (int saturation=0; saturation<=mixSaturations; saturation++) {
+      float S = (float)saturation/mixSaturations;
+      float u = _white.getU() + S*(uEdge - _white.getU());
+      float v = _white.getV() + S*(vEdge - _white.getV());
+      for (int i=0; i<channels; i++) {
+        const CIELED &LED = i < LEDs ? _LEDs[i] : _white;
+        A[0][i] = LED.getU() - u;
+        A[1][i] = LED.getV() - v;
+        A[2][i] = 1;
+        objective[i] = _mixmode == MixFlux ? 1 : -LED.getPower();
+      }
+      rhs[0] = rhs[1] = 0;
+      rhs[2] = 1;
+      // The pair's own mix, as bright as it goes for MixFlux, is the
+      // fallback at the edge of the gamut, where rounding can leave the
+      // solver with no mix or a worse one.
+      float pair[maxChannels];
+      for (int i=0; i<channels; i++) pair[i] = 0;
+      pair[LED1] = S*weight1;
+      pair[LED2] = S*weight2;
+      pair[LEDs] = 1 - S;
+      if (_mixmode == MixFlux) {
+        float peak = fmaxf(fmaxf(pair[LED1], pair[LED2]), pair[LEDs]);
+        for (int i=0; i<channels; i++) pair[i] /= peak;
+      }
+      float solved = 0, fallback = 0;
+      boolean ok = solveMix(channels, _mixmode == MixFlux ? 2 : 3, A, rhs, objective, x);
+      for (int i=0; i<channels; i++) {
+        solved += objective[i]*x[i];
+        fallback += objective[i]*pair[i];
+      }
+      if (!ok || (solved < fallback)) {
+        for (int i=0; i<channels; i++) x[i] = pair[i];
+      }
+      int entry = row*(mixSaturations + 1) + saturation;
+      float light = 0;
+      for (int i=0; i<channels; i++) {
+        _mix[entry*channels + i] = x[i]*0xFFFF + 0.5f;
+        light += _mix[entry*channels + i]*(1.0f/0xFFFF);
+      }
+      _mixinverse[entry] = 1/light;
+    }
+  }
+  // The last row is the first again, at 360.
+  for (int i=0; i<(mixSaturations + 1)*channels; i++) {
+    _mix[(rows-1)*(mixSaturations + 1)*channels + i] = _mix[i];
+  }
+  for (int i=0; i<=mixSaturations; i++) {
+    _mixinverse[(rows-1)*(mixSaturations + 1) + i] = _mixinverse[i];
+  }
+  _mixedges[2*(rows-1)] = _mixedges[0];
+  _mixedges[2*(rows-1) + 1] = _mixedges[1];
+}
@@ -26,18 +26,39 @@
 #include <Arduino.h>
 #include <vector>
 #include <memory>
+#include <array>
 
+// Most output channels (colored LEDs plus white) a lamp can drive. Sizes
+// the fixed buffers used on the render path so that it never allocates.
+const int maxChannels = 12;
+
+// Pins RGBWLamp remembers the last duty of, which covers every pin on the
+// Teensy 3.1.
+const int lampPins = 34;
+
+// Uncomment to have RGBWLamp::setColor render through the Q16 integer
+// pipeline instead of float. Both are always available by type.
+//#define FIXEDPOINT
+
+// Constant expressions, so that a ColorspaceTable can be built from them
+// by the compiler.
 class CIELED {
   private:
     float _u, _v, _maxvalue;
     int _pin;
+    float _power;
   public:
-    CIELED(float u, float v, float maxvalue, int pin);
-    CIELED(void);
-    float getU(void);
-    float getV(void);
-    float getMax(void);
-    int getPin(void);
+    // Power is what the LED draws for a unit of light, relative to the
+    // others, and only matters to MixEfficient.
+    constexpr CIELED(float u, float v, float maxvalue, int pin, float power = 1) :
+      _u(u), _v(v), _maxvalue(maxvalue), _pin(pin), _power(power) {}
+    constexpr CIELED(void) :
+      _u(0), _v(0), _maxvalue(0), _pin(0), _power(1) {}
+    constexpr float getU(void) const {return _u;};
+    constexpr float getV(void) const {return _v;};
+    constexpr float getMax(void) const {return _maxvalue;};
+    constexpr int getPin(void) const {return _pin;};
+    constexpr float getPower(void) const {return _power;};
 };
 
 class HSIColor {
@@ -54,43 +75,219 @@ class HSIColor {
     float getSaturation(void);
     float getIntensity(void);
     void getHSI(float *HSI);
+    // Exact comparison, for telling whether a frame has changed.
+    boolean operator==(const HSIColor &color) const;
+    boolean operator!=(const HSIColor &color) const;
+};
+
+// HSIColor in fixed point for the integer render path. Hue is a fraction
+// of a full turn (0x10000 is 360 degrees), and saturation and intensity
+// are Q16 (0x10000 is 1).
+class HSIColorQ16 {
+  private:
+    uint16_t _hue;
+    uint32_t _saturation, _intensity;
+  public:
+    HSIColorQ16(uint16_t hue, uint32_t saturation, uint32_t intensity);
+    HSIColorQ16(HSIColor &color);
+    HSIColorQ16(void);
+    void setHSI(uint16_t hue, uint32_t saturation, uint32_t intensity);
+    uint16_t getHue(void) {return _hue;};
+    uint32_t getSaturation(void) {return _saturation;};
+    uint32_t getIntensity(void) {return _intensity;};
+};
+
+// One entry of the hue lookup table built by Colorspace::finalize().
+struct HueSegment {
+  unsigned char LED1, LED2;
+  float weight1, weight2;
 };
 
+// The same entry with Q16 weights, for the integer path.
+struct HueSegmentQ16 {
+  unsigned char LED1, LED2;
+  uint32_t weight1, weight2;
+};
+
+// How Colorspace::Hue2LEDs() mixes a color. MixPair lights the two LEDs
+// either side of the hue, plus white for the unsaturated part. MixFlux
+// spreads the color over every LED for the most light that makes its
+// chromaticity with no channel past full, so intensity 1 is as bright as
+// the lamp can make it. MixEfficient makes the same light as MixPair for
+// the least power, going by each LED's getPower().
+enum MixMode {MixPair = 0, MixFlux = 1, MixEfficient = 2};
+
+// The mixing table's steps around the hue circle and from white out to
+// full saturation.
+const int mixHues = 72;
+const int mixSaturations = 8;
+
+// A colorspace worked out by the compiler, in ColorspaceTable.h.
+template <int colors, int resolution> class ColorspaceTable;
+
 class Colorspace {
   private:
-    std::vector<CIELED> _LEDs;
+    // The LEDs in order of angle, with their angles, the slopes of the
+    // gamut edges and the hue tables. These point into the vectors below,
+    // or into a ColorspaceTable in flash when the colorspace is fixed.
+    const CIELED *_LEDs;
+    const float *_angle, *_slope;
+    const HueSegment *_table;
+    const HueSegmentQ16 *_tableQ16;
+    const uint32_t *_angleQ16;
+    int _count;
+    boolean _fixed;
+    std::vector<CIELED> _ownLEDs;
+    std::vector<float> _ownangle, _ownslope;
+    std::vector<HueSegment> _owntable;
+    std::vector<HueSegmentQ16> _owntableQ16;
+    std::vector<uint32_t> _ownangleQ16;
     CIELED _white;
-    std::vector<float> _slope;
-    std::vector<float> _angle;
+    float _tablescale;
+    int _resolution;
+    boolean _interpolate;
+    MixMode _mixmode;
+    // Levels for each channel at each hue and saturation of the mixing
+    // table, as fractions of 0xFFFF, saturations running fastest, and one
+    // over the light each mix makes. The hues are the mixHues steps with
+    // the LED angles added, and _mixcells holds the first row of each step.
+    // _mixedges holds u' v' from white to the gamut edge at each row's hue.
+    std::vector<uint16_t> _mix;
+    std::vector<float> _mixinverse;
+    std::vector<float> _mixhues;
+    std::vector<float> _mixedges;
+    std::array<uint8_t, mixHues> _mixcells;
+    void hueWeights(float H, int &LED1, int &LED2, float &weight1, float &weight2);
+    void buildMix(void);
+    void point(void);
+    void own(void);
   public:
     Colorspace(CIELED &white);
     Colorspace(void);
+    // Points at the table rather than copying it, so the table must
+    // outlive the colorspace, as a static one does. Adding an LED or
+    // finalizing at another resolution copies it into RAM first.
+    template <int colors, int resolution> Colorspace(const ColorspaceTable<colors, resolution> &table);
+    Colorspace(const Colorspace &colorspace);
+    Colorspace &operator=(const Colorspace &colorspace);
     void addLED(CIELED &LED);
+    void finalize(int resolution, boolean interpolate = true);
+    // Mixing other than MixPair is solved for a table of hues and
+    // saturations when the colorspace is finalized, and again as LEDs are
+    // added, so that converting a color is still a lookup.
+    void setMix(MixMode mode);
+    MixMode getMix(void);
     float getAngle(int LEDnum);
     float getSlope(int LEDnum);
     std::vector<float> Hue2LEDs(HSIColor &HSI);
+    int Hue2LEDs(HSIColor &HSI, float *LEDOutputs, int channels);
+    template <size_t N> int Hue2LEDs(HSIColor &HSI, std::array<float, N> &LEDOutputs) {
+      return Hue2LEDs(HSI, LEDOutputs.data(), N);
+    }
+    int Hue2LEDs(HSIColorQ16 &HSI, uint32_t *LEDOutputs, int channels);
+    // Converts count colors at once, given as separate hue, saturation and
+    // intensity arrays, into count rows of channels outputs each.
+    int Hue2LEDs(const float *hue, const float *saturation, const float *intensity, int count, float *LEDOutputs, int channels);
+    template <size_t N> int Hue2LEDs(HSIColorQ16 &HSI, std::array<uint32_t, N> &LEDOutputs) {
+      return Hue2LEDs(HSI, LEDOutputs.data(), N);
+    }
+    int getChannels(void);
     std::vector<int> getPins(void);
     std::vector<float> getMaxValues(void);
 };
 
-class HSIFader {
+// One frame of an effect: a color for the lamp's colorspace, or levels
+// for a list of pins, as the random fader drives its LEDs directly.
+struct LampFrame {
+  boolean direct;
+  HSIColor color;
+  int channels;
+  std::array<float, maxChannels> levels;
+  std::array<int, maxChannels> pins;
+  LampFrame(void);
+  boolean operator==(const LampFrame &frame) const;
+};
+
+// Microseconds since power up in 64 bits, which every effect times itself
+// by so that none of them sees micros() wrap every 71 minutes. Each read
+// extends the count from micros(), so it must be read at least once a
+// wrap; RenderScheduler reads it every frame. Like the effects, read it
+// from the render interrupt or with interrupts off.
+class LampClock {
+  private:
+    static uint64_t _micros;
+  public:
+    static uint64_t now(void);
+};
+
+// What every effect does: fills in the frame for now. The caller owns the
+// frame and reuses it, so rendering does not allocate.
+class Effect {
+  public:
+    virtual ~Effect(void) {}
+    virtual void render(LampFrame &frame) = 0;
+};
+
+// The effects a lamp can run, by number, and the one running. Adding an
+// effect here is all it takes for the render loop to drive it.
+const int maxEffects = 8;
+const int noEffect = -1;
+
+class EffectRegistry {
+  private:
+    std::array<Effect *, maxEffects> _effects;
+    int _count;
+    volatile int _active;
+    LampFrame _frame, _drawn;
+    volatile boolean _redraw;
+  public:
+    EffectRegistry(void);
+    // Returns the new effect's number, or noEffect if there is no room.
+    int add(Effect &effect);
+    // Starts drawing an effect, or stops with noEffect. False if there is
+    // no such effect.
+    boolean select(int number);
+    int getActive(void);
+    int getCount(void);
+    // Renders the active effect into getFrame(). False if nothing is
+    // active or the frame is the same as the last one rendered, unless
+    // redraw() has been called since.
+    boolean render(void);
+    const LampFrame &getFrame(void);
+    void redraw(void);
+};
+
+// A constant color, for plain HSI mode.
+class HSISteady : public Effect {
+  private:
+    HSIColor _color;
+  public:
+    HSISteady(HSIColor color);
+    void setColor(HSIColor color);
+    HSIColor getHSIColor(void);
+    void render(LampFrame &frame);
+};
+
+class HSIFader : public Effect {
   private:
     HSIColor _colors[2];
-    unsigned long _startmicros;
-    unsigned long _delaymicros;
+    uint64_t _startmicros;
+    uint64_t _delaymicros;
     int _direction;
   public:
     HSIFader(HSIColor color1, HSIColor color2, float time, int direction);
     HSIColor getHSIColor();
     void setFader(HSIColor color1, HSIColor color2, float time, int direction);
     boolean isRunning(void);
+    // Holds the second color once the fade is over.
+    void render(LampFrame &frame);
 };
 
-class RandomFader {
+class RandomFader : public Effect {
   private:
     std::vector<CIELED> _LEDs;
     std::vector<CIELED> _effectLEDs;
-    unsigned long _startmicros;
+    uint64_t _startmicros;
     unsigned long _periodmicros;
     unsigned int _LED1, _LED2;
     std::vector<float> _effectprob;
@@ -98,16 +295,20 @@ class RandomFader {
   public:
     RandomFader(float period);
     void startRandom(float period);
+    // Drops every LED, to add a new set before startRandom().
+    void clear(void);
     void addLED(CIELED LED);
     void addEffectLED(CIELED LED, float effectprob);
+    // The colored LEDs, then the effect LEDs, up to maxChannels in all.
+    void render(LampFrame &frame);
     std::vector<float> getLEDs(void);
     std::vector<int> getPins(void);
 };
 
-class HSIStrober {
+class HSIStrober : public Effect {
   private:
     HSIColor _colors[2];
-    unsigned long _startmicros;
+    uint64_t _startmicros;
     unsigned long _periodmicros;
     unsigned long _periodmicrosDB;
   public:
@@ -116,17 +317,45 @@ class HSIStrober {
     void setStrober(HSIColor color1, HSIColor color2, float time);
     void setPeriod(float time);
     void setColor(int num, HSIColor color);
+    void render(LampFrame &frame);
 };
 
-class HSICycler {
+class HSICycler : public Effect {
   private:
     HSIColor _color;
-    unsigned long _lastmicros;
-    float _huestep;
+    uint64_t _startmicros;
+    unsigned long _periodmicros;
+    float _starthue, _huestep;
   public:
     HSICycler(HSIColor color, float time, int dir);
     HSIColor getHSIColor();
     void setCycler(HSIColor color, float time, int dir);
+    void render(LampFrame &frame);
+};
+
+// How an OutputTransfer maps a channel's level to PWM. Linear is the
+// lamp's own map. The gamma and CIE L* curves take the level as perceived
+// brightness, so that fades look even down to the dimmest levels; colors
+// mix in linear light, so they suit a lamp dimmed as a whole.
+enum TransferCurve {TransferLinear = 0, TransferGamma = 1, TransferLstar = 2};
+
+// Points in an OutputTransfer table, which is interpolated between them.
+const int transferPoints = 512;
+
+// Most frames RGBWLamp dithers a level's fraction of a code over, as a
+// power of two.
+const int maxDitherBits = 8;
+
+// A channel's level to PWM duty, from a table of duties in 1/256ths of a
+// code, so that the dither has something below the LSB to work with.
+class OutputTransfer {
+  private:
+    std::array<uint32_t, transferPoints + 1> _table;
+  public:
+    OutputTransfer(TransferCurve curve = TransferLinear, float gamma = 2.2);
+    void setCurve(TransferCurve curve, float gamma = 2.2);
+    // Duty for a level from 0 to 1, in 1/256ths of a code.
+    uint32_t getDuty(float level) const;
 };
 
 class RGBWLamp {
@@ -134,12 +363,120 @@ class RGBWLamp {
     int _resolution;
     std::vector<int> _pins;
     std::vector<float> _maxvalues;
+    std::vector<uint32_t> _maxvaluesQ16;
     std::shared_ptr<Colorspace> _colorspace;
+    std::array<float, maxChannels> _LEDOutputs;
+    std::array<uint32_t, maxChannels> _LEDOutputsQ16;
     float _PWMfrequency;
+    // Last duty written to each pin, or -1 if it is not known.
+    std::array<int32_t, lampPins> _duties;
+    unsigned long _issued, _skipped;
+    // Each pin's transfer, and the code and fraction of a code it is being
+    // dithered between, by pin as for the duties.
+    std::array<const OutputTransfer *, lampPins> _transfers;
+    std::array<uint16_t, lampPins> _codes;
+    std::array<uint8_t, lampPins> _fractions;
+    std::array<uint16_t, lampPins> _residues;
+    int _ditherBits;
+    // The power model, by pin: each sink's current at full duty, its LED's
+    // forward voltage, what the sink dissipates at full duty from the
+    // supply, and what it is dissipating now.
+    float _supply;
+    std::array<float, lampPins> _amps;
+    std::array<float, lampPins> _forwardvolts;
+    std::array<float, lampPins> _fullwatts;
+    std::array<float, lampPins> _watts;
+    float _budget, _channelbudget, _powerscale;
+    boolean _modelled;
+    void writeDuty(int pin, int duty);
+    void writeLevel(int pin, float level);
+    uint32_t levelDuty(int pin, float level);
+    void writeFineDuty(int pin, uint32_t duty);
+    void limitDuties(uint32_t *duties, const int *pins, int channels);
+    void updatePower(void);
+    int ditherStep(int pin);
   public:
     RGBWLamp(int resolution, float PWMfrequency);
     void addColorspace(std::shared_ptr<Colorspace> colorspace);
     void setColor(HSIColor &color);
+    void setColor(HSIColorQ16 &color);
     void setLEDs(std::vector<float> &LEDs, std::vector<int> &pins);
+    void setLEDs(const float *LEDs, const int *pins, int channels);
+    void setLEDs(const uint32_t *LEDs, const int *pins, int channels);
+    void setLevels(const float *levels, int channels);
+    void setFrame(const LampFrame &frame);
+    // The levels setColor() would write for a color, one per channel in the
+    // order of getPin(), without writing them. Returns the channel count.
+    int getLevels(HSIColor &color, float *levels);
+    int getChannels(void);
+    int getPin(int channel);
     void begin(void);
+    
+    // A pin is only written when its duty changes. These count the writes
+    // made and left out. Call invalidate() after driving a lamp pin some
+    // other way, such as with digitalWrite(), so the next frame rewrites it.
+    unsigned long getWritesIssued(void);
+    unsigned long getWritesSkipped(void);
+    void invalidate(void);
+    
+    // Sends a channel's levels, or every channel's, through a transfer,
+    // which the lamp keeps a pointer to. 0 goes back to the linear map.
+    void setTransfer(int channel, const OutputTransfer *transfer);
+    void setTransfer(const OutputTransfer *transfer);
+    // Spreads each level's fraction of a code over 2^bits frames, for bits
+    // more resolution on average. 0, the default, truncates to a code.
+    void setDither(int bits);
+    int getDither(void);
+    // Steps the dither on pins left between two codes. Call it on every
+    // frame that draws nothing new, as the render timer does.
+    void dither(void);
+    
+    // The power model. Each sink drops the supply less its LED's forward
+    // voltage at its current, for as much of the time as its duty, and that
+    // is what heats the board. With a supply set, every frame is estimated,
+    // and with a budget set, a frame over it has all its duties scaled down
+    // alike, which keeps its chromaticity. A budget of 0 is no limit.
+    void setSupply(float volts);
+    void setDrive(int channel, float amps, float forwardVolts);
+    void setDrive(float amps, float forwardVolts);
+    // For pins driven outside the colorspace, such as RandomFader's effect
+    // LEDs.
+    void setPinDrive(int pin, float amps, float forwardVolts);
+    void setPowerBudget(float watts, float channelWatts = 0);
+    // Watts dissipated in the sinks at the duties last written, across the
+    // lamp or for one channel, and the scale the last frame was given.
+    float getPower(void);
+    float getPower(int channel);
+    float getPowerScale(void);
+};
+
+// How a DMX fixture lays out its channels from its start address.
+//   DMXHSI8:   hue, saturation, intensity, one channel each.
+//   DMXHSI16:  the same as coarse and fine channel pairs.
+//   DMXDirect: one level per colorspace LED, white last.
+enum DMXPersonality {DMXHSI8 = 0, DMXHSI16 = 1, DMXDirect = 2};
+
+// Drives a lamp from the channels of received DMX frames.
+class DMXFixture {
+  private:
+    RGBWLamp &_lamp;
+    int _address;
+    DMXPersonality _personality;
+    std::array<uint8_t, maxChannels> _slots;
+    std::array<float, maxChannels> _levels;
+  public:
+    DMXFixture(RGBWLamp &lamp, int address, DMXPersonality personality);
+    boolean setFixture(int address, DMXPersonality personality);
+    int getAddress(void);
+    int getFootprint(void);
+    // Applies one frame, given the slots from the start address on.
+    void apply(const uint8_t *slots);
+    // Or straight from a receiver with getDimmer(), such as DmxReceiver.
+    template <class Receiver> void apply(Receiver &dmx) {
+      int footprint = getFootprint();
+      for (int i=0; i<footprint; i++) {
+        _slots[i] = dmx.getDimmer(_address + i);
+      }
+      apply(_slots.data());
+    }
 };
@@ -0,0 +1,525 @@
+//*********************************************************
+//
+// TeensyLED Controller Library
+// Copyright Brian Neltner 2015
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or 
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "LampProtocol.h"
+#include <string.h>
+
+// Payload length of each opcode, or -1 if there is no such opcode.
+static int payloadLength(uint8_t opcode) {
+  switch (opcode) {
+    case LampHSI: return 6;
+    case LampStrobe: return 16;
+    case LampFade: return 17;
+    case LampCycle: return 5;
+    case LampRandom: return 0;
+    case LampEffect: return 1;
+    case LampDMX: return 3;
+    case LampRate: return 2;
+    case LampStats: return 0;
+    case LampShow: return 0;
+    case LampLayer: return 4;
+    case LampMaster: return 2;
+    case LampCueClear: return 1;
+    case LampCue: return 16;
+    case LampCueSave: return 0;
+    case LampCuePlay: return 0;
+    case LampCalClear: return 0;
+    case LampCalLED: return 12;
+    case LampCalApply: return 0;
+    case LampCalSave: return 0;
+    case LampAck: return 2;
+    case LampStatsReport: return 24;
+    default: return -1;
+  }
+}
+
+static uint16_t get16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put16(uint8_t *p, uint16_t value) {
+  p[0] = value;
+  p[1] = value >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t value) {
+  put16(p, value);
+  put16(p + 2, value >> 16);
+}
+
+static uint16_t toLevel(float level) {
+  return level>0?(level<1?level*65535 + 0.5f:65535):0;
+}
+
+static uint32_t toTime(float value) {
+  return (value > 0) ? (uint32_t)value : 0;
+}
+
+static HSIColor getColor(const uint8_t *p) {
+  return HSIColor(get16(p)*(360.0f/65536), get16(p + 2)*(1.0f/65535), get16(p + 4)*(1.0f/65535));
+}
+
+static void putColor(uint8_t *p, HSIColor color) {
+  float hue = fmod(color.getHue(), 360);
+  if (hue < 0) hue += 360;
+  put16(p, (uint32_t)(hue*(65536/360.0f) + 0.5f) & 0xFFFF);
+  put16(p + 2, color.getSaturation()*65535 + 0.5f);
+  put16(p + 4, color.getIntensity()*65535 + 0.5f);
+}
+
+LampProtocol::LampProtocol(void) {
+  reset();
+}
+
+void LampProtocol::reset(void) {
+  _state = WaitSync;
+  _lineLength = 0;
+  _lineOverflow = false;
+  _line[0] = 0;
+  _frames = 0;
+  _errors = 0;
+  _command.opcode = 0;
+}
+
+LampStatus LampProtocol::feed(uint8_t c) {
+  switch (_state) {
+    case WaitSync:
+      if (c == lampSync) {
+        _state = ReadLength;
+        return LampNone;
+      }
+      // Anything else is text. The line ends at a carriage return, as
+      // readStringUntil(0x0D) used to have it, and a line feed after it
+      // is dropped rather than starting the next line.
+      if (c == 0x0D) {
+        LampStatus status = _lineOverflow ? LampLineError : LampLineReady;
+        _line[_lineLength] = 0;
+        _lineLength = 0;
+        _lineOverflow = false;
+        if (status == LampLineError) _errors++;
+        return status;
+      }
+      if ((c == 0x0A) && (_lineLength == 0)) return LampNone;
+      if (_lineLength < lampMaxLine) _line[_lineLength++] = c;
+      else _lineOverflow = true;
+      return LampNone;
+    case ReadLength:
+      if (c > lampMaxPayload) {
+        // Not a frame after all, so look for the next one.
+        _state = WaitSync;
+        _errors++;
+        _command.opcode = 0;
+        return LampFrameError;
+      }
+      _length = c;
+      _crc = crc16(&c, 1);
+      _state = ReadOpcode;
+      return LampNone;
+    case ReadOpcode:
+      _opcode = c;
+      _crc = crc16(&c, 1, _crc);
+      _position = 0;
+      _state = _length ? ReadPayload : ReadCRCLow;
+      return LampNone;
+    case ReadPayload:
+      _payload[_position++] = c;
+      if (_position == _length) {
+        _crc = crc16(_payload, _length, _crc);
+        _state = ReadCRCLow;
+      }
+      return LampNone;
+    case ReadCRCLow:
+      _crcLow = c;
+      _state = ReadCRCHigh;
+      return LampNone;
+    case ReadCRCHigh:
+      _state = WaitSync;
+      _command.opcode = _opcode;
+      if ((_crcLow | (c << 8)) != _crc) {
+        _errors++;
+        return LampFrameError;
+      }
+      if (!decode()) {
+        _errors++;
+        return LampFrameError;
+      }
+      _frames++;
+      return LampCommandReady;
+  }
+  return LampNone;
+}
+
+// Fills in _command from a frame that passed its CRC. False if the
+// opcode is unknown or the payload is the wrong length for it.
+boolean LampProtocol::decode(void) {
+  if (payloadLength(_opcode) != _length) return false;
+  const uint8_t *p = _payload;
+  switch (_opcode) {
+    case LampHSI:
+      _command.color1 = getColor(p);
+      break;
+    case LampStrobe:
+      _command.color1 = getColor(p);
+      _command.color2 = getColor(p + 6);
+      _command.time = get32(p + 12);
+      break;
+    case LampFade:
+      _command.color1 = getColor(p);
+      _command.color2 = getColor(p + 6);
+      _command.time = get32(p + 12);
+      _command.direction = (int8_t)p[16];
+      break;
+    case LampCycle:
+      _command.period = get32(p);
+      _command.direction = (int8_t)p[4];
+      break;
+    case LampEffect:
+      _command.effect = p[0];
+      break;
+    case LampDMX:
+      _command.address = get16(p);
+      _command.personality = p[2];
+      break;
+    case LampRate:
+      _command.rate = get16(p);
+      break;
+    case LampLayer:
+      _command.layer = p[0];
+      _command.blend = p[1];
+      _command.level = get16(p + 2)*(1.0f/65535);
+      break;
+    case LampMaster:
+      _command.level = get16(p)*(1.0f/65535);
+      break;
+    case LampCueClear:
+      _command.loop = p[0];
+      break;
+    case LampCue:
+      _command.color1 = getColor(p);
+      _command.time = get32(p + 6);
+      _command.hold = get32(p + 10);
+      _command.easing = p[14];
+      _command.direction = p[15];
+      break;
+    case LampCalLED:
+      _command.role = p[0];
+      _command.pin = p[1];
+      _command.u = get16(p + 2)*(1.0f/65535);
+      _command.v = get16(p + 4)*(1.0f/65535);
+      _command.maxvalue = get16(p + 6)*(1.0f/65535);
+      _command.power = get16(p + 8)*(1.0f/4096);
+      _command.chance = get16(p + 10)*(1.0f/65535);
+      break;
+    case LampAck:
+      _command.acked = p[0];
+      _command.status = p[1];
+      break;
+    case LampStatsReport:
+      _command.frames = get32(p);
+      _command.rendered = get32(p + 4);
+      _command.overruns = get32(p + 8);
+      _command.minMicros = get32(p + 12);
+      _command.avgMicros = get32(p + 16);
+      _command.maxMicros = get32(p + 20);
+      break;
+  }
+  return true;
+}
+
+const LampCommand &LampProtocol::getCommand(void) {
+  return _command;
+}
+
+const char *LampProtocol::getLine(void) {
+  return _line;
+}
+
+unsigned long LampProtocol::getFrameCount(void) {
+  return _frames;
+}
+
+unsigned long LampProtocol::getErrorCount(void) {
+  return _errors;
+}
+
+int LampProtocol::encode(const LampCommand &command, uint8_t *frame) {
+  int length = payloadLength(command.opcode);
+  if (length < 0) return 0;
+  uint8_t *p = frame + 3;
+  switch (command.opcode) {
+    case LampHSI:
+      putColor(p, command.color1);
+      break;
+    case LampStrobe:
+      putColor(p, command.color1);
+      putColor(p + 6, command.color2);
+      put32(p + 12, command.time);
+      break;
+    case LampFade:
+      putColor(p, command.color1);
+      putColor(p + 6, command.color2);
+      put32(p + 12, command.time);
+      p[16] = command.direction;
+      break;
+    case LampCycle:
+      put32(p, toTime(command.period + 0.5f));
+      p[4] = command.direction;
+      break;
+    case LampEffect:
+      p[0] = command.effect;
+      break;
+    case LampDMX:
+      put16(p, command.address);
+      p[2] = command.personality;
+      break;
+    case LampRate:
+      put16(p, command.rate);
+      break;
+    case LampLayer:
+      p[0] = command.layer;
+      p[1] = command.blend;
+      put16(p + 2, toLevel(command.level));
+      break;
+    case LampMaster:
+      put16(p, toLevel(command.level));
+      break;
+    case LampCueClear:
+      p[0] = command.loop;
+      break;
+    case LampCue:
+      putColor(p, command.color1);
+      put32(p + 6, command.time);
+      put32(p + 10, command.hold);
+      p[14] = command.easing;
+      p[15] = command.direction;
+      break;
+    case LampCalLED:
+      p[0] = command.role;
+      p[1] = command.pin;
+      put16(p + 2, toLevel(command.u));
+      put16(p + 4, toLevel(command.v));
+      put16(p + 6, toLevel(command.maxvalue));
+      put16(p + 8, command.power>0?(command.power<16?command.power*4096 + 0.5f:65535):0);
+      put16(p + 10, toLevel(command.chance));
+      break;
+    case LampAck:
+      p[0] = command.acked;
+      p[1] = command.status;
+      break;
+    case LampStatsReport:
+      put32(p, command.frames);
+      put32(p + 4, command.rendered);
+      put32(p + 8, command.overruns);
+      put32(p + 12, command.minMicros);
+      put32(p + 16, command.avgMicros);
+      put32(p + 20, command.maxMicros);
+      break;
+  }
+  frame[0] = lampSync;
+  frame[1] = length;
+  frame[2] = command.opcode;
+  put16(frame + 3 + length, crc16(frame + 1, length + 2));
+  return length + 5;
+}
+
+int LampProtocol::encodeAck(uint8_t opcode, boolean ok, uint8_t *frame) {
+  LampCommand ack;
+  ack.opcode = LampAck;
+  ack.acked = opcode;
+  ack.status = ok ? 0 : 1;
+  return encode(ack, frame);
+}
+
+// The text commands, and the numbers each takes: f for a decimal number,
+// i for a whole one.
+struct TextCommand {
+  const char *name;
+  uint8_t opcode;
+  const char *arguments;
+};
+
+static const TextCommand textCommands[] = {
+  {"HSI", LampHSI, "fff"},
+  {"Strobe", LampStrobe, "fffffff"},
+  {"Fade", LampFade, "fffffffi"},
+  {"Cycler", LampCycle, "fi"},
+  {"Random", LampRandom, ""},
+  {"Effect", LampEffect, "i"},
+  {"DMX", LampDMX, "ii"},
+  {"Rate", LampRate, "i"},
+  {"Stats", LampStats, ""},
+  {"Show", LampShow, ""},
+  {"Layer", LampLayer, "iif"},
+  {"Master", LampMaster, "f"},
+  {"CueClear", LampCueClear, "i"},
+  {"Cue", LampCue, "fffiiii"},
+  {"CueSave", LampCueSave, ""},
+  {"CuePlay", LampCuePlay, ""},
+  {"CalClear", LampCalClear, ""},
+  {"CalLED", LampCalLED, "iifffff"},
+  {"CalApply", LampCalApply, ""},
+  {"CalSave", LampCalSave, ""},
+};
+
+static const int numTextCommands = sizeof(textCommands)/sizeof(textCommands[0]);
+
+// Reads a number of digits, an optional sign and, for f, an optional
+// fraction, and moves text past it. False if there is no such number.
+static boolean scanNumber(const char *&text, char type, float &value) {
+  const char *p = text;
+  boolean negative = (*p == '-');
+  if (negative) p++;
+  uint32_t whole = 0, fraction = 0;
+  float scale = 1;
+  int digits = 0;
+  while ((*p >= '0') && (*p <= '9')) {
+    if (whole < 100000000) whole = whole*10 + (*p - '0');
+    p++;
+    digits++;
+  }
+  if ((type == 'f') && (*p == '.')) {
+    p++;
+    while ((*p >= '0') && (*p <= '9')) {
+      if (scale < 1e8f) {
+        fraction = fraction*10 + (*p - '0');
+        scale *= 10;
+      }
+      p++;
+      digits++;
+    }
+  }
+  if (digits == 0) return false;
+  value = whole + fraction/scale;
+  if (negative) value = -value;
+  text = p;
+  return true;
+}
+
+boolean LampProtocol::parseLine(const char *line, LampCommand &command) {
+  command.opcode = 0;
+  while (*line == ' ') line++;
+  
+  // Match the command name, which runs to the first space.
+  const char *end = line;
+  while (*end && (*end != ' ')) end++;
+  const TextCommand *match = 0;
+  for (int i=0; i<numTextCommands; i++) {
+    const char *name = textCommands[i].name;
+    if ((strlen(name) == (size_t)(end - line)) && !strncmp(name, line, end - line)) match = &textCommands[i];
+  }
+  if (!match) return false;
+  command.opcode = match->opcode;
+  
+  // Then scan its numbers, separated by spaces, with nothing after them
+  // but trailing whitespace.
+  float v[lampMaxArguments];
+  const char *p = end;
+  int count = 0;
+  for (const char *type = match->arguments; *type; type++) {
+    if (*p != ' ') return false;
+    while (*p == ' ') p++;
+    if (!scanNumber(p, *type, v[count++])) return false;
+  }
+  while ((*p == ' ') || (*p == '\t') || (*p == '\n') || (*p == '\r')) p++;
+  if (*p) return false;
+  
+  switch (command.opcode) {
+    case LampHSI:
+      command.color1.setHSI(v[0], v[1], v[2]);
+      break;
+    case LampStrobe:
+    case LampFade:
+      command.color1.setHSI(v[0], v[1], v[2]);
+      command.color2.setHSI(v[3], v[4], v[5]);
+      command.time = toTime(v[6]);
+      if (command.opcode == LampFade) command.direction = v[7];
+      // As the text commands always have, a time under 1ms is an error.
+      if (command.time == 0) return false;
+      break;
+    case LampCycle:
+      if ((v[0] <= 0) || ((v[1] != 0) && (v[1] != 1))) return false;
+      command.period = v[0];
+      command.direction = v[1];
+      break;
+    case LampEffect:
+      if ((v[0] != 0) && (v[0] != 1)) return false;
+      command.effect = v[0];
+      break;
+    case LampDMX:
+      if ((v[0] < 0) || (v[0] > 65535) || (v[1] < 0) || (v[1] > 255)) return false;
+      command.address = v[0];
+      command.personality = v[1];
+      break;
+    case LampRate:
+      if ((v[0] < 1) || (v[0] > 65535)) return false;
+      command.rate = v[0];
+      break;
+    case LampLayer:
+      if ((v[0] < 0) || (v[0] > 255) || (v[1] < 0) || (v[1] > 255) || (v[2] < 0) || (v[2] > 1)) return false;
+      command.layer = v[0];
+      command.blend = v[1];
+      command.level = v[2];
+      break;
+    case LampMaster:
+      if ((v[0] < 0) || (v[0] > 1)) return false;
+      command.level = v[0];
+      break;
+    case LampCueClear:
+      if ((v[0] != 0) && (v[0] != 1)) return false;
+      command.loop = v[0];
+      break;
+    case LampCue:
+      if ((v[3] < 0) || (v[4] < 0) || (v[5] < 0) || (v[5] > 255) || (v[6] < 0) || (v[6] > 255)) return false;
+      command.color1.setHSI(v[0], v[1], v[2]);
+      command.time = v[3];
+      command.hold = v[4];
+      command.easing = v[5];
+      command.direction = v[6];
+      break;
+    case LampCalLED:
+      if ((v[0] < 0) || (v[0] > 255) || (v[1] < 0) || (v[1] > 255)) return false;
+      for (int i=2; i<7; i++) {
+        if ((v[i] < 0) || (v[i] > (i == 5 ? 16 : 1))) return false;
+      }
+      command.role = v[0];
+      command.pin = v[1];
+      command.u = v[2];
+      command.v = v[3];
+      command.maxvalue = v[4];
+      command.power = v[5];
+      command.chance = v[6];
+      break;
+  }
+  return true;
+}
+
+uint16_t LampProtocol::crc16(const uint8_t *data, int length, uint16_t crc) {
+  for (int i=0; i<length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int bit=0; bit<8; bit++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+  }
+  return crc;
+}
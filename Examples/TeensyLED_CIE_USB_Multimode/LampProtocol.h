@@ -0,0 +1,190 @@
+//*********************************************************
+//
+// TeensyLED Controller Library
+// Copyright Brian Neltner 2015
+//
+// A compact binary command format for the lamp, alongside the text
+// commands on the same serial port.
+//
+// A frame is
+//
+//   0xA5, length, opcode, payload (length bytes), CRC16 low, CRC16 high
+//
+// with the CRC16 (CCITT, 0x1021 from 0xFFFF) taken over the length,
+// opcode and payload. Multi-byte values are little endian. Hues are
+// 16-bit fractions of a turn (0x10000 is 360 degrees), saturations and
+// intensities are 0 to 65535 for 0 to 1, and times are in ms.
+//
+//   LampHSI     hue, saturation, intensity                  6 bytes
+//   LampStrobe  color 1, color 2, period (uint32)           16 bytes
+//   LampFade    color 1, color 2, time (uint32), direction  17 bytes
+//   LampCycle   period (uint32), direction (int8)           5 bytes
+//   LampRandom  nothing                                     0 bytes
+//   LampEffect  0 or 1                                      1 byte
+//   LampDMX     address (uint16), personality               3 bytes
+//   LampRate    frames per second (uint16)                  2 bytes
+//   LampStats   nothing                                     0 bytes
+//   LampShow    nothing                                     0 bytes
+//   LampLayer   layer, blend mode, opacity (uint16)         4 bytes
+//   LampMaster  level (uint16)                              2 bytes
+//   LampCueClear  loop (0 or 1)                             1 byte
+//   LampCue     color, fade, hold (uint32), easing, direction  16 bytes
+//   LampCueSave nothing                                     0 bytes
+//   LampCuePlay nothing                                     0 bytes
+//   LampCalClear  nothing                                   0 bytes
+//   LampCalLED  role, pin, u', v', max, power, chance (uint16)  12 bytes
+//   LampCalApply  nothing                                   0 bytes
+//   LampCalSave nothing                                     0 bytes
+//
+// Each frame is answered with a LampAck frame holding the opcode and
+// 0 for OK or 1 for ERROR, except LampStats, which is answered with a
+// LampStatsReport frame of the render scheduler's counters: frames,
+// frames rendered, overruns, and the minimum, average and maximum
+// render time in microseconds, each a uint32.
+//
+// Text commands are plain ASCII, which never contains the 0xA5 sync
+// byte, so LampProtocol can split one byte stream into both: frames
+// come out as decoded LampCommands and everything else as lines ended
+// by a carriage return. It takes one byte at a time and never waits.
+// parseLine() turns a line into the same LampCommand as its frame:
+//
+//   HSI hue saturation intensity
+//   Strobe hue1 saturation1 intensity1 hue2 saturation2 intensity2 period
+//   Fade hue1 saturation1 intensity1 hue2 saturation2 intensity2 time direction
+//   Cycler period direction
+//   Random
+//   Effect 0|1
+//   DMX address personality
+//   Rate framespersecond
+//   Stats
+//   Show
+//   Layer layer blendmode opacity
+//   Master level
+//   CueClear loop
+//   Cue hue saturation intensity fade hold easing direction
+//   CueSave
+//   CuePlay
+//   CalClear
+//   CalLED role pin u v max power chance
+//   CalApply
+//   CalSave
+//
+// where blendmode is a BlendMode from Compositor.h, and opacity and
+// level run from 0 to 1, sent in frames as 0 to 65535. Cues are added
+// to the end of the list, with easing a CueEasing from CueSequencer.h
+// and fade and hold in ms. Cycler takes a period above 0 and a direction
+// of 0 or 1. CalLED adds an LED to a new calibration, with
+// role a CalibrationRole from Calibration.h and its numbers in the form
+// Calibration stores them; CalApply rebuilds the lamp from it.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or 
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include "LEDs.h"
+
+#define lampSync 0xA5
+#define lampMaxPayload 32
+#define lampMaxFrame (lampMaxPayload + 5)
+#define lampMaxLine 96
+#define lampMaxArguments 8
+
+enum LampOpcode {LampHSI = 0x01, LampStrobe = 0x02, LampFade = 0x03, LampCycle = 0x04,
+                 LampRandom = 0x05, LampEffect = 0x06, LampDMX = 0x07, LampRate = 0x08,
+                 LampStats = 0x09, LampShow = 0x0A, LampLayer = 0x0B, LampMaster = 0x0C,
+                 LampCueClear = 0x0D, LampCue = 0x0E, LampCueSave = 0x0F, LampCuePlay = 0x10,
+                 LampCalClear = 0x11, LampCalLED = 0x12, LampCalApply = 0x13, LampCalSave = 0x14,
+                 LampAck = 0x80, LampStatsReport = 0x81};
+
+// What LampProtocol::feed() has found.
+enum LampStatus {LampNone = 0, LampCommandReady = 1, LampLineReady = 2, LampFrameError = 3, LampLineError = 4};
+
+// A decoded command. Only the fields its opcode uses are set.
+struct LampCommand {
+  uint8_t opcode;
+  HSIColor color1, color2;
+  uint32_t time;
+  int8_t direction;
+  // LampCycle, the time of a turn in ms, which text may give in fractions
+  // and frames carry whole.
+  float period;
+  uint8_t effect;
+  uint16_t address;
+  uint8_t personality;
+  uint16_t rate;
+  // LampLayer and LampMaster.
+  uint8_t layer, blend;
+  float level;
+  // LampCueClear and LampCue, with color1, time for the fade and direction.
+  uint8_t loop;
+  uint32_t hold;
+  uint8_t easing;
+  // LampCalLED, in the units Calibration stores.
+  uint8_t role, pin;
+  float u, v, maxvalue, power, chance;
+  // LampAck: the opcode answered, and 0 for OK or 1 for ERROR.
+  uint8_t acked;
+  uint8_t status;
+  // LampStatsReport.
+  uint32_t frames, rendered, overruns;
+  uint32_t minMicros, avgMicros, maxMicros;
+};
+
+class LampProtocol {
+  private:
+    enum {WaitSync, ReadLength, ReadOpcode, ReadPayload, ReadCRCLow, ReadCRCHigh} _state;
+    uint8_t _length;
+    uint8_t _opcode;
+    uint8_t _payload[lampMaxPayload];
+    uint8_t _position;
+    uint16_t _crc;
+    uint8_t _crcLow;
+    char _line[lampMaxLine + 1];
+    uint8_t _lineLength;
+    boolean _lineOverflow;
+    LampCommand _command;
+    unsigned long _frames, _errors;
+    boolean decode(void);
+  public:
+    LampProtocol(void);
+    void reset(void);
+    
+    // Takes the next byte from the port. When this returns LampCommandReady
+    // or LampLineReady, the command or line is there until the next call.
+    // LampFrameError is a frame that failed its CRC or did not decode, with
+    // its opcode in getCommand(), and LampLineError a line too long to hold.
+    LampStatus feed(uint8_t c);
+    const LampCommand &getCommand(void);
+    const char *getLine(void);
+    
+    unsigned long getFrameCount(void);
+    unsigned long getErrorCount(void);
+    
+    // Builds the frame for a command, or the answer to one, into frame,
+    // which must hold lampMaxFrame bytes. Returns its length, or 0 for an
+    // unknown opcode.
+    static int encode(const LampCommand &command, uint8_t *frame);
+    static int encodeAck(uint8_t opcode, boolean ok, uint8_t *frame);
+    
+    // Parses a text command. False if the line is not a valid command, with
+    // the opcode it was meant to be in command.opcode, or 0 if it is not a
+    // command at all. Nothing is allocated.
+    static boolean parseLine(const char *line, LampCommand &command);
+    
+    static uint16_t crc16(const uint8_t *data, int length, uint16_t crc = 0xFFFF);
+};
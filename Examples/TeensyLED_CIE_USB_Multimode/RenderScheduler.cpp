@@ -0,0 +1,115 @@
+//*********************************************************
+//
+// TeensyLED Controller Library
+// Copyright Brian Neltner 2015
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or 
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "RenderScheduler.h"
+#include "LEDs.h"
+
+RenderScheduler *RenderScheduler::_active = 0;
+
+RenderScheduler::RenderScheduler(boolean (*render)(void), float rate) :
+  _running(false),
+  _render(render) {
+  setRate(rate);
+  resetStats();
+}
+
+void RenderScheduler::frameISR(void) {
+  RenderScheduler *scheduler = _active;
+  // Keeps the effects' clock counting through modes that draw no effect.
+  LampClock::now();
+  uint32_t start = ARM_DWT_CYCCNT;
+  boolean rendered = scheduler->_render();
+  uint32_t cycles = ARM_DWT_CYCCNT - start;
+  
+  scheduler->_frames++;
+  if (!rendered) return;
+  scheduler->_rendered++;
+  scheduler->_totalCycles += cycles;
+  if (cycles < scheduler->_minCycles) scheduler->_minCycles = cycles;
+  if (cycles > scheduler->_maxCycles) scheduler->_maxCycles = cycles;
+  if (cycles > scheduler->_periodCycles) scheduler->_overruns++;
+}
+
+void RenderScheduler::begin(void) {
+#if defined(__MK20DX128__) || defined(__MK20DX256__)
+  // The cycle counter is off out of reset.
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+  _active = this;
+  _running = _timer.begin(frameISR, 1e6f/_rate);
+}
+
+void RenderScheduler::end(void) {
+  _timer.end();
+  _running = false;
+}
+
+void RenderScheduler::setRate(float rate) {
+  _rate = rate;
+  _periodCycles = F_CPU/rate;
+  // The timer is only retimed once begin() has started it.
+  if (_running) _timer.update(1e6f/rate);
+}
+
+float RenderScheduler::getRate(void) {
+  return _rate;
+}
+
+uint32_t RenderScheduler::getFrames(void) {
+  return _frames;
+}
+
+uint32_t RenderScheduler::getRendered(void) {
+  return _rendered;
+}
+
+uint32_t RenderScheduler::getOverruns(void) {
+  return _overruns;
+}
+
+float RenderScheduler::getMinMicros(void) {
+  return _rendered ? _minCycles*(1e6f/F_CPU) : 0;
+}
+
+float RenderScheduler::getAvgMicros(void) {
+  noInterrupts();
+  uint64_t total = _totalCycles;
+  uint32_t rendered = _rendered;
+  interrupts();
+  return rendered ? (float)total/rendered*(1e6f/F_CPU) : 0;
+}
+
+float RenderScheduler::getMaxMicros(void) {
+  return _maxCycles*(1e6f/F_CPU);
+}
+
+void RenderScheduler::resetStats(void) {
+  noInterrupts();
+  _frames = 0;
+  _rendered = 0;
+  _overruns = 0;
+  _minCycles = 0xFFFFFFFF;
+  _maxCycles = 0;
+  _totalCycles = 0;
+  interrupts();
+}
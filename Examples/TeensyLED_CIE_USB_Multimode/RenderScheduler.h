@@ -0,0 +1,73 @@
+//*********************************************************
+//
+// TeensyLED Controller Library
+// Copyright Brian Neltner 2015
+//
+// Renders the lamp at a fixed rate from an IntervalTimer rather than
+// as fast as loop() spins, and keeps count of what that costs.
+//
+// The render function is called every frame and returns whether it
+// changed the outputs, so that a steady color costs almost nothing.
+// For the frames that did render, the time taken is measured with the
+// Cortex-M4 cycle counter and kept as a minimum, average and maximum,
+// and any frame longer than the frame period counts as an overrun.
+// At the default 183Hz, the lamp's PWM frequency, a frame has about
+// 5.5ms, or 524,000 cycles at 96MHz.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or 
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include <Arduino.h>
+
+#define renderRateDefault 183.106
+
+class RenderScheduler {
+  private:
+    IntervalTimer _timer;
+    boolean _running;
+    boolean (*_render)(void);
+    float _rate;
+    uint32_t _periodCycles;
+    volatile uint32_t _frames;
+    volatile uint32_t _rendered;
+    volatile uint32_t _overruns;
+    volatile uint32_t _minCycles;
+    volatile uint32_t _maxCycles;
+    volatile uint64_t _totalCycles;
+    static RenderScheduler *_active;
+    static void frameISR(void);
+  public:
+    // The function that draws a frame, and frames per second.
+    RenderScheduler(boolean (*render)(void), float rate = renderRateDefault);
+    void begin(void);
+    void end(void);
+    void setRate(float rate);
+    float getRate(void);
+    
+    // Frames since begin() or resetStats(), those that rendered, and those
+    // that took longer than a frame period.
+    uint32_t getFrames(void);
+    uint32_t getRendered(void);
+    uint32_t getOverruns(void);
+    // Time taken by the frames that rendered, in microseconds.
+    float getMinMicros(void);
+    float getAvgMicros(void);
+    float getMaxMicros(void);
+    void resetStats(void);
+};
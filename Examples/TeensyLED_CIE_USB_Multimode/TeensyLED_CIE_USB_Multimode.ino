@@ -39,10 +39,33 @@
 //***************************************************************************
 
 #include "LEDs.h"
+#include "ColorspaceTable.h"
+#include "LampProtocol.h"
+#include "RenderScheduler.h"
+#include "Compositor.h"
+#include "CueSequencer.h"
+#include "Calibration.h"
 #include <memory>
+#include <DmxReceiver.h>
+#include <EEPROM.h>
 
 #define propgain 0.001
 
+// The lamp dithers fractions of a PWM code over 2^lampDitherBits frames:
+// 16 frames at 183Hz gives 20 bits on average, toggling no slower than
+// 11Hz.
+#define lampDitherBits 4
+
+// The sinks' power model. Each sink pulls 700mA and drops what the supply
+// leaves after its LED string, here 3V, so 2.1W fully on. The board as a
+// whole is good for about 4W, and each BJT for 4.4W, so frames asking for
+// more are dimmed to fit, color unchanged.
+#define lampSupplyVolts 12
+#define lampSinkAmps 0.7
+#define lampForwardVolts 9
+#define lampPowerBudget 4
+#define lampChannelBudget 4.4
+
 // Create the physical abstraction for the LED controller.
 // Resolution, Frequency.
 RGBWLamp lamp(16, 183.106);
@@ -50,6 +73,9 @@ RGBWLamp lamp(16, 183.106);
 // Creates a starting HSI color for carrying HSI mode options.
 HSIColor color(0, 1, 0);
 
+// Holds the color for plain HSI mode.
+HSISteady steady(color);
+
 // Creates a freerunning HSI Fader.
 HSIFader fader(HSIColor(0, 1, 0), HSIColor(120, 1, 0), 1000, 0);
 
@@ -60,6 +86,42 @@ HSICycler cycler(HSIColor(0, 1, 0), 1000, 1);
 
 RandomFader randomfader(1000);
 
+// The cycler with the strober over it, for shows. The strobe layer starts
+// off; "Layer 1 0 1" adds it in full and "Master" dims the lot. Selected
+// with "Show".
+Compositor show(lamp);
+
+// A list of cues sent with "CueClear" and "Cue", kept in EEPROM by
+// "CueSave" and played by "CuePlay" or at power up.
+CueSequencer cues;
+
+// The LEDs as measured: the ones below unless a calibration for this
+// fixture's LEDs was saved to EEPROM. A new one is sent with "CalClear"
+// and "CalLED", put to use by "CalApply" and saved by "CalSave".
+Calibration calibration, newCalibration;
+
+// The effects above by number, and the one being drawn. DMX mode draws
+// none of them.
+EffectRegistry effects;
+int hsiEffect, strobeEffect, fadeEffect, cycleEffect, randomEffect, showEffect, cueEffect;
+
+// DMX receiver, serviced every millisecond, and the fixture personality
+// it drives the lamp through in DMX mode. Set with "DMX address personality"
+// where personality is 0 for 8-bit HSI, 1 for 16-bit HSI, or 2 for direct
+// levels of each LED with white last.
+DmxReceiver dmx;
+IntervalTimer dmxTimer;
+DMXFixture fixture(lamp, 1, DMXHSI8);
+
+// Splits the serial port into text commands and binary command frames,
+// as described in LampProtocol.h.
+LampProtocol protocol;
+
+// Draws a frame at the PWM frequency, or the rate set with "Rate", rather
+// than as fast as loop() can spin, and only when it has changed. "Stats"
+// reports how many frames were drawn and how long they took.
+RenderScheduler scheduler(render);
+
 void setup() {
   Serial.begin(115200);
   
@@ -68,374 +130,327 @@ void setup() {
   
   // Define the physical LEDs and their CIE LUV color locations.
   // u', v', maxvalue, physical pin
-  CIELED white(0.202531646, 0.469936709, (float)180/180, 9);
-  CIELED red(0.5137017676, 0.5229440531, (float)78/78, 6);
-  CIELED amber(0.3135687079, 0.5529418124, (float)60/60, 5);
-  CIELED green(0.0595846867, 0.574988823, (float)125/125, 22);
-  CIELED cyan(0.0306675939, 0.5170937486, (float)95/95, 3);
-  CIELED blue(0.1747943747, 0.1117834986, (float)30/30, 23);
-  CIELED violet(0.35, 0.15, (float)30/30, 4);
+  static constexpr CIELED white(0.202531646, 0.469936709, (float)180/180, 9);
+  static constexpr CIELED red(0.5137017676, 0.5229440531, (float)78/78, 6);
+  static constexpr CIELED amber(0.3135687079, 0.5529418124, (float)60/60, 5);
+  static constexpr CIELED green(0.0595846867, 0.574988823, (float)125/125, 22);
+  static constexpr CIELED cyan(0.0306675939, 0.5170937486, (float)95/95, 3);
+  static constexpr CIELED blue(0.1747943747, 0.1117834986, (float)30/30, 23);
+  static constexpr CIELED violet(0.35, 0.15, (float)30/30, 4);
 
   // For the LZC series RGB LED.  
-//  CIELED white(0.202531646, 0.469936709, (float)480/480, 9);
-//  CIELED red(0.5137017676, 0.5229440531, (float)210/210, 6);
-//  CIELED green(0.0595846867, 0.574988823, (float)340/340, 22);
-//  CIELED blue(0.1747943747, 0.1117834986, (float)80/80, 23);
+//  static constexpr CIELED white(0.202531646, 0.469936709, (float)480/480, 9);
+//  static constexpr CIELED red(0.5137017676, 0.5229440531, (float)210/210, 6);
+//  static constexpr CIELED green(0.0595846867, 0.574988823, (float)340/340, 22);
+//  static constexpr CIELED blue(0.1747943747, 0.1117834986, (float)80/80, 23);
   
-  // Create a colorspace object that will be put into the abstract lamp.
-  std::shared_ptr<Colorspace> colorspace (new Colorspace(white));
-  
-  // Add the CIE LED definitions to the colorspace.
-  colorspace->addLED(red);
-  colorspace->addLED(amber);
-  colorspace->addLED(green);
-  colorspace->addLED(cyan);
-  colorspace->addLED(blue);
-
-  // Create the lamp colorspace.
-  lamp.addColorspace(colorspace);
+  // What each LED is for, and how often the effect LED (blacklight) is on.
+  calibration.addLED(white, CalibrationWhite);
+  calibration.addLED(red, CalibrationColor);
+  calibration.addLED(amber, CalibrationColor);
+  calibration.addLED(green, CalibrationColor);
+  calibration.addLED(cyan, CalibrationColor);
+  calibration.addLED(blue, CalibrationColor);
+  calibration.addLED(violet, CalibrationEffect, 0.2);
   
-  // Initialize the random fader.
-  // Add the colored LEDs to randomly switch between.
-  randomfader.addLED(red);
-  randomfader.addLED(amber);
-  randomfader.addLED(green);
-  randomfader.addLED(cyan);
-  randomfader.addLED(blue);
+  // The colorspace of the white and colored LEDs that will be put into the
+  // abstract lamp, with its hue lookup table. The compiler works it out
+  // and leaves it in flash, so it costs no time or RAM here. One entry
+  // per degree, interpolated, is within about 0.1% of the exact
+  // intersection. The compiler can only do this from C++14 on; built as
+  // C++11, the same colorspace is built here from the calibration.
+#if __cplusplus >= 201402L
+  static constexpr ColorspaceTable<5, 360> lz7(white, red, amber, green, cyan, blue);
+//  static constexpr ColorspaceTable<3, 360> lz7(white, red, green, blue);
+  std::shared_ptr<Colorspace> colorspace(new Colorspace(lz7));
+#else
+  std::shared_ptr<Colorspace> colorspace = calibration.colorspace();
+  colorspace->finalize(360);
+#endif
   
-  // Add the Effect LED (blacklight) with probability of being on.
-  randomfader.addEffectLED(violet, 0.2);
+  // A calibration saved for this fixture takes their place, and its
+  // colorspace is built in RAM, about 9 kB with the table.
+  if (calibration.load()) {
+    colorspace = calibration.colorspace();
+    colorspace->finalize(360);
+  }
   
-  // And initialize the lamp so that it is fully functional.
-  lamp.begin();
+  // And initialize the lamp and the random fader so that they are fully
+  // functional. Levels map linearly to PWM, so colors mix as the
+  // colorspace worked them out; an OutputTransfer(TransferLstar) given to
+  // setTransfer() dims along CIE L* instead.
+  useCalibration(colorspace);
   
   // And start up the cycler.
   cycler.setCycler(HSIColor(0, 1, 1), 1000, 1);
-  randomfader.startRandom(4000);
+  
+  // Number the effects for the commands that select them. render() draws
+  // whichever is selected, so a new effect only needs adding here and a
+  // command to select it.
+  hsiEffect = effects.add(steady);
+  strobeEffect = effects.add(strober);
+  fadeEffect = effects.add(fader);
+  cycleEffect = effects.add(cycler);
+  randomEffect = effects.add(randomfader);
+  show.addLayer(cycler, BlendCrossfade);
+  show.addLayer(strober, BlendAdd, 0);
+  showEffect = effects.add(show);
+  cueEffect = effects.add(cues);
+  
+  // Play the saved cue list if there is one, or start with the random
+  // fader.
+  if (cues.load()) {
+    cues.start();
+    effects.select(cueEffect);
+  }
+  else effects.select(randomEffect);
+  
+  // Start listening for DMX.
+  dmx.begin();
+  dmxTimer.begin(dmxTimerISR, 1000);
+  
+  // And start drawing.
+  scheduler.begin();
 }
 
-enum mode {HSI = 0, Strobe = 1, Fade = 2, Cycle = 3, Random = 4} mode = Random;
-
 void loop() {
   
-  if (Serial.available()) evaluateCommand(Serial.readStringUntil(0x0D));
-  
-  switch (mode) {
-    case 0: // Standard HSI mode.
-      handleHSI();
-      break;
-    case 1: // Handle Strober mode.
-      handleStrobe();
-      break;
-    case 2: // Fade HSI mode.
-      handleFade();
-      break;
-    case 3: // Standalone Cycling mode.
-      handleCycle();
-      break;
-    case 4: // Random LED shifting for art.
-      handleRandom();
-      break;
+  // Commands are taken a byte at a time as they arrive, so a partial one
+  // never holds up the lamp. Everything else happens in the timers.
+  while (Serial.available()) {
+    switch (protocol.feed(Serial.read())) {
+      case LampLineReady:
+        evaluateLine(protocol.getLine());
+        break;
+      case LampCommandReady:
+        if (protocol.getCommand().opcode == LampStats) sendStats();
+        else sendAck(protocol.getCommand().opcode, applyCommand(protocol.getCommand()));
+        break;
+      case LampFrameError:
+        sendAck(protocol.getCommand().opcode, false);
+        break;
+      case LampLineError:
+        Serial.println("ERROR");
+        break;
+      default:
+        break;
+    }
   }
 }
 
-void handleHSI() {
-  lamp.setColor(color);
+void dmxTimerISR(void) {
+  dmx.bufferService();
+  // Frames are applied here rather than in loop() so that each reaches the
+  // outputs within a millisecond of arriving, whatever loop() is doing.
+  if ((effects.getActive() == noEffect) && dmx.newFrame()) fixture.apply(dmx);
 }
 
-void handleFade() {
-  // If the fader is running, update it.
-  if (fader.isRunning()) {
-    color = fader.getHSIColor();
-    lamp.setColor(color);
+// Draws the next frame of the selected effect. Called by the scheduler, and
+// returns false if there was nothing new to draw, when it only steps the
+// lamp's dither.
+boolean render(void) {
+  if (!effects.render()) {
+    lamp.dither();
+    return false;
   }
-  // If the fader is done, set state back to HSI.
-  else mode = HSI;
+  const LampFrame &frame = effects.getFrame();
+  lamp.setFrame(frame);
+  if (!frame.direct) color = frame.color;
+  return true;
 }
 
-void handleStrobe() {
-  color = strober.getHSIColor();
-  lamp.setColor(color);
+// Puts the calibration's LEDs into the lamp and the random fader, with
+// the colorspace built from it.
+void useCalibration(std::shared_ptr<Colorspace> colorspace) {
+  lamp.addColorspace(colorspace);
+  lamp.begin();
+  lamp.setDither(lampDitherBits);
+  lamp.setSupply(lampSupplyVolts);
+  lamp.setDrive(lampSinkAmps, lampForwardVolts);
+  for (int i=0; i<calibration.getCount(); i++) {
+    CIELED LED = calibration.getLED(i).LED;
+    if (calibration.getLED(i).role == CalibrationEffect) lamp.setPinDrive(LED.getPin(), lampSinkAmps, lampForwardVolts);
+  }
+  lamp.setPowerBudget(lampPowerBudget, lampChannelBudget);
+  randomfader.clear();
+  calibration.addTo(randomfader);
+  randomfader.startRandom(4000);
 }
 
-void handleCycle() {
-  color = cycler.getHSIColor();
-  lamp.setColor(color);
+// Swaps in the new calibration. Building its colorspace takes a while, so
+// the lamp keeps drawing with the old one until the new one is ready.
+boolean applyCalibration(void) {
+  if (!newCalibration.isValid()) return false;
+  std::shared_ptr<Colorspace> colorspace = newCalibration.colorspace();
+  colorspace->finalize(360);
+  noInterrupts();
+  // Pins the new LEDs leave out are turned off.
+  for (int i=0; i<calibration.getCount(); i++) {
+    CIELED LED = calibration.getLED(i).LED;
+    analogWrite(LED.getPin(), 0);
+  }
+  lamp.invalidate();
+  calibration = newCalibration;
+  useCalibration(colorspace);
+  effects.select(effects.getActive());
+  interrupts();
+  return true;
 }
 
-void handleRandom() {
-  std::vector<float> LEDs = randomfader.getLEDs();
-  std::vector<int> pins = randomfader.getPins();
-  lamp.setLEDs(LEDs, pins);
+// Carries out a command with the render timer held off, so that a frame is
+// never drawn from a half-changed effect.
+boolean applyCommand(const LampCommand &command) {
+  // Writing EEPROM takes a while, and the render timer does not touch the
+  // list, so it can keep running.
+  if (command.opcode == LampCueSave) return cues.save();
+  if (command.opcode == LampCalSave) return calibration.save();
+  if (command.opcode == LampCalApply) return applyCalibration();
+  noInterrupts();
+  boolean ok = evaluateCommand(command);
+  interrupts();
+  return ok;
 }
-    
 
-void evaluateCommand(String commandstring) {
-  if (commandstring.startsWith("HSI ")) {
-    // If it matches HSI, delete the command and capture three floats.
-    commandstring.replace("HSI ", "");
-    // Next, find the 2 spaces between the floats.
-    int spaceIndex = commandstring.indexOf(' ');
-    if (spaceIndex != -1) {
-      int spaceIndex2 = commandstring.indexOf(' ', spaceIndex + 1);
-      if (spaceIndex2 != -1) {
-        // Then check that the three values are floats.
-        if (checkFloat(commandstring.substring(0, spaceIndex)) == 0) {
-          if (checkFloat(commandstring.substring(spaceIndex+1, spaceIndex2)) == 0) {
-            if (checkFloat(commandstring.substring(spaceIndex2+1)) == 0) {
-              color.setHSI(commandstring.substring(0, spaceIndex).toFloat(), commandstring.substring(spaceIndex+1, spaceIndex2).toFloat(), commandstring.substring(spaceIndex2+1).toFloat());
-              mode = HSI;
-              Serial.println("OK");
-            }
-            else Serial.println("ERROR");
-          }
-          else Serial.println("ERROR");
-        }
-        else Serial.println("ERROR");
-      }
-      else Serial.println("ERROR");
+// Carries out a binary command. Returns false if it is not valid, in the
+// same cases as the text commands answer ERROR.
+boolean evaluateCommand(const LampCommand &command) {
+  switch (command.opcode) {
+    case LampHSI:
+      color = command.color1;
+      steady.setColor(color);
+      effects.select(hsiEffect);
+      return true;
+    case LampStrobe:
+      if (command.time == 0) return false;
+      strober.setStrober(command.color1, command.color2, command.time);
+      effects.select(strobeEffect);
+      return true;
+    case LampFade:
+      if (command.time == 0) return false;
+      fader.setFader(command.color1, command.color2, command.time, command.direction);
+      effects.select(fadeEffect);
+      return true;
+    case LampCycle:
+      if (!(command.period > 0) || ((command.direction != 0) && (command.direction != 1))) return false;
+      cycler.setCycler(color, command.period, command.direction);
+      effects.select(cycleEffect);
+      return true;
+    case LampRandom: {
+      // The random fader only drives its own LEDs, so turn the rest off.
+      HSIColor blank(0, 0, 0);
+      lamp.setColor(blank);
+      effects.select(randomEffect);
+      return true;
     }
-    else Serial.println("ERROR");
-  }
-  // Effect LED command.
-  else if (commandstring.startsWith("Effect ")) {
-    commandstring.replace("Effect ", "");
-    if (checkInt(commandstring) == 0) {
-      int effect = commandstring.toInt();
-      if (effect == 0) {
-        digitalWrite(4, LOW);
-        mode = HSI;
-      }
-      else if (effect == 1) {
-        digitalWrite(4, HIGH);
-        mode = HSI;
-      }
-      else Serial.println("ERROR");
+    case LampEffect:
+      if (command.effect > 1) return false;
+      digitalWrite(4, command.effect ? HIGH : LOW);
+      // The random fader's effect LED is on this pin too.
+      lamp.invalidate();
+      steady.setColor(color);
+      effects.select(hsiEffect);
+      return true;
+    case LampDMX:
+      if ((command.personality > DMXDirect) || !fixture.setFixture(command.address, (DMXPersonality)command.personality)) return false;
+      effects.select(noEffect);
+      return true;
+    case LampRate:
+      if (command.rate == 0) return false;
+      scheduler.setRate(command.rate);
+      scheduler.resetStats();
+      show.resetStats();
+      return true;
+    case LampShow:
+      effects.select(showEffect);
+      return true;
+    case LampLayer:
+      return show.setLayer(command.layer, (BlendMode)command.blend, command.level);
+    case LampMaster:
+      show.setMaster(command.level);
+      return true;
+    case LampCueClear:
+      cues.clear(command.loop);
+      return true;
+    case LampCue: {
+      Cue cue = {command.color1, command.time, command.hold, command.easing, (uint8_t)command.direction};
+      return cues.addCue(cue);
     }
-    else Serial.println("ERROR");
+    case LampCuePlay:
+      if (cues.getCount() == 0) return false;
+      cues.start();
+      effects.select(cueEffect);
+      return true;
+    case LampCalClear:
+      newCalibration.clear();
+      return true;
+    case LampCalLED:
+      return newCalibration.addLED(CIELED(command.u, command.v, command.maxvalue, command.pin, command.power), command.role,
+                                   command.chance);
+    default:
+      return false;
   }
-  // Random Fader command.
-  else if (commandstring.startsWith("Random")) {
-    mode = Random;
-    HSIColor blank(0, 0, 0);
-    lamp.setColor(blank);
-    Serial.println("OK");
-  }
-  // Cycler command.
-  else if (commandstring.startsWith("Cycler ")) {
-    commandstring.replace("Cycler ", "");
-    int spaceIndex = commandstring.indexOf(' ');
-    if (spaceIndex != -1) {
-      if (checkFloat(commandstring.substring(0, spaceIndex)) == 0) {
-        if (checkInt(commandstring.substring(spaceIndex+1)) == 0) {
-          mode = Cycle;
-          cycler.setCycler(color, commandstring.substring(0, spaceIndex).toFloat(), commandstring.substring(spaceIndex+1).toInt());
+}
 
-          Serial.println("OK");
-        }
-        else Serial.println("ERROR");
-      }
-      else Serial.println("ERROR");
-    }
-    else Serial.println("ERROR");
-  }
-  // Strobe command. HSI value 1, HSI value 2, period.
-  else if (commandstring.startsWith("Strobe ")) {
-    commandstring.replace("Strobe ", "");
-    // First find the six expected spaces.
-    int spaceIndex = commandstring.indexOf(' ');
-    if (spaceIndex != -1) {
-      int spaceIndex2 = commandstring.indexOf(' ', spaceIndex + 1);
-      if (spaceIndex2 != -1) {
-        int spaceIndex3 = commandstring.indexOf(' ', spaceIndex2 + 1);
-        if (spaceIndex3 != -1) {
-          int spaceIndex4 = commandstring.indexOf(' ', spaceIndex3 + 1);
-          if (spaceIndex4 != -1) {
-            int spaceIndex5 = commandstring.indexOf(' ', spaceIndex4 + 1);
-            if (spaceIndex5 != -1) {
-              int spaceIndex6 = commandstring.indexOf(' ', spaceIndex5 + 1);
-              if (spaceIndex6 != -1) {
-                
-                // Then check that the three values are floats.
-                if (checkFloat(commandstring.substring(0, spaceIndex)) == 0) {
-                  if (checkFloat(commandstring.substring(spaceIndex+1, spaceIndex2)) == 0) {
-                    if (checkFloat(commandstring.substring(spaceIndex2+1, spaceIndex3)) == 0) {
-                      if (checkFloat(commandstring.substring(spaceIndex3+1, spaceIndex4)) == 0) {
-                        if (checkFloat(commandstring.substring(spaceIndex4+1, spaceIndex5)) == 0) {
-                          if (checkFloat(commandstring.substring(spaceIndex5+1, spaceIndex6)) == 0) {
-                            if (checkFloat(commandstring.substring(spaceIndex6+1)) == 0) {
-                              unsigned long time = commandstring.substring(spaceIndex6+1).toFloat();
-                              if (time > 0) {
-                                // Then all the values are valid.
-                                HSIColor color1(commandstring.substring(0, spaceIndex).toFloat(), commandstring.substring(spaceIndex+1, spaceIndex2).toFloat(), commandstring.substring(spaceIndex2+1, spaceIndex3).toFloat());
-                                HSIColor color2(commandstring.substring(spaceIndex3+1, spaceIndex4).toFloat(), commandstring.substring(spaceIndex4+1, spaceIndex5).toFloat(), commandstring.substring(spaceIndex5+1, spaceIndex6).toFloat());
-                                
-                                strober.setStrober(color1, color2, time);
-                                mode = Strobe;
-                                Serial.println("OK");
-                              }
-                              else Serial.println("ERROR");
-                            }
-                            else Serial.println("ERROR");
-                          }
-                          else Serial.println("ERROR");
-                        }
-                        else Serial.println("ERROR");
-                      }
-                      else Serial.println("ERROR");
-                    }
-                    else Serial.println("ERROR");
-                  }
-                  else Serial.println("ERROR");
-                }
-                else Serial.println("ERROR");
-              }
-              else Serial.println("ERROR");
-            }
-            else Serial.println("ERROR");
-          }
-          else Serial.println("ERROR");
-        }
-        else Serial.println("ERROR");
-      }
-      else Serial.println("ERROR");
-    }
-    else Serial.println("ERROR");
-  }
-  
-  else if (commandstring.startsWith("Fade ")) {
-    commandstring.replace("Fade ", "");
-    
-    // First find the seven expected spaces.
-    int spaceIndex = commandstring.indexOf(' ');
-    if (spaceIndex != -1) {
-      int spaceIndex2 = commandstring.indexOf(' ', spaceIndex + 1);
-      if (spaceIndex2 != -1) {
-        int spaceIndex3 = commandstring.indexOf(' ', spaceIndex2 + 1);
-        if (spaceIndex3 != -1) {
-          int spaceIndex4 = commandstring.indexOf(' ', spaceIndex3 + 1);
-          if (spaceIndex4 != -1) {
-            int spaceIndex5 = commandstring.indexOf(' ', spaceIndex4 + 1);
-            if (spaceIndex5 != -1) {
-              int spaceIndex6 = commandstring.indexOf(' ', spaceIndex5 + 1);
-              if (spaceIndex6 != -1) {
-                int spaceIndex7 = commandstring.indexOf(' ', spaceIndex6 + 1);
-                if (spaceIndex7 != -1) {
-                
-                  // Then check that the three values are floats.
-                  if (checkFloat(commandstring.substring(0, spaceIndex)) == 0) {
-                    if (checkFloat(commandstring.substring(spaceIndex+1, spaceIndex2)) == 0) {
-                      if (checkFloat(commandstring.substring(spaceIndex2+1, spaceIndex3)) == 0) {
-                        if (checkFloat(commandstring.substring(spaceIndex3+1, spaceIndex4)) == 0) {
-                          if (checkFloat(commandstring.substring(spaceIndex4+1, spaceIndex5)) == 0) {
-                            if (checkFloat(commandstring.substring(spaceIndex5+1, spaceIndex6)) == 0) {
-                              if (checkFloat(commandstring.substring(spaceIndex6+1, spaceIndex7)) == 0) {
-                                if (checkInt(commandstring.substring(spaceIndex7+1)) == 0) {
-                                  unsigned long time = commandstring.substring(spaceIndex6+1, spaceIndex7).toFloat();
-                                  if (time > 0) {
-                                    // Then all the values are valid.
-                                    HSIColor color1(commandstring.substring(0, spaceIndex).toFloat(), commandstring.substring(spaceIndex+1, spaceIndex2).toFloat(), commandstring.substring(spaceIndex2+1, spaceIndex3).toFloat());
-                                    HSIColor color2(commandstring.substring(spaceIndex3+1, spaceIndex4).toFloat(), commandstring.substring(spaceIndex4+1, spaceIndex5).toFloat(), commandstring.substring(spaceIndex5+1, spaceIndex6).toFloat());
-                                    int direction = commandstring.substring(spaceIndex7+1).toInt();
-                                    fader.setFader(color1, color2, time, direction);
-                                    mode = Fade;
-                                    Serial.println("OK");
-                                  }
-                                  else Serial.println("ERROR");
-                                }
-                                else Serial.println("ERROR");
-                              }
-                              else Serial.println("ERROR");
-                            }
-                            else Serial.println("ERROR");
-                          }
-                          else Serial.println("ERROR");
-                        }
-                        else Serial.println("ERROR");
-                      }
-                      else Serial.println("ERROR");
-                    }
-                    else Serial.println("ERROR");
-                  }
-                  else Serial.println("ERROR");
-                }
-                else Serial.println("ERROR");
-              }
-              else Serial.println("ERROR");
-            }
-            else Serial.println("ERROR");
-          }
-          else Serial.println("ERROR");
-        }
-        else Serial.println("ERROR");
-      }
-      else Serial.println("ERROR");
-    }
-    else Serial.println("ERROR");
-  }
+void sendAck(uint8_t opcode, boolean ok) {
+  uint8_t frame[lampMaxFrame];
+  Serial.write(frame, LampProtocol::encodeAck(opcode, ok, frame));
 }
 
-int checkFloat(String data) {
-  // The simplest way to go about testing the string for only numerical inputs
-  // since Arduino doesn't implement regex, is probably to count the number of 
-  // characters and then count the number of instances of each valid number
-  // character. i.e. [0-9] and the decimal point for a float after trimming
-  // whitespace or newlines.
-  
-  data.trim();
-  // Check to make sure the string isn't now blank.
-  if (data.length() == 0) return -2;
-  
-  unsigned int runningtotal = 0;
-  
-  for (unsigned int j=0; j<data.length(); j++) {
-    char activechar = data.charAt(j);
-    // Test against valid cahracter list.
-    if ((activechar == '-') ||
-        (activechar == '.') ||
-        (activechar == '0') ||
-        (activechar == '1') ||
-        (activechar == '2') ||
-        (activechar == '3') ||
-        (activechar == '4') ||
-        (activechar == '5') ||
-        (activechar == '6') ||
-        (activechar == '7') ||
-        (activechar == '8') ||
-        (activechar == '9')) runningtotal++;
-  }
-  
-  if (runningtotal == data.length()) return 0;
-  else return -1;
+// The render scheduler's counters, as a LampStatsReport frame.
+void sendStats(void) {
+  LampCommand report;
+  report.opcode = LampStatsReport;
+  getStats(report);
+  uint8_t frame[lampMaxFrame];
+  Serial.write(frame, LampProtocol::encode(report, frame));
 }
 
-int checkInt(String data) {
-  // The simplest way to go about testing the string for only numerical inputs
-  // since Arduino doesn't implement regex, is probably to count the number of 
-  // characters and then count the number of instances of each valid number
-  // character. i.e. [0-9] and the decimal point for a float after trimming
-  // whitespace or newlines. Oh, plus the negative sign.
-  
-  data.trim();
-  
-  int runningtotal = 0;
-  
-  for (int j=0; j<data.length(); j++) {
-    char activechar = data.charAt(j);
-    // Test against valid cahracter list.
-    if ((activechar == '-') ||
-        (activechar == '0') ||
-        (activechar == '1') ||
-        (activechar == '2') ||
-        (activechar == '3') ||
-        (activechar == '4') ||
-        (activechar == '5') ||
-        (activechar == '6') ||
-        (activechar == '7') ||
-        (activechar == '8') ||
-        (activechar == '9')) runningtotal++;
+void getStats(LampCommand &report) {
+  report.frames = scheduler.getFrames();
+  report.rendered = scheduler.getRendered();
+  report.overruns = scheduler.getOverruns();
+  report.minMicros = scheduler.getMinMicros() + 0.5f;
+  report.avgMicros = scheduler.getAvgMicros() + 0.5f;
+  report.maxMicros = scheduler.getMaxMicros() + 0.5f;
+}
+
+// Carries out a text command and answers OK or ERROR. As they always
+// have, a working Effect command and a line that is not a command at all
+// get no answer. Stats is answered with the counters on one line, then
+// the time each show layer takes on one line each.
+void evaluateLine(const char *line) {
+  LampCommand command;
+  boolean ok = LampProtocol::parseLine(line, command);
+  if (ok && (command.opcode == LampStats)) {
+    getStats(command);
+    Serial.print("Stats ");
+    Serial.print(scheduler.getRate());
+    Serial.print("Hz frames ");
+    Serial.print(command.frames);
+    Serial.print(" rendered ");
+    Serial.print(command.rendered);
+    Serial.print(" overruns ");
+    Serial.print(command.overruns);
+    Serial.print(" min ");
+    Serial.print(command.minMicros);
+    Serial.print("us avg ");
+    Serial.print(command.avgMicros);
+    Serial.print("us max ");
+    Serial.print(command.maxMicros);
+    Serial.println("us");
+    for (int i=0; i<show.getLayers(); i++) {
+      Serial.print("Layer ");
+      Serial.print(i);
+      Serial.print(" avg ");
+      Serial.print(show.getLayerAvgMicros(i));
+      Serial.print("us max ");
+      Serial.print(show.getLayerMaxMicros(i));
+      Serial.println("us");
+    }
+    return;
   }
-  
-  if (runningtotal == data.length()) return 0;
-  else return -1;
+  ok = ok && applyCommand(command);
+  if (command.opcode == 0) return;
+  if (!ok) Serial.println("ERROR");
+  else if (command.opcode != LampEffect) Serial.println("OK");
 }
@@ -0,0 +1,483 @@
+//*********************************************************
+//
+// TeensyLED Host Shim
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Arduino.h"
+#include "TeensyHost.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <new>
+
+static uint64_t hostnanos = 0;
+static TeensyHost::PinState pins[TeensyHost::numPins];
+static unsigned long analogwrites = 0;
+static int writeresolution = 8;
+static int readresolution = 10;
+static void (*analogwritehook)(uint8_t pin, int value) = 0;
+static int (*analoginput)(uint8_t pin) = 0;
+static std::deque<char> serialin;
+// Bytes still on their way, with the time each arrives.
+static std::deque<std::pair<uint64_t, char> > serialpending;
+static std::string serialout;
+struct DmxFrame {
+  uint64_t endnanos;
+  std::vector<uint8_t> slots;
+};
+static std::deque<DmxFrame> dmxin;
+static uint64_t dmxlinefree = 0;
+static std::vector<TeensyHost::LineEvent> lineout;
+static bool linerecord = true;
+static uint64_t interruptnanos = 0;
+static unsigned long allocationcount = 0;
+static unsigned long allocationbytes = 0;
+static uint32_t randomstate = 1;
+
+usb_serial_class Serial;
+
+// Allocation counting for the code under test.
+
+void *operator new(size_t size) {
+  allocationcount++;
+  allocationbytes += size;
+  void *p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size) {
+  allocationcount++;
+  allocationbytes += size;
+  void *p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  free(p);
+}
+
+// Host controls.
+
+void TeensyHost::reset(void) {
+  hostnanos = 0;
+  for (int i=0; i<numPins; i++) pins[i] = PinState();
+  analogwrites = 0;
+  writeresolution = 8;
+  readresolution = 10;
+  analogwritehook = 0;
+  analoginput = 0;
+  serialin.clear();
+  serialpending.clear();
+  serialout.clear();
+  dmxin.clear();
+  dmxlinefree = 0;
+  lineout.clear();
+  linerecord = true;
+  interruptnanos = 0;
+  randomstate = 1;
+}
+
+uint64_t TeensyHost::nanos(void) {
+  return hostnanos;
+}
+
+void TeensyHost::advanceNanos(uint64_t nanos) {
+  uint64_t target = hostnanos + nanos;
+  IntervalTimer *timer;
+  while ((timer = IntervalTimer::due(target)) != 0) {
+    if (timer->deadline() > hostnanos) hostnanos = timer->deadline();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    timer->fire();
+    interruptnanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+  hostnanos = target;
+}
+
+void TeensyHost::advanceMicros(uint64_t micros) {
+  advanceNanos(micros * 1000);
+}
+
+const TeensyHost::PinState &TeensyHost::pin(uint8_t pin) {
+  return pins[pin % numPins];
+}
+
+unsigned long TeensyHost::analogWrites(void) {
+  return analogwrites;
+}
+
+int TeensyHost::analogResolution(void) {
+  return writeresolution;
+}
+
+void TeensyHost::onAnalogWrite(void (*hook)(uint8_t pin, int value)) {
+  analogwritehook = hook;
+}
+
+void TeensyHost::setAnalogInput(int (*source)(uint8_t pin)) {
+  analoginput = source;
+}
+
+void TeensyHost::serialInput(const char *data, size_t length) {
+  serialin.insert(serialin.end(), data, data + length);
+}
+
+void TeensyHost::serialInput(const std::string &data) {
+  serialInput(data.data(), data.size());
+}
+
+void TeensyHost::serialInput(const std::string &data, uint64_t bytenanos) {
+  uint64_t arrival = serialpending.empty() ? hostnanos : serialpending.back().first;
+  for (size_t i=0; i<data.size(); i++) {
+    arrival += bytenanos;
+    serialpending.push_back(std::make_pair(arrival, data[i]));
+  }
+}
+
+// Moves bytes that have arrived by now into the receive buffer.
+static void serialArrive(void) {
+  while (!serialpending.empty() && (serialpending.front().first <= hostnanos)) {
+    serialin.push_back(serialpending.front().second);
+    serialpending.pop_front();
+  }
+}
+
+std::string TeensyHost::serialOutput(void) {
+  return serialout;
+}
+
+void TeensyHost::clearSerialOutput(void) {
+  serialout.clear();
+}
+
+uint64_t TeensyHost::dmxInput(const uint8_t *frame, int length) {
+  // Break, mark after break, then 11 bits of 4us for every slot.
+  uint64_t start = dmxlinefree > hostnanos ? dmxlinefree : hostnanos;
+  DmxFrame received;
+  received.endnanos = start + 100000 + 12000 + (uint64_t)length * 44000;
+  received.slots.assign(frame, frame + length);
+  dmxin.push_back(received);
+  dmxlinefree = received.endnanos;
+  return received.endnanos;
+}
+
+int TeensyHost::dmxReceive(uint8_t *buffer, int size, uint64_t &endnanos) {
+  int length = -1;
+  while (!dmxin.empty() && (dmxin.front().endnanos <= hostnanos)) {
+    const DmxFrame &frame = dmxin.front();
+    length = frame.slots.size() < (size_t)size ? frame.slots.size() : size;
+    std::copy(frame.slots.begin(), frame.slots.begin() + length, buffer);
+    endnanos = frame.endnanos;
+    dmxin.pop_front();
+  }
+  return length;
+}
+
+void TeensyHost::lineEvent(const LineEvent &event) {
+  if (linerecord) lineout.push_back(event);
+}
+
+const std::vector<TeensyHost::LineEvent> &TeensyHost::line(void) {
+  return lineout;
+}
+
+void TeensyHost::clearLine(void) {
+  lineout.clear();
+}
+
+void TeensyHost::recordLine(bool record) {
+  linerecord = record;
+}
+
+uint64_t TeensyHost::interruptNanos(void) {
+  return interruptnanos;
+}
+
+unsigned long TeensyHost::allocations(void) {
+  return allocationcount;
+}
+
+unsigned long TeensyHost::allocatedBytes(void) {
+  return allocationbytes;
+}
+
+// Digital and analog I/O.
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  pins[pin % TeensyHost::numPins].mode = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  pins[pin % TeensyHost::numPins].digital = val ? HIGH : LOW;
+}
+
+uint8_t digitalRead(uint8_t pin) {
+  return pins[pin % TeensyHost::numPins].digital;
+}
+
+void analogWrite(uint8_t pin, int val) {
+  // The FTM saturates anything past full scale, as on the Teensy.
+  int maxval = (1 << writeresolution);
+  TeensyHost::PinState &state = pins[pin % TeensyHost::numPins];
+  state.duty = val < 0 ? 0 : (val > maxval ? maxval : val);
+  state.writes++;
+  state.lastwritenanos = hostnanos;
+  analogwrites++;
+  if (analogwritehook) analogwritehook(pin, val);
+}
+
+void analogWriteFrequency(uint8_t pin, float frequency) {
+  pins[pin % TeensyHost::numPins].frequency = frequency;
+}
+
+uint32_t analogWriteResolution(uint32_t bits) {
+  uint32_t prior = writeresolution;
+  writeresolution = bits < 2 ? 2 : (bits > 16 ? 16 : bits);
+  return prior;
+}
+
+int analogRead(uint8_t pin) {
+  if (analoginput) return analoginput(pin);
+  return 1 << (readresolution - 1);
+}
+
+void analogReadResolution(unsigned int bits) {
+  readresolution = bits < 1 ? 1 : (bits > 16 ? 16 : bits);
+}
+
+// Time.
+
+uint32_t micros(void) {
+  return (uint32_t)(hostnanos / 1000);
+}
+
+uint32_t millis(void) {
+  return (uint32_t)(hostnanos / 1000000);
+}
+
+void delay(uint32_t msec) {
+  TeensyHost::advanceMicros((uint64_t)msec * 1000);
+}
+
+void delayMicroseconds(uint32_t usec) {
+  TeensyHost::advanceMicros(usec);
+}
+
+void noInterrupts(void) {
+}
+
+void interrupts(void) {
+}
+
+uint32_t hostCycleCount(void) {
+  uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  return (uint32_t)(nanos * (F_CPU / 1000000) / 1000);
+}
+
+// Random numbers, a Park-Miller generator like the Teensy core so
+// that host runs are repeatable from a seed. The no-argument random()
+// is left to the C library.
+
+static int32_t nextrandom(void) {
+  int32_t hi = randomstate / 127773;
+  int32_t lo = randomstate % 127773;
+  int32_t x = 16807 * lo - 2836 * hi;
+  if (x < 0) x += 0x7FFFFFFF;
+  randomstate = x;
+  return x;
+}
+
+uint32_t random(uint32_t howbig) {
+  if (howbig == 0) return 0;
+  return nextrandom() % howbig;
+}
+
+int32_t random(int32_t howsmall, int32_t howbig) {
+  if (howsmall >= howbig) return howsmall;
+  return random((uint32_t)(howbig - howsmall)) + howsmall;
+}
+
+void randomSeed(uint32_t newseed) {
+  if (newseed > 0) randomstate = newseed;
+}
+
+// IntervalTimer.
+
+static IntervalTimer *timers = 0;
+
+IntervalTimer::IntervalTimer(void) :
+  _funct(0),
+  _periodnanos(0),
+  _startnanos(0),
+  _count(0),
+  _running(false),
+  _next(timers) {
+  timers = this;
+}
+
+IntervalTimer::~IntervalTimer(void) {
+  for (IntervalTimer **t = &timers; *t; t = &(*t)->_next) {
+    if (*t == this) {
+      *t = _next;
+      break;
+    }
+  }
+}
+
+bool IntervalTimer::begin(void (*funct)(void), float microseconds) {
+  if (microseconds <= 0) return false;
+  _funct = funct;
+  _periodnanos = 1000.0 * microseconds;
+  _startnanos = hostnanos;
+  _count = 1;
+  _running = true;
+  return true;
+}
+
+void IntervalTimer::update(float microseconds) {
+  if (microseconds <= 0) return;
+  // As on the Teensy, the new period starts after the pending one.
+  _startnanos = deadline() - (uint64_t)(1000.0 * microseconds);
+  _periodnanos = 1000.0 * microseconds;
+  _count = 1;
+}
+
+void IntervalTimer::end(void) {
+  _running = false;
+}
+
+uint64_t IntervalTimer::deadline(void) const {
+  return _startnanos + (uint64_t)(_count * _periodnanos + 0.5);
+}
+
+void IntervalTimer::fire(void) {
+  _count++;
+  if (_funct) _funct();
+}
+
+IntervalTimer *IntervalTimer::due(uint64_t nanos) {
+  IntervalTimer *earliest = 0;
+  for (IntervalTimer *t = timers; t; t = t->_next) {
+    if (t->_running && (t->deadline() <= nanos) && (!earliest || (t->deadline() < earliest->deadline()))) earliest = t;
+  }
+  return earliest;
+}
+
+// USB Serial.
+
+int usb_serial_class::available(void) {
+  serialArrive();
+  return serialin.size();
+}
+
+int usb_serial_class::read(void) {
+  serialArrive();
+  if (serialin.empty()) return -1;
+  char c = serialin.front();
+  serialin.pop_front();
+  return (uint8_t)c;
+}
+
+int usb_serial_class::peek(void) {
+  serialArrive();
+  if (serialin.empty()) return -1;
+  return (uint8_t)serialin.front();
+}
+
+// As Stream::timedRead(), waits up to the timeout for each byte, here by
+// moving the virtual clock on to when it arrives.
+int usb_serial_class::timedRead(void) {
+  int c = read();
+  if (c >= 0) return c;
+  uint64_t limit = hostnanos + (uint64_t)_timeout*1000000;
+  if (!serialpending.empty() && (serialpending.front().first <= limit)) {
+    TeensyHost::advanceNanos(serialpending.front().first - hostnanos);
+    return read();
+  }
+  TeensyHost::advanceNanos(limit - hostnanos);
+  return -1;
+}
+
+size_t usb_serial_class::readBytes(char *buffer, size_t length) {
+  size_t count = 0;
+  int c;
+  while ((count < length) && ((c = timedRead()) >= 0)) buffer[count++] = c;
+  return count;
+}
+
+String usb_serial_class::readStringUntil(char terminator) {
+  String ret;
+  int c;
+  // Stream blocks until the timeout when the terminator never shows up.
+  while ((c = timedRead()) >= 0) {
+    if (c == terminator) return ret;
+    ret += (char)c;
+  }
+  return ret;
+}
+
+size_t usb_serial_class::write(uint8_t c) {
+  serialout += (char)c;
+  return 1;
+}
+
+size_t usb_serial_class::write(const uint8_t *buffer, size_t size) {
+  serialout.append((const char *)buffer, size);
+  return size;
+}
+
+size_t usb_serial_class::print(const char *s) {
+  size_t n = strlen(s);
+  serialout.append(s, n);
+  return n;
+}
+
+size_t usb_serial_class::print(long n) {
+  char buffer[24];
+  snprintf(buffer, sizeof(buffer), "%ld", n);
+  return print(buffer);
+}
+
+size_t usb_serial_class::print(unsigned long n) {
+  char buffer[24];
+  snprintf(buffer, sizeof(buffer), "%lu", n);
+  return print(buffer);
+}
+
+size_t usb_serial_class::print(double n, int digits) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", digits, n);
+  return print(buffer);
+}
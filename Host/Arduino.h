@@ -0,0 +1,86 @@
+//*********************************************************
+//
+// TeensyLED Host Shim
+//
+// A recording stand-in for the parts of the Teensyduino core
+// that the TeensyLED libraries use, so that they can be built,
+// profiled and checked on a desktop. Time is virtual: micros()
+// only moves when the host program calls delay() or
+// TeensyHost::advanceMicros(), and IntervalTimer callbacks fire
+// at their exact deadlines while it does. Every analogWrite()
+// is recorded per pin. See TeensyHost.h for the host-side
+// controls.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <cmath>
+#include <cstdlib>
+
+// The Teensy core defines abs() as a macro that works on floats, and the
+// libraries rely on that. Pull in the floating point overloads instead.
+using std::abs;
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define F_CPU 96000000
+
+#include "WString.h"
+#include "elapsedMillis.h"
+#include "IntervalTimer.h"
+#include "usb_serial.h"
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+uint8_t digitalRead(uint8_t pin);
+
+void analogWrite(uint8_t pin, int val);
+void analogWriteFrequency(uint8_t pin, float frequency);
+uint32_t analogWriteResolution(uint32_t bits);
+int analogRead(uint8_t pin);
+void analogReadResolution(unsigned int bits);
+
+uint32_t micros(void);
+uint32_t millis(void);
+void delay(uint32_t msec);
+void delayMicroseconds(uint32_t usec);
+
+uint32_t random(uint32_t howbig);
+int32_t random(int32_t howsmall, int32_t howbig);
+void randomSeed(uint32_t newseed);
+
+void noInterrupts(void);
+void interrupts(void);
+
+// The Cortex-M4 cycle counter. On the host it runs from the host's
+// own clock scaled to F_CPU, so it times the host doing the work
+// rather than the virtual clock, which does not move inside a call.
+uint32_t hostCycleCount(void);
+#define ARM_DWT_CYCCNT (hostCycleCount())
@@ -0,0 +1,105 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+//   teensyled_bench [suite ...]
+//
+// Runs the named suites, or all of them without arguments.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+
+#include <stdio.h>
+#include <string.h>
+
+volatile double Benchmark::sink;
+
+static unsigned long failed = 0;
+
+const char *Benchmark::check(bool ok) {
+  if (!ok) failed++;
+  return ok ? "ok" : "FAILED";
+}
+
+unsigned long Benchmark::failures(void) {
+  return failed;
+}
+
+struct Suite {
+  const char *name;
+  void (*run)(void);
+  const char *description;
+};
+
+static const Suite suites[] = {
+  {"color", benchColor, "HSI conversions over a common sweep"},
+  {"lut", benchLUT, "Colorspace hue lookup table against the analytic path"},
+  {"q16", benchQ16, "Q16 integer render path against the float path"},
+  {"batch", benchBatch, "Batch conversions of 8, 64 and 170 fixtures"},
+  {"dmxout", benchDmx, "DMA DMX transmitter frame layout, timing and CPU cost"},
+  {"spectral", benchSpectral, "Band split onsets, latency and cost per audio block"},
+  {"protocol", benchProtocol, "Text and binary commands against the String text parser"},
+  {"render", benchRender, "Fixed rate rendering against drawing every loop() pass"},
+  {"layers", benchLayers, "Compositor blend modes and cost per layer"},
+  {"cues", benchCues, "Cue list playback timing, cost and EEPROM round trip"},
+  {"clock", benchClock, "Effects through many wraps of micros() on the 64-bit clock"},
+  {"transfer", benchTransfer, "Output transfer tables and temporal dither"},
+  {"mixing", benchMixing, "Multi-LED mixing for flux and efficiency against the LED pair"},
+  {"power", benchPower, "Power model and budget limiter across all channels"},
+  {"calibration", benchCalibration, "LED calibration through EEPROM, USB and a colorspace rebuild"},
+  {"spectra", benchSpectra, "CIE 1931 integration of LED spectra for calibration"},
+  {"fixed", benchFixed, "Colorspace worked out at compile time against the runtime one"},
+};
+
+static const int numSuites = sizeof(suites)/sizeof(suites[0]);
+
+int main(int argc, char **argv) {
+  if (argc > 1 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))) {
+    printf("Usage: %s [suite ...]\n\nSuites:\n", argv[0]);
+    for (int i=0; i<numSuites; i++) printf("  %-12s %s\n", suites[i].name, suites[i].description);
+    return 0;
+  }
+  // Every name must be a suite, so that a misspelt one in a test fails.
+  for (int j=1; j<argc; j++) {
+    bool known = false;
+    for (int i=0; i<numSuites; i++) {
+      if (!strcmp(argv[j], suites[i].name)) known = true;
+    }
+    if (!known) {
+      fprintf(stderr, "Unknown suite %s, see --help.\n", argv[j]);
+      return 2;
+    }
+  }
+  for (int i=0; i<numSuites; i++) {
+    bool selected = (argc == 1);
+    for (int j=1; j<argc; j++) {
+      if (!strcmp(argv[j], suites[i].name)) selected = true;
+    }
+    if (!selected) continue;
+    printf("== %s: %s ==\n", suites[i].name, suites[i].description);
+    TeensyHost::reset();
+    suites[i].run();
+    printf("\n");
+  }
+  if (Benchmark::failures()) {
+    printf("%lu checks FAILED\n", Benchmark::failures());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,133 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// The batch conversions against a loop of single conversions,
+// at 8 fixtures (the Audio DMX Master's setup), 64, and the 170
+// RGB fixtures of a full DMX universe. Fixtures are spread over
+// the hue circle and the intensity range, and every frame moves
+// them on so the table reads are not all from one cell. The batch
+// outputs must be identical to the single conversions.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "LEDs.h"
+#include "LZ7.h"
+#include "hsi2rgb.h"
+
+#include <stdio.h>
+
+using Benchmark::Result;
+
+static const int fixtureCounts[] = {8, 64, 170};
+static const int frames = 64;
+
+static void printHeader(void) {
+  printf("%-36s %8s %10s %10s %8s %10s\n", "conversion", "fixtures", "ns/fixture", "cycles", "allocs", "max diff");
+}
+
+static void printResult(const char *name, int fixtures, const Result &result, double maxdiff, const char *unit) {
+  printf("%-36s %8d %10.1f %10.0f %8.2f %6.0f %s %s\n", name, fixtures,
+    result.nanos/fixtures, result.cycles/fixtures, result.allocations, maxdiff, unit, Benchmark::check(maxdiff == 0));
+}
+
+// frames of count fixtures each, laid out frame after frame.
+struct Fixtures {
+  std::vector<float> hue, saturation, intensity;
+  Fixtures(int count) {
+    for (int frame=0; frame<frames; frame++) {
+      for (int i=0; i<count; i++) {
+        hue.push_back(fmod(360.0*i/count + 7.3*frame, 360));
+        saturation.push_back(0.5 + 0.5*((i + frame) % 3)/2);
+        intensity.push_back(0.05 + 0.95*((i*7 + frame) % 11)/10);
+      }
+    }
+  }
+};
+
+void benchBatch(void) {
+  printf("Each call converts every fixture of one frame. Differences are batch against single.\n");
+  printHeader();
+
+  LZ7 leds;
+  std::shared_ptr<Colorspace> colorspace = leds.colorspace();
+  colorspace->finalize(360);
+  int channels = colorspace->getChannels();
+
+  for (unsigned int c=0; c<sizeof(fixtureCounts)/sizeof(fixtureCounts[0]); c++) {
+    int count = fixtureCounts[c];
+    Fixtures fixtures(count);
+
+    // Multimode Colorspace, channels floats per fixture.
+    {
+      std::vector<float> single(count*channels), batch(count*channels);
+      double worst = 0;
+      for (int frame=0; frame<frames; frame++) {
+        for (int i=0; i<count; i++) {
+          HSIColor color(fixtures.hue[frame*count+i], fixtures.saturation[frame*count+i], fixtures.intensity[frame*count+i]);
+          colorspace->Hue2LEDs(color, &single[i*channels], channels);
+        }
+        colorspace->Hue2LEDs(&fixtures.hue[frame*count], &fixtures.saturation[frame*count], &fixtures.intensity[frame*count], count, batch.data(), channels);
+        for (int i=0; i<count*channels; i++) worst = std::max(worst, (double)fabs(single[i] - batch[i]) * 0xFFFF);
+      }
+      Result result = Benchmark::measure([&](unsigned long frame) {
+        for (int i=0; i<count; i++) {
+          HSIColor color(fixtures.hue[frame*count+i], fixtures.saturation[frame*count+i], fixtures.intensity[frame*count+i]);
+          colorspace->Hue2LEDs(color, &single[i*channels], channels);
+        }
+        Benchmark::sink += single[0];
+      }, frames);
+      printResult("Colorspace::Hue2LEDs single", count, result, 0, "LSB16");
+      result = Benchmark::measure([&](unsigned long frame) {
+        colorspace->Hue2LEDs(&fixtures.hue[frame*count], &fixtures.saturation[frame*count], &fixtures.intensity[frame*count], count, batch.data(), channels);
+        Benchmark::sink += batch[0];
+      }, frames);
+      printResult("Colorspace::Hue2LEDs batch", count, result, worst, "LSB16");
+    }
+
+    // Audio DMX Master, three bytes per fixture.
+    {
+      std::vector<uint8_t> single(count*3), batch(count*3);
+      int worst = 0;
+      for (int frame=0; frame<frames; frame++) {
+        for (int i=0; i<count; i++) {
+          int rgb[3];
+          hsi2rgb(fixtures.hue[frame*count+i], fixtures.saturation[frame*count+i], fixtures.intensity[frame*count+i], rgb);
+          for (int j=0; j<3; j++) single[i*3+j] = rgb[j];
+        }
+        hsi2rgb(&fixtures.hue[frame*count], &fixtures.saturation[frame*count], &fixtures.intensity[frame*count], batch.data(), count);
+        for (int i=0; i<count*3; i++) worst = std::max(worst, abs(single[i] - batch[i]));
+      }
+      Result result = Benchmark::measure([&](unsigned long frame) {
+        for (int i=0; i<count; i++) {
+          int rgb[3];
+          hsi2rgb(fixtures.hue[frame*count+i], fixtures.saturation[frame*count+i], fixtures.intensity[frame*count+i], rgb);
+          for (int j=0; j<3; j++) single[i*3+j] = rgb[j];
+        }
+        Benchmark::sink += single[0];
+      }, frames);
+      printResult("hsi2rgb single", count, result, 0, "LSB8");
+      result = Benchmark::measure([&](unsigned long frame) {
+        hsi2rgb(&fixtures.hue[frame*count], &fixtures.saturation[frame*count], &fixtures.intensity[frame*count], batch.data(), count);
+        Benchmark::sink += batch[0];
+      }, frames);
+      printResult("hsi2rgb batch", count, result, worst, "LSB8");
+    }
+  }
+}
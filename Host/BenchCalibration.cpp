@@ -0,0 +1,165 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// Calibration on the LZ7 lamp. The stored form against the LEDs it was
+// made from, and the colorspace built from it against the one built
+// from the LEDs themselves, over every degree of hue and 10% of
+// saturation. Then the calibration through EEPROM beside a full cue
+// list, through the text commands teensyled_calgen prints and through
+// their frames, and what CalApply costs: building and finalizing the
+// new colorspace, and the heap it takes.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "LZ7.h"
+#include "Calibration.h"
+#include "CueSequencer.h"
+#include "LampProtocol.h"
+
+#include <EEPROM.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static boolean sameCalibration(Calibration &a, Calibration &b) {
+  if (a.getCount() != b.getCount()) return false;
+  for (int i=0; i<a.getCount(); i++) {
+    CalibratedLED x = a.getLED(i), y = b.getLED(i);
+    if ((x.role != y.role) || (x.chance != y.chance) || (x.LED.getU() != y.LED.getU()) || (x.LED.getV() != y.LED.getV()) ||
+        (x.LED.getMax() != y.LED.getMax()) || (x.LED.getPower() != y.LED.getPower()) || (x.LED.getPin() != y.LED.getPin())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void benchCalibration(void) {
+  TeensyHost::reset();
+  LZ7 lz7;
+  Calibration calibration;
+  CIELED LEDs[] = {lz7.white, lz7.red, lz7.amber, lz7.green, lz7.cyan, lz7.blue, lz7.violet};
+  for (int i=0; i<7; i++) {
+    calibration.addLED(LEDs[i], i == 0 ? CalibrationWhite : (i == 6 ? CalibrationEffect : CalibrationColor), i == 6 ? 0.2 : 0);
+  }
+  uint8_t blob[calibrationEEPROMSize];
+  int size = calibration.encode(blob);
+  Calibration stored;
+  boolean decoded = stored.decode(blob, size);
+  double rounding = 0;
+  for (int i=0; i<stored.getCount(); i++) {
+    CIELED LED = stored.getLED(i).LED;
+    rounding = fmax(rounding, hypot(LED.getU() - LEDs[i].getU(), LED.getV() - LEDs[i].getV()));
+  }
+
+  // The colorspace from the stored form against the LZ7's own.
+  std::shared_ptr<Colorspace> original = lz7.colorspace(), rebuilt = stored.colorspace();
+  original->finalize(360);
+  rebuilt->finalize(360);
+  double worst = 0;
+  for (int h=0; h<360; h++) {
+    for (int s=0; s<=10; s++) {
+      HSIColor color(h, s/10.0f, 1);
+      float a[maxChannels], b[maxChannels];
+      int channels = original->Hue2LEDs(color, a, maxChannels);
+      rebuilt->Hue2LEDs(color, b, maxChannels);
+      for (int i=0; i<channels; i++) worst = fmax(worst, fabs(a[i] - b[i]));
+    }
+  }
+  printf("%d LEDs in %d bytes (%d at most), %s, u'v' within %.1e of the LEDs, levels within %.1e %s\n", stored.getCount(), size,
+         calibrationEEPROMSize, decoded ? "decodes" : "FAILED to decode", rounding, worst,
+         Benchmark::check(decoded && (rounding < 2e-5) && (worst < 1e-3)));
+
+  // EEPROM, after a full cue list, which it must leave alone.
+  TeensyHost::eraseEEPROM();
+  CueSequencer cues;
+  cues.clear(true);
+  for (int i=0; i<maxCues; i++) {
+    Cue cue = {HSIColor(i*5, 1, 1), 100, 100, EaseLinear, 1};
+    cues.addCue(cue);
+  }
+  cues.save();
+  unsigned long writes = TeensyHost::eepromWrites();
+  calibration.save();
+  unsigned long first = TeensyHost::eepromWrites() - writes;
+  writes = TeensyHost::eepromWrites();
+  calibration.save();
+  unsigned long second = TeensyHost::eepromWrites() - writes;
+  Calibration loaded;
+  boolean round = loaded.load() && sameCalibration(loaded, stored);
+  CueSequencer reloaded;
+  boolean cuesKept = reloaded.load() && (reloaded.getCount() == maxCues);
+  EEPROM.write(calibrationEEPROMAddress + 20, EEPROM.read(calibrationEEPROMAddress + 20) ^ 0x01);
+  Calibration corrupt = stored;
+  boolean refused = !corrupt.load() && sameCalibration(corrupt, stored);
+  TeensyHost::eraseEEPROM();
+  boolean empty = loaded.load();
+  printf("EEPROM at %d: %lu bytes written, %lu saving again, %s, cue list %s, corrupt %s, empty %s %s\n", calibrationEEPROMAddress,
+         first, second, round ? "loads back" : "does not load", cuesKept ? "kept" : "LOST", refused ? "refused" : "loaded",
+         empty ? "loaded" : "refused", Benchmark::check(round && cuesKept && refused && !empty && !second));
+
+  // Over USB, as text and as frames.
+  for (int f=0; f<2; f++) {
+    Calibration received;
+    LampProtocol protocol;
+    int commands = 0, accepted = 0;
+    for (int i=-1; i<stored.getCount(); i++) {
+      char line[lampMaxLine];
+      if (i < 0) snprintf(line, sizeof(line), "CalClear");
+      else {
+        CalibratedLED LED = stored.getLED(i);
+        snprintf(line, sizeof(line), "CalLED %d %d %.6f %.6f %.6f %.6f %.6f", LED.role, LED.LED.getPin(), LED.LED.getU(),
+                 LED.LED.getV(), LED.LED.getMax(), LED.LED.getPower(), LED.chance);
+      }
+      LampCommand command;
+      boolean ok = LampProtocol::parseLine(line, command);
+      if (ok && f) {
+        uint8_t frame[lampMaxFrame];
+        int length = LampProtocol::encode(command, frame);
+        ok = false;
+        for (int j=0; j<length; j++) {
+          if (protocol.feed(frame[j]) == LampCommandReady) {
+            command = protocol.getCommand();
+            ok = true;
+          }
+        }
+      }
+      commands++;
+      if (!ok) continue;
+      if (command.opcode == LampCalClear) received.clear();
+      else if (!received.addLED(CIELED(command.u, command.v, command.maxvalue, command.pin, command.power), command.role,
+                                command.chance)) continue;
+      accepted++;
+    }
+    // Each number comes through as near as its stored form can hold it.
+    uint8_t sent[calibrationEEPROMSize];
+    int length = received.encode(sent);
+    boolean same = received.isValid() && (length == size) && !memcmp(sent, blob, size);
+    printf("%-7s %d of %d commands, %s %s\n", f ? "Frames:" : "Text:", accepted, commands, same ? "same bytes" : "different bytes",
+           Benchmark::check(same));
+  }
+
+  // What CalApply does before swapping the colorspace in.
+  Benchmark::Result result = Benchmark::measure([&](unsigned long i) {
+    std::shared_ptr<Colorspace> colorspace = stored.colorspace();
+    colorspace->finalize(360);
+    Benchmark::sink += colorspace->getChannels();
+  }, 200);
+  printf("Rebuilding the colorspace: %.1f us, %.0f allocations\n", result.nanos/1000, result.allocations);
+}
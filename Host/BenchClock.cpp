@@ -0,0 +1,159 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// LampClock and the effects timed by it, run through 30 wraps of
+// micros(), about a day and a half, at ten frames a second. A fade
+// over 30 hours each way, a strobe, the cycler and the random
+// fader are checked every frame against what the virtual clock
+// says they should show, and the long fade against the fader's
+// old arithmetic, which divided whole microseconds and kept its
+// times in 32 bits. A cycler with no turn to make must hold its
+// hue. Then RenderScheduler keeping the clock through two wraps
+// with nothing to draw, and the cost of reading the clock.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "LEDs.h"
+#include "RenderScheduler.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#define clockWraps 30
+#define clockFrameMicros 100000
+#define wrapMicros 4294967296ULL
+
+static double hueError(double a, double b) {
+  double d = fabs(fmod(a - b, 360));
+  return d > 180 ? 360 - d : d;
+}
+
+// The fader's hue as it was worked out before LampClock: the time since
+// the start in a long, the fade length in an unsigned long, and the first
+// hue's share divided in whole numbers.
+static float oldFadeHue(HSIColor from, HSIColor to, uint32_t start, unsigned long delay) {
+  long time = micros() - start;
+  uint32_t delay32 = delay;
+  return from.getHue() * (1-time/delay32) + to.getHue()*time/delay32;
+}
+
+static boolean nothing(void) {
+  return false;
+}
+
+void benchClock(void) {
+  TeensyHost::reset();
+  // Start ten minutes before micros() first wraps.
+  TeensyHost::advanceMicros(wrapMicros - 600000000ULL);
+  LampClock::now();
+
+  const float fadeMillis = 30*3600e3;
+  HSIColor from(30, 1, 0.1), to(300, 0.5, 0.9);
+  HSIFader up(from, to, fadeMillis, 1), down(from, to, fadeMillis, 0);
+  HSIColor dark(0, 0, 0), light(0, 0, 1);
+  HSIStrober strober(light, dark, 777);
+  HSICycler cycler(HSIColor(0, 1, 1), 10000, 1);
+  RandomFader randomfader(4000);
+  for (int i=0; i<3; i++) randomfader.addLED(CIELED(0.2 + 0.1*i, 0.5, 1, 3 + i));
+  randomfader.startRandom(4000);
+  uint64_t start = TeensyHost::nanos()/1000;
+  uint32_t oldStart = micros();
+
+  unsigned long frames = 0, fadeWrong = 0, oldWrong = 0, strobeWrong = 0, randomWrong = 0;
+  double fadeWorst = 0, cycleWorst = 0, randomWorst = 0;
+  LampFrame frame;
+  while (TeensyHost::nanos()/1000 - start < clockWraps*wrapMicros) {
+    TeensyHost::advanceMicros(clockFrameMicros);
+    frames++;
+    uint64_t elapsed = TeensyHost::nanos()/1000 - start;
+
+    // Both fades, against the straight line from one color to the other.
+    double t = fmin(elapsed/(fadeMillis*1e3), 1);
+    HSIFader *faders[] = {&up, &down};
+    for (int f=0; f<2; f++) {
+      faders[f]->render(frame);
+      double hue = from.getHue() + t*(to.getHue() - (f ? 360 : 0) - from.getHue());
+      double error = fmax(hueError(hue, frame.color.getHue())/360,
+                          fmax(fabs(from.getSaturation() + t*(to.getSaturation() - from.getSaturation()) - frame.color.getSaturation()),
+                               fabs(from.getIntensity() + t*(to.getIntensity() - from.getIntensity()) - frame.color.getIntensity())));
+      fadeWorst = fmax(fadeWorst, error);
+      if (error > 1e-3) fadeWrong++;
+    }
+    if ((t < 1) && (hueError(from.getHue() + t*(to.getHue() - from.getHue()), oldFadeHue(from, to, oldStart, fadeMillis*1000))/360 > 1e-3)) {
+      oldWrong++;
+    }
+
+    // The strobe keeps time with the clock, half a period on and half off.
+    strober.render(frame);
+    boolean on = (elapsed % 777000) < 777000/2;
+    if (frame.color != (on ? light : dark)) strobeWrong++;
+
+    // The cycler turns the hue through 360 degrees every ten seconds.
+    cycler.render(frame);
+    cycleWorst = fmax(cycleWorst, hueError(fmod(elapsed*36e-6, 360), frame.color.getHue()));
+
+    // The random fader crosses from one LED to the next every four seconds.
+    randomfader.render(frame);
+    double p = (elapsed % 4000000)/4e6;
+    float high = 0, low = 0;
+    for (int i=0; i<frame.channels; i++) {
+      if (frame.levels[i] > high) {
+        low = high;
+        high = frame.levels[i];
+      }
+      else if (frame.levels[i] > low) low = frame.levels[i];
+    }
+    double error = fmax(fabs(high - fmax(p, 1 - p)), fabs(low - fmin(p, 1 - p)));
+    randomWorst = fmax(randomWorst, error);
+    if (error > 1e-3) randomWrong++;
+  }
+  printf("%lu frames, %d wraps of micros(), %.1f hours.\n", frames, clockWraps, (TeensyHost::nanos()/1000 - start)/3600e6);
+  printf("%-22s %10s %12s\n", "effect", "wrong", "worst");
+  printf("%-22s %10lu %12.2e %s\n", "30 hour fades", fadeWrong, fadeWorst, Benchmark::check(!fadeWrong));
+  printf("%-22s %10lu %12s\n", "old fader arithmetic", oldWrong, "");
+  printf("%-22s %10lu %12s %s\n", "strobe, 777 ms", strobeWrong, "", Benchmark::check(!strobeWrong));
+  printf("%-22s %10s %10.3f deg %s\n", "cycler, 10 s", "", cycleWorst, Benchmark::check(cycleWorst < 1));
+  printf("%-22s %10lu %12.2e %s\n", "random, 4 s", randomWrong, randomWorst, Benchmark::check(!randomWrong));
+
+  // A turn with no time or no direction is ignored, so a cycler given only
+  // those holds its color rather than going to NaN.
+  HSICycler held(HSIColor(90, 1, 1), 0, 1);
+  held.setCycler(HSIColor(180, 1, 1), 10, 7);
+  held.setCycler(HSIColor(270, 1, 1), -1, 0);
+  TeensyHost::advanceMicros(1000000);
+  held.render(frame);
+  printf("%-22s %10s %10.3f deg %s\n", "cycler, no turn", "", frame.color.getHue(), Benchmark::check(frame.color.getHue() == 90));
+
+  // With nothing drawn, as in DMX mode, the scheduler's frames alone keep
+  // the clock counting.
+  uint64_t offset = LampClock::now() - TeensyHost::nanos()/1000;
+  RenderScheduler scheduler(nothing);
+  scheduler.begin();
+  TeensyHost::advanceMicros(2*wrapMicros + 12345);
+  scheduler.end();
+  int64_t drift = LampClock::now() - TeensyHost::nanos()/1000 - offset;
+  printf("Two wraps of drawing nothing at %.0fHz: %lu frames, clock off by %lld us %s\n", scheduler.getRate(),
+         (unsigned long)scheduler.getFrames(), (long long)drift, Benchmark::check(!drift));
+
+  Benchmark::Result result = Benchmark::measure([&](unsigned long i) {
+    Benchmark::sink += LampClock::now();
+  }, 100000);
+  printf("LampClock::now(): %.1f ns %.1f cycles per read\n", result.nanos, result.cycles);
+}
@@ -0,0 +1,223 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// Every HSI conversion in the repository, run over the same
+// sweep of hue, saturation and intensity. Each is reported with
+// its cost per conversion, heap allocations per call, and the
+// largest difference from a double precision model of the same
+// algorithm, counted in LSBs of that path's own output. Every path
+// must be within one LSB of its model. The Multimode lamp's error
+// is read back from the duties it wrote to its pins.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "LegacyColor.h"
+#include "LEDs.h"
+#include "LZ7.h"
+#include "hsi2rgb.h"
+
+#include <stdio.h>
+
+using Benchmark::Result;
+using Benchmark::Sweep;
+
+static void printHeader(void) {
+  printf("%-36s %10s %10s %8s %10s\n", "conversion", "ns/conv", "cycles", "allocs", "max err");
+}
+
+static void printResult(const char *name, const Result &result, double maxerror, const char *unit) {
+  printf("%-36s %10.1f %10.0f %8.2f %6.0f %s %s\n", name, result.nanos, result.cycles, result.allocations, maxerror, unit,
+    Benchmark::check(maxerror <= 1));
+}
+
+static int quantize(double value, double fullscale) {
+  return (int)(fullscale * value);
+}
+
+// TeensyLED.h, evenly spaced R, G and B primaries at 0, 120 and 240.
+static void referenceRGBW(double H, double S, double I, int *duty) {
+  double rgbw[4];
+  H = fmod(H, 360);
+  int sector = H < 120 ? 0 : (H < 240 ? 1 : 2);
+  double h = M_PI*(H - 120*sector)/180;
+  double ratio = cos(h)/cos(M_PI/3 - h);
+  double a = S*I/3*(1 + ratio);
+  double b = S*I/3*(1 + (1 - ratio));
+  rgbw[sector] = a;
+  rgbw[(sector+1)%3] = b;
+  rgbw[(sector+2)%3] = 0;
+  rgbw[3] = (1-S)*I;
+  for (int i=0; i<4; i++) duty[i] = quantize(rgbw[i], 0xFFFF);
+}
+
+// Examples/TeensyLED_CIE, line intersection between fixed R, G and B.
+static void referenceCIE(double H, double S, double I, int *duty) {
+  const CIEConstants &c = cieConstants();
+  double rgbw[4] = {0, 0, 0, 1 - S};
+  H = fmod(fmod(H, 360) + c.RedBase + 360, 360);
+  double tanH = tan(M_PI*H/180);
+  double m, u1, v1, u2;
+  int LED1, LED2;
+  if ((H >= c.RedAngle) && (H < c.GreenAngle)) {
+    m = c.RGm; u1 = c.Red_ustar; u2 = c.Green_ustar; v1 = c.Red_vstar; LED1 = 0; LED2 = 1;
+  }
+  else if ((H >= c.GreenAngle) && (H < c.BlueAngle)) {
+    m = c.GBm; u1 = c.Green_ustar; u2 = c.Blue_ustar; v1 = c.Green_vstar; LED1 = 1; LED2 = 2;
+  }
+  else {
+    m = c.BRm; u1 = c.Blue_ustar; u2 = c.Red_ustar; v1 = c.Blue_vstar; LED1 = 2; LED2 = 0;
+  }
+  // Intersection of v = tanH*u with the line through LED1 of slope m.
+  double ustar = (v1 - m*u1)/(tanH - m);
+  rgbw[LED1] = S * fabs(ustar - u2)/fabs(u2 - u1);
+  rgbw[LED2] = S * fabs(ustar - u1)/fabs(u2 - u1);
+  const double scale[4] = {c.RedMax, c.GreenMax, c.BlueMax, c.WhiteMax};
+  for (int i=0; i<4; i++) duty[i] = quantize(rgbw[i]*I*scale[i], 0xFFFF);
+}
+
+// The Audio DMX Master's 8-bit RGB conversion.
+static void referenceRGB(double H, double S, double I, int *rgb) {
+  double out[3];
+  H = fmod(H, 360);
+  int sector = H < 120 ? 0 : (H < 240 ? 1 : 2);
+  double h = M_PI*(H - 120*sector)/180;
+  double ratio = cos(h)/cos(M_PI/3 - h);
+  out[sector] = 255*I/3*(1 + S*ratio);
+  out[(sector+1)%3] = 255*I/3*(1 + S*(1 - ratio));
+  out[(sector+2)%3] = 255*I/3*(1 - S);
+  for (int i=0; i<3; i++) rgb[i] = (int)out[i];
+}
+
+static int maxDifference(const int *a, const int *b, int n) {
+  int worst = 0;
+  for (int i=0; i<n; i++) worst = std::max(worst, abs(a[i] - b[i]));
+  return worst;
+}
+
+void benchColor(void) {
+  Sweep sweep;
+  unsigned long n = sweep.size();
+  printf("%lu conversions per sweep. Errors are against a double precision model.\n", n);
+  printHeader();
+
+  // TeensyLED.h
+  {
+    int duty[4], expected[4], worst = 0;
+    for (unsigned long i=0; i<n; i++) {
+      setColorRGBW(sweep.hue[i], sweep.saturation[i], sweep.intensity[i], duty);
+      referenceRGBW(sweep.hue[i], sweep.saturation[i], sweep.intensity[i], expected);
+      worst = std::max(worst, maxDifference(duty, expected, 4));
+    }
+    Result result = Benchmark::measure([&](unsigned long i) {
+      setColorRGBW(sweep.hue[i], sweep.saturation[i], sweep.intensity[i], duty);
+      Benchmark::sink += duty[0];
+    }, n);
+    printResult("TeensyLED.h RGBWLamp::setColor", result, worst, "LSB16");
+  }
+
+  // Examples/TeensyLED_CIE. This path prints a debug line over Serial
+  // on every call, and that cost is part of what it measures.
+  {
+    int duty[4], expected[4], worst = 0;
+    for (unsigned long i=0; i<n; i++) {
+      setColorCIE(sweep.hue[i], sweep.saturation[i], sweep.intensity[i], duty);
+      referenceCIE(sweep.hue[i], sweep.saturation[i], sweep.intensity[i], expected);
+      worst = std::max(worst, maxDifference(duty, expected, 4));
+    }
+    TeensyHost::clearSerialOutput();
+    Result result = Benchmark::measure([&](unsigned long i) {
+      setColorCIE(sweep.hue[i], sweep.saturation[i], sweep.intensity[i], duty);
+      Benchmark::sink += duty[0];
+      if (i == n - 1) TeensyHost::clearSerialOutput();
+    }, n);
+    printResult("TeensyLED_CIE RGBWLamp::setColor", result, worst, "LSB16");
+  }
+
+  // Examples/TeensyLED_CIE_USB_Multimode
+  {
+    LZ7 leds;
+    std::shared_ptr<Colorspace> colorspace = leds.colorspace();
+    ReferenceColorspace reference = leds.reference();
+    int channels = reference.size() + 1;
+
+    std::vector<HSIColor> colors;
+    for (unsigned long i=0; i<n; i++) colors.push_back(HSIColor(sweep.hue[i], sweep.saturation[i], sweep.intensity[i]));
+
+    double expected[16];
+    double worst = 0;
+    for (unsigned long i=0; i<n; i++) {
+      std::vector<float> out = colorspace->Hue2LEDs(colors[i]);
+      reference.hue2LEDs(sweep.hue[i], sweep.saturation[i], sweep.intensity[i], expected);
+      for (int j=0; j<channels; j++) worst = std::max(worst, fabs(out[j] - expected[j]) * 0xFFFF);
+    }
+    Result result = Benchmark::measure([&](unsigned long i) {
+      std::vector<float> out = colorspace->Hue2LEDs(colors[i]);
+      Benchmark::sink += out[0];
+    }, n);
+    printResult("Multimode Colorspace::Hue2LEDs", result, worst, "LSB16");
+
+    std::array<float, maxChannels> frame;
+    worst = 0;
+    for (unsigned long i=0; i<n; i++) {
+      colorspace->Hue2LEDs(colors[i], frame);
+      reference.hue2LEDs(sweep.hue[i], sweep.saturation[i], sweep.intensity[i], expected);
+      for (int j=0; j<channels; j++) worst = std::max(worst, fabs(frame[j] - expected[j]) * 0xFFFF);
+    }
+    result = Benchmark::measure([&](unsigned long i) {
+      colorspace->Hue2LEDs(colors[i], frame);
+      Benchmark::sink += frame[0];
+    }, n);
+    printResult("Multimode Hue2LEDs into std::array", result, worst, "LSB16");
+
+    RGBWLamp lamp(16, 183.106);
+    lamp.addColorspace(colorspace);
+    lamp.begin();
+    std::vector<int> pins = colorspace->getPins();
+    std::vector<float> maxvalues = colorspace->getMaxValues();
+    worst = 0;
+    for (unsigned long i=0; i<n; i++) {
+      lamp.setColor(colors[i]);
+      reference.hue2LEDs(sweep.hue[i], sweep.saturation[i], sweep.intensity[i], expected);
+      for (int j=0; j<channels; j++) {
+        int duty = quantize(expected[j]*maxvalues[j], 0xFFFF);
+        worst = std::max(worst, (double)abs(TeensyHost::pin(pins[j]).duty - duty));
+      }
+    }
+    result = Benchmark::measure([&](unsigned long i) {
+      lamp.setColor(colors[i]);
+    }, n);
+    printResult("Multimode RGBWLamp::setColor", result, worst, "LSB16");
+  }
+
+  // Examples/TeensyLED_Audio_DMX_Master
+  {
+    int rgb[3], expected[3], worst = 0;
+    for (unsigned long i=0; i<n; i++) {
+      hsi2rgb(sweep.hue[i], sweep.saturation[i], sweep.intensity[i], rgb);
+      referenceRGB(sweep.hue[i], sweep.saturation[i], sweep.intensity[i], expected);
+      worst = std::max(worst, maxDifference(rgb, expected, 3));
+    }
+    Result result = Benchmark::measure([&](unsigned long i) {
+      hsi2rgb(sweep.hue[i], sweep.saturation[i], sweep.intensity[i], rgb);
+      Benchmark::sink += rgb[0];
+    }, n);
+    printResult("Audio DMX Master hsi2rgb", result, worst, "LSB8");
+  }
+}
@@ -0,0 +1,273 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// CueSequencer played at the 183Hz PWM frequency through a three
+// hour show of a looping list of 64 random cues, across the 71
+// minute wrap of micros(). Every frame must be at exactly the
+// position the virtual clock says, in the cue a plain search of the
+// list says, and within 1e-3 of the color worked out from the cues
+// in double precision. Then the cost of a frame for lists of 2 and
+// 64 cues, a single cue against HSIFader, the list saved to EEPROM
+// and loaded back, and the cue commands as text and as frames.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "CueSequencer.h"
+#include "LampProtocol.h"
+#include "RenderScheduler.h"
+
+#include <EEPROM.h>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#define showHours 3
+
+static double wrap(double hue) {
+  hue = fmod(hue, 360);
+  return hue < 0 ? hue + 360 : hue;
+}
+
+static double hueError(double a, double b) {
+  double d = fabs(wrap(a) - wrap(b));
+  return d > 180 ? 360 - d : d;
+}
+
+// The list worked out again in double precision, and searched from the
+// start for every frame.
+struct Reference {
+  struct Segment {
+    double start, fade, end;
+    int easing;
+    double hue, saturation, intensity, huestep, saturationstep, intensitystep;
+  };
+  std::vector<Segment> segments;
+  double length;
+  bool loop;
+
+  Reference(CueSequencer &cues) : length(0), loop(cues.getLoop()) {
+    int count = cues.getCount();
+    Cue last = cues.getCue(count - 1);
+    double hue = last.color.getHue(), saturation = last.color.getSaturation(), intensity = last.color.getIntensity();
+    for (int i=0; i<count; i++) {
+      Cue cue = cues.getCue(i);
+      Segment segment;
+      segment.start = length*1000;
+      segment.fade = cue.fade*1000.0;
+      segment.end = (length + cue.fade + cue.hold)*1000.0;
+      segment.easing = cue.easing;
+      segment.hue = wrap(hue);
+      double step = wrap(cue.color.getHue()) - segment.hue;
+      if ((cue.direction == 1) && (step < 0)) step += 360;
+      if ((cue.direction == 0) && (step > 0)) step -= 360;
+      if (cue.direction == 2) step = 0;
+      segment.huestep = step;
+      segment.saturation = saturation;
+      segment.saturationstep = cue.color.getSaturation() - saturation;
+      segment.intensity = intensity;
+      segment.intensitystep = cue.color.getIntensity() - intensity;
+      segments.push_back(segment);
+      hue = segment.hue + step;
+      saturation = cue.color.getSaturation();
+      intensity = cue.color.getIntensity();
+      length += cue.fade + cue.hold;
+    }
+  }
+
+  // The cue playing and its color, micros after the start.
+  int at(double micros, double &hue, double &saturation, double &intensity) {
+    if (loop) micros = fmod(micros, length*1000);
+    else if (micros >= length*1000) micros = length*1000;
+    int cue = 0;
+    while ((cue < (int)segments.size() - 1) && (micros >= segments[cue].end)) cue++;
+    Segment &s = segments[cue];
+    double t = s.fade > 0 ? (micros - s.start)/s.fade : 1;
+    if (t > 1) t = 1;
+    switch (s.easing) {
+      case EaseIn: t = t*t; break;
+      case EaseOut: t = t*(2 - t); break;
+      case EaseInOut: t = t*t*(3 - 2*t); break;
+      case EaseStep: t = t < 1 ? 0 : 1; break;
+    }
+    hue = s.hue + t*s.huestep;
+    saturation = s.saturation + t*s.saturationstep;
+    intensity = s.intensity + t*s.intensitystep;
+    return cue;
+  }
+};
+
+static void randomCues(CueSequencer &cues, int count, bool loop) {
+  cues.clear(loop);
+  for (int i=0; i<count; i++) {
+    Cue cue;
+    cue.color.setHSI(random(3600)/10.0f, random(1001)/1000.0f, random(1001)/1000.0f);
+    // Some cues cut straight to their color, and some move straight on.
+    cue.fade = random(4) ? random(10000) : 0;
+    cue.hold = random(3) ? random(5000) : 0;
+    cue.easing = random(5);
+    cue.direction = random(3);
+    cues.addCue(cue);
+  }
+}
+
+void benchCues(void) {
+  CueSequencer cues;
+  randomSeed(18);
+  randomCues(cues, maxCues, true);
+  Reference reference(cues);
+  printf("%d cues, %.1f s a loop, played for %d hours at %.3fHz.\n", cues.getCount(), cues.getLength()/1000.0, showHours,
+         renderRateDefault);
+
+  // Frames at the PWM frequency, as RenderScheduler would call for them,
+  // starting just before micros() wraps for the first time.
+  TeensyHost::advanceMicros(4294967296ULL - 1800000000ULL);
+  cues.start();
+  uint64_t startnanos = TeensyHost::nanos();
+  double framenanos = 1e9/renderRateDefault;
+  unsigned long frames = 0, wrongPosition = 0, wrongCue = 0, wrongColor = 0, changes = 0;
+  double worst = 0;
+  int lastcue = -1;
+  LampFrame frame;
+  for (double t=0; t<showHours*3600e9; t+=framenanos) {
+    uint64_t target = startnanos + (uint64_t)t;
+    TeensyHost::advanceNanos(target - TeensyHost::nanos());
+    cues.render(frame);
+    frames++;
+    // micros() truncates the virtual clock, and so does the sequencer.
+    uint64_t elapsed = TeensyHost::nanos()/1000 - startnanos/1000;
+    uint64_t loopmicros = (uint64_t)cues.getLength()*1000;
+    if (cues.getPosition() != elapsed % loopmicros) wrongPosition++;
+    double hue, saturation, intensity;
+    int cue = reference.at(elapsed, hue, saturation, intensity);
+    if (cue != cues.getCurrent()) wrongCue++;
+    if (cue != lastcue) changes++;
+    lastcue = cue;
+    double error = fmax(hueError(hue, frame.color.getHue())/360, fmax(fabs(saturation - frame.color.getSaturation()),
+                        fabs(intensity - frame.color.getIntensity())));
+    if (error > worst) worst = error;
+    if (error > 1e-3) wrongColor++;
+  }
+  printf("%lu frames, %lu cue changes: %lu at the wrong position, %lu in the wrong cue, %lu off color (worst %.2e) %s\n",
+         frames, changes, wrongPosition, wrongCue, wrongColor, worst,
+         Benchmark::check(!(wrongPosition || wrongCue || wrongColor)));
+
+  // The cost of a frame should not grow with the list.
+  const int counts[] = {2, maxCues};
+  for (int c=0; c<2; c++) {
+    CueSequencer timed;
+    randomCues(timed, counts[c], true);
+    timed.start();
+    Benchmark::Result result = Benchmark::measure([&](unsigned long i) {
+      TeensyHost::advanceMicros(5461);
+      timed.render(frame);
+      Benchmark::sink += frame.color.getHue();
+    }, 1000);
+    printf("%2d cues: %6.1f ns %6.1f cycles %.2f allocations per frame\n", counts[c], result.nanos, result.cycles, result.allocations);
+  }
+
+  // One linear cue should fade as HSIFader does, for hues that go up.
+  {
+    double worstfade = 0;
+    const float hues[][2] = {{0, 120}, {30, 300}, {200, 200}};
+    for (int h=0; h<3; h++) {
+      for (int direction=0; direction<2; direction++) {
+        HSIColor from(hues[h][0], 1, 0.1), to(hues[h][1], 0.5, 0.9);
+        CueSequencer single;
+        single.clear(false);
+        // A cut to the first color, which must turn to its hue to get there.
+        Cue first = {from, 0, 0, EaseLinear, 1};
+        Cue second = {to, 5000, 0, EaseLinear, (uint8_t)direction};
+        single.addCue(first);
+        single.addCue(second);
+        single.start();
+        HSIFader fader(from, to, 5000, direction);
+        for (int i=0; i<=500; i++) {
+          single.render(frame);
+          HSIColor faded = fader.getHSIColor();
+          worstfade = fmax(worstfade, hueError(faded.getHue(), frame.color.getHue())/360);
+          worstfade = fmax(worstfade, fabs(faded.getSaturation() - frame.color.getSaturation()));
+          worstfade = fmax(worstfade, fabs(faded.getIntensity() - frame.color.getIntensity()));
+          TeensyHost::advanceMicros(10000);
+        }
+      }
+    }
+    printf("One cue against HSIFader: worst difference %.2e %s\n", worstfade, Benchmark::check(worstfade < 1e-3));
+  }
+
+  // Save, load, and save again, which should not need to write anything.
+  {
+    TeensyHost::eraseEEPROM();
+    unsigned long writes = TeensyHost::eepromWrites();
+    bool saved = cues.save();
+    unsigned long first = TeensyHost::eepromWrites() - writes;
+    CueSequencer loaded;
+    bool ok = saved && loaded.load() && (loaded.getCount() == cues.getCount()) && (loaded.getLoop() == cues.getLoop()) &&
+              (loaded.getLength() == cues.getLength());
+    double error = 0;
+    for (int i=0; ok && (i<cues.getCount()); i++) {
+      Cue a = cues.getCue(i), b = loaded.getCue(i);
+      if ((a.fade != b.fade) || (a.hold != b.hold) || (a.easing != b.easing) || (a.direction != b.direction)) ok = false;
+      error = fmax(error, hueError(a.color.getHue(), b.color.getHue())/360);
+      error = fmax(error, fabs(a.color.getSaturation() - b.color.getSaturation()));
+      error = fmax(error, fabs(a.color.getIntensity() - b.color.getIntensity()));
+    }
+    writes = TeensyHost::eepromWrites();
+    loaded.save();
+    unsigned long second = TeensyHost::eepromWrites() - writes;
+    EEPROM.write(100, EEPROM.read(100) ^ 0x01);
+    bool corrupt = loaded.load();
+    TeensyHost::eraseEEPROM();
+    bool empty = loaded.load();
+    printf("EEPROM: %d bytes, %lu written, %lu written saving again, colors within %.1e, corrupt list %s, empty EEPROM %s %s\n",
+           cueEEPROMSize, first, second, error, corrupt ? "loaded" : "refused", empty ? "loaded" : "refused",
+           Benchmark::check(ok && (error < 2e-5) && !corrupt && !empty));
+  }
+
+  int failures = 0;
+  LampCommand command;
+  if (!LampProtocol::parseLine("Cue 120 1 0.5 2000 500 3 1", command) || (command.opcode != LampCue) ||
+      (command.time != 2000) || (command.hold != 500) || (command.easing != 3) || (command.direction != 1)) failures++;
+  if (LampProtocol::parseLine("Cue 120 1 0.5 -1 500 3 1", command) || LampProtocol::parseLine("Cue 120 1 0.5 2000 500 3", command)) failures++;
+  if (!LampProtocol::parseLine("CueClear 0", command) || (command.opcode != LampCueClear) || (command.loop != 0)) failures++;
+  if (LampProtocol::parseLine("CueClear 2", command)) failures++;
+  if (!LampProtocol::parseLine("CueSave", command) || !LampProtocol::parseLine("CuePlay", command)) failures++;
+  LampProtocol protocol;
+  const uint8_t opcodes[] = {LampCueClear, LampCue, LampCueSave, LampCuePlay};
+  for (int i=0; i<4; i++) {
+    LampCommand sent;
+    sent.opcode = opcodes[i];
+    sent.loop = 1;
+    sent.color1 = HSIColor(90, 0.5, 0.25);
+    sent.time = 123456;
+    sent.hold = 7890;
+    sent.easing = EaseOut;
+    sent.direction = 0;
+    uint8_t bytes[lampMaxFrame];
+    int length = LampProtocol::encode(sent, bytes);
+    LampStatus status = LampNone;
+    for (int j=0; j<length; j++) status = protocol.feed(bytes[j]);
+    const LampCommand &got = protocol.getCommand();
+    if ((length == 0) || (status != LampCommandReady) || (got.opcode != sent.opcode)) failures++;
+    else if ((got.opcode == LampCueClear) && (got.loop != 1)) failures++;
+    else if ((got.opcode == LampCue) && ((got.time != sent.time) || (got.hold != sent.hold) || (got.easing != sent.easing) ||
+             (got.direction != 0) || (hueError(HSIColor(got.color1).getHue(), 90) > 0.01))) failures++;
+  }
+  printf("Cue commands as text and frames: %s\n", Benchmark::check(!failures));
+}
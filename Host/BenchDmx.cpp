@@ -0,0 +1,158 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// The Audio DMX Master's DMA transmitter on the mock UART. The
+// recorded line is split back into frames and checked against
+// DMX-512 timing: break of at least 92us, mark after break of at
+// least 12us, a zero start code, 44us slots, and at least 1204us
+// from break to break. Buffers are swapped part way through
+// frames, and every frame must carry entirely one buffer or the
+// other. The interrupt time per frame is what the transmitter
+// costs the CPU. A run passes with no errors, no mixed frames and
+// a frame for every buffer swap.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "DmxTransmitter.h"
+
+#include <stdio.h>
+
+using TeensyHost::LineEvent;
+
+struct Frame {
+  uint64_t breaknanos, marknanos, startnanos;
+  std::vector<uint8_t> slots;
+  bool evenslots;
+};
+
+// Splits the recorded line into frames, from one break to the next.
+static std::vector<Frame> splitFrames(const std::vector<LineEvent> &line) {
+  std::vector<Frame> frames;
+  for (unsigned int i=0; i<line.size(); i++) {
+    const LineEvent &event = line[i];
+    if (event.state == TeensyHost::LineBreak) {
+      Frame frame = {event.endnanos - event.startnanos, 0, event.startnanos, std::vector<uint8_t>(), true};
+      frames.push_back(frame);
+    }
+    else if (frames.empty()) continue;
+    else if (event.state == TeensyHost::LineMark) {
+      if (frames.back().slots.empty()) frames.back().marknanos += event.endnanos - event.startnanos;
+    }
+    else {
+      Frame &frame = frames.back();
+      if (event.endnanos - event.startnanos != DMXSlotMicros*1000) frame.evenslots = false;
+      if (!frame.slots.empty() && (event.startnanos != line[i-1].endnanos)) frame.evenslots = false;
+      frame.slots.push_back(event.value);
+    }
+  }
+  return frames;
+}
+
+static void fill(DmxTransmitter &dmx, uint8_t value) {
+  uint8_t *buffer = dmx.getBuffer();
+  for (int i=0; i<dmx.getChannels(); i++) buffer[i] = value + i;
+}
+
+// Runs the transmitter with buffer swaps for a while, recording the
+// line or not. Returns the number of frames sent.
+static unsigned long send(DmxTransmitter &dmx, int &swaps) {
+  dmx.begin();
+
+  // Swap in a new buffer every few milliseconds, at times that fall all
+  // over the frame.
+  const int updates = 200;
+  swaps = 0;
+  for (int i=0; i<updates; i++) {
+    if (!dmx.isSwapPending()) {
+      fill(dmx, i + 1);
+      dmx.swap();
+      swaps++;
+    }
+    TeensyHost::advanceMicros(3000 + 137*(i % 11));
+  }
+  // Let the last frame finish.
+  TeensyHost::advanceMicros(30000);
+  dmx.end();
+  return dmx.getFrameCount();
+}
+
+static void run(int channels) {
+  // Once without recording, for the transmitter's own cost.
+  TeensyHost::reset();
+  TeensyHost::recordLine(false);
+  int swaps;
+  DmxTransmitter timed(channels);
+  unsigned long sent = send(timed, swaps);
+  double cpu = (double)TeensyHost::interruptNanos() / sent;
+
+  TeensyHost::reset();
+  DmxTransmitter dmx(channels);
+  send(dmx, swaps);
+
+  std::vector<Frame> frames = splitFrames(TeensyHost::line());
+  // The last break has no frame after it.
+  if (!frames.empty() && frames.back().slots.empty()) frames.pop_back();
+
+  unsigned long errors = 0, mixed = 0;
+  uint64_t minbreak = ~0ULL, minmark = ~0ULL, minperiod = ~0ULL, maxperiod = 0;
+  int lastfill = 0, changes = 0;
+  for (unsigned int i=0; i<frames.size(); i++) {
+    const Frame &frame = frames[i];
+    minbreak = std::min(minbreak, frame.breaknanos);
+    minmark = std::min(minmark, frame.marknanos);
+    if (i > 0) {
+      uint64_t period = frame.startnanos - frames[i-1].startnanos;
+      minperiod = std::min(minperiod, period);
+      maxperiod = std::max(maxperiod, period);
+    }
+    if ((frame.breaknanos < 92000) || (frame.marknanos < 12000) || !frame.evenslots ||
+        (frame.slots.size() != (size_t)dmx.getChannels() + 1) || (frame.slots[0] != 0)) {
+      errors++;
+      continue;
+    }
+    // Every channel must come from the same buffer fill, or from none
+    // before the first swap.
+    int base = frame.slots[1];
+    for (int j=0; j<dmx.getChannels(); j++) {
+      if ((frame.slots[j+1] != (uint8_t)(base + j)) && (base || frame.slots[j+1])) {
+        mixed++;
+        break;
+      }
+    }
+    if (base != lastfill) changes++;
+    lastfill = base;
+  }
+
+  // DmxSimple holds the CPU for every bit of every slot.
+  double bitbang = (dmx.getChannels() + 1) * DMXSlotMicros;
+  printf("%8d %7lu %7lu %7lu %6.0f %6.0f %7.0f %7.0f %8d/%-4d %9.0f %10.0f %s\n", dmx.getChannels(),
+    (unsigned long)frames.size(), errors, mixed, minbreak/1000.0, minmark/1000.0, minperiod/1000.0, maxperiod/1000.0,
+    changes, swaps, cpu, bitbang, Benchmark::check(!frames.empty() && !errors && !mixed && (changes == swaps)));
+}
+
+void benchDmx(void) {
+  printf("Timing in us on the virtual clock. cpu is host ns in transmitter interrupts per frame;\n");
+  printf("bitbang is the us of CPU DmxSimple spends on the slots of the same frame on the Teensy.\n");
+  printf("%8s %7s %7s %7s %6s %6s %7s %7s %13s %9s %10s\n", "channels", "frames", "errors", "mixed",
+    "break", "mab", "minper", "maxper", "swaps seen", "cpu ns", "bitbang us");
+  run(24);
+  run(96);
+  run(512);
+}
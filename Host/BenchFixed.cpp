@@ -0,0 +1,152 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// ColorspaceTable, the colorspace the compiler works out, against the
+// Colorspace the same LEDs make at runtime: the LZ7 lamp of the Multimode
+// sketch, the LZC RGB set it has commented out, and the LZ7 at a coarse
+// table. Each pair is compared on LED order, angles and slopes, then on
+// the levels of every tenth of a degree of hue at every 10% of saturation
+// through the float path, interpolated and not, and the Q16 path. Then
+// what the fixed colorspace does when it is changed, and what each costs
+// at boot in time, heap and flash.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "ColorspaceTable.h"
+#include "LZ7.h"
+
+#include <math.h>
+#include <stdio.h>
+
+// The sketch's LEDs, as constant expressions.
+static constexpr CIELED white(0.202531646, 0.469936709, (float)180/180, 9);
+static constexpr CIELED red(0.5137017676, 0.5229440531, (float)78/78, 6);
+static constexpr CIELED amber(0.3135687079, 0.5529418124, (float)60/60, 5);
+static constexpr CIELED green(0.0595846867, 0.574988823, (float)125/125, 22);
+static constexpr CIELED cyan(0.0306675939, 0.5170937486, (float)95/95, 3);
+static constexpr CIELED blue(0.1747943747, 0.1117834986, (float)30/30, 23);
+static constexpr CIELED violet(0.35, 0.15, (float)30/30, 4);
+
+static constexpr ColorspaceTable<5, 360> lz7Table(white, red, amber, green, cyan, blue);
+static constexpr ColorspaceTable<3, 360> lzcTable(white, red, green, blue);
+static constexpr ColorspaceTable<5, 32> coarseTable(white, blue, cyan, green, amber, red);
+
+// The largest difference in levels between two colorspaces, by the float
+// path and the Q16 path in LSBs, and whether they have the same LEDs at
+// the same angles and slopes.
+struct Difference {
+  boolean same;
+  double levels, levelsQ16;
+};
+
+static Difference compare(Colorspace &a, Colorspace &b) {
+  Difference difference = {a.getPins() == b.getPins(), 0, 0};
+  for (int i=0; difference.same && (i<a.getChannels() - 1); i++) {
+    difference.same = (a.getAngle(i) == b.getAngle(i)) && (a.getSlope(i) == b.getSlope(i)) &&
+                      (a.getMaxValues()[i] == b.getMaxValues()[i]);
+  }
+  if (!difference.same) return difference;
+  for (int h=0; h<3600; h++) {
+    for (int s=0; s<=10; s++) {
+      HSIColor color(h/10.0f, s/10.0f, 1);
+      float x[maxChannels], y[maxChannels];
+      int channels = a.Hue2LEDs(color, x, maxChannels);
+      b.Hue2LEDs(color, y, maxChannels);
+      for (int i=0; i<channels; i++) difference.levels = fmax(difference.levels, fabs(x[i] - y[i]));
+      HSIColorQ16 colorQ16(color);
+      uint32_t p[maxChannels], q[maxChannels];
+      a.Hue2LEDs(colorQ16, p, maxChannels);
+      b.Hue2LEDs(colorQ16, q, maxChannels);
+      for (int i=0; i<channels; i++) difference.levelsQ16 = fmax(difference.levelsQ16, fabs((double)p[i] - q[i]));
+    }
+  }
+  return difference;
+}
+
+static boolean report(const char *name, Colorspace &fixed, Colorspace &runtime, double tolerance) {
+  Difference difference = compare(fixed, runtime);
+  boolean ok = difference.same && (difference.levels <= tolerance) && (difference.levelsQ16 <= 1);
+  printf("%-34s %-9s %12.2e %10.0f %s\n", name, difference.same ? "same" : "DIFFERENT", difference.levels, difference.levelsQ16,
+         Benchmark::check(ok));
+  return ok;
+}
+
+static std::shared_ptr<Colorspace> runtimeColorspace(CIELED white, std::vector<CIELED> &LEDs, int resolution) {
+  std::shared_ptr<Colorspace> colorspace(new Colorspace(white));
+  for (unsigned int i=0; i<LEDs.size(); i++) colorspace->addLED(LEDs[i]);
+  colorspace->finalize(resolution);
+  return colorspace;
+}
+
+void benchFixed(void) {
+  std::vector<CIELED> lz7 = {red, amber, green, cyan, blue}, lzc = {red, green, blue};
+  printf("%-34s %-9s %12s %10s\n", "Fixed against runtime", "LEDs", "levels", "Q16 LSB");
+  Colorspace fixedLZ7(lz7Table), fixedLZC(lzcTable), fixedCoarse(coarseTable);
+  std::shared_ptr<Colorspace> runtimeLZ7 = runtimeColorspace(white, lz7, 360), runtimeLZC = runtimeColorspace(white, lzc, 360);
+  std::shared_ptr<Colorspace> runtimeCoarse = runtimeColorspace(white, lz7, 32);
+  report("LZ7, 360 entries", fixedLZ7, *runtimeLZ7, 1e-6);
+  report("LZC RGB, 360 entries", fixedLZC, *runtimeLZC, 1e-6);
+  report("LZ7 added in reverse, 32 entries", fixedCoarse, *runtimeCoarse, 1e-6);
+  fixedLZ7.finalize(360, false);
+  runtimeLZ7->finalize(360, false);
+  report("LZ7, nearest entry", fixedLZ7, *runtimeLZ7, 1e-6);
+  fixedLZ7.finalize(360);
+  runtimeLZ7->finalize(360);
+
+  // Changed, it does what the runtime colorspace of the same LEDs does.
+  Colorspace flux(lz7Table);
+  flux.setMix(MixFlux);
+  std::shared_ptr<Colorspace> runtimeFlux = runtimeColorspace(white, lz7, 360);
+  runtimeFlux->setMix(MixFlux);
+  report("LZ7 with MixFlux", flux, *runtimeFlux, 1e-6);
+  Colorspace finer(lz7Table);
+  finer.finalize(720);
+  report("LZ7 finalized at 720 entries", finer, *runtimeColorspace(white, lz7, 720), 1e-6);
+  Colorspace added(lz7Table);
+  CIELED extra = violet;
+  added.addLED(extra);
+  std::vector<CIELED> six = lz7;
+  six.push_back(violet);
+  report("LZ7 with another LED added", added, *runtimeColorspace(white, six, 360), 1e-6);
+  Colorspace copy(*runtimeColorspace(white, lz7, 360));
+  report("A copy of a runtime colorspace", copy, *runtimeLZ7, 0);
+
+  // What each costs at boot.
+  Benchmark::Result runtime = Benchmark::measure([&](unsigned long i) {
+    std::shared_ptr<Colorspace> colorspace = runtimeColorspace(white, lz7, 360);
+    Benchmark::sink += colorspace->getChannels();
+  }, 200);
+  Benchmark::Result fixed = Benchmark::measure([&](unsigned long i) {
+    Colorspace colorspace(lz7Table);
+    Benchmark::sink += colorspace.getChannels();
+  }, 200);
+  // The heap each asks for, counting vectors that grow as LEDs are added.
+  unsigned long bytes = TeensyHost::allocatedBytes();
+  runtimeLZ7 = runtimeColorspace(white, lz7, 360);
+  unsigned long runtimeBytes = TeensyHost::allocatedBytes() - bytes;
+  bytes = TeensyHost::allocatedBytes();
+  Colorspace booted(lz7Table);
+  unsigned long fixedBytes = TeensyHost::allocatedBytes() - bytes;
+  printf("\n%-34s %10s %12s %10s %10s\n", "Building the LZ7 colorspace", "us", "allocations", "heap", "flash");
+  printf("%-34s %10.2f %12.0f %10lu %10s\n", "Colorspace, addLED and finalize", runtime.nanos/1000, runtime.allocations, runtimeBytes, "-");
+  printf("%-34s %10.2f %12.0f %10lu %10zu\n", "Colorspace(ColorspaceTable)", fixed.nanos/1000, fixed.allocations, fixedBytes,
+         sizeof(lz7Table));
+  printf("Fixed colorspace boots without the heap %s\n", Benchmark::check((fixed.allocations == 0) && (fixedBytes == 0)));
+}
@@ -0,0 +1,98 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// Cost and accuracy of the hue lookup table built by
+// Colorspace::finalize(), across table resolutions, with and
+// without interpolation. Errors are in 16-bit LSBs against both
+// the analytic float path the table replaces and the double
+// precision model. The analytic path must be within one LSB of the
+// model, and each table must come closer to it than the coarser
+// table of the same kind before it.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "LEDs.h"
+#include "LZ7.h"
+
+#include <stdio.h>
+
+using Benchmark::Result;
+using Benchmark::Sweep;
+
+void benchLUT(void) {
+  Sweep sweep(0.05);
+  unsigned long n = sweep.size();
+  LZ7 leds;
+  ReferenceColorspace reference = leds.reference();
+  std::shared_ptr<Colorspace> analytic = leds.colorspace();
+  int channels = analytic->getChannels();
+
+  std::vector<HSIColor> colors;
+  for (unsigned long i=0; i<n; i++) colors.push_back(HSIColor(sweep.hue[i], sweep.saturation[i], sweep.intensity[i]));
+
+  // The analytic path's own outputs and the reference, computed once.
+  std::vector<float> exact(n * channels);
+  std::vector<double> model(n * channels);
+  for (unsigned long i=0; i<n; i++) {
+    analytic->Hue2LEDs(colors[i], &exact[i*channels], channels);
+    reference.hue2LEDs(sweep.hue[i], sweep.saturation[i], sweep.intensity[i], &model[i*channels]);
+  }
+
+  std::array<float, maxChannels> frame;
+  Result result = Benchmark::measure([&](unsigned long i) {
+    analytic->Hue2LEDs(colors[i], frame);
+    Benchmark::sink += frame[0];
+  }, n);
+  double worst = 0;
+  for (unsigned long i=0; i<n*channels; i++) worst = std::max(worst, fabs(exact[i] - model[i]) * 0xFFFF);
+
+  printf("%lu conversions per sweep, %d channels. Errors in 16-bit LSBs.\n", n, channels);
+  printf("%-26s %8s %10s %10s %12s %12s\n", "path", "bytes", "ns/conv", "cycles", "vs analytic", "vs double");
+  printf("%-26s %8s %10.1f %10.0f %12s %12.2f %s\n", "analytic (tan + scan)", "-", result.nanos, result.cycles, "-", worst,
+    Benchmark::check(worst <= 1));
+
+  const int resolutions[] = {32, 64, 128, 256, 360, 720, 1024};
+  for (int interpolate=1; interpolate>=0; interpolate--) {
+    double coarser = 0xFFFF;
+    for (unsigned int r=0; r<sizeof(resolutions)/sizeof(resolutions[0]); r++) {
+      std::shared_ptr<Colorspace> table = leds.colorspace();
+      table->finalize(resolutions[r], interpolate);
+
+      double worstexact = 0, worstmodel = 0;
+      for (unsigned long i=0; i<n; i++) {
+        table->Hue2LEDs(colors[i], frame);
+        for (int j=0; j<channels; j++) {
+          worstexact = std::max(worstexact, fabs((double)frame[j] - exact[i*channels+j]) * 0xFFFF);
+          worstmodel = std::max(worstmodel, fabs(frame[j] - model[i*channels+j]) * 0xFFFF);
+        }
+      }
+      result = Benchmark::measure([&](unsigned long i) {
+        table->Hue2LEDs(colors[i], frame);
+        Benchmark::sink += frame[0];
+      }, n);
+
+      char name[64];
+      snprintf(name, sizeof(name), "table %d%s", resolutions[r], interpolate ? " lerp" : " nearest");
+      printf("%-26s %8lu %10.1f %10.0f %12.2f %12.2f %s\n", name, (resolutions[r] + 1) * sizeof(HueSegment), result.nanos, result.cycles, worstexact, worstmodel,
+        Benchmark::check(worstmodel < coarser));
+      coarser = worstmodel;
+    }
+  }
+}
@@ -0,0 +1,234 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// The Compositor's blend modes, checked channel by channel against
+// the lamp's own levels for two steady colors, and a single full
+// layer checked against drawing its effect straight to the lamp, and
+// the pin of a direct layer turned off when the layer is skipped.
+// Then the cost of a frame of one to four layers and the heap
+// allocations per frame, with the time the compositor measured for
+// each layer over a second of frames, and a show of a cycler with a
+// strobe over it and a master dimmer, drawn by RenderScheduler at the
+// 183Hz PWM frequency. Last, the Show, Layer and Master commands as
+// text and as frames.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "Compositor.h"
+#include "LZ7.h"
+#include "LampProtocol.h"
+#include "RenderScheduler.h"
+
+#include <math.h>
+#include <stdio.h>
+
+static const char *blendNames[] = {"add", "max", "multiply", "crossfade"};
+
+static EffectRegistry *drawn;
+static RGBWLamp *drawnLamp;
+
+static boolean renderShow(void) {
+  if (!drawn->render()) return false;
+  drawnLamp->setFrame(drawn->getFrame());
+  return true;
+}
+
+// Drives one pin off the lamp full on, as RandomFader drives its effect
+// LED.
+class PinEffect : public Effect {
+  private:
+    int _pin;
+  public:
+    PinEffect(int pin) : _pin(pin) {}
+    void render(LampFrame &frame) {
+      frame.direct = true;
+      frame.channels = 1;
+      frame.pins[0] = _pin;
+      frame.levels[0] = 1;
+    }
+};
+
+static float expected(BlendMode blend, float below, float layer, float opacity) {
+  switch (blend) {
+    case BlendAdd: return below + opacity*layer;
+    case BlendMax: return fmaxf(below, opacity*layer);
+    case BlendMultiply: return below*(1 - opacity + opacity*layer);
+    case BlendCrossfade: return below + opacity*(layer - below);
+  }
+  return 0;
+}
+
+void benchLayers(void) {
+  LZ7 lz7;
+  RGBWLamp lamp(16, 183.106);
+  std::shared_ptr<Colorspace> colorspace = lz7.colorspace();
+  colorspace->finalize(360);
+  lamp.addColorspace(colorspace);
+  lamp.begin();
+  int channels = lamp.getChannels();
+
+  // Each blend of a half intensity cyan over a red, at several opacities
+  // and master levels.
+  HSIColor red(0, 1, 0.8), cyan(180, 0.6, 0.5);
+  HSISteady base(red), top(cyan);
+  float below[maxChannels], above[maxChannels];
+  lamp.getLevels(red, below);
+  lamp.getLevels(cyan, above);
+  printf("%-10s %12s\n", "blend", "max error");
+  for (int b=BlendAdd; b<=BlendCrossfade; b++) {
+    float error = 0;
+    const float opacities[] = {0.25, 0.5, 1};
+    const float masters[] = {1, 0.5};
+    for (int o=0; o<3; o++) {
+      for (int m=0; m<2; m++) {
+        Compositor compositor(lamp);
+        compositor.addLayer(base, BlendCrossfade);
+        compositor.addLayer(top, (BlendMode)b, opacities[o]);
+        compositor.setMaster(masters[m]);
+        LampFrame frame;
+        compositor.render(frame);
+        if (!frame.direct || (frame.channels != channels)) error = 1;
+        for (int i=0; i<channels; i++) {
+          float want = masters[m]*expected((BlendMode)b, below[i], above[i], opacities[o]);
+          want = want>0?(want<1?want:1):0;
+          error = fmaxf(error, fabsf(frame.levels[i] - want));
+        }
+      }
+    }
+    printf("%-10s %12.2e %s\n", blendNames[b], error, Benchmark::check(error < 1e-6));
+  }
+
+  // A single full layer must light the lamp exactly as the effect would.
+  {
+    Compositor compositor(lamp);
+    compositor.addLayer(top, BlendCrossfade);
+    int mismatches = 0;
+    for (int h=0; h<360; h+=5) {
+      HSIColor color(h, 0.7, 0.6);
+      top.setColor(color);
+      lamp.setColor(color);
+      int duties[maxChannels];
+      for (int i=0; i<channels; i++) duties[i] = TeensyHost::pin(lamp.getPin(i)).duty;
+      LampFrame frame;
+      compositor.render(frame);
+      lamp.setFrame(frame);
+      for (int i=0; i<channels; i++) {
+        if (TeensyHost::pin(lamp.getPin(i)).duty != duties[i]) mismatches++;
+      }
+    }
+    printf("One full layer against setColor(): %d mismatched duties\n", mismatches);
+  }
+
+  // A direct layer's pin goes dark when the layer is skipped, and comes
+  // back when it is not.
+  {
+    PinEffect effectLED(lz7.violet.getPin());
+    Compositor compositor(lamp);
+    compositor.addLayer(top, BlendCrossfade);
+    compositor.addLayer(effectLED, BlendMax);
+    int duties[3];
+    const float opacities[] = {1, 0, 1};
+    for (int o=0; o<3; o++) {
+      compositor.setLayer(1, BlendMax, opacities[o]);
+      LampFrame frame;
+      compositor.render(frame);
+      lamp.setFrame(frame);
+      duties[o] = TeensyHost::pin(lz7.violet.getPin()).duty;
+    }
+    printf("Direct layer's pin at opacity 1, 0, 1: duty %d, %d, %d %s\n", duties[0], duties[1], duties[2],
+           Benchmark::check((duties[0] == 0xFFFF) && (duties[1] == 0) && (duties[2] == 0xFFFF)));
+  }
+
+  // Cost as layers are added: a cycler, a strobe added over it, a fade
+  // multiplied in, and the random fader at the top.
+  HSICycler cycler(HSIColor(0, 1, 1), 10000, 1);
+  HSIStrober strober(HSIColor(0, 0, 1), HSIColor(0, 0, 0), 100);
+  HSIFader fader(HSIColor(0, 0, 1), HSIColor(0, 0, 0.2), 60000, 2);
+  RandomFader randomfader(1000);
+  lz7.addTo(randomfader);
+  randomfader.startRandom(4000);
+  Effect *effects[] = {&cycler, &strober, &fader, &randomfader};
+  const BlendMode blends[] = {BlendCrossfade, BlendAdd, BlendMultiply, BlendMax};
+  printf("\n%-7s %10s %10s %8s   %s\n", "layers", "ns/frame", "cycles", "allocs", "per layer avg/max us (host)");
+  for (int n=1; n<=maxLayers; n++) {
+    Compositor compositor(lamp);
+    for (int l=0; l<n; l++) compositor.addLayer(*effects[l], blends[l], 0.8);
+    LampFrame frame;
+    Benchmark::Result result = Benchmark::measure([&](unsigned long i) {
+      compositor.render(frame);
+      Benchmark::sink += frame.levels[0];
+      TeensyHost::advanceMicros(100);
+    }, 1000);
+    compositor.resetStats();
+    for (int i=0; i<10000; i++) {
+      compositor.render(frame);
+      TeensyHost::advanceMicros(100);
+    }
+    printf("%-7d %10.1f %10.0f %8.2f  ", n, result.nanos, result.cycles, result.allocations);
+    for (int l=0; l<n; l++) printf(" %.2f/%.2f", compositor.getLayerAvgMicros(l), compositor.getLayerMaxMicros(l));
+    printf("\n");
+  }
+
+  // And a show drawn at the PWM frequency.
+  Compositor show(lamp);
+  show.addLayer(cycler, BlendCrossfade);
+  show.addLayer(strober, BlendAdd, 0.5);
+  show.setMaster(0.8);
+  EffectRegistry registry;
+  registry.select(registry.add(show));
+  drawn = &registry;
+  drawnLamp = &lamp;
+  RenderScheduler scheduler(renderShow);
+  unsigned long allocations = TeensyHost::allocations();
+  scheduler.begin();
+  TeensyHost::advanceMicros(2000000);
+  scheduler.end();
+  printf("\nCycler and strobe show at %.0fHz for 2 s: %lu frames, %lu drawn, %lu overruns, %.2f/%.2f/%.2f us min/avg/max, %lu allocations\n",
+         scheduler.getRate(), (unsigned long)scheduler.getFrames(), (unsigned long)scheduler.getRendered(),
+         (unsigned long)scheduler.getOverruns(), scheduler.getMinMicros(), scheduler.getAvgMicros(), scheduler.getMaxMicros(),
+         TeensyHost::allocations() - allocations);
+  printf("Frame budget %.0fus.\n", 1e6/renderRateDefault);
+
+  int failures = 0;
+  LampCommand command;
+  if (!LampProtocol::parseLine("Show", command) || (command.opcode != LampShow)) failures++;
+  if (!LampProtocol::parseLine("Layer 1 3 0.25", command) || (command.layer != 1) || (command.blend != BlendCrossfade) || (command.level != 0.25f)) failures++;
+  if (LampProtocol::parseLine("Layer 1 0 1.5", command) || LampProtocol::parseLine("Layer 1 0", command)) failures++;
+  if (!LampProtocol::parseLine("Master 0.5", command) || (command.opcode != LampMaster) || (command.level != 0.5f)) failures++;
+  if (LampProtocol::parseLine("Master -1", command)) failures++;
+  LampProtocol protocol;
+  const uint8_t opcodes[] = {LampShow, LampLayer, LampMaster};
+  for (int i=0; i<3; i++) {
+    LampCommand sent;
+    sent.opcode = opcodes[i];
+    sent.layer = 2;
+    sent.blend = BlendMultiply;
+    sent.level = 0.75;
+    uint8_t frame[lampMaxFrame];
+    int length = LampProtocol::encode(sent, frame);
+    LampStatus status = LampNone;
+    for (int j=0; j<length; j++) status = protocol.feed(frame[j]);
+    const LampCommand &got = protocol.getCommand();
+    if ((length == 0) || (status != LampCommandReady) || (got.opcode != sent.opcode)) failures++;
+    else if ((got.opcode == LampLayer) && ((got.layer != 2) || (got.blend != BlendMultiply) || (fabsf(got.level - 0.75f) > 1.0f/65535))) failures++;
+    else if ((got.opcode == LampMaster) && (fabsf(got.level - 0.75f) > 1.0f/65535)) failures++;
+  }
+  printf("Show, Layer and Master as text and frames: %s\n", Benchmark::check(!failures));
+}
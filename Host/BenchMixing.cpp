@@ -0,0 +1,148 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// Colorspace's mixing modes on the LZ7 colorspace. For every whole
+// degree of hue and every 5% of saturation at full intensity, the
+// light MixFlux gets out of the lamp and the power per unit of light
+// MixEfficient spends, each against MixPair for the same color, with
+// how far each mix's chromaticity lands from MixPair's and how many
+// LEDs it lights. Every mix must land within 1e-4 u'v' with no channel
+// past full. Light is counted in the colorspace's own units, one per
+// LED at full, and power by each LED's getPower(), here an
+// illustrative set since the LZ7 figures are not in the library.
+// Then the cost of a conversion and of building the mixing table.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "LZ7.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+
+static const char *mixNames[] = {"MixPair", "MixFlux", "MixEfficient"};
+
+// How far from MixPair's chromaticity any mix may land, in u'v', a tenth
+// of the smallest difference an eye can see side by side.
+#define mixingLimit 1e-4
+
+struct Mixed {
+  double light, power, u, v;
+  int lit;
+  float peak;
+};
+
+static Mixed mixed(const float *levels, int channels, CIELED *LEDs) {
+  Mixed mix = {0, 0, 0, 0, 0, 0};
+  for (int i=0; i<channels; i++) {
+    mix.light += levels[i];
+    mix.power += levels[i]*LEDs[i].getPower();
+    mix.u += levels[i]*LEDs[i].getU();
+    mix.v += levels[i]*LEDs[i].getV();
+    if (levels[i] > 1e-3f) mix.lit++;
+    if (levels[i] > mix.peak) mix.peak = levels[i];
+  }
+  if (mix.light > 0) {
+    mix.u /= mix.light;
+    mix.v /= mix.light;
+  }
+  return mix;
+}
+
+void benchMixing(void) {
+  LZ7 lz7;
+  // Relative power per unit of light, for illustration.
+  CIELED white(lz7.white.getU(), lz7.white.getV(), 1, lz7.white.getPin(), 1.0);
+  CIELED red(lz7.red.getU(), lz7.red.getV(), 1, lz7.red.getPin(), 1.8);
+  CIELED amber(lz7.amber.getU(), lz7.amber.getV(), 1, lz7.amber.getPin(), 2.6);
+  CIELED green(lz7.green.getU(), lz7.green.getV(), 1, lz7.green.getPin(), 1.5);
+  CIELED cyan(lz7.cyan.getU(), lz7.cyan.getV(), 1, lz7.cyan.getPin(), 1.7);
+  CIELED blue(lz7.blue.getU(), lz7.blue.getV(), 1, lz7.blue.getPin(), 2.2);
+  Colorspace colorspaces[] = {Colorspace(white), Colorspace(white), Colorspace(white)};
+  double build[3];
+  for (int m=MixPair; m<=MixEfficient; m++) {
+    colorspaces[m].addLED(red);
+    colorspaces[m].addLED(amber);
+    colorspaces[m].addLED(green);
+    colorspaces[m].addLED(cyan);
+    colorspaces[m].addLED(blue);
+    colorspaces[m].setMix((MixMode)m);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    colorspaces[m].finalize(360);
+    build[m] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+  int channels = colorspaces[0].getChannels();
+  // The channels in Hue2LEDs() order: the LEDs by angle, then white.
+  CIELED LEDs[maxChannels];
+  CIELED *all[] = {&red, &amber, &green, &cyan, &blue};
+  for (int i=0; i<channels - 1; i++) {
+    for (int j=0; j<5; j++) {
+      if (all[j]->getPin() == colorspaces[0].getPins()[i]) LEDs[i] = *all[j];
+    }
+  }
+  LEDs[channels - 1] = white;
+
+  printf("%d channels. Against MixPair at every degree and 5%% of saturation, intensity 1:\n", channels);
+  printf("%-13s %9s %9s %9s %11s %11s %11s %7s %8s\n", "mode", "light", "min", "max", "power/light", "max du'v'", "mean du'v'",
+         "lit", "peak");
+  for (int m=MixPair; m<=MixEfficient; m++) {
+    double light = 0, lightMin = 1e9, lightMax = 0, ratio = 0, worst = 0, error = 0, lit = 0;
+    float peak = 0;
+    int count = 0;
+    for (int h=0; h<360; h++) {
+      for (int s=0; s<=20; s++) {
+        HSIColor color(h, s/20.0f, 1);
+        float pair[maxChannels], levels[maxChannels];
+        colorspaces[MixPair].Hue2LEDs(color, pair, maxChannels);
+        colorspaces[m].Hue2LEDs(color, levels, maxChannels);
+        Mixed a = mixed(pair, channels, LEDs), b = mixed(levels, channels, LEDs);
+        double gain = b.light/a.light;
+        light += gain;
+        lightMin = fmin(lightMin, gain);
+        lightMax = fmax(lightMax, gain);
+        ratio += (b.power/b.light)/(a.power/a.light);
+        double distance = hypot(b.u - a.u, b.v - a.v);
+        worst = fmax(worst, distance);
+        error += distance;
+        lit += b.lit;
+        peak = fmaxf(peak, b.peak);
+        count++;
+      }
+    }
+    printf("%-13s %9.3f %9.3f %9.3f %11.3f %11.6f %11.6f %7.2f %8.3f %s\n", mixNames[m], light/count, lightMin, lightMax, ratio/count,
+           worst, error/count, lit/count, peak, Benchmark::check((peak <= 1.0001f) && (worst <= mixingLimit)));
+  }
+
+  printf("\n%-13s %12s %12s %14s\n", "mode", "ns/color", "cycles", "table build ms");
+  for (int m=MixPair; m<=MixEfficient; m++) {
+    float levels[maxChannels];
+    Benchmark::Result result = Benchmark::measure([&](unsigned long i) {
+      HSIColor color((i*37) % 360, ((i*7) % 100)/100.0f, 0.8);
+      colorspaces[m].Hue2LEDs(color, levels, maxChannels);
+      Benchmark::sink += levels[0];
+    }, 100000);
+    printf("%-13s %12.1f %12.1f %14.2f\n", mixNames[m], result.nanos, result.cycles, build[m]);
+  }
+  // One row for each step of hue and each LED angle, and the first again
+  // at 360, each with its point on the gamut edge.
+  int rows = mixHues + channels;
+  printf("Mixing table: %d hues x %d saturations, %d bytes.\n", rows, mixSaturations + 1,
+         (int)(rows*((mixSaturations + 1)*(channels*sizeof(uint16_t) + sizeof(float)) + 2*sizeof(float))));
+}
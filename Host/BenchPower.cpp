@@ -0,0 +1,176 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// RGBWLamp's power model and budget on the LZ7 lamp, with the sketch's
+// figures: 700mA sinks dropping 3V, 2.1W each fully on, against a 4W
+// board and 4.4W for each BJT. Over a sweep of every 2 degrees of hue
+// and 10% of saturation at full intensity, each path is drawn with no
+// budget and with one, and the dissipation worked out from the duties
+// the pins show is checked against the budget and the lamp's estimate,
+// the color against the unlimited one, and the light kept against
+// derating every color by the worst one's overrun. Then a minute of
+// RandomFader with its effect LED, and the cost of a frame.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "LZ7.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#define powerSupply 12
+#define powerAmps 0.7f
+#define powerForward 9
+#define powerBudget 4
+#define powerChannelBudget 4.4f
+#define fullWatts (powerAmps*(powerSupply - powerForward))
+
+struct Shown {
+  double watts, light, u, v, peak;
+};
+
+// What the pins show: the sinks' dissipation from their duties, and the
+// light and its chromaticity, light following duty.
+static Shown shown(CIELED *LEDs, int count) {
+  Shown s = {0, 0, 0, 0, 0};
+  for (int i=0; i<count; i++) {
+    double duty = TeensyHost::pin(LEDs[i].getPin()).duty/65535.0;
+    double watts = duty*fullWatts;
+    s.watts += watts;
+    s.peak = fmax(s.peak, watts);
+    s.light += duty;
+    s.u += duty*LEDs[i].getU();
+    s.v += duty*LEDs[i].getV();
+  }
+  if (s.light > 0) {
+    s.u /= s.light;
+    s.v /= s.light;
+  }
+  return s;
+}
+
+static void setPower(RGBWLamp &lamp, int pin, float budget) {
+  lamp.setSupply(powerSupply);
+  lamp.setDrive(powerAmps, powerForward);
+  lamp.setPinDrive(pin, powerAmps, powerForward);
+  lamp.setPowerBudget(budget, budget ? powerChannelBudget : 0);
+}
+
+void benchPower(void) {
+  TeensyHost::reset();
+  LZ7 lz7;
+  CIELED LEDs[] = {lz7.white, lz7.red, lz7.amber, lz7.green, lz7.cyan, lz7.blue, lz7.violet};
+  const int numLEDs = sizeof(LEDs)/sizeof(LEDs[0]);
+  std::shared_ptr<Colorspace> pair = lz7.colorspace(), flux = lz7.colorspace();
+  pair->finalize(360);
+  flux->setMix(MixFlux);
+  flux->finalize(360);
+  OutputTransfer lstar(TransferLstar);
+
+  const char *paths[] = {"MixPair", "MixPair, CIE L*", "MixPair, Q16", "MixFlux"};
+  printf("%.1fW a sink fully on, budget %dW, %.1fW a sink. Every 2 degrees and 10%% of saturation, intensity 1:\n",
+         fullWatts, powerBudget, powerChannelBudget);
+  printf("%-16s %7s %9s %9s %9s %9s %11s %8s %8s\n", "path", "over", "max W", "limited", "sink W", "model W",
+         "max du'v'", "kept", "static");
+  for (int p=0; p<4; p++) {
+    RGBWLamp lamp(16, 183.106);
+    lamp.addColorspace(p == 3 ? flux : pair);
+    lamp.begin();
+    if (p == 1) lamp.setTransfer(&lstar);
+    int over = 0, count = 0;
+    double worst = 0, limitedWorst = 0, peakWorst = 0, modelError = 0, shift = 0, light = 0, unlimitedLight = 0;
+    for (int h=0; h<360; h+=2) {
+      for (int s=0; s<=10; s++) {
+        HSIColor color(h, s/10.0f, 1);
+        HSIColorQ16 fixed(color);
+        Shown frames[2];
+        for (int b=0; b<2; b++) {
+          setPower(lamp, lz7.violet.getPin(), b ? powerBudget : 0);
+          if (p == 2) lamp.setColor(fixed);
+          else lamp.setColor(color);
+          frames[b] = shown(LEDs, numLEDs);
+          if (b) modelError = fmax(modelError, fabs(lamp.getPower() - frames[b].watts));
+        }
+        if (frames[0].watts > powerBudget) over++;
+        worst = fmax(worst, frames[0].watts);
+        limitedWorst = fmax(limitedWorst, frames[1].watts);
+        peakWorst = fmax(peakWorst, frames[1].peak);
+        shift = fmax(shift, hypot(frames[1].u - frames[0].u, frames[1].v - frames[0].v));
+        light += frames[1].light;
+        unlimitedLight += frames[0].light;
+        count++;
+      }
+    }
+    // Derating statically means every color gives up what the worst one
+    // is over by.
+    double derate = worst > powerBudget ? powerBudget/worst : 1;
+    boolean ok = (limitedWorst <= powerBudget + 1e-3) && (peakWorst <= powerChannelBudget + 1e-3) && (shift < 1e-3);
+    printf("%-16s %6.1f%% %9.3f %9.3f %9.3f %9.5f %11.6f %8.3f %8.3f %s\n", paths[p], 100.0*over/count, worst, limitedWorst,
+           peakWorst, modelError, shift, light/unlimitedLight, derate, Benchmark::check(ok));
+  }
+
+  // RandomFader cross fades two LEDs at a total of one and turns the
+  // effect LED fully on a fifth of the time, 4.2W at worst.
+  RGBWLamp lamp(16, 183.106);
+  lamp.addColorspace(pair);
+  lamp.begin();
+  RandomFader randomfader(2000);
+  lz7.addTo(randomfader);
+  randomfader.startRandom(2000);
+  printf("\n%-16s %8s %9s %9s %9s\n", "RandomFader, 60s", "frames", "over", "max W", "min scale");
+  for (int b=0; b<2; b++) {
+    setPower(lamp, lz7.violet.getPin(), b ? powerBudget : 0);
+    randomSeed(1);
+    randomfader.startRandom(2000);
+    int frames = 0, over = 0;
+    double worst = 0, scale = 1;
+    LampFrame frame;
+    for (int f=0; f<600; f++) {
+      TeensyHost::advanceMicros(100000);
+      randomfader.render(frame);
+      lamp.setFrame(frame);
+      Shown s = shown(LEDs, numLEDs);
+      if (s.watts > powerBudget + 1e-3) over++;
+      worst = fmax(worst, s.watts);
+      scale = fmin(scale, lamp.getPowerScale());
+      frames++;
+    }
+    printf("%-16s %8d %9d %9.3f %9.3f %s\n", b ? "budget 4W" : "no budget", frames, over, worst, scale,
+           Benchmark::check(!(b && over)));
+  }
+
+  printf("\n%-24s %10s %10s\n", "setColor()", "ns/frame", "cycles");
+  const char *costs[] = {"no model", "model, no budget", "model and budget", "Q16, model and budget"};
+  for (int c=0; c<4; c++) {
+    RGBWLamp costed(16, 183.106);
+    costed.addColorspace(pair);
+    costed.begin();
+    if (c) setPower(costed, lz7.violet.getPin(), c >= 2 ? powerBudget : 0);
+    Benchmark::Result result = Benchmark::measure([&](unsigned long i) {
+      HSIColor color((i*37) % 360, ((i*7) % 100)/100.0f, 1);
+      if (c == 3) {
+        HSIColorQ16 fixed(color);
+        costed.setColor(fixed);
+      }
+      else costed.setColor(color);
+    }, 100000);
+    printf("%-24s %10.1f %10.1f\n", costs[c], result.nanos, result.cycles);
+  }
+}
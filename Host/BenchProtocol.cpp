@@ -0,0 +1,271 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// The Multimode sketch's serial commands: as text through the old
+// String parser and through LampProtocol::parseLine(), and as
+// LampProtocol binary frames. Every form of each command must decode
+// to the same thing, and the old and new text parsers must accept and
+// reject the same lines. Every single bit error in a frame must be
+// rejected, and the stream must pick up again at the next command. A
+// cycle with no period or no direction must be rejected as text.
+// Then each is timed for commands per second and heap allocations
+// per command.
+//
+// Last, a model of loop() runs a 20Hz strobe, 100us a pass, while a
+// command arrives a byte at a time, and the longest gap between
+// passes and the latest strobe edge are given for each way of
+// reading commands.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "LampProtocol.h"
+#include "LegacyCommand.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+
+static LampCommand make(uint8_t opcode, HSIColor color1, HSIColor color2, uint32_t time, int8_t direction, uint16_t address = 0, uint8_t personality = 0) {
+  LampCommand command;
+  command.opcode = opcode;
+  command.color1 = color1;
+  command.color2 = color2;
+  command.time = time;
+  command.period = time;
+  command.direction = direction;
+  command.effect = 0;
+  command.address = address;
+  command.personality = personality;
+  return command;
+}
+
+struct Sample {
+  const char *text;
+  LampCommand command;
+};
+
+static bool sameColor(HSIColor a, HSIColor b) {
+  float dh = fabsf(a.getHue() - b.getHue());
+  if (dh > 180) dh = 360 - dh;
+  return (dh <= 360.0f/65536) && (fabsf(a.getSaturation() - b.getSaturation()) <= 1.0f/65535) &&
+         (fabsf(a.getIntensity() - b.getIntensity()) <= 1.0f/65535);
+}
+
+static bool same(const LampCommand &a, const LampCommand &b) {
+  if (a.opcode != b.opcode) return false;
+  switch (a.opcode) {
+    case LampHSI: return sameColor(a.color1, b.color1);
+    case LampStrobe: return sameColor(a.color1, b.color1) && sameColor(a.color2, b.color2) && (a.time == b.time);
+    case LampFade: return sameColor(a.color1, b.color1) && sameColor(a.color2, b.color2) && (a.time == b.time) && (a.direction == b.direction);
+    case LampCycle: return (a.period == b.period) && (a.direction == b.direction);
+    case LampDMX: return (a.address == b.address) && (a.personality == b.personality);
+    default: return true;
+  }
+}
+
+// Runs loop() passes of 100us with a 20Hz strobe, reading commands with
+// readCommands(), while line comes in a byte every bytemicros starting
+// 1ms before a strobe edge. Gives the longest pass and how late the
+// latest strobe edge was drawn.
+#define loopMicros 100
+#define strobeMicros 25000
+
+template <typename F> static void runLoop(const char *line, double bytemicros, F readCommands, double &gap, double &late) {
+  TeensyHost::reset();
+  uint64_t start = (strobeMicros - 1000)*1000;
+  uint64_t end = start + (uint64_t)(strlen(line)*bytemicros*1000) + 100000000;
+  uint64_t last = 0, edge = 0;
+  bool sent = false;
+  gap = late = 0;
+  while (TeensyHost::nanos() < end) {
+    if (!sent && (TeensyHost::nanos() >= start)) {
+      TeensyHost::serialInput(std::string(line), (uint64_t)(bytemicros*1000));
+      sent = true;
+    }
+    readCommands();
+    TeensyHost::advanceMicros(loopMicros);
+    uint64_t now = TeensyHost::nanos();
+    gap = std::max(gap, (now - last)/1e6);
+    last = now;
+    while (edge <= now) {
+      late = std::max(late, (now - edge)/1e6);
+      edge += strobeMicros*1000;
+    }
+  }
+}
+
+void benchProtocol(void) {
+  const Sample samples[] = {
+    {"HSI 200 0.8 0.5", make(LampHSI, HSIColor(200, 0.8, 0.5), HSIColor(), 0, 0)},
+    {"Strobe 0 1 1 180 1 0.2 250", make(LampStrobe, HSIColor(0, 1, 1), HSIColor(180, 1, 0.2), 250, 0)},
+    {"Fade 0 1 0 240 0.5 1 2000 1", make(LampFade, HSIColor(0, 1, 0), HSIColor(240, 0.5, 1), 2000, 1)},
+    {"Cycler 1000 1", make(LampCycle, HSIColor(), HSIColor(), 1000, 1)},
+    {"DMX 1 1", make(LampDMX, HSIColor(), HSIColor(), 0, 0, 1, DMXHSI16)},
+    {"Random", make(LampRandom, HSIColor(), HSIColor(), 0, 0)},
+  };
+  const int numSamples = sizeof(samples)/sizeof(samples[0]);
+
+  std::string text, binary;
+  uint8_t frame[lampMaxFrame];
+  int mismatched = 0;
+  LampProtocol protocol;
+  for (int i=0; i<numSamples; i++) {
+    text += samples[i].text;
+    text += '\r';
+    int length = LampProtocol::encode(samples[i].command, frame);
+    binary.append((const char *)frame, length);
+    
+    LampCommand legacy, parsed;
+    if (!legacyCommand(String(samples[i].text), legacy) || !same(legacy, samples[i].command)) mismatched++;
+    if (!LampProtocol::parseLine(samples[i].text, parsed) || !same(parsed, samples[i].command)) mismatched++;
+    LampStatus status = LampNone;
+    for (int j=0; j<length; j++) status = protocol.feed(frame[j]);
+    if ((status != LampCommandReady) || !same(protocol.getCommand(), samples[i].command)) mismatched++;
+  }
+  printf("%d commands, old text, new text and binary decoded the same %s\n", numSamples, Benchmark::check(mismatched == 0));
+
+  // Lines both text parsers must agree on.
+  const char *edges[] = {
+    "HSI 1 2", "HSI 1 2 3 4", "HSI a 0.5 0.5", "HSI -30 0.5 .5", "HSI 1. 2 3", "HSI 10 0.5 0.5 ",
+    "Strobe 0 1 1 180 1 0.2 0", "Strobe 0 1 1 180 1 0.2 0.5", "Fade 0 1 1 180 1 0.2 100 -1",
+    "Fade 0 1 1 180 1 0.2 100 1.5", "Cycler 0.5 1", "Cycler x 1", "Effect 1", "Effect 2",
+    "Effect -1", "DMX 1", "DMX 12 2", "Hello", "",
+  };
+  const int numEdges = sizeof(edges)/sizeof(edges[0]);
+  int disagreed = 0;
+  for (int i=0; i<numEdges; i++) {
+    LampCommand legacy, parsed;
+    boolean a = legacyCommand(String(edges[i]), legacy);
+    boolean b = LampProtocol::parseLine(edges[i], parsed);
+    if ((a != b) || (a && !same(legacy, parsed))) {
+      printf("  \"%s\": old %s, new %s\n", edges[i], a ? "OK" : "ERROR", b ? "OK" : "ERROR");
+      disagreed++;
+    }
+  }
+  printf("%d other lines, old and new text parsers agreed on %d %s\n", numEdges, numEdges - disagreed, Benchmark::check(disagreed == 0));
+
+  // Cycles the old parser passed on and setCycler() could not turn: no
+  // time to turn in, or no direction to turn.
+  const char *cycles[] = {"Cycler 0 1", "Cycler 0.0 0", "Cycler -5 1", "Cycler 500 -1", "Cycler 10 7", "Cycler 10 2"};
+  const int numCycles = sizeof(cycles)/sizeof(cycles[0]);
+  int rejected = 0;
+  for (int i=0; i<numCycles; i++) {
+    LampCommand parsed;
+    if (!LampProtocol::parseLine(cycles[i], parsed) && (parsed.opcode == LampCycle)) rejected++;
+  }
+  printf("%d cycles with no period or direction, new text parser rejected %d %s\n", numCycles, rejected,
+         Benchmark::check(rejected == numCycles));
+  printf("Bytes for all of them: %d as text, %d as frames\n", (int)text.size(), (int)binary.size());
+
+  // Flip every bit of every frame in turn, each followed by a good frame
+  // and a text command.
+  unsigned long flips = 0, accepted = 0, recovered = 0;
+  for (int i=0; i<numSamples; i++) {
+    int length = LampProtocol::encode(samples[i].command, frame);
+    for (int bit=0; bit<length*8; bit++) {
+      uint8_t corrupt[lampMaxFrame];
+      memcpy(corrupt, frame, length);
+      corrupt[bit/8] ^= 1 << (bit%8);
+      LampProtocol stream;
+      for (int j=0; j<length; j++) {
+        if (stream.feed(corrupt[j]) == LampCommandReady) accepted++;
+      }
+      // A long corrupted length can swallow what follows, as can a sync
+      // byte corrupted into text until the next carriage return, so send
+      // a line end and then the two commands that should get through.
+      stream.feed('\r');
+      uint8_t good[lampMaxFrame];
+      int goodlength = LampProtocol::encode(samples[0].command, good);
+      for (int k=0; k<3; k++) {
+        bool gotframe = false, gotline = false;
+        for (int j=0; j<goodlength; j++) gotframe |= (stream.feed(good[j]) == LampCommandReady);
+        const char *line = "Random\r";
+        for (int j=0; line[j]; j++) gotline |= (stream.feed(line[j]) == LampLineReady) && !strcmp(stream.getLine(), "Random");
+        if (gotframe && gotline) {
+          recovered++;
+          break;
+        }
+      }
+      flips++;
+    }
+  }
+  printf("Single bit errors: %lu, accepted as commands %lu, stream recovered within 3 commands %lu %s\n\n", flips, accepted, recovered,
+         Benchmark::check((accepted == 0) && (recovered == flips)));
+
+  unsigned long calls = 1000;
+  LampCommand command;
+  Benchmark::Result legacy = Benchmark::measure([&](unsigned long i) {
+    const Sample &sample = samples[i % numSamples];
+    TeensyHost::serialInput(sample.text);
+    TeensyHost::serialInput("\r");
+    Benchmark::sink = legacyCommand(Serial.readStringUntil(0x0D), command);
+  }, calls);
+
+  LampProtocol split;
+  Benchmark::Result lines = Benchmark::measure([&](unsigned long i) {
+    const char *sample = samples[i % numSamples].text;
+    for (int j=0; sample[j]; j++) split.feed(sample[j]);
+    if (split.feed('\r') == LampLineReady) Benchmark::sink = LampProtocol::parseLine(split.getLine(), command);
+  }, calls);
+
+  std::vector<std::string> frames;
+  for (int i=0; i<numSamples; i++) frames.push_back(std::string((const char *)frame, LampProtocol::encode(samples[i].command, frame)));
+  LampProtocol parser;
+  Benchmark::Result framed = Benchmark::measure([&](unsigned long i) {
+    const std::string &f = frames[i % numSamples];
+    LampStatus status = LampNone;
+    for (unsigned int j=0; j<f.size(); j++) status = parser.feed(f[j]);
+    if (status == LampCommandReady) Benchmark::sink = parser.getCommand().opcode;
+  }, calls);
+
+  printf("%-32s %12s %12s %14s\n", "per command", "ns", "commands/s", "allocations");
+  printf("%-32s %12.0f %12.0f %14.1f\n", "text, readStringUntil + String", legacy.nanos, 1e9/legacy.nanos, legacy.allocations);
+  printf("%-32s %12.0f %12.0f %14.1f\n", "text, LampProtocol + parseLine", lines.nanos, 1e9/lines.nanos, lines.allocations);
+  printf("%-32s %12.0f %12.0f %14.1f\n", "binary, LampProtocol", framed.nanos, 1e9/framed.nanos, framed.allocations);
+
+  // A strobe command arriving over serial while the loop renders. Typed
+  // is a terminal sending each key as it is pressed.
+  struct Pace {
+    const char *name;
+    double bytemicros;
+  };
+  const Pace paces[] = {{"one USB packet", 0}, {"115200 baud", 86.8}, {"typed, 8/s", 125000}};
+  const char *line = "Strobe 0 1 1 180 1 0.2 50\r";
+  printf("\nloop() while \"Strobe ...\" arrives    %14s %14s\n", "longest pass", "latest edge");
+  for (unsigned int k=0; k<sizeof(paces)/sizeof(paces[0]); k++) {
+    for (int reader=0; reader<2; reader++) {
+      LampProtocol stream;
+      double gap, late;
+      runLoop(line, paces[k].bytemicros, [&](void) {
+        if (reader == 0) {
+          if (Serial.available()) legacyCommand(Serial.readStringUntil(0x0D), command);
+        }
+        else {
+          while (Serial.available()) {
+            if (stream.feed(Serial.read()) == LampLineReady) LampProtocol::parseLine(stream.getLine(), command);
+          }
+        }
+      }, gap, late);
+      printf("  %-14s %-18s %11.2f ms %11.2f ms\n", paces[k].name, reader ? "LampProtocol" : "readStringUntil", gap, late);
+    }
+  }
+}
@@ -0,0 +1,89 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// The Q16 integer render path against the float path it stands
+// in for. Both lamps run at the sketch's 16-bit resolution, every
+// one of the 65536 hue codes is rendered at a grid of saturations
+// and intensities, and the duties written to each pin are
+// compared, and may be out by no more than one LSB.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "LEDs.h"
+#include "LZ7.h"
+
+#include <stdio.h>
+
+using Benchmark::Result;
+
+void benchQ16(void) {
+  LZ7 leds;
+  std::shared_ptr<Colorspace> colorspace = leds.colorspace();
+  colorspace->finalize(360);
+  std::vector<int> pins = colorspace->getPins();
+
+  RGBWLamp lamp(16, 183.106);
+  lamp.addColorspace(colorspace);
+  lamp.begin();
+
+  const uint32_t S[] = {0, 0x4000, 0x8000, 0xC000, 0x10000};
+  const uint32_t I[] = {0x0CCD, 0x4000, 0x8000, 0xC000, 0x10000};
+  std::vector<HSIColorQ16> fixedcolors;
+  std::vector<HSIColor> colors;
+  for (uint32_t hue=0; hue<0x10000; hue++) {
+    for (unsigned int s=0; s<sizeof(S)/sizeof(S[0]); s++) {
+      for (unsigned int i=0; i<sizeof(I)/sizeof(I[0]); i++) {
+        fixedcolors.push_back(HSIColorQ16(hue, S[s], I[i]));
+        colors.push_back(HSIColor((float)hue*360/0x10000, (float)S[s]/0x10000, (float)I[i]/0x10000));
+      }
+    }
+  }
+  unsigned long n = colors.size();
+
+  // Compare what each path writes to the pins.
+  unsigned long histogram[4] = {0, 0, 0, 0};
+  int worst = 0;
+  std::vector<int> duty(pins.size());
+  for (unsigned long i=0; i<n; i++) {
+    lamp.setColor(colors[i]);
+    for (unsigned int p=0; p<pins.size(); p++) duty[p] = TeensyHost::pin(pins[p]).duty;
+    lamp.setColor(fixedcolors[i]);
+    for (unsigned int p=0; p<pins.size(); p++) {
+      int difference = abs(TeensyHost::pin(pins[p]).duty - duty[p]);
+      worst = std::max(worst, difference);
+      histogram[std::min(difference, 3)]++;
+    }
+  }
+  unsigned long outputs = n * pins.size();
+  printf("%lu colors, %lu pin duties compared at 16 bits.\n", n, outputs);
+  printf("Q16 vs float: exact %.3f%%, 1 LSB %.3f%%, 2 LSB %.3f%%, more %.3f%%, worst %d LSB16 %s\n",
+    100.0*histogram[0]/outputs, 100.0*histogram[1]/outputs, 100.0*histogram[2]/outputs, 100.0*histogram[3]/outputs, worst,
+    Benchmark::check(worst <= 1));
+
+  printf("%-32s %10s %10s %8s\n", "path", "ns/call", "cycles", "allocs");
+  Result result = Benchmark::measure([&](unsigned long i) {
+    lamp.setColor(colors[i]);
+  }, n);
+  printf("%-32s %10.1f %10.0f %8.2f\n", "RGBWLamp::setColor(HSIColor)", result.nanos, result.cycles, result.allocations);
+  result = Benchmark::measure([&](unsigned long i) {
+    lamp.setColor(fixedcolors[i]);
+  }, n);
+  printf("%-32s %10.1f %10.0f %8.2f\n", "RGBWLamp::setColor(HSIColorQ16)", result.nanos, result.cycles, result.allocations);
+}
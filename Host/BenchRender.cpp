@@ -0,0 +1,232 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// The Multimode sketch's modes drawn by RenderScheduler at 100Hz, at
+// the 183Hz PWM frequency and at 500Hz, against the old loop() that
+// drew every pass, here taken as one pass every 50us. For each, the
+// frames drawn and skipped, the analogWrites per second made and left
+// out by RGBWLamp because the pin already had that duty, and the
+// scheduler's frame time and overrun counters, which on the host are
+// host time for the work a frame does.
+//
+// Then the cost of RGBWLamp::setColor() redrawing the same color and a
+// changing one, the heap allocations per frame of the random fader
+// through getLEDs() and getPins() and through the effect interface, and
+// the Rate and Stats commands as text and as frames.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "LZ7.h"
+#include "LampProtocol.h"
+#include "RenderScheduler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define renderSeconds 4
+#define loopPassMicros 50
+
+// The sketch's effects and render(), as in TeensyLED_CIE_USB_Multimode.ino,
+// registered in the order of this enum.
+enum RenderMode {HSIMode, StrobeMode, FadeMode, CycleMode, RandomMode};
+
+static const char *modeNames[] = {"HSI", "Strobe", "Fade", "Cycler", "Random"};
+
+static RGBWLamp lamp(16, 183.106);
+static HSIColor color;
+static HSISteady steady(color);
+static HSIFader fader(HSIColor(0, 1, 0), HSIColor(120, 1, 0), 1000, 0);
+static HSIStrober strober(HSIColor(), HSIColor(), 1000);
+static HSICycler cycler(HSIColor(0, 1, 0), 1000, 1);
+static RandomFader randomfader(1000);
+static EffectRegistry effects;
+// The old loop() drew every pass whether or not anything had changed.
+static bool always;
+
+static boolean render(void) {
+  if (!effects.render() && !always) return false;
+  const LampFrame &frame = effects.getFrame();
+  lamp.setFrame(frame);
+  if (!frame.direct) color = frame.color;
+  return true;
+}
+
+// Sets everything up from scratch and starts a mode, as its command would.
+static void start(RenderMode next) {
+  TeensyHost::reset();
+  static bool once = false;
+  if (!once) {
+    LZ7 lz7;
+    std::shared_ptr<Colorspace> colorspace = lz7.colorspace();
+    colorspace->finalize(360);
+    lamp.addColorspace(colorspace);
+    lz7.addTo(randomfader);
+    effects.add(steady);
+    effects.add(strober);
+    effects.add(fader);
+    effects.add(cycler);
+    effects.add(randomfader);
+    once = true;
+  }
+  lamp.begin();
+  steady.setColor(HSIColor(120, 1, 0.5));
+  strober.setStrober(HSIColor(0, 1, 1), HSIColor(240, 1, 0.2), 100);
+  fader.setFader(HSIColor(0, 1, 0.1), HSIColor(240, 0.5, 1), renderSeconds*1000, 1);
+  cycler.setCycler(HSIColor(0, 1, 1), 10000, 1);
+  randomfader.startRandom(4000);
+  effects.select(next);
+}
+
+struct Run {
+  unsigned long frames, rendered, writes, kept;
+};
+
+static Run freeRunning(RenderMode next) {
+  start(next);
+  always = true;
+  Run run = {0, 0, 0, 0};
+  unsigned long writes = TeensyHost::analogWrites();
+  unsigned long kept = lamp.getWritesSkipped();
+  for (uint64_t t=0; t<(uint64_t)renderSeconds*1000000; t+=loopPassMicros) {
+    run.frames++;
+    if (render()) run.rendered++;
+    TeensyHost::advanceMicros(loopPassMicros);
+  }
+  run.writes = TeensyHost::analogWrites() - writes;
+  run.kept = lamp.getWritesSkipped() - kept;
+  always = false;
+  return run;
+}
+
+static Run scheduled(RenderMode next, float rate, RenderScheduler &scheduler) {
+  start(next);
+  unsigned long writes = TeensyHost::analogWrites();
+  unsigned long kept = lamp.getWritesSkipped();
+  scheduler.setRate(rate);
+  scheduler.resetStats();
+  scheduler.begin();
+  TeensyHost::advanceMicros((uint64_t)renderSeconds*1000000);
+  scheduler.end();
+  Run run = {scheduler.getFrames(), scheduler.getRendered(), TeensyHost::analogWrites() - writes,
+             lamp.getWritesSkipped() - kept};
+  return run;
+}
+
+static void checkCommands(RenderScheduler &scheduler) {
+  int failures = 0;
+  LampCommand command;
+  if (!LampProtocol::parseLine("Rate 500", command) || (command.opcode != LampRate) || (command.rate != 500)) failures++;
+  if (LampProtocol::parseLine("Rate 0", command) || (command.opcode != LampRate)) failures++;
+  if (LampProtocol::parseLine("Rate 70000", command)) failures++;
+  if (!LampProtocol::parseLine("Stats", command) || (command.opcode != LampStats)) failures++;
+  if (LampProtocol::parseLine("Stats 1", command)) failures++;
+
+  LampCommand rate;
+  rate.opcode = LampRate;
+  rate.rate = 183;
+  LampCommand stats;
+  stats.opcode = LampStats;
+  LampCommand report;
+  report.opcode = LampStatsReport;
+  report.frames = scheduler.getFrames();
+  report.rendered = scheduler.getRendered();
+  report.overruns = scheduler.getOverruns();
+  report.minMicros = scheduler.getMinMicros() + 0.5f;
+  report.avgMicros = scheduler.getAvgMicros() + 0.5f;
+  report.maxMicros = scheduler.getMaxMicros() + 0.5f;
+
+  LampProtocol protocol;
+  uint8_t frame[lampMaxFrame];
+  const LampCommand *commands[] = {&rate, &stats, &report};
+  for (int i=0; i<3; i++) {
+    int length = LampProtocol::encode(*commands[i], frame);
+    LampStatus status = LampNone;
+    for (int j=0; j<length; j++) status = protocol.feed(frame[j]);
+    const LampCommand &decoded = protocol.getCommand();
+    if ((length == 0) || (status != LampCommandReady) || (decoded.opcode != commands[i]->opcode)) {
+      failures++;
+      continue;
+    }
+    if ((decoded.opcode == LampRate) && (decoded.rate != rate.rate)) failures++;
+    if ((decoded.opcode == LampStatsReport) &&
+        ((decoded.frames != report.frames) || (decoded.rendered != report.rendered) || (decoded.overruns != report.overruns) ||
+         (decoded.minMicros != report.minMicros) || (decoded.avgMicros != report.avgMicros) || (decoded.maxMicros != report.maxMicros))) failures++;
+  }
+  printf("Rate and Stats as text and frames: %s\n", Benchmark::check(!failures));
+}
+
+void benchRender(void) {
+  const float rates[] = {100, renderRateDefault, 500};
+  const int numRates = sizeof(rates)/sizeof(rates[0]);
+  RenderScheduler scheduler(render);
+
+  printf("%d s of each mode. A 183Hz frame is %.0fus, or %lu cycles at %dMHz.\n",
+         renderSeconds, 1e6/renderRateDefault, (unsigned long)(F_CPU/renderRateDefault), F_CPU/1000000);
+  printf("%-8s %-12s %8s %8s %8s %10s %10s %8s %8s %8s %8s\n", "mode", "drawn by", "frames", "drawn", "skipped", "writes/s", "kept/s",
+         "min us", "avg us", "max us", "overrun");
+  for (int m=HSIMode; m<=RandomMode; m++) {
+    Run run = freeRunning((RenderMode)m);
+    printf("%-8s %-12s %8lu %8lu %8lu %10.0f %10.0f\n", modeNames[m], "loop()", run.frames, run.rendered,
+           run.frames - run.rendered, (double)run.writes/renderSeconds, (double)run.kept/renderSeconds);
+    for (int r=0; r<numRates; r++) {
+      char label[16];
+      snprintf(label, sizeof(label), "%.0fHz", rates[r]);
+      run = scheduled((RenderMode)m, rates[r], scheduler);
+      printf("%-8s %-12s %8lu %8lu %8lu %10.0f %10.0f %8.2f %8.2f %8.2f %8lu\n", modeNames[m], label, run.frames, run.rendered,
+             run.frames - run.rendered, (double)run.writes/renderSeconds, (double)run.kept/renderSeconds, scheduler.getMinMicros(),
+             scheduler.getAvgMicros(), scheduler.getMaxMicros(), (unsigned long)scheduler.getOverruns());
+    }
+  }
+  
+  // What the lamp saves when the frame has not changed, as when the old
+  // loop() redrew a steady color.
+  start(HSIMode);
+  HSIColor colors[2] = {HSIColor(120, 1, 0.5), HSIColor(240, 1, 0.5)};
+  const char *cases[] = {"same color", "changing color"};
+  for (int c=0; c<2; c++) {
+    unsigned long writes = TeensyHost::analogWrites();
+    unsigned long kept = lamp.getWritesSkipped();
+    Benchmark::Result result = Benchmark::measure([&](unsigned long i) {
+      lamp.setColor(colors[c ? (i & 1) : 0]);
+    }, 10000);
+    double calls = (double)(TeensyHost::analogWrites() - writes + lamp.getWritesSkipped() - kept)/lamp.getChannels();
+    printf("setColor, %-15s %8.1f ns %8.1f cycles %6.2f writes %6.2f kept per call\n", cases[c], result.nanos, result.cycles,
+           (TeensyHost::analogWrites() - writes)/calls, (lamp.getWritesSkipped() - kept)/calls);
+  }
+  
+  // The random fader through the vectors the sketch used to draw it with,
+  // and through the effect interface into a frame it keeps.
+  start(RandomMode);
+  unsigned long allocations = TeensyHost::allocations();
+  for (int i=0; i<1000; i++) {
+    std::vector<float> LEDs = randomfader.getLEDs();
+    std::vector<int> pins = randomfader.getPins();
+    lamp.setLEDs(LEDs, pins);
+    TeensyHost::advanceMicros(1000);
+  }
+  printf("Random through getLEDs() and getPins(): %.2f allocations per frame\n", (TeensyHost::allocations() - allocations)/1000.0);
+  allocations = TeensyHost::allocations();
+  for (int i=0; i<1000; i++) {
+    render();
+    TeensyHost::advanceMicros(1000);
+  }
+  printf("Random through EffectRegistry::render(): %.2f allocations per frame\n", (TeensyHost::allocations() - allocations)/1000.0);
+  checkCommands(scheduler);
+}
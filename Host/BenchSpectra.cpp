@@ -0,0 +1,155 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// Spectrum, which teensyled_calgen uses to place LEDs from their power
+// spectra. The tabulated color matching functions against the CIE 1931
+// spectral locus from 380 to 700nm within 1e-4 u'v', and illuminant E
+// and the Planckian locus at illuminant A's 2856K and at 6500K. Then
+// a spectrum read back from the same samples written in each separator
+// Spectrum takes, narrowband LEDs placed through a colorspace against
+// their peaks, and the cost of integrating a spectrum.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "LEDs.h"
+#include "Spectrum.h"
+
+#include <math.h>
+#include <stdio.h>
+
+// x y of the CIE 1931 2 degree observer's spectral locus, to the five
+// places CIE 15 gives them.
+struct LocusPoint {
+  double nm, x, y;
+};
+
+static const LocusPoint locus[] = {
+  {380, 0.17411, 0.00496}, {420, 0.17141, 0.00510}, {450, 0.15664, 0.01770}, {470, 0.12412, 0.05780},
+  {490, 0.04539, 0.29498}, {500, 0.00817, 0.53842}, {505, 0.00386, 0.65482}, {520, 0.07430, 0.83380},
+  {550, 0.30160, 0.69231}, {580, 0.51249, 0.48659}, {600, 0.62704, 0.37249}, {620, 0.69150, 0.30834},
+  {650, 0.72599, 0.27401}, {700, 0.73469, 0.26531},
+};
+
+static double uvDistance(double x1, double y1, double x2, double y2) {
+  double d1 = -2*x1 + 12*y1 + 3, d2 = -2*x2 + 12*y2 + 3;
+  return hypot(4*x1/d1 - 4*x2/d2, 9*y1/d1 - 9*y2/d2);
+}
+
+static double planck(double nm, double kelvin) {
+  double m = nm*1e-9;
+  return 1/(pow(m, 5)*(exp(1.4388e-2/(m*kelvin)) - 1));
+}
+
+// A narrowband LED, a Gaussian of the given width at half its peak.
+static void gaussian(Spectrum &spectrum, double peak, double fwhm) {
+  spectrum.clear();
+  double sigma = fwhm/2.3548;
+  for (int nm=380; nm<=780; nm+=5) spectrum.add(nm, exp(-0.5*(nm - peak)*(nm - peak)/(sigma*sigma)));
+}
+
+void benchSpectra(void) {
+  printf("%-22s %9s %9s %9s %9s %10s\n", "CIE 1931", "x", "y", "table x", "table y", "du'v'");
+  double worstLocus = 0;
+  for (unsigned int i=0; i<sizeof(locus)/sizeof(locus[0]); i++) {
+    Spectrum line;
+    line.add(locus[i].nm, 1);
+    double error = uvDistance(line.getx(), line.gety(), locus[i].x, locus[i].y);
+    worstLocus = fmax(worstLocus, error);
+    char name[32];
+    snprintf(name, sizeof(name), "%.0fnm", locus[i].nm);
+    printf("%-22s %9.4f %9.4f %9.4f %9.4f %10.6f\n", name, line.getx(), line.gety(), locus[i].x, locus[i].y, error);
+  }
+  Spectrum flat, A, daylight;
+  for (int nm=360; nm<=830; nm++) {
+    flat.add(nm, 1);
+    A.add(nm, planck(nm, 2856));
+    daylight.add(nm, planck(nm, 6500));
+  }
+  struct {
+    const char *name;
+    Spectrum &spectrum;
+    double x, y;
+  } sources[] = {{"illuminant E", flat, 1.0/3, 1.0/3}, {"Planck 2856K (A)", A, 0.44757, 0.40745}, {"Planck 6500K", daylight, 0.3135, 0.3236}};
+  double worstSource = 0;
+  for (int i=0; i<3; i++) {
+    double error = uvDistance(sources[i].spectrum.getx(), sources[i].spectrum.gety(), sources[i].x, sources[i].y);
+    worstSource = fmax(worstSource, error);
+    printf("%-22s %9.4f %9.4f %9.4f %9.4f %10.6f\n", sources[i].name, sources[i].spectrum.getx(), sources[i].spectrum.gety(),
+           sources[i].x, sources[i].y, error);
+  }
+  printf("Worst du'v': spectral locus %.6f, broadband sources %.6f %s\n", worstLocus, worstSource,
+         Benchmark::check((worstLocus < 1e-4) && (worstSource < 2e-4)));
+
+  // The same samples as a digitizer, a spreadsheet and a meter save them.
+  Spectrum red;
+  gaussian(red, 623, 18);
+  const char *formats[] = {"%.9g,%.9g\n", "%.9g;%.9g\n", "%.9g\t%.9g\n", "  %.9g   %.9g\n"};
+  const char *headers[] = {"nm,mW/nm\n", "Wavelength;Power\n", "", "# spectrum\n"};
+  int readBack = 0;
+  for (int f=0; f<4; f++) {
+    FILE *file = tmpfile();
+    fputs(headers[f], file);
+    for (int nm=380; nm<=780; nm+=5) fprintf(file, formats[f], (double)nm, red.getPower(nm));
+    rewind(file);
+    Spectrum read;
+    int line;
+    if (read.read(file, line) && (read.getSamples() == red.getSamples()) && (fabs(read.getU() - red.getU()) < 1e-9) &&
+        (fabs(read.getV() - red.getV()) < 1e-9)) readBack++;
+    fclose(file);
+  }
+  printf("Spectrum files: %d of 4 separators read back the same u'v' %s\n", readBack, Benchmark::check(readBack == 4));
+
+  // Narrowband LEDs about a phosphor white, as an LZ7 might measure. Each
+  // lands near its own peak's point on the locus, pulled in by its width.
+  Spectrum white;
+  for (int nm=380; nm<=780; nm+=5) {
+    white.add(nm, 1.0*exp(-0.5*pow((nm - 450)/9.0, 2)) + 0.9*exp(-0.5*pow((nm - 565)/55.0, 2)));
+  }
+  CIELED whiteLED(white.getU(), white.getV(), 1, 9);
+  Colorspace colorspace(whiteLED);
+  const double peaks[] = {623, 590, 523, 505, 460}, widths[] = {18, 14, 32, 30, 22};
+  const int pins[] = {6, 5, 22, 3, 23};
+  printf("\n%-8s %6s %9s %9s %9s %10s\n", "LED", "FWHM", "u'", "v'", "flux", "to line");
+  double fluxes[5];
+  for (int i=0; i<5; i++) {
+    Spectrum LED;
+    gaussian(LED, peaks[i], widths[i]);
+    Spectrum line;
+    line.add(peaks[i], 1);
+    fluxes[i] = LED.getFlux();
+    CIELED cieled(LED.getU(), LED.getV(), 1, pins[i]);
+    colorspace.addLED(cieled);
+    char name[16];
+    snprintf(name, sizeof(name), "%.0fnm", peaks[i]);
+    printf("%-8s %6.0f %9.5f %9.5f %9.1f %10.5f\n", name, widths[i], LED.getU(), LED.getV(), fluxes[i],
+           hypot(LED.getU() - line.getU(), LED.getV() - line.getV()));
+  }
+  std::vector<int> order = colorspace.getPins();
+  printf("Colorspace order by angle:");
+  for (int i=0; i<colorspace.getChannels() - 1; i++) printf(" pin %d at %.3f,", order[i], colorspace.getAngle(i));
+  printf(" white u'v' %.4f %.4f\n", white.getU(), white.getV());
+
+  Benchmark::Result result = Benchmark::measure([&](unsigned long i) {
+    Spectrum LED;
+    gaussian(LED, 500 + (i % 100), 20);
+    Benchmark::sink += LED.getU();
+  }, 2000);
+  printf("Integrating an 81 sample spectrum: %.1f us\n", result.nanos/1000);
+}
@@ -0,0 +1,166 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// The Audio DMX Master's band split against its broadband beat
+// detector. Tone bursts in each band are played through the
+// SpectralAnalyzer, and each is timed from its first sample to the
+// onset in its band and to the light update that shows it, taken to
+// be the next 10ms timestep as in the sketch. Onsets in the other
+// bands during a burst count as crosstalk. The broadband detector's
+// zero must follow a DC offset as the sketch's double filter did. The
+// cost per 128-sample block is against a budget of 2.9ms, or about
+// 209,000 cycles on a 72MHz Teensy 3.1. Every burst must be found in
+// its own band and in no other, and the analyzer must fit the budget.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "AudioSampler.h"
+#include "BeatDetector.h"
+#include "SpectralAnalyzer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#define sampleRate 44100
+#define stepMillis 10
+#define burstMillis 293
+#define burstSeconds 30
+
+static const char *bandNames[audioBands] = {"bass", "mid", "high"};
+static const float bandTones[audioBands] = {60, 800, 8000};
+
+struct Burst {
+  uint32_t start;
+  int band;
+};
+
+// Decaying tone bursts, cycling through the bands, over low noise.
+static std::vector<uint16_t> generate(std::vector<Burst> &bursts) {
+  std::vector<uint16_t> samples(burstSeconds*sampleRate);
+  uint32_t spacing = sampleRate*burstMillis/1000;
+  srand(2);
+  for (uint32_t i=0; i<samples.size(); i++) {
+    uint32_t index = i/spacing;
+    uint32_t offset = i%spacing;
+    int band = index%audioBands;
+    if (offset == 0) bursts.push_back({i, band});
+    float t = (float)offset/sampleRate;
+    float noise = (float)rand()/RAND_MAX*2 - 1;
+    float value = 600*expf(-t/0.04f)*sinf(2*M_PI*bandTones[band]*t) + 15*noise;
+    samples[i] = lrintf(4096 + value);
+  }
+  return samples;
+}
+
+void benchSpectral(void) {
+  std::vector<Burst> bursts;
+  std::vector<uint16_t> samples = generate(bursts);
+  uint32_t spacing = sampleRate*burstMillis/1000;
+  uint32_t stepSamples = sampleRate*stepMillis/1000;
+
+  // Onsets in every band, in the order they were found.
+  SpectralAnalyzer analyzer(sampleRate);
+  std::vector<uint32_t> onsets[audioBands];
+  for (uint32_t i=0; i + audioBlockSamples <= samples.size(); i += audioBlockSamples) {
+    analyzer.process(&samples[i], audioBlockSamples);
+    for (int b=0; b<audioBands; b++) {
+      if (analyzer.onsetDetected((AudioBand)b)) onsets[b].push_back(analyzer.getOnsetSample((AudioBand)b));
+    }
+  }
+
+  printf("%d bursts of %.0f, %.0f and %.0f Hz, %d ms apart\n", (int)bursts.size(), bandTones[0], bandTones[1], bandTones[2], burstMillis);
+  printf("%-6s %8s %8s %10s %10s %10s %10s\n", "band", "bursts", "found", "onset ms", "max", "light ms", "max");
+  unsigned long crosstalk[audioBands][audioBands] = {{0}};
+  for (int b=0; b<audioBands; b++) {
+    unsigned long count = 0, found = 0;
+    double onsetsum = 0, onsetmax = 0, lightsum = 0, lightmax = 0;
+    for (unsigned int k=0; k<bursts.size(); k++) {
+      const Burst &burst = bursts[k];
+      // Skip the first second while levels settle.
+      if (burst.start < sampleRate) continue;
+      std::vector<uint32_t> &found_b = onsets[b];
+      std::vector<uint32_t>::iterator it = std::lower_bound(found_b.begin(), found_b.end(), burst.start);
+      bool inside = (it != found_b.end()) && (*it < burst.start + spacing);
+      if (burst.band != b) {
+        if (inside) crosstalk[burst.band][b]++;
+        continue;
+      }
+      count++;
+      if (!inside) continue;
+      found++;
+      uint32_t light = (*it + stepSamples - 1)/stepSamples*stepSamples;
+      double onset = 1000.0*(*it - burst.start)/sampleRate;
+      double shown = 1000.0*(light - burst.start)/sampleRate;
+      onsetsum += onset;
+      onsetmax = std::max(onsetmax, onset);
+      lightsum += shown;
+      lightmax = std::max(lightmax, shown);
+    }
+    printf("%-6s %8lu %8lu %10.2f %10.2f %10.2f %10.2f %s\n", bandNames[b], count, found,
+           found ? onsetsum/found : 0, onsetmax, found ? lightsum/found : 0, lightmax, Benchmark::check(count && (found == count)));
+  }
+  printf("Onsets in the wrong band:");
+  unsigned long wrong = 0;
+  for (int b=0; b<audioBands; b++) {
+    for (int c=0; c<audioBands; c++) {
+      if (c != b) printf(" %s in %s %lu%s", bandNames[b], bandNames[c], crosstalk[b][c], ((b == audioBands - 1) && (c == audioBands - 2)) ? "" : ",");
+      if (c != b) wrong += crosstalk[b][c];
+    }
+  }
+  printf(" %s\n\n", Benchmark::check(!wrong));
+
+  // The broadband detector's zero follows a DC offset away from where it
+  // starts, as the sketch's original double arithmetic did, over a minute.
+  const uint16_t offsets[] = {4000, 4500, 5000};
+  double zeroWorst = 0;
+  for (int k=0; k<3; k++) {
+    BeatDetector dc(sampleRate);
+    std::vector<uint16_t> block(audioBlockSamples, offsets[k]);
+    double zero = audioZeroStart;
+    for (unsigned long n=0; n<60*sampleRate/audioBlockSamples; n++) {
+      dc.process(block.data(), audioBlockSamples);
+      for (int j=0; j<audioBlockSamples; j++) zero = 0.999999*zero + 0.000001*offsets[k];
+    }
+    printf("%s%.0f to %.3f", k ? ", " : "Zero after 60 s of DC at ", (double)offsets[k], dc.getZero());
+    zeroWorst = fmax(zeroWorst, fabs(dc.getZero() - zero));
+  }
+  printf(", within %.4f of the doubles %s\n\n", zeroWorst, Benchmark::check(zeroWorst < 0.01));
+
+  // Cost per block, over the same audio.
+  unsigned long blocks = samples.size()/audioBlockSamples;
+  SpectralAnalyzer timed(sampleRate);
+  Benchmark::Result spectral = Benchmark::measure([&](unsigned long i) {
+    timed.process(&samples[(i % blocks)*audioBlockSamples], audioBlockSamples);
+  }, blocks);
+  Benchmark::sink = timed.getLevel(BassBand);
+
+  BeatDetector detector(sampleRate);
+  Benchmark::Result broadband = Benchmark::measure([&](unsigned long i) {
+    detector.process(&samples[(i % blocks)*audioBlockSamples], audioBlockSamples);
+  }, blocks);
+  Benchmark::sink = detector.getRMS();
+
+  printf("%-20s %12s %12s %12s\n", "per block", "ns", "cycles", "cycles/sample");
+  printf("%-20s %12.0f %12.0f %12.2f %s\n", "SpectralAnalyzer", spectral.nanos, spectral.cycles, spectral.cycles/audioBlockSamples,
+    Benchmark::check(spectral.cycles < 209000));
+  printf("%-20s %12.0f %12.0f %12.2f\n", "BeatDetector", broadband.nanos, broadband.cycles, broadband.cycles/audioBlockSamples);
+}
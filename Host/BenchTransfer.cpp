@@ -0,0 +1,128 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// RGBWLamp's output transfer and dither. Each curve's table against
+// the curve worked out in double precision, the cost per channel of
+// writing a frame through the linear map, the tables and the dither,
+// and the duty a pin shows averaged over 256 frames for the dimmest
+// 1% of levels against the duty its table asks for, with 0, 4 and 8
+// bits of dither, as effective bits of resolution, up to the 24 the
+// tables hold. Last, the writes per second a steady color costs with
+// the dither on.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Benchmark.h"
+#include "LZ7.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#define averageFrames 256
+
+static const char *curveNames[] = {"linear", "gamma 2.2", "CIE L*"};
+
+// The duty a curve asks for, in codes.
+static double exactDuty(int curve, double level) {
+  double light = level;
+  if (curve == TransferGamma) light = pow(level, 2.2);
+  else if (curve == TransferLstar) light = level > 0.08 ? pow((100*level + 16)/116, 3) : 100*level/903.3;
+  return 0xFFFF*light;
+}
+
+void benchTransfer(void) {
+  TeensyHost::reset();
+  LZ7 lz7;
+  RGBWLamp lamp(16, 183.106);
+  std::shared_ptr<Colorspace> colorspace = lz7.colorspace();
+  colorspace->finalize(360);
+  lamp.addColorspace(colorspace);
+  lamp.begin();
+  int channels = lamp.getChannels();
+  OutputTransfer transfers[] = {OutputTransfer(TransferLinear), OutputTransfer(TransferGamma), OutputTransfer(TransferLstar)};
+
+  printf("%-10s %16s\n", "table", "max error, codes");
+  for (int c=TransferLinear; c<=TransferLstar; c++) {
+    double worst = 0;
+    for (int i=0; i<=100000; i++) {
+      float level = i/100000.0f;
+      worst = fmax(worst, fabs(transfers[c].getDuty(level)/256.0 - exactDuty(c, level)));
+    }
+    printf("%-10s %16.3f %s\n", curveNames[c], worst, Benchmark::check(worst < 0.5));
+  }
+
+  // A frame of changing levels on every channel.
+  float levels[maxChannels];
+  int pins[maxChannels];
+  for (int i=0; i<channels; i++) pins[i] = lamp.getPin(i);
+  printf("\n%d channels a frame%-10s %10s %10s\n", channels, "", "ns/channel", "cycles");
+  const char *paths[] = {"linear, as before", "linear, 4 bit dither", "CIE L* table", "CIE L* table, 4 bit dither"};
+  for (int p=0; p<4; p++) {
+    lamp.setTransfer(p >= 2 ? &transfers[TransferLstar] : 0);
+    lamp.setDither(p & 1 ? 4 : 0);
+    Benchmark::Result result = Benchmark::measure([&](unsigned long i) {
+      for (int c=0; c<channels; c++) levels[c] = ((i*7 + c*131) & 1023)/1023.0f;
+      lamp.setLEDs(levels, pins, channels);
+    }, 10000);
+    printf("%-24s %10.1f %10.1f\n", paths[p], result.nanos/channels, result.cycles/channels);
+  }
+  lamp.setTransfer((const OutputTransfer *)0);
+  lamp.setDither(4);
+  Benchmark::Result stepped = Benchmark::measure([&](unsigned long i) {
+    lamp.dither();
+  }, 10000);
+  printf("%-24s %10.1f %10.1f per frame\n", "dither() alone", stepped.nanos, stepped.cycles);
+
+  // Average duty over 256 frames for each of the dimmest levels.
+  printf("\n%-10s %6s %16s %16s\n", "curve", "dither", "max error, LSB", "effective bits");
+  const int bits[] = {0, 4, 8};
+  int pin = pins[0];
+  for (int c=TransferLinear; c<=TransferLstar; c++) {
+    lamp.setTransfer(0, &transfers[c]);
+    for (int b=0; b<3; b++) {
+      lamp.setDither(bits[b]);
+      double worst = 0;
+      for (int i=0; i<=1000; i++) {
+        float level = i*0.01f/1000;
+        levels[0] = level;
+        double total = 0;
+        lamp.setLEDs(levels, pins, 1);
+        total += TeensyHost::pin(pin).duty;
+        for (int f=1; f<averageFrames; f++) {
+          lamp.dither();
+          total += TeensyHost::pin(pin).duty;
+        }
+        worst = fmax(worst, fabs(total/averageFrames - transfers[c].getDuty(level)/256.0));
+      }
+      printf("%-10s %6d %16.4f %16.1f\n", curveNames[c], bits[b], worst, log2(65536/fmax(worst, 1.0/256)));
+    }
+  }
+
+  // The dither keeps writing pins that sit between two codes.
+  lamp.setTransfer((const OutputTransfer *)0);
+  HSIColor dim(200, 0.8, 0.003);
+  const int steady[] = {0, 4};
+  for (int b=0; b<2; b++) {
+    lamp.setDither(steady[b]);
+    lamp.setColor(dim);
+    unsigned long writes = TeensyHost::analogWrites();
+    for (int f=0; f<183; f++) lamp.dither();
+    printf("Steady dim color, %d bit dither: %lu writes a second at 183Hz\n", steady[b], TeensyHost::analogWrites() - writes);
+  }
+}
@@ -0,0 +1,122 @@
+//*********************************************************
+//
+// TeensyLED Host Benchmarks
+//
+// A small timing harness shared by the benchmark suites. Each
+// suite is a function registered in Bench.cpp and selected by
+// name on the teensyled_bench command line.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "TeensyHost.h"
+
+namespace Benchmark {
+  // Host cycle counter, the TSC where there is one.
+  inline uint64_t cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  inline uint64_t nanos(void) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  struct Result {
+    double nanos;        // Per call.
+    double cycles;       // Per call.
+    double allocations;  // Per call.
+  };
+
+  // Times calls of f() until at least minnanos of wall time has passed
+  // and returns the per-call cost. f() is called with the call index.
+  template <typename F> Result measure(F f, unsigned long calls, uint64_t minnanos = 200000000) {
+    Result result;
+    unsigned long total = 0;
+    unsigned long allocations = TeensyHost::allocations();
+    uint64_t startnanos = nanos();
+    uint64_t startcycles = cycles();
+    do {
+      for (unsigned long i=0; i<calls; i++) f(i);
+      total += calls;
+    } while (nanos() - startnanos < minnanos);
+    result.cycles = (double)(cycles() - startcycles) / total;
+    result.nanos = (double)(nanos() - startnanos) / total;
+    result.allocations = (double)(TeensyHost::allocations() - allocations) / total;
+    return result;
+  }
+
+  // The hue, saturation and intensity sweep every color conversion
+  // is run over, so that results are comparable between paths.
+  struct Sweep {
+    std::vector<float> hue, saturation, intensity;
+    Sweep(float huestep = 0.5) {
+      const float S[] = {0, 0.25, 0.5, 0.75, 1};
+      const float I[] = {0.05, 0.25, 0.5, 0.75, 1};
+      for (float H = 0; H < 360; H += huestep) {
+        for (unsigned int s=0; s<sizeof(S)/sizeof(S[0]); s++) {
+          for (unsigned int i=0; i<sizeof(I)/sizeof(I[0]); i++) {
+            hue.push_back(H);
+            saturation.push_back(S[s]);
+            intensity.push_back(I[i]);
+          }
+        }
+      }
+    }
+    unsigned long size(void) const { return hue.size(); }
+  };
+
+  // Keeps results alive so the optimizer cannot drop the work.
+  extern volatile double sink;
+
+  // Counts a suite's check towards the exit status, and returns "ok" or
+  // "FAILED" to print beside it.
+  const char *check(bool ok);
+  unsigned long failures(void);
+}
+
+// Benchmark suites.
+void benchColor(void);
+void benchLUT(void);
+void benchQ16(void);
+void benchBatch(void);
+void benchDmx(void);
+void benchSpectral(void);
+void benchProtocol(void);
+void benchRender(void);
+void benchLayers(void);
+void benchCues(void);
+void benchClock(void);
+void benchTransfer(void);
+void benchMixing(void);
+void benchPower(void);
+void benchCalibration(void);
+void benchSpectra(void);
+void benchFixed(void);
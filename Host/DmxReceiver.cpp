@@ -0,0 +1,66 @@
+//*********************************************************
+//
+// TeensyLED Host Shim
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "DmxReceiver.h"
+#include "TeensyHost.h"
+
+#include <string.h>
+
+DmxReceiver::DmxReceiver(void) :
+  _length(0),
+  _newframe(false),
+  _running(false),
+  _framenanos(0) {
+  memset(_buffer, 0, sizeof(_buffer));
+}
+
+void DmxReceiver::begin(void) {
+  _running = true;
+}
+
+void DmxReceiver::end(void) {
+  _running = false;
+}
+
+// Takes the latest complete frame, if one has arrived since the last
+// call, and returns its length.
+int DmxReceiver::bufferService(void) {
+  if (!_running) return 0;
+  uint64_t framenanos;
+  int length = TeensyHost::dmxReceive(_buffer, sizeof(_buffer), framenanos);
+  if (length < 0) return 0;
+  // Slots past a short frame keep their old values.
+  if (length > _length) _length = length;
+  _framenanos = framenanos;
+  _newframe = true;
+  return length;
+}
+
+bool DmxReceiver::newFrame(void) {
+  bool newframe = _newframe;
+  _newframe = false;
+  return newframe;
+}
+
+uint8_t DmxReceiver::getDimmer(int d) {
+  if ((d < 0) || (d >= _length)) return 0;
+  return _buffer[d];
+}
@@ -0,0 +1,49 @@
+//*********************************************************
+//
+// TeensyLED Host Shim
+//
+// Stand-in for the DmxReceiver library. Frames come from
+// TeensyHost::dmxInput() and are picked up by bufferService(),
+// which the sketches call from a 1 ms IntervalTimer as they do
+// on the Teensy.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include <stdint.h>
+
+class DmxReceiver {
+  private:
+    uint8_t _buffer[513];
+    int _length;
+    bool _newframe;
+    bool _running;
+    uint64_t _framenanos;
+  public:
+    DmxReceiver(void);
+    void begin(void);
+    void end(void);
+    int bufferService(void);
+    bool newFrame(void);
+    // Channel d of the latest frame, counting from 1. Slot 0 is the
+    // start code.
+    uint8_t getDimmer(int d);
+    // Host only. When the latest frame finished arriving.
+    uint64_t frameNanos(void) const { return _framenanos; }
+};
@@ -0,0 +1,60 @@
+//*********************************************************
+//
+// TeensyLED Host Shim
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "EEPROM.h"
+#include "TeensyHost.h"
+
+#include <string.h>
+
+EEPROMClass EEPROM;
+
+// Erased EEPROM reads as 0xFF.
+static uint8_t contents[E2END + 1] = {0};
+static bool erased = false;
+static unsigned long writes = 0;
+
+static void eraseOnce(void) {
+  if (erased) return;
+  memset(contents, 0xFF, sizeof(contents));
+  erased = true;
+}
+
+uint8_t EEPROMClass::read(int index) {
+  eraseOnce();
+  if ((index < 0) || (index > E2END)) return 0;
+  return contents[index];
+}
+
+void EEPROMClass::write(int index, uint8_t value) {
+  eraseOnce();
+  if ((index < 0) || (index > E2END) || (contents[index] == value)) return;
+  contents[index] = value;
+  writes++;
+}
+
+void TeensyHost::eraseEEPROM(void) {
+  erased = false;
+  eraseOnce();
+}
+
+unsigned long TeensyHost::eepromWrites(void) {
+  return writes;
+}
@@ -0,0 +1,52 @@
+//*********************************************************
+//
+// TeensyLED Host Shim
+//
+// The Teensy 3.1's 2 kB of emulated EEPROM, as the Teensyduino
+// EEPROM library reads and writes it. It keeps its contents across
+// TeensyHost::reset(), as the real one keeps them across a power
+// cycle; see TeensyHost.h to erase it and count the writes.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include <stdint.h>
+
+#define E2END 0x7FF
+
+class EEPROMClass {
+  public:
+    uint8_t read(int index);
+    // Like the Teensy's, a write of the value already there is skipped.
+    void write(int index, uint8_t value);
+    void update(int index, uint8_t value) { write(index, value); }
+    uint16_t length(void) { return E2END + 1; }
+    template <typename T> T &get(int index, T &value) {
+      uint8_t *p = (uint8_t *)&value;
+      for (unsigned int i=0; i<sizeof(T); i++) p[i] = read(index + i);
+      return value;
+    }
+    template <typename T> const T &put(int index, const T &value) {
+      const uint8_t *p = (const uint8_t *)&value;
+      for (unsigned int i=0; i<sizeof(T); i++) write(index + i, p[i]);
+      return value;
+    }
+};
+
+extern EEPROMClass EEPROM;
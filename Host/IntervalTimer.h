@@ -0,0 +1,55 @@
+//*********************************************************
+//
+// TeensyLED Host Shim
+//
+// IntervalTimer for the virtual host clock. Callbacks run from
+// inside delay() or TeensyHost::advanceMicros(), each one at its
+// exact deadline, so code that is "interrupt driven" on the
+// Teensy stays deterministic on the host.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include <stdint.h>
+
+class IntervalTimer {
+  private:
+    void (*_funct)(void);
+    double _periodnanos;
+    uint64_t _startnanos;
+    uint64_t _count;
+    bool _running;
+    IntervalTimer *_next;
+  public:
+    IntervalTimer(void);
+    ~IntervalTimer(void);
+    bool begin(void (*funct)(void), unsigned int microseconds) { return begin(funct, (float)microseconds); }
+    bool begin(void (*funct)(void), int microseconds) { return begin(funct, (float)microseconds); }
+    bool begin(void (*funct)(void), float microseconds);
+    bool begin(void (*funct)(void), double microseconds) { return begin(funct, (float)microseconds); }
+    void update(unsigned int microseconds) { update((float)microseconds); }
+    void update(float microseconds);
+    void priority(uint8_t n) {}
+    void end(void);
+    // Host only. The running timer with the earliest deadline at or
+    // before the given time, or null, and the hooks to service it.
+    static IntervalTimer *due(uint64_t nanos);
+    uint64_t deadline(void) const;
+    void fire(void);
+};
@@ -0,0 +1,68 @@
+//*********************************************************
+//
+// TeensyLED Host Tools
+//
+// The LEDEngin LZ7 emitter set and pinout used by the
+// TeensyLED_CIE_USB_Multimode sketch, so that every host tool
+// exercises the library exactly the way the firmware sets it up.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include "LEDs.h"
+#include "ReferenceColorspace.h"
+
+class LZ7 {
+  public:
+    // u', v', maxvalue, physical pin
+    CIELED white, red, amber, green, cyan, blue, violet;
+    LZ7(void) :
+      white(0.202531646, 0.469936709, (float)180/180, 9),
+      red(0.5137017676, 0.5229440531, (float)78/78, 6),
+      amber(0.3135687079, 0.5529418124, (float)60/60, 5),
+      green(0.0595846867, 0.574988823, (float)125/125, 22),
+      cyan(0.0306675939, 0.5170937486, (float)95/95, 3),
+      blue(0.1747943747, 0.1117834986, (float)30/30, 23),
+      violet(0.35, 0.15, (float)30/30, 4) {
+    }
+    std::shared_ptr<Colorspace> colorspace(void) {
+      std::shared_ptr<Colorspace> colorspace (new Colorspace(white));
+      colorspace->addLED(red);
+      colorspace->addLED(amber);
+      colorspace->addLED(green);
+      colorspace->addLED(cyan);
+      colorspace->addLED(blue);
+      return colorspace;
+    }
+    // The same colorspace in double precision, for measuring against.
+    ReferenceColorspace reference(void) {
+      ReferenceColorspace reference(white.getU(), white.getV());
+      CIELED LEDs[] = {red, amber, green, cyan, blue};
+      for (unsigned int i=0; i<sizeof(LEDs)/sizeof(LEDs[0]); i++) reference.addLED(LEDs[i].getU(), LEDs[i].getV());
+      return reference;
+    }
+    void addTo(RandomFader &randomfader) {
+      randomfader.addLED(red);
+      randomfader.addLED(amber);
+      randomfader.addLED(green);
+      randomfader.addLED(cyan);
+      randomfader.addLED(blue);
+      randomfader.addEffectLED(violet, 0.2);
+    }
+};
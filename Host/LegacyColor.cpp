@@ -0,0 +1,76 @@
+//*********************************************************
+//
+// TeensyLED Host Tools
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include <Arduino.h>
+#include "LegacyColor.h"
+#include "TeensyHost.h"
+
+// Arduino.h is already included, so these only pull the lamp classes
+// into their own namespaces.
+namespace rgbw {
+#include "../TeensyLED.h"
+}
+
+namespace cie {
+#include "../Examples/TeensyLED_CIE/LEDs.cpp"
+}
+
+// Same pinout as the example sketches.
+enum {redpin = 6, greenpin = 22, bluepin = 23, whitepin = 9};
+
+static void readDuty(int *duty) {
+  duty[0] = TeensyHost::pin(redpin).duty;
+  duty[1] = TeensyHost::pin(greenpin).duty;
+  duty[2] = TeensyHost::pin(bluepin).duty;
+  duty[3] = TeensyHost::pin(whitepin).duty;
+}
+
+void setColorRGBW(float H, float S, float I, int *duty) {
+  static rgbw::RGBWLamp lamp(redpin, greenpin, bluepin, whitepin, 16, 183.106);
+  lamp.setHue(H);
+  lamp.setSaturation(S);
+  lamp.setIntensity(I);
+  lamp.setColor();
+  readDuty(duty);
+}
+
+void setColorCIE(float H, float S, float I, int *duty) {
+  static cie::RGBWLamp lamp(redpin, greenpin, bluepin, whitepin, 16, 183.106);
+  static bool started = false;
+  if (!started) {
+    lamp.begin();
+    started = true;
+  }
+  lamp.setHue(H);
+  lamp.setSaturation(S);
+  lamp.setIntensity(I);
+  lamp.setColor();
+  readDuty(duty);
+}
+
+const CIEConstants &cieConstants(void) {
+  static const CIEConstants constants = {
+    Red_ustar, Red_vstar, Green_ustar, Green_vstar, Blue_ustar, Blue_vstar,
+    RGm, GBm, BRm, RedBase, RedAngle, GreenAngle, BlueAngle,
+    RedMax, GreenMax, BlueMax, WhiteMax
+  };
+  return constants;
+}
@@ -0,0 +1,42 @@
+//*********************************************************
+//
+// TeensyLED Host Tools
+//
+// Entry points into the RGBW lamps of the older examples, which
+// each define their own RGBWLamp and so cannot share a translation
+// unit with the Multimode library. Each call sets the color and
+// reads the resulting 16-bit duties back from the recorded pins in
+// red, green, blue, white order.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+// TeensyLED.h, the original HSI to RGBW lamp.
+void setColorRGBW(float H, float S, float I, int *duty);
+
+// Examples/TeensyLED_CIE, the three fixed-angle CIE LEDs plus white.
+void setColorCIE(float H, float S, float I, int *duty);
+
+// The CIE constants that lamp was built from, for reference models.
+struct CIEConstants {
+  double Red_ustar, Red_vstar, Green_ustar, Green_vstar, Blue_ustar, Blue_vstar;
+  double RGm, GBm, BRm, RedBase, RedAngle, GreenAngle, BlueAngle;
+  double RedMax, GreenMax, BlueMax, WhiteMax;
+};
+const CIEConstants &cieConstants(void);
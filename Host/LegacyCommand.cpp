@@ -0,0 +1,326 @@
+//*********************************************************
+//
+// TeensyLED Host Tools
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "LegacyCommand.h"
+
+static int checkFloat(String data);
+static int checkInt(String data);
+
+boolean legacyCommand(String commandstring, LampCommand &command) {
+  command.opcode = 0;
+  if (commandstring.startsWith("HSI ")) {
+    // If it matches HSI, delete the command and capture three floats.
+    commandstring.replace("HSI ", "");
+    // Next, find the 2 spaces between the floats.
+    int spaceIndex = commandstring.indexOf(' ');
+    if (spaceIndex != -1) {
+      int spaceIndex2 = commandstring.indexOf(' ', spaceIndex + 1);
+      if (spaceIndex2 != -1) {
+        // Then check that the three values are floats.
+        if (checkFloat(commandstring.substring(0, spaceIndex)) == 0) {
+          if (checkFloat(commandstring.substring(spaceIndex+1, spaceIndex2)) == 0) {
+            if (checkFloat(commandstring.substring(spaceIndex2+1)) == 0) {
+              command.opcode = LampHSI;
+              command.color1.setHSI(commandstring.substring(0, spaceIndex).toFloat(), commandstring.substring(spaceIndex+1, spaceIndex2).toFloat(), commandstring.substring(spaceIndex2+1).toFloat());
+              return true;
+            }
+            else return false;
+          }
+          else return false;
+        }
+        else return false;
+      }
+      else return false;
+    }
+    else return false;
+  }
+  // Effect LED command.
+  else if (commandstring.startsWith("Effect ")) {
+    commandstring.replace("Effect ", "");
+    if (checkInt(commandstring) == 0) {
+      int effect = commandstring.toInt();
+      if (effect == 0) {
+        command.opcode = LampEffect;
+        command.effect = 0;
+      }
+      else if (effect == 1) {
+        command.opcode = LampEffect;
+        command.effect = 1;
+      }
+      else return false;
+    }
+    else return false;
+  }
+  // Random Fader command.
+  else if (commandstring.startsWith("Random")) {
+    command.opcode = LampRandom;
+    return true;
+  }
+  // DMX command. Start address, personality.
+  else if (commandstring.startsWith("DMX ")) {
+    commandstring.replace("DMX ", "");
+    int spaceIndex = commandstring.indexOf(' ');
+    if (spaceIndex != -1) {
+      if (checkInt(commandstring.substring(0, spaceIndex)) == 0) {
+        if (checkInt(commandstring.substring(spaceIndex+1)) == 0) {
+          int address = commandstring.substring(0, spaceIndex).toInt();
+          int personality = commandstring.substring(spaceIndex+1).toInt();
+          if ((personality >= DMXHSI8) && (personality <= DMXDirect) && (address >= 1) && (address <= 512)) {
+            command.opcode = LampDMX;
+            command.address = address;
+            command.personality = personality;
+            return true;
+          }
+          else return false;
+        }
+        else return false;
+      }
+      else return false;
+    }
+    else return false;
+  }
+  // Cycler command.
+  else if (commandstring.startsWith("Cycler ")) {
+    commandstring.replace("Cycler ", "");
+    int spaceIndex = commandstring.indexOf(' ');
+    if (spaceIndex != -1) {
+      if (checkFloat(commandstring.substring(0, spaceIndex)) == 0) {
+        if (checkInt(commandstring.substring(spaceIndex+1)) == 0) {
+          command.opcode = LampCycle;
+          command.period = commandstring.substring(0, spaceIndex).toFloat();
+          command.direction = commandstring.substring(spaceIndex+1).toInt();
+
+          return true;
+        }
+        else return false;
+      }
+      else return false;
+    }
+    else return false;
+  }
+  // Strobe command. HSI value 1, HSI value 2, period.
+  else if (commandstring.startsWith("Strobe ")) {
+    commandstring.replace("Strobe ", "");
+    // First find the six expected spaces.
+    int spaceIndex = commandstring.indexOf(' ');
+    if (spaceIndex != -1) {
+      int spaceIndex2 = commandstring.indexOf(' ', spaceIndex + 1);
+      if (spaceIndex2 != -1) {
+        int spaceIndex3 = commandstring.indexOf(' ', spaceIndex2 + 1);
+        if (spaceIndex3 != -1) {
+          int spaceIndex4 = commandstring.indexOf(' ', spaceIndex3 + 1);
+          if (spaceIndex4 != -1) {
+            int spaceIndex5 = commandstring.indexOf(' ', spaceIndex4 + 1);
+            if (spaceIndex5 != -1) {
+              int spaceIndex6 = commandstring.indexOf(' ', spaceIndex5 + 1);
+              if (spaceIndex6 != -1) {
+                
+                // Then check that the three values are floats.
+                if (checkFloat(commandstring.substring(0, spaceIndex)) == 0) {
+                  if (checkFloat(commandstring.substring(spaceIndex+1, spaceIndex2)) == 0) {
+                    if (checkFloat(commandstring.substring(spaceIndex2+1, spaceIndex3)) == 0) {
+                      if (checkFloat(commandstring.substring(spaceIndex3+1, spaceIndex4)) == 0) {
+                        if (checkFloat(commandstring.substring(spaceIndex4+1, spaceIndex5)) == 0) {
+                          if (checkFloat(commandstring.substring(spaceIndex5+1, spaceIndex6)) == 0) {
+                            if (checkFloat(commandstring.substring(spaceIndex6+1)) == 0) {
+                              unsigned long time = commandstring.substring(spaceIndex6+1).toFloat();
+                              if (time > 0) {
+                                // Then all the values are valid.
+                                HSIColor color1(commandstring.substring(0, spaceIndex).toFloat(), commandstring.substring(spaceIndex+1, spaceIndex2).toFloat(), commandstring.substring(spaceIndex2+1, spaceIndex3).toFloat());
+                                HSIColor color2(commandstring.substring(spaceIndex3+1, spaceIndex4).toFloat(), commandstring.substring(spaceIndex4+1, spaceIndex5).toFloat(), commandstring.substring(spaceIndex5+1, spaceIndex6).toFloat());
+                                
+                                command.opcode = LampStrobe;
+                                command.color1 = color1;
+                                command.color2 = color2;
+                                command.time = time;
+                                return true;
+                              }
+                              else return false;
+                            }
+                            else return false;
+                          }
+                          else return false;
+                        }
+                        else return false;
+                      }
+                      else return false;
+                    }
+                    else return false;
+                  }
+                  else return false;
+                }
+                else return false;
+              }
+              else return false;
+            }
+            else return false;
+          }
+          else return false;
+        }
+        else return false;
+      }
+      else return false;
+    }
+    else return false;
+  }
+  
+  else if (commandstring.startsWith("Fade ")) {
+    commandstring.replace("Fade ", "");
+    
+    // First find the seven expected spaces.
+    int spaceIndex = commandstring.indexOf(' ');
+    if (spaceIndex != -1) {
+      int spaceIndex2 = commandstring.indexOf(' ', spaceIndex + 1);
+      if (spaceIndex2 != -1) {
+        int spaceIndex3 = commandstring.indexOf(' ', spaceIndex2 + 1);
+        if (spaceIndex3 != -1) {
+          int spaceIndex4 = commandstring.indexOf(' ', spaceIndex3 + 1);
+          if (spaceIndex4 != -1) {
+            int spaceIndex5 = commandstring.indexOf(' ', spaceIndex4 + 1);
+            if (spaceIndex5 != -1) {
+              int spaceIndex6 = commandstring.indexOf(' ', spaceIndex5 + 1);
+              if (spaceIndex6 != -1) {
+                int spaceIndex7 = commandstring.indexOf(' ', spaceIndex6 + 1);
+                if (spaceIndex7 != -1) {
+                
+                  // Then check that the three values are floats.
+                  if (checkFloat(commandstring.substring(0, spaceIndex)) == 0) {
+                    if (checkFloat(commandstring.substring(spaceIndex+1, spaceIndex2)) == 0) {
+                      if (checkFloat(commandstring.substring(spaceIndex2+1, spaceIndex3)) == 0) {
+                        if (checkFloat(commandstring.substring(spaceIndex3+1, spaceIndex4)) == 0) {
+                          if (checkFloat(commandstring.substring(spaceIndex4+1, spaceIndex5)) == 0) {
+                            if (checkFloat(commandstring.substring(spaceIndex5+1, spaceIndex6)) == 0) {
+                              if (checkFloat(commandstring.substring(spaceIndex6+1, spaceIndex7)) == 0) {
+                                if (checkInt(commandstring.substring(spaceIndex7+1)) == 0) {
+                                  unsigned long time = commandstring.substring(spaceIndex6+1, spaceIndex7).toFloat();
+                                  if (time > 0) {
+                                    // Then all the values are valid.
+                                    HSIColor color1(commandstring.substring(0, spaceIndex).toFloat(), commandstring.substring(spaceIndex+1, spaceIndex2).toFloat(), commandstring.substring(spaceIndex2+1, spaceIndex3).toFloat());
+                                    HSIColor color2(commandstring.substring(spaceIndex3+1, spaceIndex4).toFloat(), commandstring.substring(spaceIndex4+1, spaceIndex5).toFloat(), commandstring.substring(spaceIndex5+1, spaceIndex6).toFloat());
+                                    int direction = commandstring.substring(spaceIndex7+1).toInt();
+                                    command.opcode = LampFade;
+                                    command.color1 = color1;
+                                    command.color2 = color2;
+                                    command.time = time;
+                                    command.direction = direction;
+                                    return true;
+                                  }
+                                  else return false;
+                                }
+                                else return false;
+                              }
+                              else return false;
+                            }
+                            else return false;
+                          }
+                          else return false;
+                        }
+                        else return false;
+                      }
+                      else return false;
+                    }
+                    else return false;
+                  }
+                  else return false;
+                }
+                else return false;
+              }
+              else return false;
+            }
+            else return false;
+          }
+          else return false;
+        }
+        else return false;
+      }
+      else return false;
+    }
+    else return false;
+  }
+  // The Effect command answers nothing when it works, and nor does an
+  // unknown command.
+  return command.opcode != 0;
+}
+
+static int checkFloat(String data) {
+  // The simplest way to go about testing the string for only numerical inputs
+  // since Arduino doesn't implement regex, is probably to count the number of 
+  // characters and then count the number of instances of each valid number
+  // character. i.e. [0-9] and the decimal point for a float after trimming
+  // whitespace or newlines.
+  
+  data.trim();
+  // Check to make sure the string isn't now blank.
+  if (data.length() == 0) return -2;
+  
+  unsigned int runningtotal = 0;
+  
+  for (unsigned int j=0; j<data.length(); j++) {
+    char activechar = data.charAt(j);
+    // Test against valid cahracter list.
+    if ((activechar == '-') ||
+        (activechar == '.') ||
+        (activechar == '0') ||
+        (activechar == '1') ||
+        (activechar == '2') ||
+        (activechar == '3') ||
+        (activechar == '4') ||
+        (activechar == '5') ||
+        (activechar == '6') ||
+        (activechar == '7') ||
+        (activechar == '8') ||
+        (activechar == '9')) runningtotal++;
+  }
+  
+  if (runningtotal == data.length()) return 0;
+  else return -1;
+}
+
+static int checkInt(String data) {
+  // The simplest way to go about testing the string for only numerical inputs
+  // since Arduino doesn't implement regex, is probably to count the number of 
+  // characters and then count the number of instances of each valid number
+  // character. i.e. [0-9] and the decimal point for a float after trimming
+  // whitespace or newlines. Oh, plus the negative sign.
+  
+  data.trim();
+  
+  int runningtotal = 0;
+  
+  for (int j=0; j<data.length(); j++) {
+    char activechar = data.charAt(j);
+    // Test against valid cahracter list.
+    if ((activechar == '-') ||
+        (activechar == '0') ||
+        (activechar == '1') ||
+        (activechar == '2') ||
+        (activechar == '3') ||
+        (activechar == '4') ||
+        (activechar == '5') ||
+        (activechar == '6') ||
+        (activechar == '7') ||
+        (activechar == '8') ||
+        (activechar == '9')) runningtotal++;
+  }
+  
+  if (runningtotal == data.length()) return 0;
+  else return -1;
+}
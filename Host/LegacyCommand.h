@@ -0,0 +1,33 @@
+//*********************************************************
+//
+// TeensyLED Host Tools
+//
+// The Multimode sketch's String based text command parser, as it
+// was before LampProtocol, kept for comparison. The checks are the
+// same, but for DMX addresses only being range checked as there is no
+// fixture. Where the sketch acted on a command this fills in the
+// equivalent LampCommand instead, and where it answered OK or ERROR
+// this returns true or false.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include "LampProtocol.h"
+
+boolean legacyCommand(String commandstring, LampCommand &command);
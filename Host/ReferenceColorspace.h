@@ -0,0 +1,82 @@
+//*********************************************************
+//
+// TeensyLED Host Tools
+//
+// A double precision model of Colorspace::Hue2LEDs, used as the
+// reference the firmware conversions are measured against. It
+// follows the same algorithm as the library: order the LEDs by
+// their angle around the white point, find the pair bracketing the
+// target hue, and intersect the hue ray with the line between them.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include <math.h>
+#include <vector>
+
+class ReferenceColorspace {
+  private:
+    double _whiteu, _whitev;
+    std::vector<double> _u, _v, _angle;
+  public:
+    ReferenceColorspace(double whiteu, double whitev) :
+      _whiteu(whiteu),
+      _whitev(whitev) {
+    }
+    void addLED(double u, double v) {
+      double angle = fmod((180/M_PI) * atan2(v - _whitev, u - _whiteu) + 360, 360);
+      unsigned int i = 0;
+      while ((i < _angle.size()) && (_angle[i] < angle)) i++;
+      _u.insert(_u.begin() + i, u);
+      _v.insert(_v.begin() + i, v);
+      _angle.insert(_angle.begin() + i, angle);
+    }
+    int size(void) const {
+      return _angle.size();
+    }
+    double getAngle(int LEDnum) const {
+      return _angle[LEDnum];
+    }
+    // Fills out[0..size()] with the LED levels followed by white.
+    void hue2LEDs(double H, double S, double I, double *out) const {
+      int n = _angle.size();
+      H = fmod(fmod(H, 360) + 360, 360);
+      for (int i=0; i<=n; i++) out[i] = 0;
+      int LED1, LED2;
+      if ((H < _angle[0]) || (H >= _angle[n-1])) {
+        LED1 = n - 1;
+        LED2 = 0;
+      }
+      else {
+        LED2 = 1;
+        while ((LED2 < n - 1) && (H > _angle[LED2])) LED2++;
+        LED1 = LED2 - 1;
+      }
+      double u1 = _u[LED1] - _whiteu, v1 = _v[LED1] - _whitev;
+      double u2 = _u[LED2] - _whiteu, v2 = _v[LED2] - _whitev;
+      // Intersect the hue ray with the segment in parametric form so
+      // that vertical edges and hues near 90 and 270 degrees are exact.
+      double dx = cos(M_PI*H/180), dy = sin(M_PI*H/180);
+      double ex = u2 - u1, ey = v2 - v1;
+      double t = (dx*v1 - dy*u1) / (dy*ex - dx*ey);
+      out[LED1] = I * S * (1 - t);
+      out[LED2] = I * S * t;
+      out[n] = I * (1 - S);
+    }
+};
@@ -0,0 +1,74 @@
+//*********************************************************
+//
+// TeensyLED Host Spectra
+//
+// An LED's power spectrum and where it lands in CIE 1931 and 1976. The
+// color matching functions are the CIE 1931 2 degree observer, tabulated
+// at every 5nm from 380 to 780nm and linear between. A spectrum is
+// integrated at every nanometer over that range, linearly between its
+// samples.
+//
+// A spectrum file has a wavelength in nm and a power on each line,
+// separated by a comma, semicolon, tab or spaces, as a spreadsheet or a
+// digitizer saves them. Lines that do not start with a number, such as
+// headers, are skipped. The power can be in any units; in W/nm, the
+// flux comes out in lumens.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+
+// The CIE 1931 2 degree color matching functions at a wavelength in nm.
+double cieX(double nm);
+double cieY(double nm);
+double cieZ(double nm);
+
+class Spectrum {
+  private:
+    std::vector<double> _nm, _power;
+    double _X, _Y, _Z;
+    bool _integrated;
+    void integrate(void);
+  public:
+    Spectrum(void);
+    void clear(void);
+    // Samples must come in order of wavelength.
+    bool add(double nm, double power);
+    // False if the file has fewer than two samples, or they are out of
+    // order, with the line it stopped at in line.
+    bool read(FILE *file, int &line);
+    int getSamples(void);
+    // Power at a wavelength, 0 outside the samples.
+    double getPower(double nm);
+    // Wavelength of the highest sample.
+    double getPeak(void);
+
+    double getX(void);
+    double getY(void);
+    double getZ(void);
+    // CIE 1931 x y and CIE 1976 u' v'.
+    double getx(void);
+    double gety(void);
+    double getU(void);
+    double getV(void);
+    // 683 lm/W times Y.
+    double getFlux(void);
+};
@@ -0,0 +1,108 @@
+//*********************************************************
+//
+// TeensyLED Host Shim
+//
+// Host-side controls for the Teensy stand-in: the virtual clock,
+// the recorded pin state, injected analog, serial and DMX input,
+// and a count of heap allocations made by the code under test.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace TeensyHost {
+  const int numPins = 64;
+
+  struct PinState {
+    uint8_t mode;
+    uint8_t digital;
+    int duty;
+    float frequency;
+    unsigned long writes;
+    uint64_t lastwritenanos;
+  };
+
+  // Puts the clock back to zero and clears pins, serial and counters.
+  void reset(void);
+
+  // The virtual clock, in nanoseconds since reset. Advancing it runs
+  // every IntervalTimer callback that falls due, in deadline order.
+  uint64_t nanos(void);
+  void advanceNanos(uint64_t nanos);
+  void advanceMicros(uint64_t micros);
+
+  const PinState &pin(uint8_t pin);
+  unsigned long analogWrites(void);
+  int analogResolution(void);
+
+  // Optional observer called on every analogWrite().
+  void onAnalogWrite(void (*hook)(uint8_t pin, int value));
+
+  // Source of analogRead() values. Reads return mid-scale without one.
+  void setAnalogInput(int (*source)(uint8_t pin));
+
+  void serialInput(const char *data, size_t length);
+  void serialInput(const std::string &data);
+  // Or arriving a byte every bytenanos from now, after anything already
+  // on its way.
+  void serialInput(const std::string &data, uint64_t bytenanos);
+  std::string serialOutput(void);
+  void clearSerialOutput(void);
+
+  // DMX512 arriving on Serial1, for the DmxReceiver stand-in. A frame
+  // is the start code and its slots, sent at 250 kbaud after a 100us
+  // break and 12us mark after break, straight after whatever was sent
+  // before it. Returns the time its last slot ends.
+  uint64_t dmxInput(const uint8_t *frame, int length);
+  // Copies out the latest frame fully received by now, dropping it and
+  // any older ones. Returns its length, or -1 if there is none.
+  int dmxReceive(uint8_t *buffer, int size, uint64_t &endnanos);
+
+  // Serial1's transmit line, as the DmxTransmitter stand-in drives it:
+  // each stretch of time it is held low, held high, or sending a byte.
+  enum LineState {LineBreak, LineMark, LineByte};
+  struct LineEvent {
+    uint64_t startnanos, endnanos;
+    LineState state;
+    uint8_t value;
+  };
+  void lineEvent(const LineEvent &event);
+  const std::vector<LineEvent> &line(void);
+  void clearLine(void);
+  // Recording is on after reset. Turning it off leaves only the cost of
+  // the code driving the line in interruptNanos().
+  void recordLine(bool record);
+
+  // Host wall clock time spent inside IntervalTimer callbacks since
+  // reset, a stand-in for interrupt load.
+  uint64_t interruptNanos(void);
+
+  // Sets every EEPROM byte back to 0xFF, and the number of bytes
+  // changed by EEPROM writes since start up.
+  void eraseEEPROM(void);
+  unsigned long eepromWrites(void);
+
+  // Number of operator new calls since start up, and the bytes they asked
+  // for.
+  unsigned long allocations(void);
+  unsigned long allocatedBytes(void);
+}
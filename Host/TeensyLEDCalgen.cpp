@@ -0,0 +1,259 @@
+//*********************************************************
+//
+// TeensyLED Host Calibration Generator
+//
+// Turns a fixture's measured LEDs into the calibration the Multimode
+// sketch keeps in EEPROM, as described in Calibration.h, or into a header
+// of the same LEDs for building in.
+//
+//   teensyled_calgen measurements [blob|header.h]
+//
+// The measurements file has one LED a line:
+//
+//   role pin uv|xy a b max [power [chance]]
+//   role pin spectrum file max [power [chance]]
+//
+// where role is white, color or effect, a and b are the LED's CIE
+// 1976 u' v' or CIE 1931 x y as a meter reports them, or file is its
+// power spectrum as described in Spectrum.h, relative to the
+// measurements file. max is its maximum value, or auto when every white
+// and color LED has a spectrum, to balance their flux so that each gives
+// as much light as the dimmest at full. power is its power for a unit of
+// light (1 if left out) and chance how often RandomFader turns an effect
+// LED on. # starts a comment.
+//
+// The LEDs are printed with their hue angles about the white point, as
+// Colorspace works them out, then the text commands that send the
+// calibration over USB and save it. A blob, if named, gets its bytes; a
+// header gets the LEDs as CIELEDs, with the angles and slopes and a
+// ColorspaceTable of them.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "Calibration.h"
+#include "Spectrum.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+static const char *roleNames[] = {"white", "color", "effect"};
+
+// Reads the measurements into calibration, with each LED's flux from its
+// spectrum, or 0. False, having said why, if a line does not read or the
+// LEDs are not a usable calibration.
+static bool readMeasurements(FILE *file, const std::string &filename, Calibration &calibration, std::vector<double> &fluxes) {
+  std::string directory = filename.find('/') == std::string::npos ? "" : filename.substr(0, filename.rfind('/') + 1);
+  std::vector<bool> automatic;
+  char line[512];
+  int number = 0;
+  while (fgets(line, sizeof(line), file)) {
+    number++;
+    char *comment = strchr(line, '#');
+    if (comment) *comment = 0;
+    char role[16], space[16], a[256], b[32], max[32];
+    int pin;
+    double power = 1, chance = 0;
+    int fields = sscanf(line, "%15s %d %15s %255s", role, &pin, space, a);
+    if (fields <= 0) continue;
+    int r = 0;
+    while ((r < 3) && strcmp(role, roleNames[r])) r++;
+    bool spectral = (fields == 4) && !strcmp(space, "spectrum");
+    if (spectral) fields = sscanf(line, "%*s %*d %*s %*s %31s %lf %lf", max, &power, &chance) + 5;
+    else fields = sscanf(line, "%*s %*d %*s %*s %31s %31s %lf %lf", b, max, &power, &chance) + 4;
+    if ((fields < 6) || (r == 3) || (!spectral && strcmp(space, "uv") && strcmp(space, "xy")) || (pin < 0) || (pin >= lampPins)) {
+      fprintf(stderr, "%s:%d: expected role pin uv|xy a b max [power [chance]] or role pin spectrum file max [power [chance]]\n",
+              filename.c_str(), number);
+      return false;
+    }
+    double u, v, flux = 0;
+    if (spectral) {
+      std::string path = a[0] == '/' ? std::string(a) : directory + a;
+      FILE *csv = fopen(path.c_str(), "r");
+      Spectrum spectrum;
+      int stopped = 0;
+      if (!csv || !spectrum.read(csv, stopped)) {
+        if (csv) fprintf(stderr, "%s:%d: not a spectrum\n", path.c_str(), stopped);
+        else fprintf(stderr, "%s:%d: cannot open %s\n", filename.c_str(), number, path.c_str());
+        if (csv) fclose(csv);
+        return false;
+      }
+      fclose(csv);
+      u = spectrum.getU();
+      v = spectrum.getV();
+      flux = spectrum.getFlux();
+    }
+    else {
+      u = atof(a);
+      v = atof(b);
+      if (!strcmp(space, "xy")) {
+        double d = -2*u + 12*v + 3;
+        u = 4*atof(a)/d;
+        v = 9*atof(b)/d;
+      }
+    }
+    bool isAuto = !strcmp(max, "auto");
+    double maxvalue = isAuto ? 1 : atof(max);
+    if ((u < 0) || (u > 1) || (v < 0) || (v > 1) || (maxvalue < 0) || (maxvalue > 1) || (power < 0) || (power >= 16) ||
+        (chance < 0) || (chance > 1)) {
+      fprintf(stderr, "%s:%d: u' v', max and chance run from 0 to 1, and power from 0 to 16\n", filename.c_str(), number);
+      return false;
+    }
+    if (isAuto && !spectral) {
+      fprintf(stderr, "%s:%d: max can only be auto for an LED with a spectrum\n", filename.c_str(), number);
+      return false;
+    }
+    if (!calibration.addLED(CIELED(u, v, maxvalue, pin, power), r, chance)) {
+      fprintf(stderr, "%s:%d: more than %d LEDs\n", filename.c_str(), number, maxChannels);
+      return false;
+    }
+    fluxes.push_back(flux);
+    automatic.push_back(isAuto);
+  }
+  if (!calibration.isValid()) {
+    fprintf(stderr, "%s: a calibration needs one white and at least three colors\n", filename.c_str());
+    return false;
+  }
+
+  // Balance the automatic LEDs against the dimmest white or color.
+  double dimmest = 0;
+  bool balance = false;
+  for (int i=0; i<calibration.getCount(); i++) {
+    if (calibration.getLED(i).role == CalibrationEffect) continue;
+    if (fluxes[i] <= 0) dimmest = -1;
+    else if ((dimmest >= 0) && ((dimmest == 0) || (fluxes[i] < dimmest))) dimmest = fluxes[i];
+    balance = balance || automatic[i];
+  }
+  if (!balance) return true;
+  if (dimmest <= 0) {
+    fprintf(stderr, "%s: auto needs a spectrum with some light in it for every white and color LED\n", filename.c_str());
+    return false;
+  }
+  Calibration balanced;
+  for (int i=0; i<calibration.getCount(); i++) {
+    CalibratedLED LED = calibration.getLED(i);
+    float maxvalue = automatic[i] ? (LED.role == CalibrationEffect ? 1 : dimmest/fluxes[i]) : LED.LED.getMax();
+    balanced.addLED(CIELED(LED.LED.getU(), LED.LED.getV(), maxvalue, LED.LED.getPin(), LED.LED.getPower()), LED.role, LED.chance);
+  }
+  calibration = balanced;
+  return true;
+}
+
+// The LEDs as code, with the colorspace's angles and slopes, all as stored.
+static bool writeHeader(const char *filename, const char *source, Calibration &stored, Colorspace &colorspace) {
+  FILE *out = fopen(filename, "w");
+  if (!out) return false;
+  fprintf(out, "// Generated by teensyled_calgen from %s.\n\n#pragma once\n\n#include \"ColorspaceTable.h\"\n\n", source);
+  fprintf(out, "// u', v', maxvalue, physical pin, power\n");
+  const char *names[] = {"calibratedWhite", "calibratedColor", "calibratedEffect"};
+  int counts[3] = {0, 0, 0};
+  for (int i=0; i<stored.getCount(); i++) {
+    CalibratedLED LED = stored.getLED(i);
+    fprintf(out, "static constexpr CIELED %s", names[LED.role]);
+    if (LED.role != CalibrationWhite) fprintf(out, "%d", counts[LED.role]);
+    fprintf(out, "(%.9g, %.9g, %.9g, %d, %.9g);\n", LED.LED.getU(), LED.LED.getV(), LED.LED.getMax(), LED.LED.getPin(),
+            LED.LED.getPower());
+    if (LED.role == CalibrationEffect) fprintf(out, "static const float calibratedEffect%dChance = %.9g;\n", counts[LED.role], LED.chance);
+    counts[LED.role]++;
+  }
+  int LEDs = colorspace.getChannels() - 1;
+  std::vector<int> pins = colorspace.getPins();
+  fprintf(out, "\n// The colors in order of hue angle about the white point, in degrees, as\n");
+  fprintf(out, "// Colorspace works them out, and the slope in u'v' of the gamut edge from\n");
+  fprintf(out, "// each to the next. The first angle is the hue offset of red that older\n");
+  fprintf(out, "// examples carry as RedBase.\n");
+  fprintf(out, "#define calibratedColors %d\nstatic const int calibratedPins[] = {", LEDs);
+  for (int i=0; i<LEDs; i++) fprintf(out, "%s%d", i ? ", " : "", pins[i]);
+  fprintf(out, "};\nstatic const float calibratedAngles[] = {");
+  for (int i=0; i<LEDs; i++) fprintf(out, "%s%.9g", i ? ", " : "", colorspace.getAngle(i));
+  fprintf(out, "};\nstatic const float calibratedSlopes[] = {");
+  for (int i=0; i<LEDs; i++) fprintf(out, "%s%.9g", i ? ", " : "", colorspace.getSlope(i));
+  fprintf(out, "};\n#define calibratedRedBase %.9g\n", colorspace.getAngle(0));
+  fprintf(out, "\n// The colorspace of the white and color LEDs, built by the compiler into\n");
+  fprintf(out, "// flash: std::shared_ptr<Colorspace>(new Colorspace(calibratedColorspace)).\n");
+  fprintf(out, "static constexpr ColorspaceTable<calibratedColors, 360> calibratedColorspace(calibratedWhite");
+  for (int i=0; i<counts[CalibrationColor]; i++) fprintf(out, ", calibratedColor%d", i);
+  fprintf(out, ");\n");
+  return !fclose(out);
+}
+
+int main(int argc, char **argv) {
+  if ((argc < 2) || (argc > 3)) {
+    fprintf(stderr, "Usage: %s measurements [blob|header.h]\n", argv[0]);
+    return 1;
+  }
+  FILE *file = fopen(argv[1], "r");
+  if (!file) {
+    fprintf(stderr, "Cannot open %s.\n", argv[1]);
+    return 1;
+  }
+  Calibration calibration;
+  std::vector<double> fluxes;
+  bool ok = readMeasurements(file, argv[1], calibration, fluxes);
+  fclose(file);
+  if (!ok) return 1;
+
+  // What the fixture will get, after the rounding of the stored form.
+  uint8_t blob[calibrationEEPROMSize];
+  int size = calibration.encode(blob);
+  Calibration stored;
+  stored.decode(blob, size);
+  std::shared_ptr<Colorspace> colorspace = stored.colorspace();
+  std::vector<int> pins = colorspace->getPins();
+  fprintf(stderr, "%-7s %4s %9s %9s %9s %7s %7s %10s %8s\n", "role", "pin", "u'", "v'", "hue", "max", "power", "flux", "chance");
+  for (int i=0; i<stored.getCount(); i++) {
+    CalibratedLED LED = stored.getLED(i);
+    int channel = 0;
+    while ((channel < colorspace->getChannels() - 1) && (pins[channel] != LED.LED.getPin())) channel++;
+    fprintf(stderr, "%-7s %4d %9.5f %9.5f ", roleNames[LED.role], LED.LED.getPin(), LED.LED.getU(), LED.LED.getV());
+    if (LED.role == CalibrationColor) fprintf(stderr, "%9.4f", colorspace->getAngle(channel));
+    else fprintf(stderr, "%9s", "");
+    fprintf(stderr, " %7.4f %7.3f ", LED.LED.getMax(), LED.LED.getPower());
+    if (fluxes[i] > 0) fprintf(stderr, "%10.4g", fluxes[i]);
+    else fprintf(stderr, "%10s", "");
+    fprintf(stderr, " %8.3f\n", LED.chance);
+  }
+  fprintf(stderr, "%d bytes at EEPROM address %d.\n", size, calibrationEEPROMAddress);
+
+  if (argc == 3) {
+    std::string name = argv[2];
+    bool header = (name.size() > 2) && (name.substr(name.size() - 2) == ".h");
+    if (header) ok = writeHeader(argv[2], argv[1], stored, *colorspace);
+    else {
+      FILE *out = fopen(argv[2], "wb");
+      ok = out && (fwrite(blob, 1, size, out) == (size_t)size);
+      if (out) ok = !fclose(out) && ok;
+    }
+    if (!ok) {
+      fprintf(stderr, "Cannot write %s.\n", argv[2]);
+      return 1;
+    }
+  }
+
+  // The commands, each LED exactly as stored.
+  printf("CalClear\r\n");
+  for (int i=0; i<stored.getCount(); i++) {
+    CalibratedLED LED = stored.getLED(i);
+    printf("CalLED %d %d %.6f %.6f %.6f %.6f %.6f\r\n", LED.role, LED.LED.getPin(), LED.LED.getU(), LED.LED.getV(),
+           LED.LED.getMax(), LED.LED.getPower(), LED.chance);
+  }
+  printf("CalApply\r\nCalSave\r\n");
+  return 0;
+}
@@ -0,0 +1,139 @@
+//*********************************************************
+//
+// TeensyLED Host DMX Replay
+//
+// Plays a DMX byte stream into the Multimode sketch's DMX fixture
+// mode on the virtual clock and reports how long each frame took
+// to reach the PWM outputs and what it cost to apply.
+//
+//   teensyled_dmx [hsi8|hsi16|direct] [address] [file] [slots]
+//
+// The file holds frames back to back, each the start code followed
+// by its channels, slots bytes in all (513 by default, a full
+// universe). Without a file a hue and intensity sweep is generated.
+// Frames go out at DMX512 line rate and the receiver is serviced
+// from a 1 ms IntervalTimer, as in the sketch.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "LEDs.h"
+#include "LZ7.h"
+#include "Benchmark.h"
+#include "DmxReceiver.h"
+#include "TeensyHost.h"
+
+#include <stdio.h>
+#include <string>
+
+static DmxReceiver *dmx;
+static DMXFixture *fixture;
+
+static unsigned long applied = 0;
+static double latencysum = 0, latencymax = 0, latencymin = 1e30;
+static double costsum = 0, costmax = 0;
+
+static void dmxTimerISR(void) {
+  dmx->bufferService();
+  if (dmx->newFrame()) {
+    uint64_t start = Benchmark::nanos();
+    fixture->apply(*dmx);
+    double cost = Benchmark::nanos() - start;
+    double latency = (TeensyHost::nanos() - dmx->frameNanos()) / 1000.0;
+    applied++;
+    latencysum += latency;
+    latencymax = std::max(latencymax, latency);
+    latencymin = std::min(latencymin, latency);
+    costsum += cost;
+    costmax = std::max(costmax, cost);
+  }
+}
+
+int main(int argc, char **argv) {
+  std::string name = argc > 1 ? argv[1] : "hsi8";
+  int address = argc > 2 ? atoi(argv[2]) : 1;
+  const char *filename = argc > 3 ? argv[3] : 0;
+  int slots = argc > 4 ? atoi(argv[4]) : 513;
+
+  DMXPersonality personality;
+  if (name == "hsi8") personality = DMXHSI8;
+  else if (name == "hsi16") personality = DMXHSI16;
+  else if (name == "direct") personality = DMXDirect;
+  else {
+    fprintf(stderr, "Unknown personality %s.\n", name.c_str());
+    return 1;
+  }
+
+  TeensyHost::reset();
+
+  RGBWLamp lamp(16, 183.106);
+  LZ7 leds;
+  std::shared_ptr<Colorspace> colorspace = leds.colorspace();
+  colorspace->finalize(360);
+  lamp.addColorspace(colorspace);
+  lamp.begin();
+
+  DmxReceiver receiver;
+  DMXFixture dmxfixture(lamp, 1, DMXHSI8);
+  if (!dmxfixture.setFixture(address, personality) || (address + dmxfixture.getFootprint() > slots)) {
+    fprintf(stderr, "The %s fixture does not fit at address %d in %d slot frames.\n", name.c_str(), address, slots);
+    return 1;
+  }
+  dmx = &receiver;
+  fixture = &dmxfixture;
+  IntervalTimer dmxTimer;
+  receiver.begin();
+  dmxTimer.begin(dmxTimerISR, 1000);
+
+  // Queue every frame on the line.
+  std::vector<uint8_t> frame(slots);
+  unsigned long sent = 0;
+  uint64_t lastend = 0;
+  if (filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+      fprintf(stderr, "Cannot open %s.\n", filename);
+      return 1;
+    }
+    while (fread(frame.data(), 1, slots, file) == (size_t)slots) {
+      lastend = TeensyHost::dmxInput(frame.data(), slots);
+      sent++;
+    }
+    fclose(file);
+  }
+  else {
+    for (int i=0; i<200; i++) {
+      std::fill(frame.begin(), frame.end(), 0);
+      for (int j=0; j<dmxfixture.getFootprint(); j++) frame[address + j] = (i*5 + j*40) & 0xFF;
+      lastend = TeensyHost::dmxInput(frame.data(), slots);
+      sent++;
+    }
+  }
+
+  TeensyHost::advanceNanos(lastend + 2000000);
+
+  printf("%lu frames of %d slots sent, %lu applied.\n", sent, slots, applied);
+  if (applied) {
+    printf("Frame end to PWM update: min %.1f us, mean %.1f us, max %.1f us\n", latencymin, latencysum/applied, latencymax);
+    printf("Host cost to apply a frame: mean %.0f ns, max %.0f ns\n", costsum/applied, costmax);
+    std::vector<int> pins = colorspace->getPins();
+    printf("Duties after the last frame:");
+    for (unsigned int i=0; i<pins.size(); i++) printf(" pin%d=%d", pins[i], TeensyHost::pin(pins[i]).duty);
+    printf("\n");
+  }
+  return 0;
+}
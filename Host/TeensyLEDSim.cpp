@@ -0,0 +1,97 @@
+//*********************************************************
+//
+// TeensyLED Host Simulator
+//
+// Runs one of the Multimode sketch's effects against the host
+// shim on the virtual clock and prints the recorded PWM duty of
+// every lamp pin as CSV, one row per frame.
+//
+//   teensyled_sim [hsi|fade|strobe|cycle|random] [seconds] [framemicros]
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "LEDs.h"
+#include "LZ7.h"
+#include "TeensyHost.h"
+
+#include <stdio.h>
+#include <string>
+
+int main(int argc, char **argv) {
+  std::string mode = argc > 1 ? argv[1] : "cycle";
+  float seconds = argc > 2 ? atof(argv[2]) : 2;
+  unsigned long framemicros = argc > 3 ? atol(argv[3]) : 10000;
+
+  TeensyHost::reset();
+
+  // Same construction order as the sketch's globals and setup().
+  RGBWLamp lamp(16, 183.106);
+  HSIColor color(0, 1, 0);
+  HSISteady steady(color);
+  HSIFader fader(HSIColor(0, 1, 0), HSIColor(120, 1, 0), 1000, 0);
+  HSIStrober strober(HSIColor(), HSIColor(), 1000);
+  HSICycler cycler(HSIColor(0, 1, 0), 1000, 1);
+  RandomFader randomfader(1000);
+
+  LZ7 leds;
+  std::shared_ptr<Colorspace> colorspace = leds.colorspace();
+  colorspace->finalize(360);
+  lamp.addColorspace(colorspace);
+  leds.addTo(randomfader);
+  lamp.begin();
+
+  cycler.setCycler(HSIColor(0, 1, 1), 1000, 1);
+  randomfader.startRandom(4000);
+  fader.setFader(HSIColor(0, 1, 0), HSIColor(240, 0.5, 1), seconds*1000, 1);
+  strober.setStrober(HSIColor(0, 1, 1), HSIColor(180, 1, 0.2), 250);
+  steady.setColor(HSIColor(200, 0.8, 0.5));
+
+  // Drawn through the effect interface, as the sketch's render() does.
+  EffectRegistry effects;
+  const char *names[] = {"hsi", "strobe", "fade", "cycle", "random"};
+  Effect *modes[] = {&steady, &strober, &fader, &cycler, &randomfader};
+  for (int i=0; i<5; i++) {
+    int number = effects.add(*modes[i]);
+    if (mode == names[i]) effects.select(number);
+  }
+  if (effects.getActive() == noEffect) {
+    fprintf(stderr, "Unknown mode %s.\n", mode.c_str());
+    return 1;
+  }
+
+  const int pins[] = {6, 5, 22, 3, 23, 9, 4};
+  const int numpins = sizeof(pins)/sizeof(pins[0]);
+
+  printf("micros");
+  for (int i=0; i<numpins; i++) printf(",pin%d", pins[i]);
+  printf("\n");
+
+  unsigned long frames = seconds * 1e6 / framemicros;
+  for (unsigned long frame=0; frame<frames; frame++) {
+    if (effects.render()) lamp.setFrame(effects.getFrame());
+
+    printf("%lu", (unsigned long)micros());
+    for (int i=0; i<numpins; i++) printf(",%d", TeensyHost::pin(pins[i]).duty);
+    printf("\n");
+
+    TeensyHost::advanceMicros(framemicros);
+  }
+
+  fprintf(stderr, "%lu analogWrite calls over %lu frames.\n", TeensyHost::analogWrites(), frames);
+  return 0;
+}
@@ -0,0 +1,225 @@
+//*********************************************************
+//
+// TeensyLED Host Audio Replay
+//
+// Plays a WAV file into the Audio DMX Master's background sampler
+// and beat detector on the virtual clock, much faster than real time.
+// The consumer reads blocks the way the sketch's loop() does and
+// stalls now and then; every sample taken is checked to reach it once
+// and in order. Detected beats and each retuning of the threshold are
+// printed as they happen, for tuning bpsTarget and the detector's
+// constants against recordings.
+//
+//   teensyled_wav [file.wav|-] [stallms] [bps] [beats.txt]
+//
+// The file is mixed to mono and resampled to the sketch's sample
+// rate, then offset and scaled as a line level signal on a 13-bit
+// ADC biased at half scale. Without a file, or with -, a 120 bpm kick drum with
+// hi-hats is generated. Once a second the consumer stops reading for
+// stallms milliseconds (10 by default), standing in for a slow
+// serial write or a long render. bps is the detector's target beats
+// per second (6, as in the sketch, by default).
+//
+// If beat times are known, from a text file of times in seconds one
+// per line or those of the generated signal, detected beats within
+// 70ms of one count as hits and the precision and recall are given.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "AudioSampler.h"
+#include "BeatDetector.h"
+#include "Benchmark.h"
+#include "TeensyHost.h"
+#include "WavFile.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+// As in the sketch.
+#define audioSampleRate 44100
+#define audioBits 13
+#define bpsTarget 6
+#define timestep 10
+
+// How far a detected beat may be from a known one to count.
+#define beatTolerance 0.07
+
+// 1V peak to peak on a 3.3V reference, about 1241 counts either side
+// of mid-scale at 13 bits.
+#define lineLevel (0.5f/3.3f*(1 << audioBits))
+
+// Consumer poll period when it is not stalled.
+#define pollMicros 100
+
+static WavFile wav;
+static std::vector<uint16_t> taken;
+static std::vector<double> known;
+
+// Every conversion the sampler starts takes the next sample of the
+// file, and is logged so the consumer can be checked against it.
+static int audioInput(uint8_t pin) {
+  size_t index = (uint64_t)taken.size()*wav.rate/audioSampleRate;
+  float sample = (index < wav.samples.size()) ? wav.samples[index] : 0;
+  int value = lrintf((1 << (audioBits - 1)) + sample*lineLevel);
+  value = std::max(0, std::min((1 << audioBits) - 1, value));
+  taken.push_back(value);
+  return value;
+}
+
+static void generate(float seconds) {
+  wav.rate = audioSampleRate;
+  wav.samples.resize(seconds*wav.rate);
+  srand(1);
+  for (size_t i=0; i<wav.samples.size(); i++) {
+    float t = (float)i/wav.rate;
+    float beat = fmodf(t, 0.5f);
+    float hat = fmodf(t + 0.25f, 0.5f);
+    float kick = expf(-beat*30)*sinf(2*M_PI*(50 + 100*expf(-beat*40))*beat);
+    float noise = (float)rand()/RAND_MAX*2 - 1;
+    wav.samples[i] = 0.7f*kick + 0.15f*expf(-hat*200)*noise;
+  }
+  for (double t = 0; t < seconds; t += 0.5) known.push_back(t);
+}
+
+static bool readBeats(const char *filename) {
+  FILE *file = fopen(filename, "r");
+  if (!file) return false;
+  double t;
+  while (fscanf(file, "%lf", &t) == 1) known.push_back(t);
+  fclose(file);
+  std::sort(known.begin(), known.end());
+  return true;
+}
+
+// Pairs detected and known beats in time order, each at most once.
+static unsigned long countHits(const std::vector<double> &detected) {
+  unsigned long hits = 0;
+  size_t j = 0;
+  for (size_t i=0; i<known.size(); i++) {
+    while ((j < detected.size()) && (detected[j] < known[i] - beatTolerance)) j++;
+    if ((j < detected.size()) && (detected[j] <= known[i] + beatTolerance)) {
+      hits++;
+      j++;
+    }
+  }
+  return hits;
+}
+
+int main(int argc, char **argv) {
+  float stallms = (argc > 2) ? atof(argv[2]) : 10;
+  float bps = (argc > 3) ? atof(argv[3]) : bpsTarget;
+  bool generated = (argc < 2) || !strcmp(argv[1], "-");
+  if (!generated) {
+    wav = readWav(argv[1]);
+    if (!wav.error.empty()) {
+      fprintf(stderr, "%s: %s\n", argv[1], wav.error.c_str());
+      return 1;
+    }
+  }
+  else generate(60);
+  if ((argc > 4) && !readBeats(argv[4])) {
+    fprintf(stderr, "%s: cannot open file\n", argv[4]);
+    return 1;
+  }
+  double seconds = (double)wav.samples.size()/wav.rate;
+  printf("Input: %s, %.2f s at %u Hz, sampled at %d Hz\n", generated ? "generated" : argv[1], seconds, wav.rate, audioSampleRate);
+  printf("Ring: %d blocks of %d samples, %.1f ms; stall %.1f ms each second\n", audioRingBlocks, audioBlockSamples, 1000.0*audioRingSamples/audioSampleRate, stallms);
+
+  TeensyHost::reset();
+  TeensyHost::setAnalogInput(audioInput);
+  taken.reserve(seconds*audioSampleRate + audioRingSamples);
+
+  AudioSampler sampler(0, audioSampleRate, audioBits);
+  BeatDetector detector(audioSampleRate, bps, timestep);
+  sampler.begin();
+
+  uint16_t block[audioBlockSamples];
+  unsigned long blocks = 0, mismatched = 0;
+  int backlog = 0;
+  double costsum = 0, costmax = 0;
+  double detectsum = 0, detectmax = 0;
+  std::vector<double> beats;
+  uint64_t endnanos = seconds*1e9;
+  uint64_t nextstall = 1000000000;
+  while (TeensyHost::nanos() < endnanos) {
+    if (TeensyHost::nanos() >= nextstall) {
+      TeensyHost::advanceNanos(stallms*1e6);
+      nextstall += 1000000000;
+    }
+    else TeensyHost::advanceMicros(pollMicros);
+
+    backlog = std::max(backlog, sampler.available());
+    for (;;) {
+      uint64_t start = Benchmark::nanos();
+      boolean read = sampler.readBlock(block);
+      double cost = Benchmark::nanos() - start;
+      if (!read) break;
+      costsum += cost;
+      costmax = std::max(costmax, cost);
+      // Where this block should start in everything taken, allowing
+      // for whatever was skipped.
+      size_t position = blocks*audioBlockSamples + sampler.getDropped();
+      for (int i=0; i<audioBlockSamples; i++) {
+        if ((position + i >= taken.size()) || (block[i] != taken[position + i])) {
+          mismatched++;
+          break;
+        }
+      }
+      blocks++;
+
+      start = Benchmark::nanos();
+      detector.process(block, audioBlockSamples);
+      cost = Benchmark::nanos() - start;
+      detectsum += cost;
+      detectmax = std::max(detectmax, cost);
+      // Timestamps are in the audio as delivered, which only differs
+      // from the input if samples were dropped.
+      if (detector.beatDetected()) {
+        double t = (double)detector.getBeatSample()/audioSampleRate;
+        beats.push_back(t);
+        printf("beat %.4f s volume %.2f\n", t, detector.getBeatVolume());
+      }
+      if (detector.tuned()) {
+        printf("tune %.4f s %.2f bps threshold %.3f decay %.0f ms\n", (double)detector.getSampleCount()/audioSampleRate, detector.getBeatsPerSecond(), detector.getThreshold(), detector.getDecayPeriod());
+      }
+    }
+  }
+  sampler.end();
+
+  unsigned long samples = sampler.getSampleCount();
+  unsigned long delivered = blocks*audioBlockSamples;
+  printf("Samples taken:     %lu\n", samples);
+  printf("Samples delivered: %lu in %lu blocks, %lu still in the ring\n", delivered, blocks, samples - delivered - sampler.getDropped());
+  printf("Samples dropped:   %lu\n", (unsigned long)sampler.getDropped());
+  printf("Blocks out of order or corrupt: %lu\n", mismatched);
+  printf("Largest backlog:   %d of %d blocks\n", backlog, audioRingBlocks);
+  printf("Sampling interrupt: %.0f ns per sample (host)\n", (double)TeensyHost::interruptNanos()/samples);
+  printf("readBlock:         %.0f ns mean, %.0f ns max per block (host)\n", blocks ? costsum/blocks : 0, costmax);
+  printf("BeatDetector:      %.0f ns mean, %.0f ns max per block, %.1f ns per sample, %.0fx real time (host)\n", blocks ? detectsum/blocks : 0, detectmax, delivered ? detectsum/delivered : 0, detectsum ? delivered*1e9/audioSampleRate/detectsum : 0);
+  printf("Beats:             %lu, %.2f per second against a target of %.2f\n", (unsigned long)beats.size(), beats.size()/seconds, bps);
+  printf("Final tuning:      threshold %.3f, decay %.0f ms\n", detector.getThreshold(), detector.getDecayPeriod());
+  if (!known.empty()) {
+    unsigned long hits = countHits(beats);
+    printf("Known beats:       %lu, %lu hit within %.0f ms\n", (unsigned long)known.size(), hits, beatTolerance*1000);
+    printf("Precision %.3f, recall %.3f\n", beats.empty() ? 0 : (double)hits/beats.size(), (double)hits/known.size());
+  }
+  return ((mismatched == 0) && (sampler.getDropped() == 0)) ? 0 : 2;
+}
@@ -0,0 +1,249 @@
+//*********************************************************
+//
+// TeensyLED Host Shim
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "WString.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void String::assign(const char *s, unsigned int length) {
+  char *buffer = 0;
+  if (length > 0) {
+    buffer = new char[length + 1];
+    memcpy(buffer, s, length);
+    buffer[length] = 0;
+  }
+  delete[] _buffer;
+  _buffer = buffer;
+  _length = length;
+}
+
+String::String(const char *s) :
+  _buffer(0),
+  _length(0) {
+  assign(s, strlen(s));
+}
+
+String::String(const String &s) :
+  _buffer(0),
+  _length(0) {
+  assign(s.c_str(), s._length);
+}
+
+String::String(char c) :
+  _buffer(0),
+  _length(0) {
+  assign(&c, 1);
+}
+
+static const char *formatInteger(char *buffer, unsigned long value, bool negative, unsigned char base) {
+  char *p = buffer + 33;
+  *p = 0;
+  if (base < 2 || base > 16) base = 10;
+  do {
+    *--p = "0123456789abcdef"[value % base];
+    value /= base;
+  } while (value);
+  if (negative) *--p = '-';
+  return p;
+}
+
+String::String(int value, unsigned char base) :
+  _buffer(0),
+  _length(0) {
+  char buffer[34];
+  const char *s = formatInteger(buffer, value < 0 && base == 10 ? -(long)value : (unsigned int)value, value < 0 && base == 10, base);
+  assign(s, strlen(s));
+}
+
+String::String(unsigned int value, unsigned char base) :
+  _buffer(0),
+  _length(0) {
+  char buffer[34];
+  const char *s = formatInteger(buffer, value, false, base);
+  assign(s, strlen(s));
+}
+
+String::String(long value, unsigned char base) :
+  _buffer(0),
+  _length(0) {
+  char buffer[34];
+  const char *s = formatInteger(buffer, value < 0 && base == 10 ? -(unsigned long)value : (unsigned long)value, value < 0 && base == 10, base);
+  assign(s, strlen(s));
+}
+
+String::String(unsigned long value, unsigned char base) :
+  _buffer(0),
+  _length(0) {
+  char buffer[34];
+  const char *s = formatInteger(buffer, value, false, base);
+  assign(s, strlen(s));
+}
+
+String::String(float value, unsigned char decimalPlaces) :
+  _buffer(0),
+  _length(0) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimalPlaces, value);
+  assign(buffer, strlen(buffer));
+}
+
+String::String(double value, unsigned char decimalPlaces) :
+  _buffer(0),
+  _length(0) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimalPlaces, value);
+  assign(buffer, strlen(buffer));
+}
+
+String::~String(void) {
+  delete[] _buffer;
+}
+
+String & String::operator = (const String &s) {
+  if (this != &s) assign(s.c_str(), s._length);
+  return *this;
+}
+
+String & String::operator = (const char *s) {
+  assign(s, strlen(s));
+  return *this;
+}
+
+String & String::operator += (const String &s) {
+  return *this += s.c_str();
+}
+
+String & String::operator += (const char *s) {
+  unsigned int length = strlen(s);
+  if (length == 0) return *this;
+  // Arduino reallocates the buffer on every concatenation.
+  char *buffer = new char[_length + length + 1];
+  memcpy(buffer, c_str(), _length);
+  memcpy(buffer + _length, s, length + 1);
+  delete[] _buffer;
+  _buffer = buffer;
+  _length += length;
+  return *this;
+}
+
+String & String::operator += (char c) {
+  char s[2] = {c, 0};
+  return *this += s;
+}
+
+String operator + (const String &lhs, const String &rhs) {
+  String ret(lhs);
+  ret += rhs;
+  return ret;
+}
+
+String operator + (const String &lhs, const char *rhs) {
+  String ret(lhs);
+  ret += rhs;
+  return ret;
+}
+
+String operator + (const char *lhs, const String &rhs) {
+  String ret(lhs);
+  ret += rhs;
+  return ret;
+}
+
+char String::charAt(unsigned int index) const {
+  if (index >= _length) return 0;
+  return _buffer[index];
+}
+
+bool String::equals(const String &s) const {
+  return (_length == s._length) && (strcmp(c_str(), s.c_str()) == 0);
+}
+
+bool String::startsWith(const String &prefix) const {
+  if (prefix._length > _length) return false;
+  return strncmp(c_str(), prefix.c_str(), prefix._length) == 0;
+}
+
+bool String::endsWith(const String &suffix) const {
+  if (suffix._length > _length) return false;
+  return strcmp(c_str() + _length - suffix._length, suffix.c_str()) == 0;
+}
+
+int String::indexOf(char c, unsigned int fromIndex) const {
+  if (fromIndex >= _length) return -1;
+  const char *p = strchr(c_str() + fromIndex, c);
+  return p ? p - c_str() : -1;
+}
+
+int String::indexOf(const String &s, unsigned int fromIndex) const {
+  if (fromIndex >= _length) return -1;
+  const char *p = strstr(c_str() + fromIndex, s.c_str());
+  return p ? p - c_str() : -1;
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) {
+    unsigned int temp = endIndex;
+    endIndex = beginIndex;
+    beginIndex = temp;
+  }
+  String ret;
+  if (beginIndex >= _length) return ret;
+  if (endIndex > _length) endIndex = _length;
+  ret.assign(c_str() + beginIndex, endIndex - beginIndex);
+  return ret;
+}
+
+void String::replace(const String &find, const String &replace) {
+  if (find._length == 0 || _length == 0) return;
+  String ret;
+  const char *p = c_str();
+  const char *match;
+  while ((match = strstr(p, find.c_str())) != 0) {
+    String head;
+    head.assign(p, match - p);
+    ret += head;
+    ret += replace;
+    p = match + find._length;
+  }
+  ret += p;
+  *this = ret;
+}
+
+void String::trim(void) {
+  const char *begin = c_str();
+  const char *end = begin + _length;
+  while ((begin < end) && (*begin == ' ' || *begin == '\t' || *begin == '\r' || *begin == '\n')) begin++;
+  while ((end > begin) && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) end--;
+  if ((begin == c_str()) && (end == c_str() + _length)) return;
+  String ret;
+  ret.assign(begin, end - begin);
+  *this = ret;
+}
+
+long String::toInt(void) const {
+  return atol(c_str());
+}
+
+float String::toFloat(void) const {
+  return atof(c_str());
+}
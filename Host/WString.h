@@ -0,0 +1,70 @@
+//*********************************************************
+//
+// TeensyLED Host Shim
+//
+// The subset of the Arduino String class used by the sketches.
+// Like the original, every non-empty String owns its own heap
+// buffer, so allocation counts on the host are representative
+// of what the same code costs on the Teensy.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+class String {
+  private:
+    char *_buffer;
+    unsigned int _length;
+    void assign(const char *s, unsigned int length);
+  public:
+    String(const char *s = "");
+    String(const String &s);
+    explicit String(char c);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(float value, unsigned char decimalPlaces = 2);
+    explicit String(double value, unsigned char decimalPlaces = 2);
+    ~String(void);
+    String & operator = (const String &s);
+    String & operator = (const char *s);
+    String & operator += (const String &s);
+    String & operator += (const char *s);
+    String & operator += (char c);
+    friend String operator + (const String &lhs, const String &rhs);
+    friend String operator + (const String &lhs, const char *rhs);
+    friend String operator + (const char *lhs, const String &rhs);
+    unsigned int length(void) const { return _length; }
+    const char *c_str(void) const { return _buffer ? _buffer : ""; }
+    char charAt(unsigned int index) const;
+    char operator [] (unsigned int index) const { return charAt(index); }
+    bool equals(const String &s) const;
+    bool operator == (const String &s) const { return equals(s); }
+    bool operator != (const String &s) const { return !equals(s); }
+    bool startsWith(const String &prefix) const;
+    bool endsWith(const String &suffix) const;
+    int indexOf(char c, unsigned int fromIndex = 0) const;
+    int indexOf(const String &s, unsigned int fromIndex = 0) const;
+    String substring(unsigned int beginIndex) const { return substring(beginIndex, _length); }
+    String substring(unsigned int beginIndex, unsigned int endIndex) const;
+    void replace(const String &find, const String &replace);
+    void trim(void);
+    long toInt(void) const;
+    float toFloat(void) const;
+};
@@ -0,0 +1,96 @@
+//*********************************************************
+//
+// TeensyLED Host Tools
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#include "WavFile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static uint32_t little(const uint8_t *p, int bytes) {
+  uint32_t value = 0;
+  for (int i=bytes-1; i>=0; i--) value = (value << 8) | p[i];
+  return value;
+}
+
+WavFile readWav(const char *filename) {
+  WavFile wav;
+  wav.rate = 0;
+  FILE *file = fopen(filename, "rb");
+  if (!file) {
+    wav.error = "cannot open file";
+    return wav;
+  }
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) data.insert(data.end(), chunk, chunk + n);
+  fclose(file);
+
+  if ((data.size() < 12) || memcmp(&data[0], "RIFF", 4) || memcmp(&data[8], "WAVE", 4)) {
+    wav.error = "not a RIFF WAVE file";
+    return wav;
+  }
+
+  int format = 0, channels = 0, bits = 0;
+  size_t position = 12;
+  while (position + 8 <= data.size()) {
+    const uint8_t *header = &data[position];
+    size_t size = little(header + 4, 4);
+    const uint8_t *body = header + 8;
+    if (position + 8 + size > data.size()) size = data.size() - position - 8;
+    if (!memcmp(header, "fmt ", 4) && (size >= 16)) {
+      format = little(body, 2);
+      channels = little(body + 2, 2);
+      wav.rate = little(body + 4, 4);
+      bits = little(body + 14, 2);
+      // WAVE_FORMAT_EXTENSIBLE keeps the real format in the sub-format.
+      if ((format == 0xFFFE) && (size >= 26)) format = little(body + 24, 2);
+    }
+    else if (!memcmp(header, "data", 4)) {
+      if ((format != 1) || (channels < 1) || (bits % 8) || (bits < 8) || (bits > 32)) {
+        wav.error = "only integer PCM is supported";
+        return wav;
+      }
+      int bytes = bits/8;
+      size_t frames = size / (bytes*channels);
+      wav.samples.reserve(frames);
+      for (size_t i=0; i<frames; i++) {
+        float sum = 0;
+        for (int c=0; c<channels; c++) {
+          const uint8_t *p = body + (i*channels + c)*bytes;
+          float value;
+          if (bits == 8) value = (p[0] - 128) / 128.0f;
+          else {
+            // Sign extend from the top byte.
+            int32_t raw = little(p, bytes) << (32 - bits);
+            value = raw / 2147483648.0f;
+          }
+          sum += value;
+        }
+        wav.samples.push_back(sum/channels);
+      }
+      return wav;
+    }
+    position += 8 + size + (size & 1);
+  }
+  wav.error = "no data chunk";
+  return wav;
+}
@@ -0,0 +1,40 @@
+//*********************************************************
+//
+// TeensyLED Host Tools
+//
+// Minimal reader for PCM WAV files, enough to feed recorded
+// audio to the audio sketches. 8, 16, 24 and 32-bit integer PCM
+// are read, and multiple channels are mixed down to mono.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct WavFile {
+  uint32_t rate;
+  // Mono samples scaled to -1 to 1.
+  std::vector<float> samples;
+  // Empty on success, otherwise what was wrong with the file.
+  std::string error;
+};
+
+WavFile readWav(const char *filename);
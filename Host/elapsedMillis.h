@@ -0,0 +1,54 @@
+//*********************************************************
+//
+// TeensyLED Host Shim
+//
+// elapsedMillis and elapsedMicros, matching the Teensy core
+// but counted against the virtual host clock.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include <stdint.h>
+
+uint32_t micros(void);
+uint32_t millis(void);
+
+class elapsedMillis {
+  private:
+    uint32_t ms;
+  public:
+    elapsedMillis(void) { ms = millis(); }
+    elapsedMillis(uint32_t val) { ms = millis() - val; }
+    operator uint32_t () const { return millis() - ms; }
+    elapsedMillis & operator = (uint32_t val) { ms = millis() - val; return *this; }
+    elapsedMillis & operator -= (uint32_t val) { ms += val; return *this; }
+    elapsedMillis & operator += (uint32_t val) { ms -= val; return *this; }
+};
+
+class elapsedMicros {
+  private:
+    uint32_t us;
+  public:
+    elapsedMicros(void) { us = micros(); }
+    elapsedMicros(uint32_t val) { us = micros() - val; }
+    operator uint32_t () const { return micros() - us; }
+    elapsedMicros & operator = (uint32_t val) { us = micros() - val; return *this; }
+    elapsedMicros & operator -= (uint32_t val) { us += val; return *this; }
+    elapsedMicros & operator += (uint32_t val) { us -= val; return *this; }
+};
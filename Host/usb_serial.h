@@ -0,0 +1,65 @@
+//*********************************************************
+//
+// TeensyLED Host Shim
+//
+// USB Serial for the host. Bytes written by the sketch are
+// captured, and bytes the host program injects with
+// TeensyHost::serialInput() are what the sketch reads back.
+// Like the real Stream, readStringUntil() and readBytes() wait up
+// to the timeout for each byte, which here advances the virtual
+// clock to when it arrives or the timeout is up.
+//
+// This file is part of TeensyLED Controller.
+//
+// TeensyLED Controller is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TeensyLED Controller is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TeensyLED Controller.  If not, see <http://www.gnu.org/licenses/>.
+//
+//**********************************************************
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "WString.h"
+
+class usb_serial_class {
+  private:
+    unsigned long _timeout;
+    int timedRead(void);
+  public:
+    usb_serial_class(void) : _timeout(1000) {}
+    void begin(long baud) {}
+    int available(void);
+    int read(void);
+    int peek(void);
+    size_t readBytes(char *buffer, size_t length);
+    String readStringUntil(char terminator);
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+    void flush(void) {}
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t print(const char *s);
+    size_t print(const String &s) { return print(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int n) { return print((long)n); }
+    size_t print(unsigned int n) { return print((unsigned long)n); }
+    size_t print(long n);
+    size_t print(unsigned long n);
+    size_t print(double n, int digits = 2);
+    size_t println(void) { return print("\r\n"); }
+    template <typename T> size_t println(T value) { return print(value) + println(); }
+    size_t println(double n, int digits) { return print(n, digits) + println(); }
+    operator bool() const { return true; }
+};
+
+extern usb_serial_class Serial;